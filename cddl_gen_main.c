@@ -0,0 +1,687 @@
+/*==============================================================================
+  cddl_gen_main.c -- Generates C encoders and decoders from CDDL
+
+ Copyright (c) 2026, Laurence Lundblade. All rights reserved.
+
+ SPDX-License-Identifier: BSD-3-Clause
+
+ See BSD-3-Clause license in README.md
+
+ Created on 10/15/26
+ =============================================================================*/
+
+/*
+ Usage: qcborcddl <schema.cddl> <output-base>
+
+ This reads a CDDL schema and writes <output-base>.h and
+ <output-base>.c. For each map rule in the schema there is a C
+ structure and functions to encode and decode it. The generated code
+ uses the compiled records of QCBOREncode_AddRecord() and
+ QCBORDecode_GetRecord(), so the labels, types and layout are fixed
+ when the code is generated rather than discovered while decoding.
+
+ Only the part of CDDL that maps directly onto C structures is
+ handled. Labels must be integers given by a name that is defined as
+ an integer constant elsewhere in the schema, the usual style for
+ COSE and EAT. The name becomes the structure member.
+
+     pose = {
+        time     => int,
+        x        => float,
+      ? status   => uint .size 4,
+        name     => tstr,
+     }
+     time   = 1
+     x      = 2
+     status = 5
+     name   = 6
+
+ Member types are int, uint, float (any of the float types), bool,
+ tstr / text and bstr / bytes. int and uint may be followed by .size 4
+ to make a 32-bit member. Optional members, those marked with ?, have
+ a bit in the uPresent member of the structure. Anything else, for
+ example arrays, nested maps, choices and text labels, is an error.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+
+#define MAX_NAME     64
+#define MAX_RULES    128
+#define MAX_MEMBERS  32 /* Same as QCBOR_MAX_RECORD_FIELDS */
+
+
+/* Member types, each corresponds to a QCBOR_RECORD_XXX */
+enum MemberType {
+   MT_INT64,
+   MT_INT32,
+   MT_UINT64,
+   MT_UINT32,
+   MT_DOUBLE,
+   MT_BOOL,
+   MT_TEXT,
+   MT_BYTES
+};
+
+static const struct {
+   const char *szRecordType;
+   const char *szCType;
+   const char *szAddFunction;
+} aTypeInfo[] = {
+   {"INT64",  "int64_t",    "QCBOREncode_AddInt64ToMapN"},
+   {"INT32",  "int32_t",    "QCBOREncode_AddInt64ToMapN"},
+   {"UINT64", "uint64_t",   "QCBOREncode_AddUInt64ToMapN"},
+   {"UINT32", "uint32_t",   "QCBOREncode_AddUInt64ToMapN"},
+   {"DOUBLE", "double",     "QCBOREncode_AddDoubleToMapN"},
+   {"BOOL",   "bool",       "QCBOREncode_AddBoolToMapN"},
+   {"TEXT",   "UsefulBufC", "QCBOREncode_AddTextToMapN"},
+   {"BYTES",  "UsefulBufC", "QCBOREncode_AddBytesToMapN"},
+};
+
+
+typedef struct {
+   char            szName[MAX_NAME];  /* Label name and member name */
+   enum MemberType uType;
+   bool            bOptional;
+   int             nLine;
+} Member;
+
+typedef struct {
+   char     szName[MAX_NAME];
+   int      nLine;
+   bool     bIsMap;
+   int64_t  nValue;     /* For integer constants */
+   unsigned uNumMembers;
+   Member   aMembers[MAX_MEMBERS];
+} Rule;
+
+
+/* Tokens from the CDDL input */
+enum TokenType {
+   TOK_END,
+   TOK_NAME,
+   TOK_INT,
+   TOK_CONTROL, /* A control operator like .size */
+   TOK_PUNCT    /* One of = { } , ? : or => */
+};
+
+typedef struct {
+   enum TokenType uType;
+   char           szText[MAX_NAME];
+   int64_t        nValue;
+   int            nLine;
+} Token;
+
+typedef struct {
+   const char *szFileName;
+   const char *pCursor;
+   int         nLine;
+   Token       Peeked;
+   bool        bHavePeeked;
+} Lexer;
+
+
+static Rule     aRules[MAX_RULES];
+static unsigned uNumRules;
+
+
+static void Fail(const char *szFileName, int nLine, const char *szFormat, ...)
+{
+   va_list ap;
+
+   fprintf(stderr, "%s:%d: ", szFileName, nLine);
+   va_start(ap, szFormat);
+   vfprintf(stderr, szFormat, ap);
+   va_end(ap);
+   fputs("\n", stderr);
+   exit(1);
+}
+
+
+static bool IsNameStart(int c)
+{
+   return isalpha(c) || c == '_' || c == '@' || c == '$';
+}
+
+
+static bool IsNameChar(int c)
+{
+   return IsNameStart(c) || isdigit(c) || c == '-';
+}
+
+
+static Token ReadToken(Lexer *pLex)
+{
+   Token       Tok;
+   const char *p;
+   size_t      uLen;
+
+   memset(&Tok, 0, sizeof(Tok));
+
+   /* Skip white space and comments */
+   for(p = pLex->pCursor; *p; p++) {
+      if(*p == ';') {
+         while(p[1] && p[1] != '\n') {
+            p++;
+         }
+      } else if(*p == '\n') {
+         pLex->nLine++;
+      } else if(!isspace((unsigned char)*p)) {
+         break;
+      }
+   }
+   Tok.nLine = pLex->nLine;
+
+   if(*p == '\0') {
+      Tok.uType = TOK_END;
+
+   } else if(IsNameStart((unsigned char)*p) || *p == '.') {
+      const char *pStart = p;
+      Tok.uType = *p == '.' ? TOK_CONTROL : TOK_NAME;
+      p++;
+      while(IsNameChar((unsigned char)*p)) {
+         p++;
+      }
+      uLen = (size_t)(p - pStart);
+      if(uLen >= MAX_NAME) {
+         Fail(pLex->szFileName, Tok.nLine, "name too long");
+      }
+      memcpy(Tok.szText, pStart, uLen);
+
+   } else if(isdigit((unsigned char)*p) || (*p == '-' && isdigit((unsigned char)p[1]))) {
+      char *pEnd;
+      Tok.uType  = TOK_INT;
+      Tok.nValue = strtoll(p, &pEnd, 0);
+      p = pEnd;
+
+   } else if(p[0] == '=' && p[1] == '>') {
+      Tok.uType = TOK_PUNCT;
+      strcpy(Tok.szText, "=>");
+      p += 2;
+
+   } else if(strchr("={},?:", *p)) {
+      Tok.uType     = TOK_PUNCT;
+      Tok.szText[0] = *p;
+      p++;
+
+   } else {
+      Fail(pLex->szFileName, Tok.nLine, "unexpected character '%c'", *p);
+   }
+
+   pLex->pCursor = p;
+   return Tok;
+}
+
+
+static Token NextToken(Lexer *pLex)
+{
+   if(pLex->bHavePeeked) {
+      pLex->bHavePeeked = false;
+      return pLex->Peeked;
+   }
+   return ReadToken(pLex);
+}
+
+
+static const Token *PeekToken(Lexer *pLex)
+{
+   if(!pLex->bHavePeeked) {
+      pLex->Peeked      = ReadToken(pLex);
+      pLex->bHavePeeked = true;
+   }
+   return &pLex->Peeked;
+}
+
+
+static bool IsPunct(const Token *pTok, const char *szPunct)
+{
+   return pTok->uType == TOK_PUNCT && !strcmp(pTok->szText, szPunct);
+}
+
+
+static void ExpectPunct(Lexer *pLex, const char *szPunct)
+{
+   Token Tok = NextToken(pLex);
+   if(!IsPunct(&Tok, szPunct)) {
+      Fail(pLex->szFileName, Tok.nLine, "expected '%s'", szPunct);
+   }
+}
+
+
+static enum MemberType ParseType(Lexer *pLex)
+{
+   Token           Tok;
+   enum MemberType uType;
+   bool            bSizable = false;
+
+   Tok = NextToken(pLex);
+   if(Tok.uType != TOK_NAME) {
+      Fail(pLex->szFileName, Tok.nLine, "expected a type");
+   }
+
+   if(!strcmp(Tok.szText, "int")) {
+      uType    = MT_INT64;
+      bSizable = true;
+   } else if(!strcmp(Tok.szText, "uint")) {
+      uType    = MT_UINT64;
+      bSizable = true;
+   } else if(!strncmp(Tok.szText, "float", 5)) {
+      uType = MT_DOUBLE;
+   } else if(!strcmp(Tok.szText, "bool")) {
+      uType = MT_BOOL;
+   } else if(!strcmp(Tok.szText, "tstr") || !strcmp(Tok.szText, "text")) {
+      uType = MT_TEXT;
+   } else if(!strcmp(Tok.szText, "bstr") || !strcmp(Tok.szText, "bytes")) {
+      uType = MT_BYTES;
+   } else {
+      Fail(pLex->szFileName, Tok.nLine, "type '%s' is not supported", Tok.szText);
+      return MT_INT64; /* Not reached */
+   }
+
+   if(PeekToken(pLex)->uType == TOK_CONTROL) {
+      Tok = NextToken(pLex);
+      if(!bSizable || strcmp(Tok.szText, ".size")) {
+         Fail(pLex->szFileName, Tok.nLine, "'%s' is not supported here", Tok.szText);
+      }
+      Tok = NextToken(pLex);
+      if(Tok.uType != TOK_INT || (Tok.nValue != 4 && Tok.nValue != 8)) {
+         Fail(pLex->szFileName, Tok.nLine, ".size must be 4 or 8");
+      }
+      if(Tok.nValue == 4) {
+         uType = uType == MT_INT64 ? MT_INT32 : MT_UINT32;
+      }
+   }
+
+   return uType;
+}
+
+
+static void ParseMap(Lexer *pLex, Rule *pRule)
+{
+   Token   Tok;
+   Member *pMember;
+
+   pRule->bIsMap = true;
+
+   while(1) {
+      Tok = NextToken(pLex);
+      if(IsPunct(&Tok, "}")) {
+         break;
+      }
+      if(pRule->uNumMembers >= MAX_MEMBERS) {
+         Fail(pLex->szFileName, Tok.nLine, "more than %d members", MAX_MEMBERS);
+      }
+      pMember        = &pRule->aMembers[pRule->uNumMembers++];
+      pMember->nLine = Tok.nLine;
+
+      if(IsPunct(&Tok, "?")) {
+         pMember->bOptional = true;
+         Tok = NextToken(pLex);
+      }
+      if(Tok.uType != TOK_NAME) {
+         Fail(pLex->szFileName, Tok.nLine, "expected a label name");
+      }
+      strcpy(pMember->szName, Tok.szText);
+
+      Tok = NextToken(pLex);
+      if(IsPunct(&Tok, ":")) {
+         Fail(pLex->szFileName, Tok.nLine, "text labels are not supported, use name => type");
+      }
+      if(!IsPunct(&Tok, "=>")) {
+         Fail(pLex->szFileName, Tok.nLine, "expected '=>'");
+      }
+
+      pMember->uType = ParseType(pLex);
+
+      Tok = NextToken(pLex);
+      if(IsPunct(&Tok, "}")) {
+         break;
+      }
+      if(!IsPunct(&Tok, ",")) {
+         Fail(pLex->szFileName, Tok.nLine, "expected ',' or '}'");
+      }
+   }
+}
+
+
+static void Parse(Lexer *pLex)
+{
+   Token Tok;
+   Rule *pRule;
+
+   while(1) {
+      Tok = NextToken(pLex);
+      if(Tok.uType == TOK_END) {
+         break;
+      }
+      if(Tok.uType != TOK_NAME) {
+         Fail(pLex->szFileName, Tok.nLine, "expected a rule name");
+      }
+      if(uNumRules >= MAX_RULES) {
+         Fail(pLex->szFileName, Tok.nLine, "too many rules");
+      }
+      pRule = &aRules[uNumRules++];
+      strcpy(pRule->szName, Tok.szText);
+      pRule->nLine = Tok.nLine;
+
+      ExpectPunct(pLex, "=");
+
+      Tok = NextToken(pLex);
+      if(Tok.uType == TOK_INT) {
+         pRule->nValue = Tok.nValue;
+      } else if(IsPunct(&Tok, "{")) {
+         ParseMap(pLex, pRule);
+      } else {
+         Fail(pLex->szFileName, Tok.nLine, "only maps and integer constants are supported");
+      }
+   }
+}
+
+
+static const Rule *FindRule(const char *szName)
+{
+   unsigned u;
+
+   for(u = 0; u < uNumRules; u++) {
+      if(!strcmp(aRules[u].szName, szName)) {
+         return &aRules[u];
+      }
+   }
+   return NULL;
+}
+
+
+/* Check the schema and get the integer label of every member */
+static void Resolve(const char *szFileName, int64_t aaLabels[MAX_RULES][MAX_MEMBERS])
+{
+   unsigned    uRule, uMember, u;
+   const Rule *pRule;
+   const Rule *pConst;
+
+   for(uRule = 0; uRule < uNumRules; uRule++) {
+      pRule = &aRules[uRule];
+      if(FindRule(pRule->szName) != pRule) {
+         Fail(szFileName, pRule->nLine, "'%s' is defined more than once", pRule->szName);
+      }
+      if(pRule->bIsMap && pRule->uNumMembers == 0) {
+         Fail(szFileName, pRule->nLine, "'%s' is an empty map", pRule->szName);
+      }
+      for(uMember = 0; uMember < pRule->uNumMembers; uMember++) {
+         const Member *pMember = &pRule->aMembers[uMember];
+         pConst = FindRule(pMember->szName);
+         if(pConst == NULL || pConst->bIsMap) {
+            Fail(szFileName, pMember->nLine, "'%s' must be defined as an integer", pMember->szName);
+         }
+         if(!strcmp(pMember->szName, "uPresent")) {
+            Fail(szFileName, pMember->nLine, "'uPresent' is reserved");
+         }
+         aaLabels[uRule][uMember] = pConst->nValue;
+         for(u = 0; u < uMember; u++) {
+            if(aaLabels[uRule][u] == pConst->nValue) {
+               Fail(szFileName, pMember->nLine, "duplicate label %" PRId64, pConst->nValue);
+            }
+         }
+      }
+   }
+}
+
+
+/* C identifiers can't have '-', '@' or '$' */
+static const char *CName(const char *szName)
+{
+   static char szBuf[MAX_NAME];
+   char       *p;
+
+   strcpy(szBuf, szName);
+   for(p = szBuf; *p; p++) {
+      if(!isalnum((unsigned char)*p)) {
+         *p = '_';
+      }
+   }
+   return szBuf;
+}
+
+
+static uint32_t OptionalMask(const Rule *pRule)
+{
+   uint32_t uMask = 0;
+   unsigned u;
+
+   for(u = 0; u < pRule->uNumMembers; u++) {
+      if(pRule->aMembers[u].bOptional) {
+         uMask |= (uint32_t)1 << u;
+      }
+   }
+   return uMask;
+}
+
+
+static uint32_t RequiredMask(const Rule *pRule)
+{
+   uint32_t uAll = pRule->uNumMembers == 32 ? 0xffffffff :
+                                              ((uint32_t)1 << pRule->uNumMembers) - 1;
+   return uAll & ~OptionalMask(pRule);
+}
+
+
+static void WriteHeader(FILE *pOut, const char *szGuard, const char *szInit, const char *szSource)
+{
+   unsigned    uRule, uMember;
+   const Rule *pRule;
+   char        szType[MAX_NAME];
+
+   fprintf(pOut, "/* Generated by qcborcddl from %s. Do not edit. */\n\n", szSource);
+   fprintf(pOut, "#ifndef %s\n#define %s\n\n", szGuard, szGuard);
+   fprintf(pOut, "#include <stdint.h>\n#include <stdbool.h>\n");
+   fprintf(pOut, "#include \"qcbor/qcbor_encode.h\"\n#include \"qcbor/qcbor_decode.h\"\n\n");
+
+   for(uRule = 0; uRule < uNumRules; uRule++) {
+      pRule = &aRules[uRule];
+      if(!pRule->bIsMap) {
+         continue;
+      }
+      strcpy(szType, CName(pRule->szName));
+      fprintf(pOut, "\n/* %s = { ... } */\ntypedef struct {\n", pRule->szName);
+      for(uMember = 0; uMember < pRule->uNumMembers; uMember++) {
+         const Member *pMember = &pRule->aMembers[uMember];
+         fprintf(pOut, "   %-10s %s;\n", aTypeInfo[pMember->uType].szCType, CName(pMember->szName));
+      }
+      if(OptionalMask(pRule)) {
+         fprintf(pOut, "   %-10s uPresent; /* Bit n is set when optional member n is present */\n", "uint32_t");
+      }
+      fprintf(pOut, "} %s;\n\n", szType);
+      fprintf(pOut, "void Encode_%s(QCBOREncodeContext *pCtx, const %s *p);\n", szType, szType);
+      fprintf(pOut, "QCBORError Decode_%s(QCBORDecodeContext *pCtx, %s *p);\n\n", szType, szType);
+   }
+
+   fprintf(pOut, "\n/* Call once before any of the above. */\n");
+   fprintf(pOut, "QCBORError %s(void);\n\n", szInit);
+   fprintf(pOut, "#endif /* %s */\n", szGuard);
+}
+
+
+static void WriteSource(FILE                *pOut,
+                        const char          *szHeader,
+                        const char          *szInit,
+                        const char          *szSource,
+                        int64_t              aaLabels[MAX_RULES][MAX_MEMBERS])
+{
+   unsigned    uRule, uMember;
+   const Rule *pRule;
+   char        szType[MAX_NAME];
+
+   fprintf(pOut, "/* Generated by qcborcddl from %s. Do not edit. */\n\n", szSource);
+   fprintf(pOut, "#include \"%s\"\n\n", szHeader);
+
+   for(uRule = 0; uRule < uNumRules; uRule++) {
+      pRule = &aRules[uRule];
+      if(!pRule->bIsMap) {
+         continue;
+      }
+      strcpy(szType, CName(pRule->szName));
+      const uint32_t uOptional = OptionalMask(pRule);
+
+      /* The record */
+      fprintf(pOut, "\nstatic const QCBORRecordField s_%s_Fields[] = {\n", szType);
+      for(uMember = 0; uMember < pRule->uNumMembers; uMember++) {
+         const Member *pMember = &pRule->aMembers[uMember];
+         fprintf(pOut, "   QCBORField_%s(%" PRId64 ", %s, %s),\n",
+                 aTypeInfo[pMember->uType].szRecordType,
+                 aaLabels[uRule][uMember],
+                 szType,
+                 CName(pMember->szName));
+      }
+      fprintf(pOut, "};\n\nstatic QCBORRecord s_%s_Record;\n\n", szType);
+
+      /* The encoder */
+      fprintf(pOut, "void Encode_%s(QCBOREncodeContext *pCtx, const %s *p)\n{\n", szType, szType);
+      if(uOptional == 0) {
+         fprintf(pOut, "   QCBOREncode_AddRecord(pCtx, &s_%s_Record, p);\n", szType);
+      } else {
+         fprintf(pOut, "   if((p->uPresent & 0x%" PRIx32 ") == 0x%" PRIx32 ") {\n", uOptional, uOptional);
+         fprintf(pOut, "      QCBOREncode_AddRecord(pCtx, &s_%s_Record, p);\n", szType);
+         fprintf(pOut, "      return;\n   }\n\n");
+         fprintf(pOut, "   QCBOREncode_OpenMap(pCtx);\n");
+         for(uMember = 0; uMember < pRule->uNumMembers; uMember++) {
+            const Member *pMember = &pRule->aMembers[uMember];
+            const char   *szIndent = "   ";
+            if(pMember->bOptional) {
+               fprintf(pOut, "   if(p->uPresent & 0x%" PRIx32 ") {\n", (uint32_t)1 << uMember);
+               szIndent = "      ";
+            }
+            fprintf(pOut, "%s%s(pCtx, %" PRId64 ", p->%s);\n",
+                    szIndent,
+                    aTypeInfo[pMember->uType].szAddFunction,
+                    aaLabels[uRule][uMember],
+                    CName(pMember->szName));
+            if(pMember->bOptional) {
+               fprintf(pOut, "   }\n");
+            }
+         }
+         fprintf(pOut, "   QCBOREncode_CloseMap(pCtx);\n");
+      }
+      fprintf(pOut, "}\n\n");
+
+      /* The decoder */
+      fprintf(pOut, "QCBORError Decode_%s(QCBORDecodeContext *pCtx, %s *p)\n{\n", szType, szType);
+      fprintf(pOut, "   uint32_t   uFound;\n");
+      fprintf(pOut, "   QCBORError uErr;\n\n");
+      fprintf(pOut, "   uErr = QCBORDecode_GetRecord(pCtx, &s_%s_Record, p, &uFound);\n", szType);
+      fprintf(pOut, "   if(uErr != QCBOR_SUCCESS) {\n      return uErr;\n   }\n");
+      fprintf(pOut, "   if((uFound & 0x%" PRIx32 ") != 0x%" PRIx32 ") {\n",
+              RequiredMask(pRule), RequiredMask(pRule));
+      fprintf(pOut, "      return QCBOR_ERR_LABEL_NOT_FOUND;\n   }\n");
+      if(uOptional) {
+         fprintf(pOut, "   p->uPresent = uFound & 0x%" PRIx32 ";\n", uOptional);
+      }
+      fprintf(pOut, "   return QCBOR_SUCCESS;\n}\n\n");
+   }
+
+   /* Compile all the records once */
+   fprintf(pOut, "\nQCBORError %s(void)\n{\n   QCBORError uErr = QCBOR_SUCCESS;\n\n", szInit);
+   for(uRule = 0; uRule < uNumRules; uRule++) {
+      pRule = &aRules[uRule];
+      if(!pRule->bIsMap) {
+         continue;
+      }
+      strcpy(szType, CName(pRule->szName));
+      fprintf(pOut, "   if(uErr == QCBOR_SUCCESS) {\n");
+      fprintf(pOut, "      uErr = QCBOREncode_CompileRecord(&s_%s_Record, s_%s_Fields, %u);\n",
+              szType, szType, pRule->uNumMembers);
+      fprintf(pOut, "   }\n");
+   }
+   fprintf(pOut, "   return uErr;\n}\n");
+}
+
+
+static char *ReadFile(const char *szFileName)
+{
+   FILE  *pFile;
+   char  *pBuf;
+   long   nSize;
+
+   pFile = fopen(szFileName, "rb");
+   if(pFile == NULL ||
+      fseek(pFile, 0, SEEK_END) ||
+      (nSize = ftell(pFile)) < 0 ||
+      fseek(pFile, 0, SEEK_SET)) {
+      fprintf(stderr, "can't read %s\n", szFileName);
+      exit(1);
+   }
+   pBuf = malloc((size_t)nSize + 1);
+   if(pBuf == NULL || fread(pBuf, 1, (size_t)nSize, pFile) != (size_t)nSize) {
+      fprintf(stderr, "can't read %s\n", szFileName);
+      exit(1);
+   }
+   pBuf[nSize] = '\0';
+   fclose(pFile);
+   return pBuf;
+}
+
+
+static FILE *OpenOutput(const char *szBase, const char *szExtension, char *szFileName, size_t uSize)
+{
+   FILE *pFile;
+
+   snprintf(szFileName, uSize, "%s%s", szBase, szExtension);
+   pFile = fopen(szFileName, "w");
+   if(pFile == NULL) {
+      fprintf(stderr, "can't write %s\n", szFileName);
+      exit(1);
+   }
+   return pFile;
+}
+
+
+int main(int argc, const char * argv[])
+{
+   static int64_t aaLabels[MAX_RULES][MAX_MEMBERS];
+   Lexer          Lex;
+   FILE          *pHeader;
+   FILE          *pSource;
+   char           szHeaderName[1024];
+   char           szSourceName[1024];
+   char           szBaseName[MAX_NAME];
+   char           szGuard[MAX_NAME + 8];
+   char           szInit[MAX_NAME + 8];
+   const char    *szBase;
+   char          *p;
+
+   if(argc != 3) {
+      fprintf(stderr, "usage: %s <schema.cddl> <output-base>\n", argv[0]);
+      return 1;
+   }
+
+   memset(&Lex, 0, sizeof(Lex));
+   Lex.szFileName = argv[1];
+   Lex.pCursor    = ReadFile(argv[1]);
+   Lex.nLine      = 1;
+
+   Parse(&Lex);
+   Resolve(argv[1], aaLabels);
+
+   /* Names for the init function and include guard from the output base */
+   szBase = strrchr(argv[2], '/');
+   szBase = szBase ? szBase + 1 : argv[2];
+   snprintf(szBaseName, sizeof(szBaseName), "%s", CName(szBase));
+   snprintf(szInit, sizeof(szInit), "%s_Init", szBaseName);
+   snprintf(szGuard, sizeof(szGuard), "%s_h", szBaseName);
+
+   pHeader = OpenOutput(argv[2], ".h", szHeaderName, sizeof(szHeaderName));
+   WriteHeader(pHeader, szGuard, szInit, argv[1]);
+   fclose(pHeader);
+
+   p = strrchr(szHeaderName, '/');
+   pSource = OpenOutput(argv[2], ".c", szSourceName, sizeof(szSourceName));
+   WriteSource(pSource, p ? p + 1 : szHeaderName, szInit, argv[1], aaLabels);
+   fclose(pSource);
+
+   return 0;
+}
@@ -0,0 +1,53 @@
+/*==============================================================================
+  cmd_line_bench.c -- Runs benchmarks for QCBOR encoder / decoder
+
+ Copyright (c) 2026, Laurence Lundblade. All rights reserved.
+
+ SPDX-License-Identifier: BSD-3-Clause
+
+ See BSD-3-Clause license in README.md
+
+ Created on 10/14/26
+ =============================================================================*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <time.h>
+#include "run_benchmarks.h"
+
+
+/*
+ This is an implementation of OutputStringCB built using stdio. If
+ you don't have stdio, replaces this.
+ */
+static void fputs_wrapper(const char *szString, void *pOutCtx, int bNewLine)
+{
+    fputs(szString, (FILE *)pOutCtx);
+    if(bNewLine) {
+        fputs("\n", pOutCtx);
+    }
+}
+
+
+/*
+ This is an implementation of BenchmarkClockCB built using POSIX
+ clock_gettime(). If you don't have it, replace this.
+ */
+static uint64_t clock_wrapper(void *pClockCtx)
+{
+   struct timespec ts;
+
+   (void)pClockCtx;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+
+int main(int argc, const char * argv[])
+{
+   (void)argc; // Avoid unused parameter error
+
+   // This runs all the benchmarks
+   return RunBenchmarksQCBOR(argv+1, &clock_wrapper, NULL, &fputs_wrapper, stdout);
+}
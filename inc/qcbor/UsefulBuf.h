@@ -41,6 +41,11 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
  when         who             what, where, why
  --------     ----            --------------------------------------------------
+ 10/15/2026   llundblade      Add UsefulOutBuf_Advance().
+ 10/14/2026   llundblade      Add UsefulInputBuf_SetBufferLength() and
+                              UsefulInputBuf_Rewind().
+ 10/14/2026   llundblade      Add UsefulOutBuf_RetrieveOutputStorage() and
+                              UsefulOutBuf_Truncate().
  1/25/2020    llundblade      Add some casts so static anlyzers don't complain.
  5/21/2019    llundblade      #define configs for efficient endianness handling.
  5/16/2019    llundblade      Add UsefulOutBuf_IsBufferNULL().
@@ -1182,6 +1187,51 @@ static inline int UsefulOutBuf_WillItFit(UsefulOutBuf *pUOutBuf, size_t uLen);
 static inline int UsefulOutBuf_IsBufferNULL(UsefulOutBuf *pUOutBuf);
 
 
+/**
+ @brief Returns the storage given to UsefulOutBuf_Init().
+
+ @param[in] pUOutBuf  Pointer to the @ref UsefulOutBuf.
+
+ @return The storage pointer and size.
+
+ This is for callers that need to modify data they have already
+ output in place, for example to fill in a length they reserved room
+ for. Only the bytes below UsefulOutBuf_GetEndPosition() are valid
+ data. The pointer is @c NULL in size calculation mode.
+ */
+static inline UsefulBuf UsefulOutBuf_RetrieveOutputStorage(UsefulOutBuf *pUOutBuf);
+
+
+/**
+ @brief Discard data from the end of the @ref UsefulOutBuf.
+
+ @param[in] pUOutBuf         Pointer to the @ref UsefulOutBuf.
+ @param[in] uNewEndPosition  The new end position.
+
+ The end position is set back to @c uNewEndPosition. It has no effect
+ if @c uNewEndPosition is not less than the current end position. The
+ error state is not affected.
+ */
+static inline void UsefulOutBuf_Truncate(UsefulOutBuf *pUOutBuf, size_t uNewEndPosition);
+
+
+/**
+ @brief Add data written directly to the storage to the @ref UsefulOutBuf.
+
+ @param[in] pUOutBuf  Pointer to the @ref UsefulOutBuf.
+ @param[in] uAmount   The number of bytes written.
+
+ This is for callers that write a lot of small pieces straight into
+ the storage from UsefulOutBuf_RetrieveOutputStorage(), starting at
+ UsefulOutBuf_GetEndPosition(), after checking there is room for all
+ of them with UsefulOutBuf_WillItFit(). The end position is moved
+ forward by @c uAmount. If @c uAmount is more than
+ UsefulOutBuf_RoomLeft() the error state is set and the end position
+ doesn't change.
+ */
+static inline void UsefulOutBuf_Advance(UsefulOutBuf *pUOutBuf, size_t uAmount);
+
+
 /**
    @brief Returns the resulting valid data in a UsefulOutBuf
 
@@ -1478,7 +1528,7 @@ static double UsefulInputBuf_GetDouble(UsefulInputBuf *pUInBuf);
    of @ref UsefulInputBuf
 
  Once in the error state, it can only be cleared by calling
- UsefulInputBuf_Init().
+ UsefulInputBuf_Init() or UsefulInputBuf_Rewind().
 
  You may be able to only check the error state at the end after all
  the UsefulInputBuf_GetXxxx() calls have been made, but if what you
@@ -1489,6 +1539,35 @@ static double UsefulInputBuf_GetDouble(UsefulInputBuf *pUInBuf);
 static int UsefulInputBuf_GetError(UsefulInputBuf *pUInBuf);
 
 
+/**
+ @brief Sets the length of the data being parsed.
+
+ @param[in] pUInBuf  Pointer to the @ref UsefulInputBuf.
+ @param[in] uNewLen  The new length.
+
+ This is for when more data has been received into the buffer after
+ the data originally given to UsefulInputBuf_Init(), so the buffer
+ pointer stays the same and only the length changes. If the new
+ length is less than the cursor, the cursor is moved back to the new
+ length.
+ */
+static void UsefulInputBuf_SetBufferLength(UsefulInputBuf *pUInBuf, size_t uNewLen);
+
+
+/**
+ @brief Go back to an earlier position and clear the error state.
+
+ @param[in] pUInBuf  Pointer to the @ref UsefulInputBuf.
+ @param[in] uPos     Position to go back to.
+
+ This is for backing out of getting data that was only partly
+ received. After the length is increased with
+ UsefulInputBuf_SetBufferLength(), the data can be gotten again.
+ It does nothing if @c uPos is off the end of the buffer.
+ */
+static void UsefulInputBuf_Rewind(UsefulInputBuf *pUInBuf, size_t uPos);
+
+
 
 
 /*----------------------------------------------------------
@@ -1898,6 +1977,30 @@ static inline int UsefulOutBuf_IsBufferNULL(UsefulOutBuf *pMe)
 }
 
 
+static inline UsefulBuf UsefulOutBuf_RetrieveOutputStorage(UsefulOutBuf *pMe)
+{
+   return pMe->UB;
+}
+
+
+static inline void UsefulOutBuf_Truncate(UsefulOutBuf *pMe, size_t uNewEndPosition)
+{
+   if(uNewEndPosition < pMe->data_len) {
+      pMe->data_len = uNewEndPosition;
+   }
+}
+
+
+static inline void UsefulOutBuf_Advance(UsefulOutBuf *pMe, size_t uAmount)
+{
+   if(uAmount > UsefulOutBuf_RoomLeft(pMe)) {
+      pMe->err = 1;
+   } else {
+      pMe->data_len += uAmount;
+   }
+}
+
+
 
 static inline void UsefulInputBuf_Init(UsefulInputBuf *pMe, UsefulBufC UB)
 {
@@ -2125,6 +2228,24 @@ static inline int UsefulInputBuf_GetError(UsefulInputBuf *pMe)
    return pMe->err;
 }
 
+
+static inline void UsefulInputBuf_SetBufferLength(UsefulInputBuf *pMe, size_t uNewLen)
+{
+   if(pMe->cursor > uNewLen) {
+      pMe->cursor = uNewLen;
+   }
+   pMe->UB.len = uNewLen;
+}
+
+
+static inline void UsefulInputBuf_Rewind(UsefulInputBuf *pMe, size_t uPos)
+{
+   if(uPos <= pMe->UB.len) {
+      pMe->cursor = uPos;
+      pMe->err    = 0;
+   }
+}
+
 #ifdef __cplusplus
 }
 #endif
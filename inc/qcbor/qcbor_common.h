@@ -34,6 +34,48 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef qcbor_common_h
 #define qcbor_common_h
 
+#include "UsefulBuf.h"
+
+
+/*
+ Decoder feature profiles. Each of these can be defined on its own
+ to leave out a part of the decoder and make the common path through
+ QCBORDecode_GetNext() shorter. Input that uses a left-out feature
+ is an error rather than being decoded.
+
+ QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS -- No chunk coalescing.
+   Indefinite-length strings give QCBOR_ERR_INDEF_LEN_STRINGS_DISABLED.
+
+ QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS -- No break handling.
+   Indefinite-length arrays and maps give
+   QCBOR_ERR_INDEF_LEN_ARRAYS_DISABLED.
+
+ QCBOR_DISABLE_TAGS -- No tag gathering, mapping or processing of
+   dates, big numbers, decimal fractions and typed arrays. Tags give
+   QCBOR_ERR_TAGS_DISABLED.
+
+ QCBOR_DISABLE_NON_INTEGER_LABELS -- Only integer map labels. Other
+   labels give QCBOR_ERR_MAP_LABEL_TYPE.
+
+ QCBOR_PROFILE_CONSTRAINED turns on all of these for links where both
+ ends are controlled and only definite-length, integer-labeled and
+ untagged CBOR is sent.
+ */
+#ifdef QCBOR_PROFILE_CONSTRAINED
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+#define QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+#endif
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
+#define QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
+#endif
+#ifndef QCBOR_DISABLE_TAGS
+#define QCBOR_DISABLE_TAGS
+#endif
+#ifndef QCBOR_DISABLE_NON_INTEGER_LABELS
+#define QCBOR_DISABLE_NON_INTEGER_LABELS
+#endif
+#endif /* QCBOR_PROFILE_CONSTRAINED */
+
 /* Standard CBOR Major type for positive integers of various lengths */
 #define CBOR_MAJOR_TYPE_POSITIVE_INT 0
 
@@ -158,6 +200,14 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     (https://tools.ietf.org/html/rfc8932). No API is provided for this
     tag. */
 #define CBOR_TAG_CWT           61
+/** The first of the [RFC 8746]
+    (https://tools.ietf.org/html/rfc8746) typed array tags, an array
+    of uint8_t. See QCBOREncode_AddTypedArray() and @ref
+    QCBOR_TYPE_TYPED_ARRAY. */
+#define CBOR_TAG_TYPED_ARRAY_FIRST 64
+/** The last of the typed array tags, an array of little-endian
+    128-bit floats. */
+#define CBOR_TAG_TYPED_ARRAY_LAST  87
 /** Tag for COSE format encryption. See [RFC 8152, COSE]
     (https://tools.ietf.org/html/rfc8152). No API is provided for this
     tag. */
@@ -174,6 +224,12 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     (https://tools.ietf.org/html/rfc5870) and WGS-84. No API is
     provided for this tag. */
 #define CBOR_TAG_GEO_COORD    103
+/** A reference to an earlier string in a string reference namespace.
+    See [stringref](http://cbor.schmorp.de/stringref) and
+    QCBOREncode_OpenStringRefNamespace(). */
+#define CBOR_TAG_STRING_REF    25
+/** Starts a string reference namespace. See @ref CBOR_TAG_STRING_REF. */
+#define CBOR_TAG_STRING_REF_NAMESPACE 256
 /** The magic number, self-described CBOR. No API is provided for this
     tag. */
 #define CBOR_TAG_CBOR_MAGIC 55799
@@ -225,13 +281,16 @@ typedef enum {
 
    /** During encoding, more arrays or maps were closed than
        opened. This is a coding error on the part of the caller of the
-       encoder. */
+       encoder. Also when QCBORDecode_ExitArrayOrMap() is called when
+       no array or map is being decoded. */
    QCBOR_ERR_TOO_MANY_CLOSES = 4,
 
    /** During decoding, some CBOR construct was encountered that this
        decoder doesn't support, primarily this is the reserved
        additional info values, 28 through 30. During encoding,
-       an attempt to create simple value between 24 and 31. */
+       an attempt to create simple value between 24 and 31 or to use
+       QCBOREncode_AddBytesLenOnly() with
+       @ref QCBOR_ENCODE_CONFIG_NO_SLIDE. */
    QCBOR_ERR_UNSUPPORTED = 5,
 
    /** During decoding, hit the end of the given data to decode. For
@@ -328,6 +387,98 @@ typedef enum {
     /** Support for half-precision float decoding is disabled. */
     QCBOR_ERR_HALF_PRECISION_UNSUPPORTED = 26,
 
+    /** The callback passed to QCBOREncode_InitWithSink() returned an
+        error. */
+    QCBOR_ERR_SINK_WRITE = 27,
+
+    /** The end of the input was reached before the end of the data
+        item during incremental decoding. This is not an error and
+        nothing was consumed. Call QCBORDecode_AddInput() and try
+        again. See QCBORDecode_InitIncremental(). */
+    QCBOR_ERR_NEED_MORE_DATA = 28,
+
+    /** QCBORDecode_IndexMap() was not called right after the map was
+        returned by QCBORDecode_GetNext(), or the item given was not a
+        map. */
+    QCBOR_ERR_MAP_NOT_ENTERED = 29,
+
+    /** The map has more entries than the memory given to
+        QCBORDecode_IndexMap() can hold. */
+    QCBOR_ERR_INDEX_TOO_SMALL = 30,
+
+    /** The label was not found in the indexed map. See
+        QCBORDecode_GetItemInIndexN(). */
+    QCBOR_ERR_LABEL_NOT_FOUND = 31,
+
+    /** The encoded output has strings output by reference so it isn't
+        in one buffer. Use QCBOREncode_FinishSegments() rather than
+        QCBOREncode_Finish(). See QCBOREncode_SetReferences(). */
+    QCBOR_ERR_OUTPUT_HAS_REFERENCES = 32,
+
+    /** The length of a typed array isn't a multiple of the size of
+        its elements, the element type isn't one of
+        QCBOR_TYPED_ARRAY_XXX or the item isn't a typed array. See
+        QCBOREncode_AddTypedArray() and @ref QCBOR_TYPE_TYPED_ARRAY. */
+    QCBOR_ERR_BAD_TYPED_ARRAY = 33,
+
+    /** An item isn't of the type asked for, for example an element
+        of the array given to QCBORDecode_GetInt64Array() isn't an
+        integer. */
+    QCBOR_ERR_UNEXPECTED_TYPE = 34,
+
+    /** The paths given to QCBORDecode_CompileQuery() are not
+        valid or there are too many of them. */
+    QCBOR_ERR_BAD_QUERY = 35,
+
+    /** An indefinite-length string was encountered and
+        QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS is defined. */
+    QCBOR_ERR_INDEF_LEN_STRINGS_DISABLED = 36,
+
+    /** An indefinite-length array or map was encountered and
+        QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS is defined. */
+    QCBOR_ERR_INDEF_LEN_ARRAYS_DISABLED = 37,
+
+    /** A tag was encountered and QCBOR_DISABLE_TAGS is defined. */
+    QCBOR_ERR_TAGS_DISABLED = 38,
+
+    /** The fields given to QCBOREncode_CompileRecord() are not valid,
+        have the same label twice or there are too many of them. */
+    QCBOR_ERR_BAD_RECORD = 39,
+
+    /** A string reference is not on an unsigned integer, is not in a
+        string reference namespace or refers to a string that hasn't
+        been seen. */
+    QCBOR_ERR_BAD_STRING_REF = 40,
+
+    /** A string reference refers to a string that didn't fit in the
+        table given to QCBORDecode_SetStringRefs(). */
+    QCBOR_ERR_STRING_REF_TABLE_FULL = 41,
+
+    /** A string reference namespace is inside another one. This
+        implementation supports only one at a time. */
+    QCBOR_ERR_STRING_REF_NESTED = 42,
+
+    /** The decoder has left the array or map that the cursor given to
+        QCBORDecode_RestoreCursor() was saved in. */
+    QCBOR_ERR_BAD_CURSOR = 43,
+
+    /** There isn't room in the @ref QCBORRing for a record of the size
+        given to QCBORRing_StartRecord() until the consumer catches up. */
+    QCBOR_ERR_RING_FULL = 44,
+
+    /** A map has the same label twice. This is only checked for when
+        QCBORDecode_SetMapChecks() is called. */
+    QCBOR_ERR_DUPLICATE_LABEL = 45,
+
+    /** The memory given to QCBORDecode_SetMapChecks() is too small for
+        the labels in the maps that are open. */
+    QCBOR_ERR_LABEL_CHECK_FULL = 46,
+
+    /** A feature that keeps its state in the extension was used
+        without QCBOREncode_SetExtension() or
+        QCBORDecode_SetExtension() being called. */
+    QCBOR_ERR_NO_EXTENSION = 47,
+
     /* This is stored in uint8_t in places; never add values > 255 */
 } QCBORError;
 
@@ -347,17 +498,134 @@ const char *qcbor_err_to_str(QCBORError err);
 
 /**
  The maximum number of items in a single array or map when encoding of
- decoding.
+ decoding. It is 65,534 unless QCBOR_USE_LARGE_ARRAYS is defined.
+
+ With QCBOR_USE_LARGE_ARRAYS, the counts of items are 32 bits so this
+ is 4,294,967,294, and offsets in the encoded output are a @c size_t
+ so the output can be more than 4GB. The encode and decode contexts
+ get about a third bigger. This also changes the type of @c uCount in
+ @ref QCBORItem so everything using QCBOR has to be compiled with the
+ same setting.
+
+ The maximum nesting, @ref QCBOR_MAX_ARRAY_NESTING, can be set from 1
+ to 255 by defining QCBOR_CONFIG_MAX_ARRAY_NESTING. Each level adds 8
+ bytes or so to the encode and decode contexts.
  */
-// -1 is because the value UINT16_MAX is used to track indefinite-length arrays
-#define QCBOR_MAX_ITEMS_IN_ARRAY (UINT16_MAX-1)
+// -1 is because the largest count is used to track indefinite-length arrays
+#define QCBOR_MAX_ITEMS_IN_ARRAY (QCBOR_COUNT_INDEFINITE-1)
+
+
+/**
+ The number of tags in @ref QCBORTagListIn that are recorded in @c
+ uTagBits in @ref QCBORItem. Tags in the list after these are recorded
+ in @c uExtTagBits.
+ */
+#define QCBOR_MAX_CUSTOM_TAGS    16
 
 
 /**
  The maximum number of tags that can be in @ref QCBORTagListIn and passed to
  QCBORDecode_SetCallerConfiguredTagList()
  */
-#define QCBOR_MAX_CUSTOM_TAGS    16
+#define QCBOR_MAX_CUSTOM_TAGS_EXTENDED 32
+
+
+/**
+ @brief Type for the callback that hashes encoded CBOR as it goes.
+
+ @param[in] pDigestCtx  The context given with the callback.
+ @param[in] Bytes       The next bytes to hash.
+
+ This is called with the bytes in order, usually 64 bytes or more at
+ a time, but any length is possible. It is typically a
+ wrapper around the update function of a hash like SHA-256. It is
+ used by QCBOREncode_BstrWrapWithDigest() and QCBORDecode_SetDigest().
+ */
+typedef void (* QCBORDigestUpdate)(void *pDigestCtx, UsefulBufC Bytes);
+
+
+/**
+ The element types of [RFC 8746] (https://tools.ietf.org/html/rfc8746)
+ typed arrays for QCBOREncode_AddTypedArray() and @ref
+ QCBOR_TYPE_TYPED_ARRAY. The elements of @c FLOAT16 and @c FLOAT128
+ arrays are the bits of the floats in a @c uint16_t and in 16 bytes.
+ */
+#define QCBOR_TYPED_ARRAY_UINT8    0x00
+#define QCBOR_TYPED_ARRAY_UINT16   0x01
+#define QCBOR_TYPED_ARRAY_UINT32   0x02
+#define QCBOR_TYPED_ARRAY_UINT64   0x03
+#define QCBOR_TYPED_ARRAY_SINT8    0x08
+#define QCBOR_TYPED_ARRAY_SINT16   0x09
+#define QCBOR_TYPED_ARRAY_SINT32   0x0a
+#define QCBOR_TYPED_ARRAY_SINT64   0x0b
+#define QCBOR_TYPED_ARRAY_FLOAT16  0x10
+#define QCBOR_TYPED_ARRAY_FLOAT32  0x11
+#define QCBOR_TYPED_ARRAY_FLOAT64  0x12
+#define QCBOR_TYPED_ARRAY_FLOAT128 0x13
+
+
+/**
+ The types of the members of a C structure that can be described by a
+ @ref QCBORRecordField for QCBOREncode_AddRecord() and
+ QCBORDecode_GetRecord(). @c TEXT and @c BYTES members are a @ref
+ UsefulBufC.
+ */
+#define QCBOR_RECORD_INT64   1
+#define QCBOR_RECORD_INT32   2
+#define QCBOR_RECORD_UINT64  3
+#define QCBOR_RECORD_UINT32  4
+#define QCBOR_RECORD_DOUBLE  5
+#define QCBOR_RECORD_BOOL    6
+#define QCBOR_RECORD_TEXT    7
+#define QCBOR_RECORD_BYTES   8
+
+
+/**
+ One member of a C structure and the integer map label it is encoded
+ with. Usually these are made with QCBORField_INT64() and the other
+ macros below. See QCBOREncode_CompileRecord().
+ */
+typedef struct _QCBORRecordField {
+   /** The map label */
+   int64_t nLabel;
+   /** offsetof() the member in the structure */
+   size_t  uOffset;
+   /** One of @c QCBOR_RECORD_XXX */
+   uint8_t uType;
+} QCBORRecordField;
+
+/** Initializers for @ref QCBORRecordField for static arrays of fields */
+#define QCBORField_INT64(n, s, m)  {(n), offsetof(s, m), QCBOR_RECORD_INT64}
+#define QCBORField_INT32(n, s, m)  {(n), offsetof(s, m), QCBOR_RECORD_INT32}
+#define QCBORField_UINT64(n, s, m) {(n), offsetof(s, m), QCBOR_RECORD_UINT64}
+#define QCBORField_UINT32(n, s, m) {(n), offsetof(s, m), QCBOR_RECORD_UINT32}
+#define QCBORField_DOUBLE(n, s, m) {(n), offsetof(s, m), QCBOR_RECORD_DOUBLE}
+#define QCBORField_BOOL(n, s, m)   {(n), offsetof(s, m), QCBOR_RECORD_BOOL}
+#define QCBORField_TEXT(n, s, m)   {(n), offsetof(s, m), QCBOR_RECORD_TEXT}
+#define QCBORField_BYTES(n, s, m)  {(n), offsetof(s, m), QCBOR_RECORD_BYTES}
+
+
+/** The maximum number of fields in a @ref QCBORRecord. */
+#define QCBOR_MAX_RECORD_FIELDS QCBOR_MAX_RECORD_FIELDS1
+
+
+/**
+ A list of fields compiled by QCBOREncode_CompileRecord() for
+ QCBOREncode_AddRecord() and QCBORDecode_GetRecord(). It is about 380
+ bytes and is usually made once and kept in static memory. The
+ contents are opaque.
+ */
+typedef struct _QCBORRecord QCBORRecord;
+
+
+/**
+ The memory for the strings in a string reference namespace. The
+ caller gives an array of these to
+ QCBOREncode_OpenStringRefNamespace() and to
+ QCBORDecode_SetStringRefs(). Each is 24 bytes on a 64-bit CPU and 16
+ bytes on a 32-bit CPU. The contents are opaque.
+ */
+typedef struct _QCBORStringRef QCBORStringRef;
 
 
 #endif /* qcbor_common_h */
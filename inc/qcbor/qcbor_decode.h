@@ -151,6 +151,11 @@ typedef enum {
 /** For @ref QCBOR_DECODE_MODE_MAP_AS_ARRAY decode mode, a map that is
      being traversed as an array. See QCBORDecode_Init() */
 #define QCBOR_TYPE_MAP_AS_ARRAY  32
+/** Type for an [RFC 8746] (https://tools.ietf.org/html/rfc8746)
+    typed array, a byte string tagged with one of the tags from @ref
+    CBOR_TAG_TYPED_ARRAY_FIRST to @ref CBOR_TAG_TYPED_ARRAY_LAST. Data
+    is in @c val.typedArray. See QCBORDecode_CopyTypedArray(). */
+#define QCBOR_TYPE_TYPED_ARRAY   33
 
 #define QCBOR_TYPE_BREAK         31 // Used internally; never returned
 
@@ -189,6 +194,10 @@ typedef struct _QCBORItem {
    /** If not equal to @c uNestingLevel, this item closed out at least
        one map/array */
    uint8_t  uNextNestLevel;
+   /** Bits for the caller-configured tags after the first @ref
+       QCBOR_MAX_CUSTOM_TAGS. See QCBORDecode_IsTagged(). This fits in
+       what would otherwise be padding. */
+   uint16_t uExtTagBits;
 
    /** The union holding the item's value. Select union member based
        on @c uDataType */
@@ -202,9 +211,10 @@ typedef struct _QCBORItem {
       UsefulBufC  string;
       /** The "value" for @c uDataType @ref QCBOR_TYPE_ARRAY or @ref
           QCBOR_TYPE_MAP -- the number of items in the array or map.
-          It is @c UINT16_MAX when decoding indefinite-lengths maps
-          and arrays. */
-      uint16_t    uCount;
+          It is @c QCBOR_COUNT_INDEFINITE, @c UINT16_MAX unless
+          QCBOR_USE_LARGE_ARRAYS is defined, when decoding
+          indefinite-lengths maps and arrays. */
+      QCBORCount  uCount;
       /** The value for @c uDataType @ref QCBOR_TYPE_DOUBLE. */
       double      dfnum;
       /** The value for @c uDataType @ref QCBOR_TYPE_FLOAT. */
@@ -252,6 +262,17 @@ typedef struct _QCBORItem {
          } Mantissa;
       } expAndMantissa;
 #endif
+      /** The value for @c uDataType @ref QCBOR_TYPE_TYPED_ARRAY. The
+          elements are in place in the input in the byte order given
+          by @c bLittleEndian and may not be aligned. */
+      struct {
+         UsefulBufC Elements;
+         /** One of @ref QCBOR_TYPED_ARRAY_UINT8 and such */
+         uint8_t    uElementType;
+         /** 1 if the elements are little-endian, 0 if they are
+             big-endian or are one byte */
+         uint8_t    bLittleEndian;
+      } typedArray;
       uint64_t    uTagV;  // Used internally during decoding
    } val;
 
@@ -336,7 +357,9 @@ typedef UsefulBuf (* QCBORStringAllocate)(void *pAllocateCxt, void *pOldMem, siz
  it up with QCBORDecode_SetMemPool(). This is the size of the overhead
  needed by QCBORDecode_SetMemPool(). The amount of memory available
  for decoded strings will be the size of the buffer given to
- QCBORDecode_SetMemPool() less this amount.
+ QCBORDecode_SetMemPool() less this amount. The MemPool's bookkeeping
+ is now in the decode context, but this overhead is kept so pools
+ sized with it have the same space for strings as before.
 
  If you write your own string allocator or use the separately
  available malloc based string allocator, this size will not apply.
@@ -353,7 +376,8 @@ typedef UsefulBuf (* QCBORStringAllocate)(void *pAllocateCxt, void *pOldMem, siz
  */
 typedef struct {
    /** The number of tags in the @c puTags. The maximum size is @ref
-       QCBOR_MAX_CUSTOM_TAGS. */
+       QCBOR_MAX_CUSTOM_TAGS_EXTENDED. Lookup is faster if the tags
+       are sorted in ascending order. */
    uint8_t uNumTags;
    /** An array of tags to add to recognize in addition to the
        built-in ones. */
@@ -380,6 +404,30 @@ typedef struct {
 } QCBORTagListOut;
 
 
+/**
+ Limits for QCBORDecode_Validate(). A member that is zero selects the
+ same limit the decoder has so anything that validates can be
+ decoded. Limits larger than the decoder's are reduced to the
+ decoder's.
+ */
+typedef struct {
+   /** The maximum depth of nested arrays and maps. The default is
+       @ref QCBOR_MAX_ARRAY_NESTING. */
+   uint8_t  uMaxNesting;
+   /** Non-zero to allow a CBOR sequence [RFC 8742]
+       (https://tools.ietf.org/html/rfc8742) of zero or more data
+       items. Otherwise the input must be exactly one data item. */
+   uint8_t  bAllowSequence;
+   /** The maximum number of items in an array or pairs in a map. The
+       default is @ref QCBOR_MAX_ITEMS_IN_ARRAY. */
+   QCBORCount uMaxItemsInArray;
+   /** The maximum length of a string. For an indefinite-length
+       string this is the total of the chunks. The default is @c
+       SIZE_MAX less 4. */
+   size_t   uMaxStringLength;
+} QCBORValidateLimits;
+
+
 /**
  QCBORDecodeContext is the data type that holds context decoding the
  data items for some received CBOR.  It is about 100 bytes, so it can
@@ -390,6 +438,92 @@ typedef struct {
 typedef struct _QCBORDecodeContext QCBORDecodeContext;
 
 
+/**
+ The state of the decoder features that aren't needed for most
+ decoding: QCBORDecode_SetDigest(), QCBORDecode_SetStringRefs(),
+ QCBORDecode_SetMapChecks() and the fast lookup of the tags given to
+ QCBORDecode_SetCallerConfiguredTagList(). It is kept out of @ref
+ QCBORDecodeContext so that the context is small without them. It is
+ about 90 bytes on a 64-bit CPU. The contents are opaque. See
+ QCBORDecode_SetExtension().
+ */
+typedef struct _QCBORDecodeExtension QCBORDecodeExtension;
+
+
+/**
+ An index of the entries in one map for looking them up by label. See
+ QCBORDecode_IndexMap(). It is about 170 bytes. The contents are
+ opaque.
+ */
+typedef struct _QCBORMapIndex QCBORMapIndex;
+
+
+/**
+ One entry in a @ref QCBORMapIndex. The caller gives an array of these
+ to QCBORDecode_IndexMap(), one per map entry. Each is 24 bytes on a
+ 64-bit CPU and 16 bytes on a 32-bit CPU. The contents are opaque.
+ */
+typedef struct _QCBORMapIndexEntry QCBORMapIndexEntry;
+
+
+/**
+ A set of paths compiled by QCBORDecode_CompileQuery() for
+ QCBORDecode_RunQuery(). It is about 80 bytes. The contents are
+ opaque.
+ */
+typedef struct _QCBORQuery QCBORQuery;
+
+
+/**
+ A string allocator that gets memory in slabs from another allocator
+ and is reset between decodes. See QCBORArena_Init(). It is about 100
+ bytes. The contents are opaque.
+ */
+typedef struct _QCBORArena QCBORArena;
+
+
+/**
+ A position in the input saved by QCBORDecode_SaveCursor() to go back
+ to with QCBORDecode_RestoreCursor(). It is 16 bytes on a 64-bit CPU
+ and 12 bytes on a 32-bit CPU. The contents are opaque.
+ */
+typedef struct _QCBORDecodeCursor QCBORDecodeCursor;
+
+
+/**
+ An entry in the memory given to QCBORDecode_SetMapChecks(). It is 24
+ bytes on a 64-bit CPU and 20 or 24 bytes on a 32-bit CPU. The
+ contents are opaque.
+ */
+typedef struct _QCBORLabelCheck QCBORLabelCheck;
+
+
+/**
+ Usage statistics of a @ref QCBORArena. See QCBORArena_GetStats().
+ */
+typedef struct {
+   /** Bytes allocated to strings since the last reset */
+   size_t   uBytesInUse;
+   /** The most @c uBytesInUse has been since QCBORArena_Init() */
+   size_t   uHighWater;
+   /** Bytes held from the backing allocator, including slab
+       headers */
+   size_t   uSlabBytes;
+   /** Number of slabs held from the backing allocator */
+   uint32_t uNumSlabs;
+   /** Number of allocations since QCBORArena_Init() */
+   uint32_t uAllocations;
+   /** Number of reallocations since QCBORArena_Init() */
+   uint32_t uReallocations;
+} QCBORArenaStats;
+
+
+/**
+ The slab size used by QCBORArena_Init() when 0 is given.
+ */
+#define QCBOR_ARENA_DEFAULT_SLAB_SIZE 1024
+
+
 /**
  Initialize the CBOR decoder context.
 
@@ -434,6 +568,93 @@ typedef struct _QCBORDecodeContext QCBORDecodeContext;
 void QCBORDecode_Init(QCBORDecodeContext *pCtx, UsefulBufC EncodedCBOR, QCBORDecodeMode nMode);
 
 
+/**
+ @brief Reuse a decode context for another input.
+
+ @param[in] pCtx         The context to reset.
+ @param[in] EncodedCBOR  The buffer with CBOR encoded bytes to be decoded.
+
+ This starts decoding @c EncodedCBOR with all the configuration of @c
+ pCtx kept so it doesn't have to be set up again for each of many
+ messages. What is kept is the decode mode, the string allocator, the
+ caller-configured tag list, the digest callback, the string
+ reference table and the memory for map checks. The statistics of QCBOR_CONFIG_ENABLE_STATS are
+ also kept and go on counting.
+
+ Everything else is as after QCBORDecode_Init(). In particular a
+ context set up with QCBORDecode_InitIncremental() goes back to
+ complete input.
+
+ The MemPool of QCBORDecode_SetMemPool() is emptied so all strings
+ allocated from it are no longer good. Other string allocators are
+ not called. Call QCBORDecode_Finish() on the previous input first so
+ the allocator destructor is called as usual.
+ */
+void QCBORDecode_Reset(QCBORDecodeContext *pCtx, UsefulBufC EncodedCBOR);
+
+
+/**
+ @brief Initialize the decoder for input that arrives in pieces.
+
+ @param[in] pCtx      The context to initialize.
+ @param[in] Received  The part of the encoded CBOR received so far.
+ @param[in] nMode     See QCBORDecode_Init() and @ref QCBORDecodeMode.
+
+ This is QCBORDecode_Init() for input that is received in pieces, for
+ example from a network. The input is parsed as it arrives so the
+ whole message doesn't have to be received into a separate buffer
+ first.
+
+ When QCBORDecode_GetNext() or QCBORDecode_GetNextWithTags() gets to
+ the end of the input received in the middle of a data item, it
+ returns @ref QCBOR_ERR_NEED_MORE_DATA rather than @ref
+ QCBOR_ERR_HIT_END. The decoder is put back exactly as it was
+ before the call, so it can be called again after
+ QCBORDecode_AddInput(). The same happens when the end of the input
+ is right after an item in an indefinite-length map or array because
+ there isn't yet a way to know if a break comes next.
+
+ The input must be received into one buffer, starting with @c
+ Received.ptr, because strings returned from the decoder point into
+ it. Only the length of the input grows.
+
+ @ref QCBOR_ERR_NEED_MORE_DATA is also returned when all the input
+ received has been decoded and the decoder is at the top level,
+ because another item of a CBOR sequence may follow.
+
+ Once all input has been received, call QCBORDecode_EndOfInput() so
+ that any truncation is reported as @ref QCBOR_ERR_HIT_END and the
+ end of the top level as @ref QCBOR_ERR_NO_MORE_ITEMS.
+ QCBORDecode_Finish() can be called as usual at the end.
+ */
+void QCBORDecode_InitIncremental(QCBORDecodeContext *pCtx, UsefulBufC Received, QCBORDecodeMode nMode);
+
+
+/**
+ @brief Add more input for decoding.
+
+ @param[in] pCtx       The decoder context.
+ @param[in] uNumBytes  The number of bytes received.
+
+ The bytes received must be in the same buffer, right after the
+ input given so far to QCBORDecode_InitIncremental() and earlier
+ calls to this.
+ */
+void QCBORDecode_AddInput(QCBORDecodeContext *pCtx, size_t uNumBytes);
+
+
+/**
+ @brief Indicate all of the input has been received.
+
+ @param[in] pCtx  The decoder context.
+
+ After this, the decoder behaves as if it had been initialized with
+ QCBORDecode_Init(). In particular, input that ends in the middle of
+ a data item is an error, @ref QCBOR_ERR_HIT_END.
+ */
+void QCBORDecode_EndOfInput(QCBORDecodeContext *pCtx);
+
+
 /**
  @brief Set up the MemPool string allocator for indefinite-length strings.
 
@@ -520,6 +741,94 @@ void QCBORDecode_SetUpAllocator(QCBORDecodeContext *pCtx,
                                 void *pAllocateContext,
                                 bool bAllStrings);
 
+
+/**
+ @brief Initialize an arena string allocator.
+
+ @param[out] pArena      The arena to initialize.
+ @param[in] pfBacking    The allocator the arena gets its slabs from.
+ @param[in] pBackingCxt  Context passed to @c pfBacking.
+ @param[in] uSlabSize    The smallest slab to get from @c pfBacking or
+                         0 for @ref QCBOR_ARENA_DEFAULT_SLAB_SIZE.
+
+ An arena is a string allocator for indefinite-length strings that is
+ set up with QCBORDecode_SetArena(). Like the MemPool, see
+ QCBORDecode_SetMemPool(), it allocates by bumping an offset so each
+ allocation is quick and there is no overhead per string. Unlike the
+ MemPool, it doesn't need a buffer big enough for the largest input
+ up front. It gets more memory as it is needed from @c pfBacking in
+ slabs of at least @c uSlabSize bytes. A string larger than that gets
+ a slab of its own.
+
+ @c pfBacking is called the same way the decoder calls a @ref
+ QCBORStringAllocate to allocate and free. It is never asked to
+ reallocate. It can, for example, be a malloc-based allocator.
+
+ When decoding many messages, call QCBORArena_Reset() after each one
+ is no longer needed. The slabs are kept and reused, so once the arena
+ has grown big enough for the messages, no more calls are made to @c
+ pfBacking. Call QCBORArena_Free() to give the slabs back.
+
+ No memory is allocated by this. The arena is about 100 bytes.
+ */
+void QCBORArena_Init(QCBORArena *pArena,
+                     QCBORStringAllocate pfBacking,
+                     void *pBackingCxt,
+                     size_t uSlabSize);
+
+
+/**
+ @brief Use an arena as the string allocator.
+
+ @param[in] pCtx         The decode context.
+ @param[in] pArena       An arena initialized by QCBORArena_Init().
+ @param[in] bAllStrings  If true, all strings, even of definite
+                         length, will be allocated with the arena.
+
+ This is QCBORDecode_SetUpAllocator() with the arena's allocator
+ function. The arena may be used by one decode context after another,
+ but not by two at the same time. QCBORDecode_Finish() doesn't reset
+ or free the arena so the strings stay good until
+ QCBORArena_Reset() or QCBORArena_Free() is called.
+ */
+void QCBORDecode_SetArena(QCBORDecodeContext *pCtx, QCBORArena *pArena, bool bAllStrings);
+
+
+/**
+ @brief Reset an arena so its memory can be used again.
+
+ @param[in] pArena  The arena to reset.
+
+ This takes the same short time no matter how much was allocated. All
+ strings allocated from the arena are no longer good after this. The
+ slabs are kept for reuse. The high-water mark and the counts of
+ allocations are not reset.
+ */
+void QCBORArena_Reset(QCBORArena *pArena);
+
+
+/**
+ @brief Give all an arena's slabs back to its backing allocator.
+
+ @param[in] pArena  The arena to free.
+
+ This resets the arena too. It can still be used after this and will
+ get new slabs as needed.
+ */
+void QCBORArena_Free(QCBORArena *pArena);
+
+
+/**
+ @brief Get usage statistics for an arena.
+
+ @param[in] pArena   The arena.
+ @param[out] pStats  The statistics.
+
+ These can be used to tune the slab size or to size a MemPool for the
+ same messages from the high-water mark.
+ */
+void QCBORArena_GetStats(const QCBORArena *pArena, QCBORArenaStats *pStats);
+
 /**
  @brief Configure list of caller-selected tags to be recognized.
 
@@ -534,15 +843,181 @@ void QCBORDecode_SetUpAllocator(QCBORDecodeContext *pCtx,
  copy of it is made.
 
  The maximum number of tags that can be added is @ref
- QCBOR_MAX_CUSTOM_TAGS.  If a list larger than this is given, the
- error will be returned when QCBORDecode_GetNext() is called, not
+ QCBOR_MAX_CUSTOM_TAGS_EXTENDED.  If a list larger than this is given,
+ the error will be returned when QCBORDecode_GetNext() is called, not
  here.
 
+ With QCBORDecode_SetExtension() this makes a small filter of the
+ tags and checks whether they are sorted so tags are looked up quickly
+ while decoding. The tags in the list must not be changed after this
+ is called. If they are sorted in ascending order they are found with
+ a binary search rather than a linear one. Without it the list is
+ searched linearly.
+
  See description of @ref QCBORTagListIn.
  */
 void QCBORDecode_SetCallerConfiguredTagList(QCBORDecodeContext *pCtx, const QCBORTagListIn *pTagList);
 
 
+/**
+ @brief Give the decoder memory for its optional features.
+
+ @param[in] pCtx  The decoder context.
+ @param[in] pExt  Memory for the state of the optional features.
+
+ Call this right after QCBORDecode_Init() before anything is decoded.
+ @c pExt must stay valid until decoding is finished.
+
+ QCBORDecode_SetDigest(), QCBORDecode_SetStringRefs() and
+ QCBORDecode_SetMapChecks() return @ref QCBOR_ERR_NO_EXTENSION
+ without it.
+ */
+void QCBORDecode_SetExtension(QCBORDecodeContext *pCtx, QCBORDecodeExtension *pExt);
+
+
+/**
+ @brief Hash the input as it is decoded.
+
+ @param[in] pCtx        The decode context.
+ @param[in] pfDigest    Callback given the input.
+ @param[in] pDigestCtx  Context passed to @c pfDigest.
+
+ @retval QCBOR_ERR_NO_EXTENSION  QCBORDecode_SetExtension() wasn't called.
+
+ The input that is consumed by QCBORDecode_GetNext() and the other
+ decode functions is given to @c pfDigest in order while it is still
+ in cache. This is for decoding the content of a bstr-wrapped CBOR,
+ like a COSE payload, with its own decode context so the hash needed
+ to verify the signature is computed in the same pass. Input consumed
+ before this is called isn't given.
+
+ The rest of the consumed input is given to @c pfDigest when
+ QCBORDecode_Finish() is called. If all of the input is not consumed,
+ for example with a CBOR sequence, the extra bytes are not given.
+ Input that is decoded more than once, for example after
+ QCBORDecode_ExitIndexedMap(), is only given once. Input skipped by
+ QCBORDecode_SkipCurrent() is given.
+ */
+QCBORError QCBORDecode_SetDigest(QCBORDecodeContext *pCtx,
+                                 QCBORDigestUpdate   pfDigest,
+                                 void               *pDigestCtx);
+
+
+/**
+ @brief Resolve string references.
+
+ @param[in] pCtx        The decoder context.
+ @param[in] pTable      Memory for the strings in a namespace.
+ @param[in] uTableSize  The number of entries in @c pTable.
+
+ @retval QCBOR_ERR_NO_EXTENSION  QCBORDecode_SetExtension() wasn't called.
+
+ Call this after QCBORDecode_Init() to decode input made with
+ QCBOREncode_OpenStringRefNamespace() or by any other
+ [stringref](http://cbor.schmorp.de/stringref) encoder.
+
+ In an item tagged with @ref CBOR_TAG_STRING_REF_NAMESPACE, each byte
+ and text string long enough to be referred to is recorded in @c
+ pTable. An integer tagged with @ref CBOR_TAG_STRING_REF is returned
+ as the string it refers to, including when it is a map label. The
+ string is not copied. It points to the earlier one in the input, or
+ to the allocated memory of the earlier one if it was allocated, in
+ which case @c uDataAlloc is not set for the reference. Neither tag is
+ in the tags returned for an item.
+
+ @c pTable needs one entry per string numbered in the namespace, not
+ just those referred to. If it is too small, a reference to a string
+ that wasn't recorded gives @ref QCBOR_ERR_STRING_REF_TABLE_FULL.
+ Other errors are @ref QCBOR_ERR_BAD_STRING_REF and @ref
+ QCBOR_ERR_STRING_REF_NESTED.
+
+ Without this the tags are returned like any others. References are
+ not resolved by QCBORDecode_GetItemInIndexN(),
+ QCBORDecode_GetItemInIndexSZ() or QCBORDecode_RunQuery() because
+ they don't decode the input in order. They don't work with @ref
+ QCBOR_DISABLE_TAGS.
+ */
+QCBORError QCBORDecode_SetStringRefs(QCBORDecodeContext *pCtx,
+                                     QCBORStringRef     *pTable,
+                                     size_t              uTableSize);
+
+
+/**
+ @brief Check maps for duplicate labels and deterministic encoding.
+
+ @param[in] pCtx          The decoder context.
+ @param[in] pScratch      Memory for the labels of the maps that are open.
+ @param[in] uScratchSize  The number of entries in @c pScratch.
+
+ @retval QCBOR_ERR_NO_EXTENSION  QCBORDecode_SetExtension() wasn't called.
+
+ After this, QCBORDecode_GetNext() returns @ref
+ QCBOR_ERR_DUPLICATE_LABEL for a map with the same integer, text
+ string or byte string label twice. Integer labels are compared by
+ value, so 1 encoded in one byte and 1 encoded in two bytes are the
+ same label. The labels of each map are put in a hash table in @c
+ pScratch so this is about as fast as decoding them, even for big
+ maps. The labels of a map are compared only to each other, not to
+ those of the maps it is in or that are in it.
+
+ The input is also checked for deterministic encoding as described in
+ [RFC 8949 section 4.2.1](https://www.rfc-editor.org/rfc/rfc8949.html#section-4.2.1):
+ all heads in the shortest form, no indefinite lengths, floats in the
+ smallest size that holds them exactly and the labels of each map in
+ the bytewise lexicographic order of their encoding. The result is
+ given by QCBORDecode_IsDeterministic(). Duplicate labels are an
+ error rather than just not deterministic. With @ref
+ QCBOR_DISABLE_PREFERRED_FLOAT, single and double-precision floats
+ can't be checked so they are always counted as not deterministic.
+
+ Each map that is open takes one entry plus a power of two entries
+ that is at least twice the number of labels in it. An
+ indefinite-length map starts with 16 and doubles as needed, which
+ takes three times its size while it doubles. @ref
+ QCBOR_ERR_LABEL_CHECK_FULL is returned when there isn't enough. Four
+ times the number of labels in all the maps that are open at the same
+ time plus one per map is always enough for definite-length maps.
+
+ Only the input that is decoded in order is checked. That is input
+ decoded by QCBORDecode_GetNext() and the functions that call it,
+ QCBORDecode_GetInt64Array() and QCBORDecode_GetDoubleArray(). Maps
+ skipped over by QCBORDecode_ExitArrayOrMap(),
+ QCBORDecode_SkipCurrent(), QCBORDecode_GetRecord() and
+ QCBORDecode_IndexMap() are checked too, because they are decoded
+ with QCBORDecode_GetNext() rather than skipped using only the heads
+ once this is called. That makes skipping them slower.
+
+ What was before the position the decoder was at when this was called
+ isn't checked and input that is decoded again after
+ QCBORDecode_RestoreCursor() or QCBORDecode_GetItemInIndexN() isn't
+ checked again. QCBORDecode_Validate(), QCBORDecode_RunQuery() and
+ QCBORDecode_SplitSequence() don't use a decode context so they never
+ check labels. Labels aren't checked in @ref
+ QCBOR_DECODE_MODE_MAP_AS_ARRAY. This turns off the fast path of
+ QCBORDecode_GetNextBatch().
+ */
+QCBORError QCBORDecode_SetMapChecks(QCBORDecodeContext *pCtx,
+                                    QCBORLabelCheck    *pScratch,
+                                    size_t              uScratchSize);
+
+
+/**
+ @brief Whether the input decoded so far is deterministically encoded.
+
+ @param[in] pCtx  The decoder context.
+
+ @return @c true if everything decoded since QCBORDecode_SetMapChecks()
+         was called is deterministically encoded, @c false if not or
+         if it wasn't called.
+
+ A signature verifier that requires deterministic encoding can call
+ this after decoding the payload and QCBORDecode_Finish() returning
+ success rather than encoding the payload again to compare. The result
+ is not meaningful if decoding ended in an error.
+ */
+bool QCBORDecode_IsDeterministic(QCBORDecodeContext *pCtx);
+
+
 /**
  @brief Gets the next item (integer, byte string, array...) in
         preorder traversal of CBOR tree.
@@ -631,7 +1106,7 @@ void QCBORDecode_SetCallerConfiguredTagList(QCBORDecodeContext *pCtx, const QCBO
  of Items in the array or map.  Typically, an implementation will call
  QCBORDecode_GetNext() in a for loop to fetch them all. When decoding
  indefinite-length maps and arrays, @c QCBORItem.val.uCount is @c
- UINT16_MAX and @c uNextNestLevel must be used to know when the end of
+ QCBOR_COUNT_INDEFINITE and @c uNextNestLevel must be used to know when the end of
  a map or array is reached.
 
  Nesting level 0 is the outside top-most nesting level. For example,
@@ -789,6 +1264,65 @@ QCBORError QCBORDecode_GetNext(QCBORDecodeContext *pCtx, QCBORItem *pDecodedItem
 QCBORError QCBORDecode_GetNextWithTags(QCBORDecodeContext *pCtx, QCBORItem *pDecodedItem, QCBORTagListOut *pTagList);
 
 
+/**
+ @brief Gets a number of items at once.
+
+ @param[in]  pCtx          The decoder context.
+ @param[out] pItems        Array to fill in with the items decoded.
+ @param[in]  uMaxItems     The number of items in @c pItems.
+ @param[out] puNumDecoded  The number of items put in @c pItems.
+
+ @return See return values for QCBORDecode_GetNext().
+
+ This is the same as calling QCBORDecode_GetNext() repeatedly, but it
+ is faster for arrays of integers, floats, simple values and strings.
+ The items in a definite-length array that are not the last item
+ are decoded in a tight loop that skips most of the layers of
+ QCBORDecode_GetNext(). The items don't need the usual full zeroing,
+ so members of @ref QCBORItem that aren't valid for an item's type,
+ like the @c label when @c uLabelType is @ref QCBOR_TYPE_NONE, are
+ not cleared.
+
+ Decoding stops after @c uMaxItems items, after an item that opens an
+ array or map, or after an item that closes one. That is, the items
+ returned are always from one nesting level and the last item tells
+ what comes next through its @c uNestingLevel and @c uNextNestLevel.
+ A batch is never empty unless there is an error.
+
+ If an error occurs, decoding stops and the error is returned. @c
+ puNumDecoded is still set to the number of good items decoded before
+ the error, including for @ref QCBOR_ERR_NO_MORE_ITEMS at the end of
+ the input. This makes a loop calling this look the same as one that
+ calls QCBORDecode_GetNext().
+ */
+QCBORError QCBORDecode_GetNextBatch(QCBORDecodeContext *pCtx,
+                                    QCBORItem          *pItems,
+                                    size_t              uMaxItems,
+                                    size_t             *puNumDecoded);
+
+
+/**
+ @brief Copy the numbers in a typed array into the byte order of the CPU.
+
+ @param[in] pItem           A @ref QCBOR_TYPE_TYPED_ARRAY item.
+ @param[in] Dest            Where to copy the numbers to.
+ @param[out] puNumElements  The number of numbers copied.
+
+ @retval QCBOR_ERR_BAD_TYPED_ARRAY   @c pItem isn't a typed array.
+ @retval QCBOR_ERR_BUFFER_TOO_SMALL  @c Dest is too small.
+
+ The decoder returns typed arrays as a pointer to the numbers in the
+ input, without copying them. When they are in the byte order of the
+ CPU and aligned, they can be used in place. Otherwise this copies
+ them into @c Dest, usually a C array of the element type, swapping
+ the bytes of each if needed. It is a @c memcpy() when no swap is
+ needed.
+ */
+QCBORError QCBORDecode_CopyTypedArray(const QCBORItem *pItem,
+                                      UsefulBuf        Dest,
+                                      size_t          *puNumElements);
+
+
 /**
  @brief Determine if a CBOR item was tagged with a particular tag
 
@@ -815,6 +1349,338 @@ QCBORError QCBORDecode_GetNextWithTags(QCBORDecodeContext *pCtx, QCBORItem *pDec
 int QCBORDecode_IsTagged(QCBORDecodeContext *pCtx, const QCBORItem *pItem, uint64_t uTag);
 
 
+/**
+ @brief Skip the rest of the array or map being decoded.
+
+ @param[in] pCtx  The decoder context.
+
+ @retval QCBOR_ERR_TOO_MANY_CLOSES  No array or map is being decoded.
+
+ @retval QCBOR_ERR_NEED_MORE_DATA   When decoding incrementally, the
+                                    end of the array or map hasn't
+                                    been received yet. Nothing was
+                                    consumed.
+
+ This skips all the items remaining in the innermost array or map
+ that QCBORDecode_GetNext() has descended into, including everything
+ in any arrays and maps in it. The next call to QCBORDecode_GetNext()
+ returns the item after the array or map. The decoder is left in the
+ same state as if QCBORDecode_GetNext() had been called for each of
+ the skipped items.
+
+ This is much faster than calling QCBORDecode_GetNext() for each item
+ because only the heads of the items are decoded. String payloads are
+ passed over using the length in their head, tags are not looked up
+ and no string allocation is done, even for indefinite-length
+ strings.
+
+ The skipped items are checked for being well-formed with the same
+ errors as QCBORDecode_GetNext() would return for them. They are not
+ otherwise checked. For example, map labels can be of any type and
+ the content of tags is not checked.
+
+ In a string reference namespace, see QCBORDecode_SetStringRefs(), the
+ skipped strings still have to be numbered, so this falls back to
+ calling QCBORDecode_GetNext() for each item. The same is done when
+ QCBORDecode_SetMapChecks() has been called so the skipped maps are
+ checked. When decoding
+ incrementally, what was decoded before @ref QCBOR_ERR_NEED_MORE_DATA
+ is then consumed.
+
+ See also QCBORDecode_SkipCurrent().
+ */
+QCBORError QCBORDecode_ExitArrayOrMap(QCBORDecodeContext *pCtx);
+
+
+/**
+ @brief Skip the contents of an array or map just returned.
+
+ @param[in] pCtx   The decoder context.
+ @param[in] pItem  The item just returned by QCBORDecode_GetNext().
+
+ If @c pItem is a non-empty array or map this skips all of its
+ contents with QCBORDecode_ExitArrayOrMap() so the next call to
+ QCBORDecode_GetNext() returns the item after it. For any other item
+ it does nothing, so it can be called on any item that isn't
+ wanted.
+
+ @c pItem must be the item just returned by QCBORDecode_GetNext().
+ */
+QCBORError QCBORDecode_SkipCurrent(QCBORDecodeContext *pCtx, const QCBORItem *pItem);
+
+
+/**
+ @brief Decode the rest of an array of integers into a C array.
+
+ @param[in] pCtx          The decoder context.
+ @param[in] pArray        The array item returned by
+                          QCBORDecode_GetNext().
+ @param[out] pnValues     Where to put the integers.
+ @param[in] uMaxValues    The number of integers @c pnValues can hold.
+ @param[out] puNumValues  The number of integers put in @c pnValues.
+
+ @retval QCBOR_ERR_UNEXPECTED_TYPE   An element isn't an integer, or
+                                     @c pArray isn't an array or isn't
+                                     the one being decoded.
+
+ @retval QCBOR_ERR_INT_OVERFLOW      An element is too large for an
+                                     @c int64_t.
+
+ @retval QCBOR_ERR_BUFFER_TOO_SMALL  There are more than @c uMaxValues
+                                     elements.
+
+ @retval QCBOR_ERR_NEED_MORE_DATA    When decoding incrementally, the
+                                     end of the array hasn't been
+                                     received yet.
+
+ This is for the common case of an array that is all integers. It
+ decodes all the elements left in @c pArray, both definite and
+ indefinite length, and the next call to QCBORDecode_GetNext()
+ returns the item after the array. It is much faster than calling
+ QCBORDecode_GetNext() for each element because each one is decoded
+ straight into @c pnValues. There is no @ref QCBORItem, label
+ handling or tag processing for the elements. Tags on elements are
+ not allowed.
+
+ This is called after QCBORDecode_GetNext() returns @c pArray, or
+ after it has returned some of the elements of @c pArray.
+
+ On any error nothing is consumed and @c puNumValues is 0. The rest
+ of the array can still be decoded with QCBORDecode_GetNext(), for
+ example to find out what the element that isn't an integer is.
+ */
+QCBORError QCBORDecode_GetInt64Array(QCBORDecodeContext *pCtx,
+                                     const QCBORItem    *pArray,
+                                     int64_t            *pnValues,
+                                     size_t              uMaxValues,
+                                     size_t             *puNumValues);
+
+
+/**
+ @brief Decode the rest of an array of floating-point numbers into a C array.
+
+ @param[in] pCtx          The decoder context.
+ @param[in] pArray        The array item returned by
+                          QCBORDecode_GetNext().
+ @param[out] pdValues     Where to put the numbers.
+ @param[in] uMaxValues    The number of numbers @c pdValues can hold.
+ @param[out] puNumValues  The number of numbers put in @c pdValues.
+
+ @retval QCBOR_ERR_UNEXPECTED_TYPE   An element isn't a half, single or
+                                     double-precision number.
+
+ This is the same as QCBORDecode_GetInt64Array(), but for arrays of
+ floating-point numbers. They are all converted to double the same
+ as QCBORDecode_GetNext() does. Integers are not accepted. Other
+ errors are the same as for QCBORDecode_GetInt64Array() and for
+ floating-point in QCBORDecode_GetNext().
+ */
+QCBORError QCBORDecode_GetDoubleArray(QCBORDecodeContext *pCtx,
+                                      const QCBORItem    *pArray,
+                                      double             *pdValues,
+                                      size_t              uMaxValues,
+                                      size_t             *puNumValues);
+
+
+/**
+ @brief Decode a map into a C structure.
+
+ @param[in] pCtx      The decoder context.
+ @param[in] pRecord   The record from QCBOREncode_CompileRecord().
+ @param[out] pStruct  The structure to fill in.
+ @param[out] puFound  One bit for each field of @c pRecord that was
+                      in the map, bit 0 for the first field. May be
+                      @c NULL.
+
+ @retval QCBOR_ERR_UNEXPECTED_TYPE  The next item isn't a map or the
+                                    value of a field isn't of its type.
+
+ @retval QCBOR_ERR_INT_OVERFLOW     The value of an integer field is too
+                                    large for its member.
+
+ This gets the next item, which must be a map, and decodes all of its
+ entries in one pass. The value of each entry whose label is the
+ label of a field is put in the member of @c pStruct for the field.
+ Members for fields that are not in the map are not changed. Other
+ entries are skipped over, including all the contents of arrays and
+ maps, as with QCBORDecode_SkipCurrent(). If a label is in the map
+ more than once the last one is used, unless
+ QCBORDecode_SetMapChecks() has been called, in which case the error
+ is @ref QCBOR_ERR_DUPLICATE_LABEL.
+
+ The entries may be in any order. The search for a label starts at
+ the field after the one last found, so it takes one comparison per
+ entry when the entries are in the order of the fields, as they are
+ when encoded with QCBOREncode_AddRecord().
+
+ Integer fields take integers only. Double fields take half, single
+ and double-precision numbers. Text and byte string members point
+ into the input, or into memory from the string allocator for
+ indefinite-length strings.
+
+ On error the decoder is part way through the map so decoding should
+ usually be abandoned. Some members may have been filled in.
+ */
+QCBORError QCBORDecode_GetRecord(QCBORDecodeContext *pCtx,
+                                 const QCBORRecord  *pRecord,
+                                 void               *pStruct,
+                                 uint32_t           *puFound);
+
+
+/**
+ @brief Index a map so its entries can be looked up by label.
+
+ @param[in] pCtx         The decoder context.
+ @param[in] pMapItem     The map item just returned by
+                         QCBORDecode_GetNext().
+ @param[out] pIndex      The index to fill in.
+ @param[in] pEntries     Memory for the index, one entry per map entry.
+ @param[in] uNumEntries  The number of entries in @c pEntries.
+
+ @retval QCBOR_ERR_MAP_NOT_ENTERED  @c pMapItem is not a map or it
+                                    wasn't the last item returned.
+
+ @retval QCBOR_ERR_INDEX_TOO_SMALL  The map has more than @c
+                                    uNumEntries entries.
+
+ Other errors are those of QCBORDecode_GetNext() encountered while
+ scanning the map.
+
+ Finding a few labels in a large map otherwise means looping over
+ QCBORDecode_GetNext() comparing labels, and starting over for any
+ lookups that are not in order. This scans the map once, including
+ any maps and arrays in it, recording where each entry starts. The
+ index is then sorted by label so QCBORDecode_GetItemInIndexN() and
+ QCBORDecode_GetItemInIndexSZ() are a binary search and one decode of
+ the entry.
+
+ This must be called right after QCBORDecode_GetNext() returns the
+ map in @c pMapItem. Afterwards the decoder is positioned after the
+ end of the map, as if all its items had been consumed. An empty map
+ results in an empty index.
+
+ Integer, text string and byte string labels are indexed. Strings are
+ kept as a 64-bit hash, not a pointer, so the index entries are
+ small. The map must not be decoded as an array, see @ref
+ QCBOR_DECODE_MODE_MAP_AS_ARRAY.
+
+ If all strings are being allocated, see QCBORDecode_SetMemPool(),
+ the strings allocated while scanning the map are freed.
+
+ The index is only good with the decode context and input it was
+ made with.
+ */
+QCBORError QCBORDecode_IndexMap(QCBORDecodeContext *pCtx,
+                                const QCBORItem    *pMapItem,
+                                QCBORMapIndex      *pIndex,
+                                QCBORMapIndexEntry *pEntries,
+                                size_t              uNumEntries);
+
+
+/**
+ @brief Get an item out of an indexed map by integer label.
+
+ @param[in] pCtx     The decoder context.
+ @param[in] pIndex   The index made by QCBORDecode_IndexMap().
+ @param[in] nLabel   The label to look for.
+ @param[out] pItem   The item found.
+
+ @retval QCBOR_ERR_LABEL_NOT_FOUND  There is no entry with the label.
+
+ Other errors are those of QCBORDecode_GetNext() for the entry.
+
+ This moves the decoder to the entry and decodes it with
+ QCBORDecode_GetNext(), so @c pItem is just as it would be from
+ that. If the item is a map or array, its contents can be gotten with
+ QCBORDecode_GetNext() and may also be indexed. Calling
+ QCBORDecode_GetNext() continues with the entries that come after
+ the one found in the encoded map. Lookups can be in any order.
+
+ If the map has duplicate labels, which one is returned is not
+ specified.
+
+ Call QCBORDecode_ExitIndexedMap() when done with the map.
+ */
+QCBORError QCBORDecode_GetItemInIndexN(QCBORDecodeContext  *pCtx,
+                                       const QCBORMapIndex *pIndex,
+                                       int64_t              nLabel,
+                                       QCBORItem           *pItem);
+
+
+/**
+ @brief Get an item out of an indexed map by text string label.
+
+ @param[in] pCtx     The decoder context.
+ @param[in] pIndex   The index made by QCBORDecode_IndexMap().
+ @param[in] szLabel  The label to look for.
+ @param[out] pItem   The item found.
+
+ @return See QCBORDecode_GetItemInIndexN().
+
+ This is the same as QCBORDecode_GetItemInIndexN(), but for a text
+ string label.
+ */
+QCBORError QCBORDecode_GetItemInIndexSZ(QCBORDecodeContext  *pCtx,
+                                        const QCBORMapIndex *pIndex,
+                                        const char          *szLabel,
+                                        QCBORItem           *pItem);
+
+
+/**
+ @brief Position the decoder after an indexed map.
+
+ @param[in] pCtx    The decoder context.
+ @param[in] pIndex  The index made by QCBORDecode_IndexMap().
+
+ After this, QCBORDecode_GetNext() returns whatever comes after the
+ map, the same as right after QCBORDecode_IndexMap().
+ */
+void QCBORDecode_ExitIndexedMap(QCBORDecodeContext *pCtx, const QCBORMapIndex *pIndex);
+
+
+/**
+ @brief Save the decode position to come back to later.
+
+ @param[in]  pCtx     The decoder context.
+ @param[out] pCursor  The saved position.
+
+ This is quick and the cursor is small so it can be used, for
+ example, to look at the first items of a message to decide how to
+ decode it and then to decode it from the start again with
+ QCBORDecode_RestoreCursor() rather than with QCBORDecode_Init().
+ Any number of cursors may be saved.
+ */
+void QCBORDecode_SaveCursor(QCBORDecodeContext *pCtx, QCBORDecodeCursor *pCursor);
+
+
+/**
+ @brief Go back to a position saved by QCBORDecode_SaveCursor().
+
+ @param[in] pCtx     The decoder context.
+ @param[in] pCursor  A position saved with the same context.
+
+ @retval QCBOR_ERR_BAD_CURSOR  The decoder has left the array or map
+                               that was being decoded when the cursor
+                               was saved.
+
+ After this QCBORDecode_GetNext() returns the same item it returned
+ right after the cursor was saved.
+
+ Only the current nesting level is saved in a cursor, so it can be
+ restored only while decoding is still in the array or map it was
+ saved in, or in one that it encloses. Leaving that array or map is
+ detected and the error is returned. Note that getting the last item
+ in an array or map leaves it. It is not detected if it is left and
+ another is entered at the same level, so don't do this.
+
+ Input already given to the digest callback set by
+ QCBORDecode_SetDigest() is not given again. Strings allocated by the
+ string allocator are not freed, so they will be allocated again when
+ decoded again.
+ */
+QCBORError QCBORDecode_RestoreCursor(QCBORDecodeContext *pCtx, const QCBORDecodeCursor *pCursor);
+
+
 /**
  Check whether all the bytes have been decoded and maps and arrays closed.
 
@@ -854,6 +1720,296 @@ int QCBORDecode_IsTagged(QCBORDecodeContext *pCtx, const QCBORItem *pItem, uint6
 QCBORError QCBORDecode_Finish(QCBORDecodeContext *pCtx);
 
 
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+/**
+ Counters of the work done by a decode context. See
+ QCBORDecode_GetStats().
+ */
+typedef struct {
+   /** Data items decoded, including those from
+       QCBORDecode_GetNextBatch() and QCBORDecode_GetInt64Array(), but
+       not those skipped over */
+   uint64_t uItemsDecoded;
+   /** Bytes of input consumed */
+   size_t   uBytesConsumed;
+   /** The deepest array and map nesting reached. It is 1 for a
+       top-level array. */
+   uint8_t  uMaxNesting;
+   /** Calls to the string allocator, including frees */
+   uint32_t uAllocatorCalls;
+   /** Total of the sizes asked of the string allocator */
+   size_t   uAllocatorBytes;
+   /** Tags recorded in @c uTagBits or @c uExtTagBits of an item */
+   uint32_t uTagsMapped;
+   /** Tags that were not recognized and not recorded */
+   uint32_t uTagsNotMapped;
+} QCBORDecodeStats;
+
+
+/**
+ @brief Get counters of the work done by a decode context.
+
+ @param[in]  pCtx    The decode context.
+ @param[out] pStats  The counters since QCBORDecode_Init().
+
+ This is only available when the library is built with
+ @c QCBOR_CONFIG_ENABLE_STATS. Without it the counters are not in
+ @ref QCBORDecodeContext at all and cost nothing. This may be called
+ any time, including after QCBORDecode_Finish().
+ */
+void QCBORDecode_GetStats(QCBORDecodeContext *pCtx, QCBORDecodeStats *pStats);
+#endif /* QCBOR_CONFIG_ENABLE_STATS */
+
+
+
+
+/**
+ @brief Check that CBOR is well-formed without decoding it.
+
+ @param[in]  EncodedCBOR    The CBOR to check.
+ @param[in]  pLimits        Limits on the CBOR or @c NULL for the
+                            decoder's limits.
+ @param[out] puErrorOffset  Place to return the offset of the error
+                            or @c NULL.
+
+ @return @ref QCBOR_SUCCESS if the input is well-formed and within the
+         limits or the error the decoder would return for it.
+
+ This checks the structure of the input: the heads of all the data
+ items, that definite-length arrays and maps have all their items,
+ that breaks occur only where they end an indefinite-length array,
+ map or string, that the chunks of indefinite-length strings are all
+ of the right type, that maps have an even number of items, and that
+ the nesting depth, array sizes and string lengths are within the
+ limits. It is much faster than decoding the input with
+ QCBORDecode_GetNext(), because no @ref QCBORItem is filled in and
+ string payloads are skipped using the length in their head, so it is
+ good for rejecting malformed input at ingress before any other work
+ is done on it.
+
+ The errors returned are the same as those returned by
+ QCBORDecode_GetNext() and QCBORDecode_Finish() for the same
+ malformation. @ref QCBOR_ERR_HIT_END is returned if the input ends
+ before the data item does, including for empty input when @c
+ bAllowSequence is not set. @ref QCBOR_ERR_EXTRA_BYTES is returned if
+ there are bytes after the data item and @c bAllowSequence is not set.
+
+ If there is an error, *puErrorOffset is set to the offset in the
+ input of the head of the data item that is in error, or of the end
+ of the input when it ended too soon. It is set to 0 on success.
+
+ This only checks that the CBOR is well-formed. It doesn't check the
+ content of tags, for example that an epoch date is a number, or the
+ types of map labels, that map labels aren't duplicated, or that text
+ strings are valid UTF-8. Those are checked when the input is decoded. Indefinite-length strings, arrays
+ and maps and tags are rejected with the same errors as
+ QCBORDecode_GetNext() when they are left out of the decoder with
+ QCBOR_DISABLE_TAGS and such. See qcbor_common.h.
+
+ No decode context, string allocator or memory beyond a few hundred
+ bytes of stack is needed.
+ */
+QCBORError QCBORDecode_Validate(UsefulBufC                 EncodedCBOR,
+                                const QCBORValidateLimits *pLimits,
+                                size_t                    *puErrorOffset);
+
+
+/**
+ @brief Find the data items in a CBOR sequence without decoding them.
+
+ @param[in]  Sequence    The CBOR sequence [RFC 8742]
+                         (https://tools.ietf.org/html/rfc8742).
+ @param[out] pItems      Array to fill in with the encoded data items.
+ @param[in]  uMaxItems   The number of entries in @c pItems.
+ @param[out] puNumItems  The number of data items put in @c pItems.
+ @param[out] puConsumed  The number of bytes of @c Sequence in the
+                         items put in @c pItems. May be @c NULL.
+
+ @return @ref QCBOR_SUCCESS or the error QCBORDecode_Validate() gives
+         for the first data item that isn't well-formed.
+
+ This splits a CBOR sequence into its top-level data items so they
+ can be decoded independently, for example by several threads each
+ with its own @ref QCBORDecodeContext. The boundaries come from the
+ heads alone using the same checks as QCBORDecode_Validate(), so it
+ is much faster than decoding. Each item put in @c pItems is
+ well-formed and within the decoder's limits.
+
+ Splitting stops after @c uMaxItems items or at the end of @c
+ Sequence. Call again on what is after @c puConsumed for more.
+
+ On error, @c pItems has the good items before the bad one and @c
+ puConsumed is the offset of the bad one. When the input is received
+ in pieces, @ref QCBOR_ERR_HIT_END means the last item is incomplete
+ and should be kept for next time.
+
+ See also QCBORDecode_PartitionSequence().
+ */
+QCBORError QCBORDecode_SplitSequence(UsefulBufC  Sequence,
+                                     UsefulBufC *pItems,
+                                     size_t      uMaxItems,
+                                     size_t     *puNumItems,
+                                     size_t     *puConsumed);
+
+
+/**
+ A share of the items from QCBORDecode_SplitSequence(), for one
+ worker. See QCBORDecode_PartitionSequence().
+ */
+typedef struct {
+   /** The first item for this job, an entry in the array of items
+       given to QCBORDecode_PartitionSequence(). */
+   const UsefulBufC *pItems;
+   /** The number of items for this job. It may be 0. */
+   size_t            uNumItems;
+   /** The position of @c pItems in the sequence, for putting results
+       in order. */
+   size_t            uFirstIndex;
+} QCBORSequenceJob;
+
+
+/**
+ @brief Divide the items in a CBOR sequence into jobs for workers.
+
+ @param[in]  pItems     The items from QCBORDecode_SplitSequence().
+ @param[in]  uNumItems  The number of items in @c pItems.
+ @param[out] pJobs      Array of jobs to fill in.
+ @param[in]  uNumJobs   The number of jobs in @c pJobs, usually the
+                        number of threads.
+
+ This gives each job a run of items next to each other with about the
+ same number of bytes in each, so jobs take about the same time to
+ decode. The jobs are in sequence order, so results put out in job
+ order, or by @c uFirstIndex, are in the order of the sequence.
+
+ QCBOR has no threads of its own. Each worker does its job with its
+ own @ref QCBORDecodeContext and, if needed, its own string
+ allocator, calling QCBORDecode_Init() and QCBORDecode_Finish() for
+ each item. Nothing is shared between the workers except the input,
+ which is only read.
+ */
+void QCBORDecode_PartitionSequence(const UsefulBufC *pItems,
+                                   size_t            uNumItems,
+                                   QCBORSequenceJob *pJobs,
+                                   size_t            uNumJobs);
+
+
+/** The maximum number of paths in a @ref QCBORQuery. */
+#define QCBOR_MAX_QUERY_PATHS QCBOR_MAX_QUERY_PATHS1
+
+/** The maximum number of steps, including the @ref QCBOR_PATH_END
+    steps, in a @ref QCBORQuery. */
+#define QCBOR_MAX_QUERY_STEPS QCBOR_MAX_QUERY_STEPS1
+
+
+/** The @c uKind of a @ref QCBORPathStep that ends a path */
+#define QCBOR_PATH_END          0
+/** Go into the map entry whose label is the integer @c nValue */
+#define QCBOR_PATH_LABEL_INT    1
+/** Go into the map entry whose label is the text string @c Text */
+#define QCBOR_PATH_LABEL_TEXT   2
+/** Go into the array element at index @c nValue, counting from 0 */
+#define QCBOR_PATH_ARRAY_INDEX  3
+/** Go into the CBOR data item in a byte string, for example a COSE
+    payload */
+#define QCBOR_PATH_BSTR_WRAPPED 4
+
+
+/**
+ One step of a path for QCBORDecode_CompileQuery(). Usually these are
+ made with QCBORPath_INT() and the other macros below.
+ */
+typedef struct _QCBORPathStep {
+   /** One of @c QCBOR_PATH_XXX */
+   uint8_t    uKind;
+   /** The integer label or array index */
+   int64_t    nValue;
+   /** The text label */
+   UsefulBufC Text;
+} QCBORPathStep;
+
+/** Initializers for @ref QCBORPathStep for static arrays of paths */
+#define QCBORPath_INT(n)            {QCBOR_PATH_LABEL_INT, (n), {NULL, 0}}
+#define QCBORPath_TEXT_LITERAL(sz)  {QCBOR_PATH_LABEL_TEXT, 0, {(sz), sizeof(sz)-1}}
+#define QCBORPath_INDEX(n)          {QCBOR_PATH_ARRAY_INDEX, (n), {NULL, 0}}
+#define QCBORPath_BSTR_WRAPPED      {QCBOR_PATH_BSTR_WRAPPED, 0, {NULL, 0}}
+#define QCBORPath_END               {QCBOR_PATH_END, 0, {NULL, 0}}
+
+
+/**
+ @brief Compile paths to data items for QCBORDecode_RunQuery().
+
+ @param[out] pQuery     The compiled query.
+ @param[in]  pSteps     The steps of all the paths.
+ @param[in]  uNumSteps  The number of entries in @c pSteps.
+
+ @retval QCBOR_ERR_BAD_QUERY  A step is not valid, @c pSteps doesn't
+                              end with @ref QCBOR_PATH_END, a path has
+                              more steps than @ref
+                              QCBOR_MAX_ARRAY_NESTING, or there are
+                              more than @ref QCBOR_MAX_QUERY_PATHS
+                              paths or @ref QCBOR_MAX_QUERY_STEPS steps.
+
+ Each path is a list of steps from the top-level data item down to
+ the one wanted, ending with @ref QCBOR_PATH_END. The paths are one
+ after another in @c pSteps. For example, this gets the algorithm
+ from the protected headers and the kid from the unprotected headers
+ of a COSE_Sign1 message:
+
+     static const QCBORPathStep spPaths[] = {
+        QCBORPath_INDEX(0), QCBORPath_BSTR_WRAPPED, QCBORPath_INT(1), QCBORPath_END,
+        QCBORPath_INDEX(1), QCBORPath_INT(4), QCBORPath_END
+     };
+
+ A path with no steps gets the top-level data item. This is done once
+ and the query is run on any number of inputs. Paths that start the
+ same are merged so the common part is only followed once. @c pSteps
+ is not copied and must not change while the query is in use.
+ */
+QCBORError QCBORDecode_CompileQuery(QCBORQuery          *pQuery,
+                                    const QCBORPathStep *pSteps,
+                                    size_t               uNumSteps);
+
+
+/**
+ @brief Get the data items a compiled query points to in one pass.
+
+ @param[in]  pQuery         The query from QCBORDecode_CompileQuery().
+ @param[in]  EncodedCBOR    One CBOR data item to search.
+ @param[out] pItems         One item for each path, in order.
+ @param[out] pEncodedItems  The encoded CBOR of each item found. May
+                            be @c NULL.
+
+ @return @ref QCBOR_SUCCESS even if some paths weren't found, or an
+         error from QCBORDecode_Validate() or QCBORDecode_GetNext().
+
+ The items for paths that are not in @c EncodedCBOR have @c uDataType
+ @ref QCBOR_TYPE_NONE. An item that is found is decoded with
+ QCBORDecode_GetNext() in @ref QCBOR_DECODE_MODE_NORMAL so tags like
+ dates are processed. It has nesting level 0 and no label. If it is
+ an array or map only the item for its head is given. Decode the rest
+ of it from @c pEncodedItems. Strings point into @c EncodedCBOR.
+ There is no string allocator, so an indefinite-length string that is
+ found gives @ref QCBOR_ERR_NO_STRING_ALLOCATOR.
+
+ Everything not on a path is skipped over using only the heads, as in
+ QCBORDecode_SkipCurrent(), so this is much faster than decoding all
+ the items. Tags before a map, array or wrapped byte string on a path
+ are skipped. If a map has a label more than once, the first entry is
+ used. The search stops as soon as all the paths are found, so the
+ rest of the input is not checked for being well-formed.
+
+ No decode context is needed. A query may be run by several threads
+ at once. Without one, QCBORDecode_SetMapChecks() doesn't apply, so
+ duplicate labels are not found. Use QCBORDecode_GetNext() with map
+ checks when they matter.
+ */
+QCBORError QCBORDecode_RunQuery(const QCBORQuery *pQuery,
+                                UsefulBufC        EncodedCBOR,
+                                QCBORItem        *pItems,
+                                UsefulBufC       *pEncodedItems);
+
+
 
 
 /**
@@ -308,6 +308,15 @@ extern "C" {
  float as 32-bits and a double as 64-bits. Floating-point epoch dates
  will be unsupported.
 
+ Define QCBOR_USE_HW_FLOAT_CONVERSION to have the conversions between
+ half, single and double precision use the CPU's conversion
+ instructions where they give exactly the same result as the shifts
+ and masks. This is F16C on x86 (compiled with -mf16c or an -march
+ that has it) and __fp16 on 64-bit Arm. NaNs, and the narrowing
+ conversions that would lose precision, still use the shifts and
+ masks. It has no effect if QCBOR_DISABLE_FLOAT_HW_USE or
+ QCBOR_DISABLE_PREFERRED_FLOAT is defined.
+
  Summary Limits of this implementation:
  - The entire encoded CBOR must fit into contiguous memory.
  - Max size of encoded / decoded CBOR data is @c UINT32_MAX (4GB).
@@ -349,14 +358,43 @@ extern "C" {
 
 /**
  QCBOREncodeContext is the data type that holds context for all the
- encoding functions. It is less than 200 bytes, so it can go on the
- stack. The contents are opaque, and the caller should not access
+ encoding functions. It is about 180 bytes on a 64-bit CPU, so it can
+ go on the stack. The contents are opaque, and the caller should not access
  internal members.  A context may be re used serially as long as it is
  re initialized.
  */
 typedef struct _QCBOREncodeContext QCBOREncodeContext;
 
 
+/**
+ The state of the encoder features that aren't needed for most
+ encoding: QCBOREncode_InitWithSink(), QCBOREncode_SetReferences(),
+ QCBOREncode_BstrWrapWithDigest() and
+ QCBOREncode_OpenStringRefNamespace(). It is kept out of @ref
+ QCBOREncodeContext so that the context is small without them. It is
+ about 96 bytes on a 64-bit CPU. The contents are opaque. See
+ QCBOREncode_SetExtension().
+ */
+typedef struct _QCBOREncodeExtension QCBOREncodeExtension;
+
+
+/**
+ One string output by reference rather than copied. The caller gives
+ an array of these to QCBOREncode_SetReferences(). Each is 24 bytes on
+ a 64-bit CPU and 16 bytes on a 32-bit CPU. The contents are opaque.
+ */
+typedef struct _QCBOREncodeRef QCBOREncodeRef;
+
+
+/**
+ A ring buffer that one thread encodes records into and another takes
+ them out of without locks or copying. See QCBORRing_Init(). It is 48
+ bytes on a 64-bit CPU and 24 bytes on a 32-bit CPU. The contents are
+ opaque.
+ */
+typedef struct _QCBORRing QCBORRing;
+
+
 /**
  Initialize the encoder to prepare to encode some CBOR.
 
@@ -389,6 +427,272 @@ typedef struct _QCBOREncodeContext QCBOREncodeContext;
 void QCBOREncode_Init(QCBOREncodeContext *pCtx, UsefulBuf Storage);
 
 
+/**
+ Flags for QCBOREncode_Config(). They can be OR'd together.
+ */
+typedef enum {
+   /** The default. When a map, array or bstr wrapping is closed, its
+       head is inserted at the position it was opened, sliding
+       everything encoded since to the right. */
+   QCBOR_ENCODE_CONFIG_NONE = 0x00,
+
+   /** Close maps, arrays and bstr wrapping without sliding. See
+       QCBOREncode_Config(). */
+   QCBOR_ENCODE_CONFIG_NO_SLIDE = 0x01,
+} QCBOREncodeConfig;
+
+
+/**
+ @brief Configure the encoder.
+
+ @param[in] pCtx          The encoder context.
+ @param[in] uConfigFlags  Flags from @ref QCBOREncodeConfig OR'd
+                          together.
+
+ Call this right after QCBOREncode_Init() before anything is added.
+ The configuration lasts until the next QCBOREncode_Init().
+
+ The head of a map or array can't be output when it is opened because
+ the number of items in it isn't known until it is closed. Likewise
+ for the length of bstr-wrapped CBOR. Normally the head is inserted
+ when it is closed which slides everything that was encoded since the
+ open to the right by the size of the head. With deep nesting this
+ can be O(bytes x depth).
+
+ With @ref QCBOR_ENCODE_CONFIG_NO_SLIDE, room for the largest
+ possible head (3 bytes for maps and arrays, 5 bytes for bstr
+ wrapping) is reserved when the map, array or bstr wrap is opened. On
+ close the head is written into the end of the reserved room. The
+ unused part of the reserved room is filled with a byte that can
+ never start a well-formed CBOR data item. QCBOREncode_Finish() then
+ removes all such filler in one pass over the output so the output is
+ still preferred serialization and the same as without this
+ configuration. The cost of that pass is proportional to the number
+ of data items in the output, not the nesting depth. String content
+ is skipped over, not looked at.
+
+ This is a trade off. The slide is a memmove() which is very fast on
+ CPUs with large caches, so with shallow nesting of many small
+ items, the normal mode may be faster. This mode is better for deep
+ nesting of large content and for CPUs with slow memory copies.
+ Measure it with the qcborbench benchmarks.
+
+ The content of bstr-wrapped CBOR must be final when it is closed so
+ that it can be hashed. Filler within it is removed when it is closed
+ by a pass over just its content. Nested bstr wrapping thus still
+ costs one pass over the content per level of bstr wrapping, but
+ nesting of maps and arrays doesn't.
+
+ With this configuration the pointer returned by
+ QCBOREncode_CloseBstrWrap2() for a bstr wrap that is not inside
+ another bstr wrap stays valid until QCBOREncode_Finish() rather than
+ the next close. For one that is inside another it is only valid until
+ the enclosing bstr wrap is closed, because the filler removed then
+ may be before it.
+
+ Some caveats:
+
+ - The output buffer must have room for the reserved heads of all the
+   maps and arrays that have been opened in addition to the final
+   output. When @c Storage.ptr is @c NULL to compute the size of the
+   output, QCBOREncode_Finish() returns this larger size that is
+   needed for the buffer, not the size of the final output.
+
+ - The pass that removes filler relies on the output being
+   well-formed CBOR. Anything added with QCBOREncode_AddEncoded() must
+   be well-formed. QCBOREncode_AddBytesLenOnly() is not allowed
+   because it outputs a head without its content. It sets the error
+   @ref QCBOR_ERR_UNSUPPORTED.
+ */
+void QCBOREncode_Config(QCBOREncodeContext *pCtx, uint8_t uConfigFlags);
+
+
+/**
+ @brief Give the encoder memory for its optional features.
+
+ @param[in] pCtx  The encoder context.
+ @param[in] pExt  Memory for the state of the optional features.
+
+ Call this right after QCBOREncode_Init() before anything is added.
+ @c pExt must stay valid until encoding is finished. It isn't needed
+ with QCBOREncode_InitWithSink() which takes it as a parameter.
+
+ QCBOREncode_SetReferences(), QCBOREncode_BstrWrapWithDigest() and
+ QCBOREncode_OpenStringRefNamespace() set the error @ref
+ QCBOR_ERR_NO_EXTENSION without it.
+ */
+void QCBOREncode_SetExtension(QCBOREncodeContext *pCtx, QCBOREncodeExtension *pExt);
+
+
+/**
+ @brief Type for the callback that takes encoded output.
+
+ @param[in] pSinkCtx  The context given to QCBOREncode_InitWithSink().
+ @param[in] Bytes     The next bytes of encoded output.
+
+ @return 0 on success. Anything else stops the encoding and
+         QCBOREncode_Finish() returns @ref QCBOR_ERR_SINK_WRITE.
+
+ This is called with the encoded output in order as it is flushed out
+ of the staging buffer. It may be called with just one byte. It must
+ write or copy the bytes before returning because the encoder reuses
+ the memory.
+ */
+typedef int (* QCBOREncodeSink)(void *pSinkCtx, UsefulBufC Bytes);
+
+
+/**
+ @brief Initialize the encoder to output through a callback.
+
+ @param[in,out] pCtx      The encoder context to initialize.
+ @param[in]     Staging   Buffer to hold encoded output until it is
+                          flushed.
+ @param[in]     pExt      Memory for the sink state. See
+                          QCBOREncode_SetExtension().
+ @param[in]     pfSink    Callback that is given the encoded output.
+ @param[in]     pSinkCtx  Context passed to @c pfSink.
+
+ This is an alternative to QCBOREncode_Init() for when the output is
+ written to a socket, file or such as it is encoded rather than put
+ into one contiguous buffer. The memory needed is bounded by the size
+ of @c Staging, not the size of the encoded output. There is no need
+ to encode twice to find out the size of the buffer to allocate.
+
+ The encoded output accumulates in @c Staging. When there isn't room
+ for the next data item, as much as possible is flushed to @c pfSink.
+ @c Staging.ptr must not be @c NULL; there is no size calculation mode
+ with a sink.
+
+ The head of a definite-length map or array can't be output until it
+ is closed because it contains the number of items. If a flush has to
+ output bytes inside a map or array that is still open, its head is
+ output as an indefinite-length head and its close outputs a break.
+ This is well-formed CBOR, but isn't preferred serialization and may
+ not be accepted by some CBOR protocols. If everything fits in @c
+ Staging, nothing is flushed until QCBOREncode_Finish() and the output
+ is exactly the same as with QCBOREncode_Init().
+
+ Bstr-wrapped CBOR can't be output until it is closed because the
+ wrapped CBOR is returned for hashing and because the head has its
+ length. Everything from the opening of the outermost open bstr wrap
+ has to fit in @c Staging or the error @ref QCBOR_ERR_BUFFER_TOO_SMALL
+ occurs. The pointer returned by QCBOREncode_CloseBstrWrap2() must be
+ used before anything else is added.
+
+ A byte or text string that is larger than the room in @c Staging is
+ passed straight to @c pfSink without being copied, unless it is in a
+ bstr wrap.
+
+ QCBOREncode_Finish() flushes the rest of the output. The @ref
+ UsefulBufC it returns has a @c NULL pointer and the total length of
+ everything output. The configuration @ref
+ QCBOR_ENCODE_CONFIG_NO_SLIDE has no effect because a slide is never
+ more than the size of @c Staging.
+ */
+void QCBOREncode_InitWithSink(QCBOREncodeContext   *pCtx,
+                              UsefulBuf             Staging,
+                              QCBOREncodeExtension *pExt,
+                              QCBOREncodeSink       pfSink,
+                              void                 *pSinkCtx);
+
+
+/**
+ @brief Output large strings by reference rather than copying them.
+
+ @param[in] pCtx        The encoder context.
+ @param[in] pRefs       Memory to record the references in.
+ @param[in] uNumRefs    The number of references @c pRefs can hold.
+ @param[in] uMinRefLen  Byte strings, text strings and encoded CBOR
+                        this long or longer are referenced.
+
+ Call this right after QCBOREncode_Init() and
+ QCBOREncode_SetExtension() before anything is added.
+
+ Normally QCBOREncode_AddBytes(), QCBOREncode_AddText(),
+ QCBOREncode_AddEncoded() and such copy their content into the output
+ buffer. With this, only the head goes in the output buffer for
+ content of @c uMinRefLen bytes or more. A reference to the caller's
+ memory is recorded in @c pRefs. The memory must stay valid and
+ unchanged until the output has been used. The output buffer then only
+ has to be big enough for the heads and the small items.
+
+ The output is then a list of pieces in order. Each piece is either
+ part of the output buffer or a referenced string. Get it with
+ QCBOREncode_FinishSegments() and output it with something like @c
+ writev() or a DMA descriptor list. QCBOREncode_Finish() returns @ref
+ QCBOR_ERR_OUTPUT_HAS_REFERENCES if anything was referenced.
+ QCBOREncode_FinishGetSize() returns the total length of all the
+ pieces.
+
+ Content is copied as usual rather than referenced:
+ - when @c pRefs is full,
+ - inside bstr wrapping, because the wrapped CBOR must be contiguous
+   for hashing,
+ - with @ref QCBOR_ENCODE_CONFIG_NO_SLIDE, because removal of the
+   filler has to walk the string content, and
+ - with QCBOREncode_InitWithSink(), which already passes large strings
+   to the sink without copying.
+ */
+void QCBOREncode_SetReferences(QCBOREncodeContext *pCtx,
+                               QCBOREncodeRef     *pRefs,
+                               size_t              uNumRefs,
+                               size_t              uMinRefLen);
+
+
+/**
+ @brief Start a string reference namespace to shrink repeated strings.
+
+ @param[in] pCtx        The encoder context.
+ @param[in] pTable      Memory for the strings in the namespace.
+ @param[in] uTableSize  The number of entries in @c pTable.
+
+ This adds a @ref CBOR_TAG_STRING_REF_NAMESPACE tag. The next item
+ added, usually a map or array, is the namespace. Call
+ QCBOREncode_CloseStringRefNamespace() after it.
+
+ In the namespace, a byte or text string that is the same as an
+ earlier one is encoded as a @ref CBOR_TAG_STRING_REF tag on the
+ earlier one's number instead of again. This is
+ [stringref](http://cbor.schmorp.de/stringref). Only strings long
+ enough that the reference is smaller are numbered, three bytes for
+ the first 24. Map labels added with QCBOREncode_AddTextToMap() and
+ such are strings too, which is where this helps the most.
+
+ @c pTable is a hash table of pointers to the strings added. The
+ memory of the strings must stay valid and unchanged until the
+ namespace is closed. It is only filled to three quarters. Once it is
+ that full, later strings are output as usual, though references to
+ the ones in it are still made. Allocate about one and a half entries
+ per distinct string.
+
+ The decoder needs QCBORDecode_SetStringRefs() to turn the references
+ back into strings. To most other decoders they are tagged integers.
+
+ QCBOREncode_SetExtension() must have been called.
+
+ Opening a namespace in a namespace sets @ref
+ QCBOR_ERR_STRING_REF_NESTED. Bstr wrapping in a namespace sets @ref
+ QCBOR_ERR_UNSUPPORTED. Strings in CBOR added with
+ QCBOREncode_AddEncoded() or QCBOREncode_AddEncodedFragment() are not
+ seen by the encoder, so such CBOR must not have strings of three or
+ more bytes.
+ */
+void QCBOREncode_OpenStringRefNamespace(QCBOREncodeContext *pCtx,
+                                        QCBORStringRef     *pTable,
+                                        size_t              uTableSize);
+
+
+/**
+ @brief End the string reference namespace.
+
+ @param[in] pCtx  The encoder context.
+
+ Call this after the item that follows
+ QCBOREncode_OpenStringRefNamespace().
+ */
+void QCBOREncode_CloseStringRefNamespace(QCBOREncodeContext *pCtx);
+
+
 /**
  @brief  Add a signed 64-bit integer to the encoded output.
 
@@ -687,6 +991,46 @@ static void QCBOREncode_AddBytesToMapN(QCBOREncodeContext *pCtx, int64_t nLabel,
 
 
 
+/**
+ @brief Add a typed array of numbers to the encoded output.
+
+ @param[in] pCtx          The encoding context to add the array to.
+ @param[in] uElementType  One of @ref QCBOR_TYPED_ARRAY_UINT8 and such.
+ @param[in] Elements      Pointer and length in bytes of the numbers.
+ @param[in] bBigEndian    Output the numbers big-endian rather than in
+                          the byte order of the CPU.
+
+ This outputs an [RFC 8746] (https://tools.ietf.org/html/rfc8746)
+ typed array, a byte string with the numbers in it, with the tag for
+ the element type and byte order. It is much smaller and faster to
+ encode and decode than an array of numbers, particularly for floats
+ which aren't each reduced with preferred serialization.
+
+ @c Elements is usually a C array of the element type. When @c
+ bBigEndian is @c false or the CPU is big-endian it is output as
+ is. Like other byte strings it is output by reference if
+ QCBOREncode_SetReferences() is in use and it is big enough. When @c
+ bBigEndian is @c true on a little-endian CPU the bytes of each number
+ are swapped as it is copied.
+
+ If @c Elements.len is not a multiple of the element size or @c
+ uElementType isn't one of the element types, the error @ref
+ QCBOR_ERR_BAD_TYPED_ARRAY is set.
+
+ The tags for the multi-dimensional and homogeneous arrays of RFC 8746
+ can be added with QCBOREncode_AddTag() before this.
+ */
+void QCBOREncode_AddTypedArray(QCBOREncodeContext *pCtx,
+                               uint8_t             uElementType,
+                               UsefulBufC          Elements,
+                               bool                bBigEndian);
+
+static void QCBOREncode_AddTypedArrayToMap(QCBOREncodeContext *pCtx, const char *szLabel, uint8_t uElementType, UsefulBufC Elements, bool bBigEndian);
+
+static void QCBOREncode_AddTypedArrayToMapN(QCBOREncodeContext *pCtx, int64_t nLabel, uint8_t uElementType, UsefulBufC Elements, bool bBigEndian);
+
+
+
 /**
  @brief Add a binary UUID to the encoded output.
 
@@ -1263,6 +1607,44 @@ static void QCBOREncode_BstrWrapInMap(QCBOREncodeContext *pCtx, const char *szLa
 static void QCBOREncode_BstrWrapInMapN(QCBOREncodeContext *pCtx, int64_t nLabel);
 
 
+/**
+ @brief Indicate start of bstr-wrapped CBOR that is hashed as it is encoded.
+
+ @param[in] pCtx        The encoding context to open the bstr-wrapped
+                        CBOR in.
+ @param[in] pfDigest    Callback given the wrapped CBOR.
+ @param[in] pDigestCtx  Context passed to @c pfDigest.
+
+ This is the same as QCBOREncode_BstrWrap() except that the wrapped
+ CBOR is also given to @c pfDigest in order as it is encoded. The
+ hashing then overlaps with the encoding while the output is still in
+ cache rather than going over the wrapped CBOR again after
+ QCBOREncode_CloseBstrWrap2(). The last of it is given to @c pfDigest
+ before QCBOREncode_CloseBstrWrap2() returns. Only the content is given,
+ not the head of the bstr.
+
+ The bytes of an open definite-length map or array can't be given
+ until it is closed because its head goes in front of them and isn't
+ known until then. Wrapped CBOR that is a single large map, like most
+ COSE payloads, is thus mostly hashed at its close. Use
+ QCBOREncode_OpenMapIndefiniteLength() and similar inside the wrap
+ where this matters.
+
+ This works best with @ref QCBOR_ENCODE_CONFIG_NO_SLIDE. Otherwise the
+ wrapped CBOR is moved in memory once more when the head of the bstr
+ is inserted. Nothing is given to @c pfDigest when only computing the
+ size.
+
+ Only one bstr wrap with a digest can be open at a time. Opening
+ another, and QCBOREncode_AddBytesLenOnly() inside it, set the error
+ @ref QCBOR_ERR_UNSUPPORTED. QCBOREncode_SetExtension() must have been
+ called.
+ */
+void QCBOREncode_BstrWrapWithDigest(QCBOREncodeContext *pCtx,
+                                    QCBORDigestUpdate   pfDigest,
+                                    void               *pDigestCtx);
+
+
 /**
  @brief Close a wrapping bstr.
 
@@ -1329,6 +1711,114 @@ static void QCBOREncode_AddEncodedToMap(QCBOREncodeContext *pCtx, const char *sz
 static void QCBOREncode_AddEncodedToMapN(QCBOREncodeContext *pCtx, int64_t nLabel, UsefulBufC Encoded);
 
 
+/**
+ @brief Add a fragment of already-encoded CBOR that is several items.
+
+ @param[in] pCtx       The encoding context to add the fragment to.
+ @param[in] Fragment   The already-encoded CBOR data items.
+ @param[in] uNumItems  The number of data items in @c Fragment.
+
+ This is like QCBOREncode_AddEncoded() except @c Fragment may be
+ several data items one after another, a CBOR sequence, and they are
+ counted as @c uNumItems in the enclosing array or map. In a map a
+ label and its value are each an item, so a fragment of map entries
+ has twice the number of entries as items. Only the top-level items
+ in the fragment are counted. The items in arrays and maps in it are
+ not.
+
+ This is for encoding a large document in pieces. For example, the
+ records in a big array can be encoded by different threads, each
+ with its own QCBOREncodeContext and output buffer. Each finishes by
+ calling QCBOREncode_Finish() at the top level with no array or map
+ open. A parent context then opens the array and adds the fragments
+ in order with this. The library has no threads or locks of its own,
+ so the caller must wait for a fragment to be finished before adding
+ it.
+
+ If QCBOREncode_SetReferences() is in use and the fragment is long
+ enough, it is referenced rather than copied so the fragments don't
+ have to be combined into one buffer.
+
+ @ref QCBOR_ERR_ARRAY_TOO_LONG is set if the count of items in the
+ enclosing array or map would go over @ref QCBOR_MAX_ITEMS_IN_ARRAY.
+ As with QCBOREncode_AddEncoded(), the fragment is not checked. If @c
+ uNumItems is not right, the encoded arrays and maps will have the
+ wrong counts.
+ */
+void QCBOREncode_AddEncodedFragment(QCBOREncodeContext *pCtx,
+                                    UsefulBufC          Fragment,
+                                    size_t              uNumItems);
+
+
+/**
+ @brief Compile a description of a C structure for encoding and decoding it.
+
+ @param[out] pRecord     The compiled record.
+ @param[in]  pFields     The members of the structure and their labels.
+ @param[in]  uNumFields  The number of entries in @c pFields.
+
+ @retval QCBOR_ERR_BAD_RECORD  A field has a bad type, two fields have
+                               the same label or there are more than
+                               @ref QCBOR_MAX_RECORD_FIELDS fields.
+
+ A record is a C structure that is encoded as a map with an integer
+ label for each member. For example:
+
+     typedef struct {
+        int64_t    nTime;
+        double     dX;
+        UsefulBufC Name;
+     } Pose;
+
+     static const QCBORRecordField spPoseFields[] = {
+        QCBORField_INT64(1, Pose, nTime),
+        QCBORField_DOUBLE(2, Pose, dX),
+        QCBORField_TEXT(3, Pose, Name)
+     };
+
+ This is done once and the record is used to encode and decode any
+ number of structures. The heads of the map and the labels are
+ encoded here so they are copied rather than encoded each time.
+
+ The type of each member must match the @c QCBOR_RECORD_XXX type given
+ for it. The C compiler can't check this. @c pFields is not copied
+ and must not change while the record is in use.
+ */
+QCBORError QCBOREncode_CompileRecord(QCBORRecord            *pRecord,
+                                     const QCBORRecordField *pFields,
+                                     size_t                  uNumFields);
+
+
+/**
+ @brief Add a C structure as a map.
+
+ @param[in] pCtx     The encoding context to add the map to.
+ @param[in] pRecord  The record from QCBOREncode_CompileRecord().
+ @param[in] pStruct  The structure to encode.
+
+ This adds a definite-length map with one entry for each field of @c
+ pRecord in the order they were given to QCBOREncode_CompileRecord().
+ The output is exactly the same as calling QCBOREncode_OpenMap(),
+ then QCBOREncode_AddInt64ToMapN() and the like for each field, then
+ QCBOREncode_CloseMap(). Numbers are encoded in preferred
+ serialization the same as QCBOREncode_AddDouble() and the others.
+
+ When the whole map fits in the output buffer, which is checked once,
+ it is written directly to the end of it without going through the
+ head encoding, nesting tracking and error checks for each item, so
+ it is several times faster than adding the fields one at a time.
+ When encoding to a sink, with a digest or with references, or when
+ only computing the size, the fields are added one at a time.
+ */
+void QCBOREncode_AddRecord(QCBOREncodeContext *pCtx,
+                           const QCBORRecord  *pRecord,
+                           const void         *pStruct);
+
+static void QCBOREncode_AddRecordToMap(QCBOREncodeContext *pCtx, const char *szLabel, const QCBORRecord *pRecord, const void *pStruct);
+
+static void QCBOREncode_AddRecordToMapN(QCBOREncodeContext *pCtx, int64_t nLabel, const QCBORRecord *pRecord, const void *pStruct);
+
+
 /**
  @brief Get the encoded result.
 
@@ -1402,11 +1892,167 @@ QCBORError QCBOREncode_Finish(QCBOREncodeContext *pCtx, UsefulBufC *pEncodedCBOR
  @return The same errors as QCBOREncode_Finish().
 
  This functions the same as QCBOREncode_Finish(), but only returns the
- size of the encoded output.
+ size of the encoded output. If strings were output by reference, see
+ QCBOREncode_SetReferences(), it is the total size including them and
+ @ref QCBOR_ERR_OUTPUT_HAS_REFERENCES is not returned.
  */
 QCBORError QCBOREncode_FinishGetSize(QCBOREncodeContext *pCtx, size_t *uEncodedLen);
 
 
+/**
+ @brief Get the encoded CBOR as a list of pieces.
+
+ @param[in] pCtx            The context to finish encoding with.
+ @param[out] pSegments      The pieces of the encoded CBOR in order.
+ @param[in] uNumSegments    The number of entries in @c pSegments.
+ @param[out] puNumSegments  The number of entries filled in.
+
+ @retval QCBOR_ERR_BUFFER_TOO_SMALL  @c pSegments doesn't have room for
+                                     all the pieces.
+
+ Otherwise this returns the same errors as QCBOREncode_Finish().
+
+ This is for when strings are output by reference, see
+ QCBOREncode_SetReferences(). The pieces alternate between parts of
+ the output buffer and referenced strings. A reference right after
+ another has no piece of the output buffer between them, so there are
+ at most twice the number of references plus one pieces.
+
+ When nothing was referenced this gives the one piece that
+ QCBOREncode_Finish() would, or none if the output is empty.
+ */
+QCBORError QCBOREncode_FinishSegments(QCBOREncodeContext *pCtx,
+                                      UsefulBufC         *pSegments,
+                                      size_t              uNumSegments,
+                                      size_t             *puNumSegments);
+
+
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+/**
+ Counters of the work done by an encode context. See
+ QCBOREncode_GetStats().
+ */
+typedef struct {
+   /** Bytes moved up to make room for the heads of arrays, maps and
+       bstr wraps as they are closed */
+   size_t   uBytesMoved;
+   /** Number of those heads inserted */
+   uint32_t uNumInserts;
+} QCBOREncodeStats;
+
+
+/**
+ @brief Get counters of the work done by an encode context.
+
+ @param[in]  pCtx    The encoding context.
+ @param[out] pStats  The counters since QCBOREncode_Init().
+
+ This is only available when the library is built with
+ @c QCBOR_CONFIG_ENABLE_STATS. Without it the counters are not in
+ @ref QCBOREncodeContext at all and cost nothing. The bytes moved are
+ the cost that @ref QCBOR_ENCODE_CONFIG_NO_SLIDE avoids. Nothing is
+ moved when only computing the size or in that mode.
+ */
+void QCBOREncode_GetStats(QCBOREncodeContext *pCtx, QCBOREncodeStats *pStats);
+#endif /* QCBOR_CONFIG_ENABLE_STATS */
+
+
+/**
+ @brief Set up a ring buffer for a stream of encoded records.
+
+ @param[out] pRing    The ring to initialize.
+ @param[in]  Storage  The memory for the records.
+
+ This is for a CBOR sequence [RFC 8742]
+ (https://tools.ietf.org/html/rfc8742) of records, for example
+ telemetry, that one thread, the producer, encodes and another, the
+ consumer, sends on. The producer encodes each record in place in the
+ ring with QCBORRing_StartRecord() and QCBORRing_PublishRecord(). The
+ consumer gets whole records that are ready with QCBORRing_Peek() and
+ gives the space back with QCBORRing_Consume(). Neither copies the
+ records or takes a lock.
+
+ There must be only one producer thread and one consumer thread. Each
+ side does only a store with release semantics of the position it
+ owns and a load with acquire semantics of the other's. These are
+ done with the @c __atomic built-ins of GCC and clang. For other
+ compilers, define @c QCBOR_RING_LOAD_ACQUIRE(p) and @c
+ QCBOR_RING_STORE_RELEASE(p, v) for a pointer to a @c size_t when
+ building the library or the ring functions are left out.
+
+ A record is never split at the end of @c Storage, so some of the end
+ may go unused. @c Storage should be several times bigger than the
+ largest record.
+ */
+void QCBORRing_Init(QCBORRing *pRing, UsefulBuf Storage);
+
+
+/**
+ @brief Start encoding a record into a ring buffer.
+
+ @param[in] pRing     The ring.
+ @param[in] pCtx      The encoder context to encode the record with.
+ @param[in] uMaxSize  The most the record can take.
+
+ @retval QCBOR_ERR_RING_FULL  There aren't @c uMaxSize contiguous
+                              bytes free. Nothing is done.
+
+ This is called only by the producer. It does QCBOREncode_Init() of
+ @c pCtx with @c uMaxSize bytes of the ring as the output buffer. Then
+ add the record to @c pCtx, usually one map or array, and call
+ QCBORRing_PublishRecord().
+
+ If the record turns out bigger than @c uMaxSize,
+ QCBORRing_PublishRecord() returns @ref QCBOR_ERR_BUFFER_TOO_SMALL.
+ */
+QCBORError QCBORRing_StartRecord(QCBORRing *pRing, QCBOREncodeContext *pCtx, size_t uMaxSize);
+
+
+/**
+ @brief Finish a record and make it available to the consumer.
+
+ @param[in] pRing  The ring.
+ @param[in] pCtx   The encoder context given to QCBORRing_StartRecord().
+
+ @return The error from QCBOREncode_Finish(), if any.
+
+ This is called only by the producer. On an error nothing is
+ published and the space is used for the next record.
+ */
+QCBORError QCBORRing_PublishRecord(QCBORRing *pRing, QCBOREncodeContext *pCtx);
+
+
+/**
+ @brief Get the records ready for the consumer.
+
+ @param[in] pRing  The ring.
+
+ @return The bytes of one or more whole records, or a length of 0 if
+         there are none.
+
+ This is called only by the consumer. The records are contiguous and
+ may be decoded in place as a CBOR sequence, for example with
+ QCBORDecode_SplitSequence(). When the producer has gone back to the
+ start of the ring, this returns the records up to the end and, after
+ they are consumed, the ones at the start. The records stay good until
+ given back with QCBORRing_Consume().
+ */
+UsefulBufC QCBORRing_Peek(QCBORRing *pRing);
+
+
+/**
+ @brief Give the space of consumed records back to the producer.
+
+ @param[in] pRing   The ring.
+ @param[in] uBytes  The number of bytes consumed.
+
+ This is called only by the consumer. @c uBytes must be the length of
+ whole records from the start of what QCBORRing_Peek() returned, at
+ most all of it.
+ */
+void QCBORRing_Consume(QCBORRing *pRing, size_t uBytes);
+
+
 /**
  @brief Indicate whether output buffer is NULL or not.
 
@@ -1784,6 +2430,30 @@ static inline void QCBOREncode_AddBytesToMapN(QCBOREncodeContext *pCtx, int64_t
    QCBOREncode_AddBytes(pCtx, Bytes);
 }
 
+static inline void QCBOREncode_AddTypedArrayToMap(QCBOREncodeContext *pCtx, const char *szLabel, uint8_t uElementType, UsefulBufC Elements, bool bBigEndian)
+{
+   QCBOREncode_AddSZString(pCtx, szLabel);
+   QCBOREncode_AddTypedArray(pCtx, uElementType, Elements, bBigEndian);
+}
+
+static inline void QCBOREncode_AddTypedArrayToMapN(QCBOREncodeContext *pCtx, int64_t nLabel, uint8_t uElementType, UsefulBufC Elements, bool bBigEndian)
+{
+   QCBOREncode_AddInt64(pCtx, nLabel);
+   QCBOREncode_AddTypedArray(pCtx, uElementType, Elements, bBigEndian);
+}
+
+static inline void QCBOREncode_AddRecordToMap(QCBOREncodeContext *pCtx, const char *szLabel, const QCBORRecord *pRecord, const void *pStruct)
+{
+   QCBOREncode_AddSZString(pCtx, szLabel);
+   QCBOREncode_AddRecord(pCtx, pRecord, pStruct);
+}
+
+static inline void QCBOREncode_AddRecordToMapN(QCBOREncodeContext *pCtx, int64_t nLabel, const QCBORRecord *pRecord, const void *pStruct)
+{
+   QCBOREncode_AddInt64(pCtx, nLabel);
+   QCBOREncode_AddRecord(pCtx, pRecord, pStruct);
+}
+
 static inline void QCBOREncode_AddBytesLenOnly(QCBOREncodeContext *pCtx, UsefulBufC Bytes)
 {
     QCBOREncode_AddBuffer(pCtx, CBOR_MAJOR_NONE_TYPE_BSTR_LEN_ONLY, Bytes);
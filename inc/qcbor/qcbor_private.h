@@ -53,16 +53,65 @@ extern "C" {
  that is public. This is done this way so there can be a nice
  separation of public and private parts in this file.
 */
+#ifdef QCBOR_CONFIG_MAX_ARRAY_NESTING
+#define QCBOR_MAX_ARRAY_NESTING1 QCBOR_CONFIG_MAX_ARRAY_NESTING
+#else
 #define QCBOR_MAX_ARRAY_NESTING1 15 // Do not increase this over 255
+#endif
+
+#if QCBOR_MAX_ARRAY_NESTING1 > 255 || QCBOR_MAX_ARRAY_NESTING1 < 1
+#error QCBOR_CONFIG_MAX_ARRAY_NESTING must be from 1 to 255
+#endif
+
+
+/*
+ The type of the count of items in an array or map and of offsets in
+ the encoded output. With QCBOR_USE_LARGE_ARRAYS they are bigger so
+ arrays and maps can be longer and the output can be bigger than 4GB
+ at the cost of larger contexts. The largest count is used to
+ indicate indefinite length. See QCBOR_MAX_ITEMS_IN_ARRAY.
+ */
+#ifdef QCBOR_USE_LARGE_ARRAYS
+typedef uint32_t QCBORCount;
+#define QCBOR_COUNT_INDEFINITE UINT32_MAX
+typedef size_t   QCBOROffset;
+#else
+typedef uint16_t QCBORCount;
+#define QCBOR_COUNT_INDEFINITE UINT16_MAX
+typedef uint32_t QCBOROffset;
+#endif
 
 
 /* The largest offset to the start of an array or map. It is slightly
- less than UINT32_MAX so the error condition can be tests on 32-bit machines.
- UINT32_MAX comes from uStart in QCBORTrackNesting being a uin32_t.
+ less than the largest QCBOROffset so the error condition can be
+ tested on 32-bit machines. It is UINT32_MAX less a little unless
+ QCBOR_USE_LARGE_ARRAYS is defined.
 
  This will cause trouble on a machine where size_t is less than 32-bits.
  */
+#ifdef QCBOR_USE_LARGE_ARRAYS
+#define QCBOR_MAX_ARRAY_OFFSET  (SIZE_MAX - 100)
+#else
 #define QCBOR_MAX_ARRAY_OFFSET  (UINT32_MAX - 100)
+#endif
+
+
+/* The digest callbacks are called when at least this many bytes are
+ ready, except at the end, so the call overhead is small compared to
+ the hashing. It is the block size of SHA-256.
+ */
+#define QCBOR_DIGEST_UPDATE_SIZE 64
+
+
+/* The loads and stores QCBORRing uses to be shared between a producer
+ and a consumer thread without a lock. For compilers other than GCC
+ and clang they may be defined by the build. If they aren't, the ring
+ functions are left out.
+ */
+#if !defined(QCBOR_RING_LOAD_ACQUIRE) && (defined(__GNUC__) || defined(__clang__))
+#define QCBOR_RING_LOAD_ACQUIRE(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define QCBOR_RING_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
 
 /*
  PRIVATE DATA STRUCTURE
@@ -72,25 +121,163 @@ extern "C" {
 
  uStart is a uint32_t instead of a size_t to keep the size of this
  struct down so it can be on the stack without any concern.  It would be about
- double if size_t was used instead.
+ double if size_t was used instead. It and uCount are bigger with
+ QCBOR_USE_LARGE_ARRAYS.
 
  Size approximation (varies with CPU/compiler):
-    64-bit machine: (15 + 1) * (4 + 2 + 1 + 1 pad) + 8 = 136 bytes
-    32-bit machine: (15 + 1) * (4 + 2 + 1 + 1 pad) + 4 = 132 bytes
+    64-bit machine: (15 + 1) * (4 + 2 + 1 + 1) + 8 = 136 bytes
+    32-bit machine: (15 + 1) * (4 + 2 + 1 + 1) + 4 = 132 bytes
+    64-bit machine with QCBOR_USE_LARGE_ARRAYS: (15 + 1) * (8 + 4 + 1 + 1 + 2 padding) + 8 = 264 bytes
 */
 typedef struct __QCBORTrackNesting {
    // PRIVATE DATA STRUCTURE
    struct {
       // See function QCBOREncode_OpenMapOrArray() for details on how this works
-      uint32_t  uStart;   // uStart is the byte position where the array starts
-      uint16_t  uCount;   // Number of items in the arrary or map; counts items
+      QCBOROffset uStart; // uStart is the byte position where the array starts
+      QCBORCount  uCount; // Number of items in the arrary or map; counts items
                           // in a map, not pairs of items
       uint8_t   uMajorType; // Indicates if item is a map or an array
+      uint8_t   uFlushed;   // Head was flushed to a sink as indefinite length
    } pArrays[QCBOR_MAX_ARRAY_NESTING1+1], // stored state for the nesting levels
    *pCurrentNesting; // the current nesting level
 } QCBORTrackNesting;
 
 
+/*
+ PRIVATE DATA STRUCTURE
+
+ A byte or text string, or encoded CBOR, that is output by reference
+ rather than copied. See QCBOREncode_SetReferences().
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 4 + 1 + 3 + 16 = 24 bytes
+   32-bit machine: 4 + 1 + 3 + 8 = 16 bytes
+   64-bit machine with QCBOR_USE_LARGE_ARRAYS: 8 + 1 + 7 + 16 = 32 bytes
+ */
+struct _QCBOREncodeRef {
+   // PRIVATE DATA STRUCTURE
+   QCBOROffset uOffset; // Where it goes in the output buffer
+   uint8_t     uLevel;  // Nesting level it is in, to tell whether one
+                        // at the start of an array or map is in it
+   UsefulBufC  Bytes;
+};
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ A single-producer, single-consumer ring of encoded records set up by
+ QCBORRing_Init(). uWrite is written only by the producer and uRead
+ only by the consumer, each with a release store that the other
+ pairs with an acquire load. Records never wrap. When one doesn't fit
+ at the end, it goes at the start and uWrapEnd marks where the
+ records before it end.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 5 * 8 = 48 bytes
+   32-bit machine: 4 + 5 * 4 = 24 bytes
+ */
+struct _QCBORRing {
+   // PRIVATE DATA STRUCTURE
+   uint8_t *pStorage;
+   size_t   uSize;
+   size_t   uWrite;    // End of the published records
+   size_t   uRead;     // Start of the records not consumed
+   size_t   uWrapEnd;  // End of the records before the start was gone back to
+   size_t   uReserved; // Start of the record being encoded; producer only
+};
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ A string in a string reference namespace. The encoder keeps these in
+ a hash table and uIndex is the reference number. The decoder keeps
+ them in order so the reference number is the position in the array.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 8 + 4 + 1 + 3 bytes padding = 24 bytes
+   32-bit machine: 4 + 4 + 4 + 1 + 3 bytes padding = 16 bytes
+ */
+struct _QCBORStringRef {
+   // PRIVATE DATA STRUCTURE
+   const void *pStr;   // NULL for an unused encoder entry
+   size_t      uLen;
+   uint32_t    uIndex; // Only used by the encoder
+   uint8_t     uType;  // Major type for the encoder, QCBOR_TYPE_XXX for the decoder
+};
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ An entry in the memory given to QCBORDecode_SetMapChecks(). Each map
+ that is open has an entry for the map followed by a hash table of
+ 2^uSizeLog2 entries for its labels. The maps are a stack linked by
+ uPrevMap.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 8 + 4 + 1 + 3 bytes padding = 24 bytes
+   32-bit machine: 4 + 8 + 4 + 1 + 3 bytes padding = 20 bytes
+ */
+struct _QCBORLabelCheck {
+   // PRIVATE DATA STRUCTURE
+   union {
+      struct {
+         const void *pStr;   // NULL for an integer label
+         uint64_t    uValue; // The integer or the string length
+         uint32_t    uHash;  // Top of the hash for a quicker compare
+         uint8_t     uType;  // QCBOR_TYPE_XXX or QCBOR_TYPE_NONE for an empty slot
+      } label;
+      struct {
+         size_t   uPrevLabel;    // Offset in the input of the last label
+         uint32_t uPrevLabelLen; // 0 before the first label
+         uint32_t uPrevMap;      // Entry of the enclosing map or QCBOR_NO_LABEL_CHECK_MAP
+         uint32_t uUsed;         // Labels in the hash table
+         uint8_t  uSizeLog2;
+         uint8_t  uLevel;        // Nesting level of the labels
+      } map;
+   } u;
+};
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ The state of the optional encoder features, kept out of
+ QCBOREncodeContext so it doesn't make the context bigger for
+ encoding that doesn't use them. Given to the encoder with
+ QCBOREncode_SetExtension() or QCBOREncode_InitWithSink().
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 24 + 8 + 4 + 4 + 8 + 24 + 8 + 12 + 1 (+ 3 padding) = 96 bytes
+   32-bit machine: 12 + 4 + 4 + 4 + 4 + 12 + 4 + 12 + 1 (+ 3 padding) = 60 bytes
+*/
+struct _QCBOREncodeExtension {
+   // PRIVATE DATA STRUCTURE
+   // Same as QCBOREncodeSink; NULL unless QCBOREncode_InitWithSink()
+   int            (* pfSink)(void *pSinkCtx, UsefulBufC Bytes);
+   void             *pSinkCtx;
+   size_t            uSinkBytes; // Number of bytes given to pfSink
+   // Set by QCBOREncode_SetReferences(); pRefs is NULL otherwise
+   struct _QCBOREncodeRef *pRefs;
+   uint32_t          uNumRefs;
+   uint32_t          uMaxRefs;
+   size_t            uMinRefLen;
+   // Same as QCBORDigestUpdate; NULL unless a bstr wrap opened with
+   // QCBOREncode_BstrWrapWithDigest() is open
+   void           (* pfDigest)(void *pDigestCtx, UsefulBufC Bytes);
+   void             *pDigestCtx;
+   size_t            uDigestPos; // Output before this was given to pfDigest
+   // Set by QCBOREncode_OpenStringRefNamespace(); NULL otherwise
+   struct _QCBORStringRef *pStringRefs;
+   uint32_t          uStringRefsSize;   // Entries in the hash table
+   uint32_t          uStringRefsStored; // Entries used
+   uint32_t          uNextStringRef;    // Next reference number
+   uint8_t           uDigestLevel; // Nesting level of the digested bstr wrap
+};
+
+
 /*
  PRIVATE DATA STRUCTURE
 
@@ -98,15 +285,24 @@ typedef struct __QCBORTrackNesting {
  form a public "object" that does the job of encdoing.
 
  Size approximation (varies with CPU/compiler):
-   64-bit machine: 27 + 1 (+ 4 padding) + 136 = 32 + 136 = 168 bytes
-   32-bit machine: 15 + 1 + 132 = 148 bytes
+   64-bit machine: 32 + 1 + 1 (+ 6 padding) + 8 + 136 = 184 bytes
+   32-bit machine: 16 + 1 + 1 (+ 2 padding) + 4 + 132 = 156 bytes
 */
 struct _QCBOREncodeContext {
    // PRIVATE DATA STRUCTURE
    UsefulOutBuf      OutBuf;  // Pointer to output buffer, its length and
                               // position in it
    uint8_t           uError;  // Error state, always from QCBORError enum
+   uint8_t           uConfigFlags; // From QCBOREncodeConfig enum
+   // NULL unless QCBOREncode_SetExtension() or QCBOREncode_InitWithSink()
+   struct _QCBOREncodeExtension *pExt;
    QCBORTrackNesting nesting; // Keep track of array and map nesting
+
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+   // For QCBOREncode_GetStats(). Not in the sizes above.
+   size_t            uBytesMoved;
+   uint32_t          uNumInserts;
+#endif
 };
 
 
@@ -124,8 +320,8 @@ struct _QCBOREncodeContext {
 typedef struct __QCBORDecodeNesting  {
   // PRIVATE DATA STRUCTURE
    struct {
-      uint16_t uCount;
-      uint8_t  uMajorType;
+      QCBORCount uCount;
+      uint8_t    uMajorType;
    } pMapsAndArrays[QCBOR_MAX_ARRAY_NESTING1+1],
    *pCurrent;
 } QCBORDecodeNesting;
@@ -135,9 +331,74 @@ typedef struct  {
    // PRIVATE DATA STRUCTURE
    void *pAllocateCxt;
    UsefulBuf (* pfAllocator)(void *pAllocateCxt, void *pOldMem, size_t uNewSize);
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+   // For QCBORDecode_GetStats()
+   uint32_t uCalls;
+   size_t   uBytes; // Total of the sizes asked for
+#endif
 } QCORInternalAllocator;
 
 
+/*
+ PRIVATE DATA STRUCTURE
+
+ The state of the MemPool string allocator set up by
+ QCBORDecode_SetMemPool(). It is the context passed to the MemPool
+ allocator function so it doesn't have to be packed into and unpacked
+ from the pool on every call.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 4 + 4 = 16 bytes
+   32-bit machine: 4 + 4 + 4 = 12 bytes
+ */
+typedef struct {
+   // PRIVATE DATA STRUCTURE
+   uint8_t  *pPool;
+   uint32_t  uPoolSize;
+   uint32_t  uFreeOffset; // From the start of the pool
+} QCBORInternalMemPool;
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ The state of the optional decoder features, kept out of
+ QCBORDecodeContext so it doesn't make the context bigger for
+ decoding that doesn't use them. Given to the decoder with
+ QCBORDecode_SetExtension().
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 24 + 8 + 8 + 8 + 16 + 8 + 3 + 5 bytes padding = 88 bytes
+   32-bit machine: 8 + 12 + 4 + 8 + 4 + 12 + 3 + 1 bytes padding = 52 bytes
+ */
+struct _QCBORDecodeExtension {
+   // PRIVATE DATA STRUCTURE
+
+   // Made from pCallerConfiguredTagList to speed up lookup
+   uint64_t   uCallerTagFilter; // One bit set per tag in the list
+
+   // Same as QCBORDigestUpdate; NULL unless QCBORDecode_SetDigest()
+   void    (* pfDigest)(void *pDigestCtx, UsefulBufC Bytes);
+   void      *pDigestCtx;
+   size_t     uDigestPos; // Input before this was given to pfDigest
+
+   // Set by QCBORDecode_SetStringRefs(); NULL otherwise
+   struct _QCBORStringRef *pStringRefs;
+   uint32_t   uStringRefsSize;
+   uint32_t   uNextStringRef;  // Next reference number in the namespace
+
+   // Set by QCBORDecode_SetMapChecks(); NULL otherwise
+   struct _QCBORLabelCheck *pLabelChecks;
+   size_t     uLabelCheckPos;   // Labels and maps before this were checked
+   uint32_t   uLabelChecksSize;
+   uint32_t   uLabelCheckTop;   // Entry of the innermost map or QCBOR_NO_LABEL_CHECK_MAP
+
+   uint8_t    bCallerTagsSorted; // Caller-configured tag list is in ascending order
+   uint8_t    uStringRefLevel;   // Nesting level of the namespace or QCBOR_NO_STRING_REF_NAMESPACE
+   uint8_t    bNotDeterministic; // Not deterministic encoding since QCBORDecode_SetMapChecks()
+};
+
+
 /*
  PRIVATE DATA STRUCTURE
 
@@ -145,8 +406,8 @@ typedef struct  {
  functions form an "object" that does CBOR decoding.
 
  Size approximation (varies with CPU/compiler):
-   64-bit machine: 32 + 1 + 1 + 6 bytes padding + 72 + 16 + 8 + 8 = 144 bytes
-   32-bit machine: 16 + 1 + 1 + 2 bytes padding + 68 +  8 + 8 + 4 = 108 bytes
+   64-bit machine: 32 + 1 + 1 + 1 + 5 bytes padding + 72 + 16 + 16 + 8 + 8 = 160 bytes
+   32-bit machine: 16 + 1 + 1 + 1 + 1 bytes padding + 68 +  8 + 12 + 4 + 4 = 116 bytes
  */
 struct _QCBORDecodeContext {
    // PRIVATE DATA STRUCTURE
@@ -154,6 +415,7 @@ struct _QCBORDecodeContext {
 
    uint8_t        uDecodeMode;
    uint8_t        bStringAllocateAll;
+   uint8_t        bIncremental; // QCBORDecode_InitIncremental() until end of input
 
    QCBORDecodeNesting nesting;
 
@@ -161,18 +423,190 @@ struct _QCBORDecodeContext {
    // strings, it is configured here.
    QCORInternalAllocator StringAllocator;
 
-   // These are special for the internal MemPool allocator.
-   // They are not used otherwise. We tried packing these
-   // in the MemPool itself, but there are issues
-   // with memory alignment.
-   uint32_t uMemPoolSize;
-   uint32_t uMemPoolFreeOffset;
+   // This is special for the internal MemPool allocator.
+   // It is not used otherwise.
+   QCBORInternalMemPool MemPool;
 
    // This is NULL or points to QCBORTagList.
    // It is type void for the same reason as above.
    const void *pCallerConfiguredTagList;
+
+   // NULL unless QCBORDecode_SetExtension()
+   struct _QCBORDecodeExtension *pExt;
+
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+   // For QCBORDecode_GetStats(). Not in the sizes above.
+   uint64_t   uItemsDecoded;
+   uint32_t   uTagsMapped;
+   uint32_t   uTagsNotMapped;
+   uint8_t    uMaxNesting;
+#endif
 };
 
+/*
+ PRIVATE DATA STRUCTURE
+
+ One entry in a map index made by QCBORDecode_IndexMap(). String
+ labels are kept as a hash so the entry is small. A lookup decodes the
+ entry to confirm the label.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 8 + 2 + 1 + 5 bytes padding = 24 bytes
+   32-bit machine: 8 + 4 + 2 + 1 + 1 bytes padding = 16 bytes
+ */
+struct _QCBORMapIndexEntry {
+   // PRIVATE DATA STRUCTURE
+   int64_t    nLabel;     // The integer label or the hash of a string label
+   size_t     uOffset;    // Where the entry starts in the input
+   QCBORCount uOrdinal;   // Position of the entry in the map
+   uint8_t    uLabelType; // QCBOR_TYPE_XXX of the label
+};
+
+
+/*
+ The largest number of paths and of steps, including the ends of the
+ paths, in a QCBORQuery. (The public definitions that refer to these
+ are in qcbor_decode.h.)
+ */
+#define QCBOR_MAX_QUERY_PATHS1 16
+#define QCBOR_MAX_QUERY_STEPS1 48
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ A compiled query. The paths are merged into a tree of steps so
+ common prefixes are followed once. A step that starts a branch of
+ the tree is a node and auParent has the node before it, or
+ QCBOR_QUERY_ROOT for the top-level data item. The steps that repeat
+ a node of an earlier path and the ends of the paths are not nodes.
+ auPathEnd has the node each path ends at.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 1 + 1 + 48 + 16 + 6 bytes padding = 80 bytes
+   32-bit machine: 4 + 1 + 1 + 48 + 16 + 2 bytes padding = 72 bytes
+ */
+#define QCBOR_QUERY_ROOT     0xff
+#define QCBOR_QUERY_NOT_NODE 0xfe
+
+struct _QCBORQuery {
+   // PRIVATE DATA STRUCTURE
+   const struct _QCBORPathStep *pSteps;
+   uint8_t                      uNumSteps;
+   uint8_t                      uNumPaths;
+   uint8_t                      auParent[QCBOR_MAX_QUERY_STEPS1];
+   uint8_t                      auPathEnd[QCBOR_MAX_QUERY_PATHS1];
+};
+
+
+/*
+ The largest number of fields in a QCBORRecord. (The public
+ definition that refers to this is in qcbor_common.h.)
+ */
+#define QCBOR_MAX_RECORD_FIELDS1 32
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ A compiled record. auHeads has the encoded head of the map followed
+ by the encoded head of each label so they don't have to be encoded
+ every time. The label of field i ends at auHeadEnd[i] and starts
+ where the one before it ends. uMaxFixed is the most bytes the record
+ can take not counting the content of strings.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 1 + 1 + 2 + 297 + 64 + 3 bytes padding = 376 bytes
+   32-bit machine: 4 + 1 + 1 + 2 + 297 + 64 + 3 bytes padding = 372 bytes
+ */
+struct _QCBORRecord {
+   // PRIVATE DATA STRUCTURE
+   const struct _QCBORRecordField *pFields;
+   uint8_t                         uNumFields;
+   uint8_t                         uMapHeadLen;
+   uint16_t                        uMaxFixed;
+   uint8_t                         auHeads[(1 + QCBOR_MAX_RECORD_FIELDS1) * (1 + sizeof(uint64_t))];
+   uint16_t                        auHeadEnd[QCBOR_MAX_RECORD_FIELDS1];
+};
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ A map index. The entries are sorted by label for binary search. The
+ decoder nesting is kept for the start of the map so a lookup can go
+ straight to an entry and for the end of the map to leave it.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 2 + 6 bytes padding + 72 + 72 + 8 = 168 bytes
+   32-bit machine: 4 + 2 + 2 bytes padding + 68 + 68 + 4 = 148 bytes
+ */
+struct _QCBORMapIndex {
+   // PRIVATE DATA STRUCTURE
+   struct _QCBORMapIndexEntry *pEntries;
+   QCBORCount                  uNumEntries;
+   QCBORDecodeNesting          MapNesting;
+   QCBORDecodeNesting          EndNesting;
+   size_t                      uEndOffset;
+};
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ A decode position saved by QCBORDecode_SaveCursor(). Only the
+ current nesting level is kept, not the whole QCBORDecodeNesting, so
+ it is small. The levels it encloses are unchanged as long as the
+ decoder hasn't left the level.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 8 + 4 + 2 + 1 + 1 = 16 bytes
+   32-bit machine: 4 + 4 + 2 + 1 + 1 = 12 bytes
+ */
+struct _QCBORDecodeCursor {
+   // PRIVATE DATA STRUCTURE
+   size_t     uOffset;         // Of the input
+   uint32_t   uNextStringRef;  // Same as in QCBORDecodeContext
+   QCBORCount uCount;          // Of the current nesting level
+   uint8_t    uLevel;          // The current nesting level
+   uint8_t    uStringRefLevel; // Same as in QCBORDecodeContext
+};
+
+
+/*
+ PRIVATE DATA STRUCTURE
+
+ An arena string allocator set up by QCBORArena_Init(). The slabs come
+ from the backing allocator and are kept in a list. Allocation is from
+ the current slab. A reset goes back to the start of the first slab so
+ the slabs are reused.
+
+ Size approximation (varies with CPU/compiler):
+   64-bit machine: 11 * 8 + 3 * 4 + 4 bytes padding = 104 bytes
+   32-bit machine: 11 * 4 + 3 * 4 = 56 bytes
+ */
+struct _QCBORArena {
+   // PRIVATE DATA STRUCTURE
+   // Same as QCBORStringAllocate
+   UsefulBuf (* pfBacking)(void *pBackingCxt, void *pOldMem, size_t uNewSize);
+   void                  *pBackingCxt;
+   size_t                 uSlabSize;    // Minimum size asked of pfBacking
+   struct _QCBORArenaSlab *pFirstSlab;
+   struct _QCBORArenaSlab *pCurrentSlab; // NULL before the first allocation
+   size_t                 uSlabOffset;  // Next free byte in the current slab
+   uint8_t               *pLast;        // Only the last allocation can be
+   size_t                 uLastLen;     // reallocated or freed
+
+   // For QCBORArena_GetStats()
+   size_t                 uBytesInUse;
+   size_t                 uHighWater;
+   size_t                 uSlabBytes;
+   uint32_t               uNumSlabs;
+   uint32_t               uAllocations;
+   uint32_t               uReallocations;
+};
+
+
 // Used internally in the impementation here
 // Must not conflict with any of the official CBOR types
 #define CBOR_MAJOR_NONE_TYPE_RAW  9
@@ -181,6 +615,105 @@ struct _QCBORDecodeContext {
 #define CBOR_MAJOR_NONE_TYPE_ARRAY_INDEFINITE_LEN 12
 #define CBOR_MAJOR_NONE_TYPE_MAP_INDEFINITE_LEN 13
 
+
+/*
+ The bits of an RFC 8746 typed array tag after CBOR_TAG_TYPED_ARRAY_FIRST
+ is subtracted. The element types, QCBOR_TYPED_ARRAY_XXX, are these
+ without the endianness bit.
+ */
+#define QCBOR_TYPED_ARRAY_FLOAT_BIT         0x10
+#define QCBOR_TYPED_ARRAY_SIGNED_BIT        0x08
+#define QCBOR_TYPED_ARRAY_LITTLE_ENDIAN_BIT 0x04
+#define QCBOR_TYPED_ARRAY_SIZE_MASK         0x03
+
+
+/*
+ The size of an element of a typed array or 0 if uElementType isn't
+ one of QCBOR_TYPED_ARRAY_XXX. The size bits are log2 of the size in
+ bytes for integers and one less than that for floats.
+ */
+static inline size_t QCBOR_Private_TypedArrayElementSize(uint8_t uElementType)
+{
+   if(uElementType & ~(QCBOR_TYPED_ARRAY_FLOAT_BIT | QCBOR_TYPED_ARRAY_SIGNED_BIT | QCBOR_TYPED_ARRAY_SIZE_MASK) ||
+      ((uElementType & QCBOR_TYPED_ARRAY_FLOAT_BIT) && (uElementType & QCBOR_TYPED_ARRAY_SIGNED_BIT))) {
+      // Signed floats are reserved tags
+      return 0;
+   }
+
+   const size_t uSize = (size_t)1 << (uElementType & QCBOR_TYPED_ARRAY_SIZE_MASK);
+   return uElementType & QCBOR_TYPED_ARRAY_FLOAT_BIT ? uSize * 2 : uSize;
+}
+
+
+/*
+ Returns 1 on a big-endian CPU. Without USEFULBUF_CONFIG_BIG_ENDIAN or
+ USEFULBUF_CONFIG_LITTLE_ENDIAN this is worked out at run time, but
+ compilers turn it into a constant.
+ */
+static inline int QCBOR_Private_IsBigEndianHost(void)
+{
+#if defined(USEFULBUF_CONFIG_BIG_ENDIAN)
+   return 1;
+#elif defined(USEFULBUF_CONFIG_LITTLE_ENDIAN)
+   return 0;
+#else
+   const uint16_t uOne = 1;
+   return *(const uint8_t *)&uOne == 0;
+#endif
+}
+
+
+/*
+ Copy uLen bytes of elements uSize bytes long reversing the bytes of
+ each one. uLen is a multiple of uSize.
+
+ Code Reviewers: THIS FUNCTION DOES POINTER MATH
+ */
+static inline void QCBOR_Private_ReverseElements(uint8_t       *pDest,
+                                                 const uint8_t *pSrc,
+                                                 size_t         uLen,
+                                                 size_t         uSize)
+{
+   for(size_t u = 0; u < uLen; u += uSize) {
+      for(size_t i = 0; i < uSize; i++) {
+         pDest[u + i] = pSrc[u + uSize - 1 - i];
+      }
+   }
+}
+
+
+/*
+ The value of uStringRefLevel in the decode context when not in a
+ string reference namespace.
+ */
+#define QCBOR_NO_STRING_REF_NAMESPACE UINT8_MAX
+
+
+/*
+ The value of uLabelCheckTop in the decode context and of uPrevMap in
+ a _QCBORLabelCheck when there is no map.
+ */
+#define QCBOR_NO_LABEL_CHECK_MAP UINT32_MAX
+
+
+/*
+ The shortest string that gets the reference number uIndex in a string
+ reference namespace. Shorter strings are smaller than a reference to
+ them so they aren't numbered.
+ */
+static inline size_t QCBOR_Private_StringRefMinLen(uint32_t uIndex)
+{
+   if(uIndex < 24) {
+      return 3;
+   } else if(uIndex < 256) {
+      return 4;
+   } else if(uIndex < 65536) {
+      return 5;
+   } else {
+      return 7;
+   }
+}
+
 #ifdef __cplusplus
 }
 #endif
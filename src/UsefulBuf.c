@@ -106,12 +106,27 @@ size_t UsefulBuf_IsValue(const UsefulBufC UB, uint8_t uValue)
       return 0;
    }
 
-   const uint8_t * const pEnd = (uint8_t *)UB.ptr + UB.len;
-   for(const uint8_t *p = UB.ptr; p < pEnd; p++) {
+   const uint8_t       *p    = UB.ptr;
+   const uint8_t *const pEnd = p + UB.len;
+
+   /* Check 32 bytes at a time until some don't match, then find the
+      one that doesn't byte by byte. The memcpy() is the portable way
+      to do unaligned loads. Compilers turn it into plain loads. */
+   const uint64_t uValues = uValue * 0x0101010101010101ULL;
+   while(pEnd - p >= 32) {
+      uint64_t u[4];
+      memcpy(u, p, sizeof(u));
+      if(((u[0] ^ uValues) | (u[1] ^ uValues) | (u[2] ^ uValues) | (u[3] ^ uValues)) != 0) {
+         break;
+      }
+      p += 32;
+   }
+
+   for(; p < pEnd; p++) {
       if(*p != uValue) {
          /* Byte didn't match */
          /* Cast from signed  to unsigned . Safe because the loop increments.*/
-         return (size_t)(p - (uint8_t *)UB.ptr);
+         return (size_t)(p - (const uint8_t *)UB.ptr);
       }
    }
 
@@ -122,17 +137,39 @@ size_t UsefulBuf_IsValue(const UsefulBufC UB, uint8_t uValue)
 
 /*
  Public function -- see UsefulBuf.h
+
+ Code Reviewers: THIS FUNCTION DOES POINTER MATH
+
+ memchr() finds candidates for the first byte. It is usually much
+ faster than a byte loop because C libraries do it a word or a vector
+ register at a time. Only the candidates are compared with memcmp().
  */
 size_t UsefulBuf_FindBytes(UsefulBufC BytesToSearch, UsefulBufC BytesToFind)
 {
    if(BytesToSearch.len < BytesToFind.len) {
       return SIZE_MAX;
    }
+   if(BytesToFind.len == 0) {
+      return 0;
+   }
 
-   for(size_t uPos = 0; uPos <= BytesToSearch.len - BytesToFind.len; uPos++) {
-      if(!UsefulBuf_Compare((UsefulBufC){((uint8_t *)BytesToSearch.ptr) + uPos, BytesToFind.len}, BytesToFind)) {
-         return uPos;
+   const uint8_t * const pStart = BytesToSearch.ptr;
+   const uint8_t * const pFind  = BytesToFind.ptr;
+   /* The last position where BytesToFind fits */
+   const uint8_t * const pLast  = pStart + (BytesToSearch.len - BytesToFind.len);
+   const uint8_t        *p      = pStart;
+
+   while(p <= pLast) {
+      /* Cast is safe because p <= pLast */
+      p = memchr(p, pFind[0], (size_t)(pLast - p) + 1);
+      if(p == NULL) {
+         break;
+      }
+      if(!memcmp(p + 1, pFind + 1, BytesToFind.len - 1)) {
+         /* Cast from signed to unsigned. Safe because p >= pStart */
+         return (size_t)(p - pStart);
       }
+      p++;
    }
 
    return SIZE_MAX;
@@ -170,6 +170,60 @@ static inline double CopyUint64ToDouble(uint64_t u64)
 }
 
 
+/*
+ Optional use of the CPU's conversion instructions for the cases
+ where they give exactly the same result as the shifts and masks
+ below. See QCBOR_USE_HW_FLOAT_CONVERSION in README.md.
+
+ The instructions quiet sNaNs and align NaN payloads on the MSB
+ rather than the LSB, so NaNs always go through the code below. The
+ only narrowing done in hardware is where the value is known to fit
+ without loss, so the different rounding of the instructions never
+ comes into play. Single-precision subnormals also go through the
+ code below when widening because a denormals-are-zero mode set by
+ the application would flush them.
+
+ Half-precision is done with F16C on x86 (gcc/clang -mf16c) and with
+ __fp16 on 64-bit Arm. If neither is available only the widening of
+ single to double is done in hardware.
+ */
+#if defined(QCBOR_USE_HW_FLOAT_CONVERSION) && !defined(QCBOR_DISABLE_FLOAT_HW_USE)
+
+#define IEEE754_HW_FLOAT
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#define IEEE754_HW_HALF
+static inline uint16_t HWFloatToHalf(float f)
+{
+    return (uint16_t)_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+}
+
+static inline float HWHalfToFloat(uint16_t uHalf)
+{
+    return _cvtsh_ss(uHalf);
+}
+#elif defined(__aarch64__) && defined(__ARM_FP16_FORMAT_IEEE)
+#define IEEE754_HW_HALF
+static inline uint16_t HWFloatToHalf(float f)
+{
+    const __fp16 h = (__fp16)f;
+    uint16_t     uHalf;
+    memcpy(&uHalf, &h, sizeof(uint16_t));
+    return uHalf;
+}
+
+static inline float HWHalfToFloat(uint16_t uHalf)
+{
+    __fp16 h;
+    memcpy(&h, &uHalf, sizeof(uint16_t));
+    return (float)h;
+}
+#endif
+
+#endif /* QCBOR_USE_HW_FLOAT_CONVERSION && !QCBOR_DISABLE_FLOAT_HW_USE */
+
+
 // Public function; see ieee754.h
 uint16_t IEEE754_FloatToHalf(float f)
 {
@@ -335,6 +389,14 @@ uint16_t IEEE754_DoubleToHalf(double d)
 // Public function; see ieee754.h
 double IEEE754_HalfToDouble(uint16_t uHalfPrecision)
 {
+#ifdef IEEE754_HW_HALF
+    if((uHalfPrecision & HALF_EXPONENT_MASK) != HALF_EXPONENT_MASK ||
+       !(uHalfPrecision & HALF_SIGNIFICAND_MASK)) {
+        // Not a NaN
+        return (double)HWHalfToFloat(uHalfPrecision);
+    }
+#endif
+
     // Pull out the three parts of the half-precision float.  Do all
     // the work in 64 bits because that is what the end result is.  It
     // may give smaller code size and will keep static analyzers
@@ -403,6 +465,17 @@ double IEEE754_HalfToDouble(uint16_t uHalfPrecision)
 // Public function; see ieee754.h
 double IEEE754_FloatToDouble(uint32_t uFloat)
 {
+#ifdef IEEE754_HW_FLOAT
+    if((uFloat & SINGLE_EXPONENT_MASK) != SINGLE_EXPONENT_MASK ?
+          (uFloat & SINGLE_EXPONENT_MASK) || !(uFloat & SINGLE_SIGNIFICAND_MASK) :
+          !(uFloat & SINGLE_SIGNIFICAND_MASK)) {
+        // Not a NaN or a subnormal
+        float f;
+        memcpy(&f, &uFloat, sizeof(uint32_t));
+        return (double)f;
+    }
+#endif
+
     // Pull out the three parts of the single-precision float.  Do all
     // the work in 64 bits because that is what the end result is.  It
     // may give smaller code size and will keep static analyzers
@@ -429,8 +502,7 @@ double IEEE754_FloatToDouble(uint32_t uFloat)
             do {
                 uDoubleSignificand <<= 1;
                 uDoubleBiasedExponent--;
-                // TODO: is this right? Where does 0x400 come from?
-            } while ((uDoubleSignificand & 0x400) == 0);
+            } while ((uDoubleSignificand & (SINGLE_SIGNIFICAND_MASK + 1)) == 0);
             uDoubleSignificand &= SINGLE_SIGNIFICAND_MASK;
             uDoubleSignificand <<= (DOUBLE_NUM_SIGNIFICAND_BITS - SINGLE_NUM_SIGNIFICAND_BITS);
         } else {
@@ -471,6 +543,38 @@ double IEEE754_FloatToDouble(uint32_t uFloat)
 
 
 
+/*
+ These are for when the value is known to convert to half-precision
+ without loss so the hardware gives the same result as the code
+ above. uBits is the value as an unsigned integer so the checks for
+ NaN are cheap.
+ */
+static inline uint16_t FloatToHalfNoLoss(float f, uint32_t uBits)
+{
+#ifdef IEEE754_HW_HALF
+    if((uBits & SINGLE_EXPONENT_MASK) != SINGLE_EXPONENT_MASK || !(uBits & SINGLE_SIGNIFICAND_MASK)) {
+        return HWFloatToHalf(f);
+    }
+#else
+    (void)uBits;
+#endif
+    return IEEE754_FloatToHalf(f);
+}
+
+static inline uint16_t DoubleToHalfNoLoss(double d, uint64_t uBits)
+{
+#ifdef IEEE754_HW_HALF
+    if((uBits & DOUBLE_EXPONENT_MASK) != DOUBLE_EXPONENT_MASK || !(uBits & DOUBLE_SIGNIFICAND_MASK)) {
+        // Exact in half so also exact in single
+        return HWFloatToHalf((float)d);
+    }
+#else
+    (void)uBits;
+#endif
+    return IEEE754_DoubleToHalf(d);
+}
+
+
 // Public function; see ieee754.h
 IEEE754_union IEEE754_FloatToSmallest(float f)
 {
@@ -490,15 +594,15 @@ IEEE754_union IEEE754_FloatToSmallest(float f)
     if(uSingle == 0) {
         // Value is 0.0000, not a a subnormal
         result.uSize = IEEE754_UNION_IS_HALF;
-        result.uValue  = IEEE754_FloatToHalf(f);
+        result.uValue  = FloatToHalfNoLoss(f, uSingle);
     } else if(nSingleExponent == SINGLE_EXPONENT_INF_OR_NAN) {
         // NaN, +/- infinity
         result.uSize = IEEE754_UNION_IS_HALF;
-        result.uValue  = IEEE754_FloatToHalf(f);
+        result.uValue  = FloatToHalfNoLoss(f, uSingle);
     } else if((nSingleExponent >= HALF_EXPONENT_MIN) && nSingleExponent <= HALF_EXPONENT_MAX && (!(uSingleSignificand & uDroppedSingleBits))) {
         // Normal number in exponent range and precision won't be lost
         result.uSize = IEEE754_UNION_IS_HALF;
-        result.uValue  = IEEE754_FloatToHalf(f);
+        result.uValue  = FloatToHalfNoLoss(f, uSingle);
     } else {
         // Subnormal, exponent out of range, or precision will be lost
         result.uSize = IEEE754_UNION_IS_SINGLE;
@@ -532,15 +636,15 @@ IEEE754_union IEEE754_DoubleToSmallestInternal(double d, int bAllowHalfPrecision
     if(d == 0.0) { // Take care of positive and negative zero
         // Value is 0.0000, not a a subnormal
         result.uSize  = IEEE754_UNION_IS_HALF;
-        result.uValue = IEEE754_DoubleToHalf(d);
+        result.uValue = DoubleToHalfNoLoss(d, uDouble);
     } else if(nDoubleExponent == DOUBLE_EXPONENT_INF_OR_NAN) {
         // NaN, +/- infinity
         result.uSize  = IEEE754_UNION_IS_HALF;
-        result.uValue = IEEE754_DoubleToHalf(d);
+        result.uValue = DoubleToHalfNoLoss(d, uDouble);
     } else if(bAllowHalfPrecision && (nDoubleExponent >= HALF_EXPONENT_MIN) && nDoubleExponent <= HALF_EXPONENT_MAX && (!(uDoubleSignificand & uDroppedHalfBits))) {
         // Can convert to half without precision loss
         result.uSize  = IEEE754_UNION_IS_HALF;
-        result.uValue = IEEE754_DoubleToHalf(d);
+        result.uValue = DoubleToHalfNoLoss(d, uDouble);
     } else if((nDoubleExponent >= SINGLE_EXPONENT_MIN) && nDoubleExponent <= SINGLE_EXPONENT_MAX && (!(uDoubleSignificand & uDroppedSingleBits))) {
         // Can convert to single without precision loss
         result.uSize  = IEEE754_UNION_IS_SINGLE;
@@ -65,7 +65,13 @@ DecodeNesting_IsNested(const QCBORDecodeNesting *pNesting)
 inline static int
 DecodeNesting_IsIndefiniteLength(const QCBORDecodeNesting *pNesting)
 {
-   return pNesting->pCurrent->uCount == UINT16_MAX;
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
+   return pNesting->pCurrent->uCount == QCBOR_COUNT_INDEFINITE;
+#else
+   // Never indefinite so the code for breaks is left out
+   (void)pNesting;
+   return 0;
+#endif
 }
 
 inline static uint8_t
@@ -86,26 +92,6 @@ DecodeNesting_TypeIsMap(const QCBORDecodeNesting *pNesting)
    return CBOR_MAJOR_TYPE_MAP == pNesting->pCurrent->uMajorType;
 }
 
-// Process a break. This will either ascend the nesting or error out
-inline static QCBORError
-DecodeNesting_BreakAscend(QCBORDecodeNesting *pNesting)
-{
-   // breaks must always occur when there is nesting
-   if(!DecodeNesting_IsNested(pNesting)) {
-      return QCBOR_ERR_BAD_BREAK;
-   }
-
-   // breaks can only occur when the map/array is indefinite length
-   if(!DecodeNesting_IsIndefiniteLength(pNesting)) {
-      return QCBOR_ERR_BAD_BREAK;
-   }
-
-   // if all OK, the break reduces the level of nesting
-   pNesting->pCurrent--;
-
-   return QCBOR_SUCCESS;
-}
-
 // Called on every single item except breaks including open of a map/array
 inline static void
 DecodeNesting_DecrementCount(QCBORDecodeNesting *pNesting)
@@ -130,6 +116,30 @@ DecodeNesting_DecrementCount(QCBORDecodeNesting *pNesting)
    }
 }
 
+// Process a break. This will either ascend the nesting or error out
+inline static QCBORError
+DecodeNesting_BreakAscend(QCBORDecodeNesting *pNesting)
+{
+   // breaks must always occur when there is nesting
+   if(!DecodeNesting_IsNested(pNesting)) {
+      return QCBOR_ERR_BAD_BREAK;
+   }
+
+   // breaks can only occur when the map/array is indefinite length
+   if(!DecodeNesting_IsIndefiniteLength(pNesting)) {
+      return QCBOR_ERR_BAD_BREAK;
+   }
+
+   // if all OK, the break reduces the level of nesting
+   pNesting->pCurrent--;
+
+   // The closed array or map is an item in the one enclosing it. This
+   // may close out a definite length one and more above it.
+   DecodeNesting_DecrementCount(pNesting);
+
+   return QCBOR_SUCCESS;
+}
+
 // Called on every map/array
 inline static QCBORError
 DecodeNesting_Descend(QCBORDecodeNesting *pNesting, QCBORItem *pItem)
@@ -144,7 +154,7 @@ DecodeNesting_Descend(QCBORDecodeNesting *pNesting, QCBORItem *pItem)
    }
 
    // Error out if arrays is too long to handle
-   if(pItem->val.uCount != UINT16_MAX && pItem->val.uCount > QCBOR_MAX_ITEMS_IN_ARRAY) {
+   if(pItem->val.uCount != QCBOR_COUNT_INDEFINITE && pItem->val.uCount > QCBOR_MAX_ITEMS_IN_ARRAY) {
       nReturn = QCBOR_ERR_ARRAY_TOO_LONG;
       goto Done;
    }
@@ -179,39 +189,65 @@ DecodeNesting_Init(QCBORDecodeNesting *pNesting)
  clearly established and useful. Once a tag is added here
  it can't be taken out as that would break backwards compatibility.
  There are only 48 slots available forever.
+
+ The position in this list is the tag's bit index in uTagBits. The
+ list is given as an X macro so the reverse table below is built from
+ the same list at compile time. All but the last, which is handled
+ separately, must be less than TAG_MAPPER_REVERSE_SIZE.
+ */
+#define TAG_MAPPER_BUILT_IN_SMALL(X) \
+   X(CBOR_TAG_DATE_STRING) /* See TAG_MAPPER_FIRST_SIX */ \
+   X(CBOR_TAG_DATE_EPOCH) /* See TAG_MAPPER_FIRST_SIX */ \
+   X(CBOR_TAG_POS_BIGNUM) /* See TAG_MAPPER_FIRST_SIX */ \
+   X(CBOR_TAG_NEG_BIGNUM) /* See TAG_MAPPER_FIRST_SIX */ \
+   X(CBOR_TAG_DECIMAL_FRACTION) /* See TAG_MAPPER_FIRST_SIX */ \
+   X(CBOR_TAG_BIGFLOAT) /* See TAG_MAPPER_FIRST_SIX */ \
+   X(CBOR_TAG_COSE_ENCRYPTO) \
+   X(CBOR_TAG_COSE_MAC0) \
+   X(CBOR_TAG_COSE_SIGN1) \
+   X(CBOR_TAG_ENC_AS_B64URL) \
+   X(CBOR_TAG_ENC_AS_B64) \
+   X(CBOR_TAG_ENC_AS_B16) \
+   X(CBOR_TAG_CBOR) \
+   X(CBOR_TAG_URI) \
+   X(CBOR_TAG_B64URL) \
+   X(CBOR_TAG_B64) \
+   X(CBOR_TAG_REGEX) \
+   X(CBOR_TAG_MIME) \
+   X(CBOR_TAG_BIN_UUID) \
+   X(CBOR_TAG_CWT) \
+   X(CBOR_TAG_ENCRYPT) \
+   X(CBOR_TAG_MAC) \
+   X(CBOR_TAG_SIGN) \
+   X(CBOR_TAG_GEO_COORD)
+
+#define TAG_MAPPER_ENUM(uTag)    TAG_MAPPER_INDEX_##uTag,
+#define TAG_MAPPER_REVERSE(uTag) [uTag] = TAG_MAPPER_INDEX_##uTag + 1,
+
+enum {
+   TAG_MAPPER_BUILT_IN_SMALL(TAG_MAPPER_ENUM)
+   TAG_MAPPER_INDEX_CBOR_TAG_CBOR_MAGIC,
+   TAG_MAPPER_NUM_BUILT_IN
+};
+
+/*
+ The reverse of the list above for tags less than
+ TAG_MAPPER_REVERSE_SIZE. It is indexed by tag value and gives the bit
+ index plus one so the zero entries are the tags that aren't built in.
+ This makes looking up a built-in tag one load instead of a scan of
+ the list. CBOR_TAG_CBOR_MAGIC is last with the bit index
+ TAG_MAPPER_INDEX_CBOR_TAG_CBOR_MAGIC.
  */
-static const uint16_t spBuiltInTagMap[] = {
-   CBOR_TAG_DATE_STRING, // See TAG_MAPPER_FIRST_SIX
-   CBOR_TAG_DATE_EPOCH, // See TAG_MAPPER_FIRST_SIX
-   CBOR_TAG_POS_BIGNUM, // See TAG_MAPPER_FIRST_SIX
-   CBOR_TAG_NEG_BIGNUM, // See TAG_MAPPER_FIRST_SIX
-   CBOR_TAG_DECIMAL_FRACTION, // See TAG_MAPPER_FIRST_SIX
-   CBOR_TAG_BIGFLOAT, // See TAG_MAPPER_FIRST_SIX
-   CBOR_TAG_COSE_ENCRYPTO,
-   CBOR_TAG_COSE_MAC0,
-   CBOR_TAG_COSE_SIGN1,
-   CBOR_TAG_ENC_AS_B64URL,
-   CBOR_TAG_ENC_AS_B64,
-   CBOR_TAG_ENC_AS_B16,
-   CBOR_TAG_CBOR,
-   CBOR_TAG_URI,
-   CBOR_TAG_B64URL,
-   CBOR_TAG_B64,
-   CBOR_TAG_REGEX,
-   CBOR_TAG_MIME,
-   CBOR_TAG_BIN_UUID,
-   CBOR_TAG_CWT,
-   CBOR_TAG_ENCRYPT,
-   CBOR_TAG_MAC,
-   CBOR_TAG_SIGN,
-   CBOR_TAG_GEO_COORD,
-   CBOR_TAG_CBOR_MAGIC
+#define TAG_MAPPER_REVERSE_SIZE 128
+
+static const uint8_t spBuiltInTagReverse[TAG_MAPPER_REVERSE_SIZE] = {
+   TAG_MAPPER_BUILT_IN_SMALL(TAG_MAPPER_REVERSE)
 };
 
 // This is used in a bit of cleverness in GetNext_TaggedItem() to
 // keep code size down and switch for the internal processing of
 // these types. This will break if the first six items in
-// spBuiltInTagMap don't have values 0,1,2,3,4,5. That is the
+// TAG_MAPPER_BUILT_IN_SMALL don't have values 0,1,2,3,4,5. That is the
 // mapping is 0 to 0, 1 to 1, 2 to 2 and 3 to 3....
 #define QCBOR_TAGFLAG_DATE_STRING      (0x01LL << CBOR_TAG_DATE_STRING)
 #define QCBOR_TAGFLAG_DATE_EPOCH       (0x01LL << CBOR_TAG_DATE_EPOCH)
@@ -236,9 +272,13 @@ static const uint16_t spBuiltInTagMap[] = {
 #define TAG_MAPPER_CUSTOM_TAGS_BASE_INDEX (TAG_MAPPER_TOTAL_TAG_BITS - QCBOR_MAX_CUSTOM_TAGS) // 48
 #define TAG_MAPPER_MAX_SIZE_BUILT_IN_TAGS (TAG_MAPPER_TOTAL_TAG_BITS - QCBOR_MAX_CUSTOM_TAGS ) // 48
 
+// Caller-configured tags after the first QCBOR_MAX_CUSTOM_TAGS have
+// bit indexes from 64 up. These are in uExtTagBits.
+#define TAG_MAPPER_EXT_TAGS_BASE_INDEX TAG_MAPPER_TOTAL_TAG_BITS // 64
+
 static inline int TagMapper_LookupBuiltIn(uint64_t uTag)
 {
-   if(sizeof(spBuiltInTagMap)/sizeof(uint16_t) > TAG_MAPPER_MAX_SIZE_BUILT_IN_TAGS) {
+   if(TAG_MAPPER_NUM_BUILT_IN > TAG_MAPPER_MAX_SIZE_BUILT_IN_TAGS) {
       /*
        This is a cross-check to make sure the above array doesn't
        accidentally get made too big.  In normal conditions the above
@@ -248,38 +288,112 @@ static inline int TagMapper_LookupBuiltIn(uint64_t uTag)
       return -1;
    }
 
-   if(uTag > UINT16_MAX) {
-      // This tag map works only on 16-bit tags
-      return -1;
+   if(uTag < TAG_MAPPER_REVERSE_SIZE) {
+      // -1 for the tags that aren't built in
+      return (int)spBuiltInTagReverse[uTag] - 1;
    }
 
-   for(int nTagBitIndex = 0; nTagBitIndex < (int)(sizeof(spBuiltInTagMap)/sizeof(uint16_t)); nTagBitIndex++) {
-      if(spBuiltInTagMap[nTagBitIndex] == uTag) {
-         return nTagBitIndex;
-      }
+   if(uTag == CBOR_TAG_CBOR_MAGIC) {
+      return TAG_MAPPER_INDEX_CBOR_TAG_CBOR_MAGIC;
    }
+
    return -1; // Indicates no match
 }
 
-static inline int TagMapper_LookupCallerConfigured(const QCBORTagListIn *pCallerConfiguredTagMap, uint64_t uTag)
+
+/*
+ One bit in the 64-bit filter that QCBORDecode_SetCallerConfiguredTagList()
+ makes of the caller-configured tags. The multiply is Fibonacci
+ hashing, which spreads out small sequential tag numbers well.
+ */
+static inline uint64_t TagMapper_FilterBit(uint64_t uTag)
+{
+   return 0x01ULL << ((uTag * 0x9e3779b97f4a7c15ULL) >> 58);
+}
+
+
+/*
+ Makes the filter and checks the order of the caller-configured tags
+ for the lookup. They are kept in the extension, so without one the
+ lookup is a linear search of the list.
+ */
+static void TagMapper_SetUpCallerConfigured(QCBORDecodeContext *me)
+{
+   const QCBORTagListIn *pTagList = me->pCallerConfiguredTagList;
+
+   if(me->pExt == NULL) {
+      return;
+   }
+   me->pExt->uCallerTagFilter  = 0;
+   me->pExt->bCallerTagsSorted = 1;
+   if(pTagList == NULL || pTagList->uNumTags > QCBOR_MAX_CUSTOM_TAGS_EXTENDED) {
+      // The error for a list that is too long is returned by GetNext()
+      return;
+   }
+   for(int n = 0; n < pTagList->uNumTags; n++) {
+      me->pExt->uCallerTagFilter |= TagMapper_FilterBit(pTagList->puTags[n]);
+      if(n > 0 && pTagList->puTags[n-1] >= pTagList->puTags[n]) {
+         me->pExt->bCallerTagsSorted = 0;
+      }
+   }
+}
+
+
+static inline int TagMapper_LookupCallerConfigured(const QCBORDecodeContext *me, uint64_t uTag)
 {
-   for(int nTagBitIndex = 0; nTagBitIndex < pCallerConfiguredTagMap->uNumTags; nTagBitIndex++) {
-      if(pCallerConfiguredTagMap->puTags[nTagBitIndex] == uTag) {
-         return nTagBitIndex + TAG_MAPPER_CUSTOM_TAGS_BASE_INDEX;
+   const QCBORTagListIn *pCallerConfiguredTagMap = me->pCallerConfiguredTagList;
+
+   // Most tags that aren't in the list are rejected here without
+   // looking at the list
+   if(me->pExt != NULL && !(me->pExt->uCallerTagFilter & TagMapper_FilterBit(uTag))) {
+      return -1;
+   }
+
+   int nTagBitIndex;
+
+   if(me->pExt != NULL && me->pExt->bCallerTagsSorted) {
+      // Binary search for the first tag that is not less than uTag
+      int nLow  = 0;
+      int nHigh = pCallerConfiguredTagMap->uNumTags;
+      while(nLow < nHigh) {
+         const int nMid = (nLow + nHigh) / 2;
+         if(pCallerConfiguredTagMap->puTags[nMid] < uTag) {
+            nLow = nMid + 1;
+         } else {
+            nHigh = nMid;
+         }
+      }
+      nTagBitIndex = nLow;
+
+   } else {
+      for(nTagBitIndex = 0; nTagBitIndex < pCallerConfiguredTagMap->uNumTags; nTagBitIndex++) {
+         if(pCallerConfiguredTagMap->puTags[nTagBitIndex] == uTag) {
+            break;
+         }
       }
    }
 
-   return -1; // Indicates no match
+   if(nTagBitIndex >= pCallerConfiguredTagMap->uNumTags ||
+      pCallerConfiguredTagMap->puTags[nTagBitIndex] != uTag) {
+      return -1; // Indicates no match
+   }
+
+   if(nTagBitIndex < QCBOR_MAX_CUSTOM_TAGS) {
+      return nTagBitIndex + TAG_MAPPER_CUSTOM_TAGS_BASE_INDEX;
+   } else {
+      return nTagBitIndex - QCBOR_MAX_CUSTOM_TAGS + TAG_MAPPER_EXT_TAGS_BASE_INDEX;
+   }
 }
 
 /*
   Find the tag bit index for a given tag value, or error out
 
- This and the above functions could probably be optimized and made
- clearer and neater.
+ The bit index is 0 to 47 for built-in tags, 48 to 63 for the first
+ QCBOR_MAX_CUSTOM_TAGS caller-configured tags and 64 up for the rest
+ of them.
  */
 static QCBORError
-TagMapper_Lookup(const QCBORTagListIn *pCallerConfiguredTagMap,
+TagMapper_Lookup(const QCBORDecodeContext *me,
                  uint64_t uTag,
                  uint8_t *puTagBitIndex)
 {
@@ -290,14 +404,15 @@ TagMapper_Lookup(const QCBORTagListIn *pCallerConfiguredTagMap,
       return QCBOR_SUCCESS;
    }
 
+   const QCBORTagListIn *pCallerConfiguredTagMap = me->pCallerConfiguredTagList;
    if(pCallerConfiguredTagMap) {
-      if(pCallerConfiguredTagMap->uNumTags > QCBOR_MAX_CUSTOM_TAGS) {
+      if(pCallerConfiguredTagMap->uNumTags > QCBOR_MAX_CUSTOM_TAGS_EXTENDED) {
          return QCBOR_ERR_TOO_MANY_TAGS;
       }
-      nTagBitIndex = TagMapper_LookupCallerConfigured(pCallerConfiguredTagMap, uTag);
+      nTagBitIndex = TagMapper_LookupCallerConfigured(me, uTag);
       if(nTagBitIndex >= 0) {
-         // Cast is safe because TagMapper_LookupBuiltIn never returns > 63
-
+         // Cast is safe because TagMapper_LookupCallerConfigured never
+         // returns more than 64 + QCBOR_MAX_CUSTOM_TAGS_EXTENDED
          *puTagBitIndex = (uint8_t)nTagBitIndex;
          return QCBOR_SUCCESS;
       }
@@ -317,31 +432,45 @@ TagMapper_Lookup(const QCBORTagListIn *pCallerConfiguredTagMap,
   ===========================================================================*/
 
 static inline void
-StringAllocator_Free(const QCORInternalAllocator *pMe, void *pMem)
+StringAllocator_Free(QCORInternalAllocator *pMe, void *pMem)
 {
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+   pMe->uCalls++;
+#endif
    (pMe->pfAllocator)(pMe->pAllocateCxt, pMem, 0);
 }
 
 // StringAllocator_Reallocate called with pMem NULL is
 // equal to StringAllocator_Allocate()
 static inline UsefulBuf
-StringAllocator_Reallocate(const QCORInternalAllocator *pMe,
+StringAllocator_Reallocate(QCORInternalAllocator *pMe,
                            void *pMem,
                            size_t uSize)
 {
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+   pMe->uCalls++;
+   pMe->uBytes += uSize;
+#endif
    return (pMe->pfAllocator)(pMe->pAllocateCxt, pMem, uSize);
 }
 
 static inline UsefulBuf
-StringAllocator_Allocate(const QCORInternalAllocator *pMe, size_t uSize)
+StringAllocator_Allocate(QCORInternalAllocator *pMe, size_t uSize)
 {
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+   pMe->uCalls++;
+   pMe->uBytes += uSize;
+#endif
    return (pMe->pfAllocator)(pMe->pAllocateCxt, NULL, uSize);
 }
 
 static inline void
-StringAllocator_Destruct(const QCORInternalAllocator *pMe)
+StringAllocator_Destruct(QCORInternalAllocator *pMe)
 {
    if(pMe->pfAllocator) {
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+      pMe->uCalls++;
+#endif
       (pMe->pfAllocator)(pMe->pAllocateCxt, NULL, 0);
    }
 }
@@ -370,6 +499,87 @@ void QCBORDecode_Init(QCBORDecodeContext *me,
 }
 
 
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORDecode_Reset(QCBORDecodeContext *me, UsefulBufC EncodedCBOR)
+{
+   UsefulInputBuf_Init(&(me->InBuf), EncodedCBOR);
+   me->bIncremental = 0;
+   DecodeNesting_Init(&(me->nesting));
+
+   if(me->StringAllocator.pAllocateCxt == &(me->MemPool)) {
+      me->MemPool.uFreeOffset = QCBOR_DECODE_MIN_MEM_POOL_SIZE;
+   }
+   if(me->pExt != NULL) {
+      me->pExt->uDigestPos      = 0;
+      me->pExt->uNextStringRef  = 0;
+      me->pExt->uStringRefLevel = QCBOR_NO_STRING_REF_NAMESPACE;
+
+      me->pExt->uLabelCheckPos    = 0;
+      me->pExt->uLabelCheckTop    = QCBOR_NO_LABEL_CHECK_MAP;
+      me->pExt->bNotDeterministic = 0;
+   }
+}
+
+
+/*
+ Public function, see header file
+ */
+void QCBORDecode_InitIncremental(QCBORDecodeContext *me,
+                                 UsefulBufC Received,
+                                 QCBORDecodeMode nDecodeMode)
+{
+   QCBORDecode_Init(me, Received, nDecodeMode);
+   me->bIncremental = 1;
+}
+
+
+/*
+ Public function, see header file
+ */
+void QCBORDecode_AddInput(QCBORDecodeContext *me, size_t uNumBytes)
+{
+   const size_t uLen = me->InBuf.UB.len;
+
+   // Don't wrap around on hostile input
+   if(uNumBytes <= SIZE_MAX - uLen) {
+      UsefulInputBuf_SetBufferLength(&(me->InBuf), uLen + uNumBytes);
+   }
+}
+
+
+/*
+ Public function, see header file
+ */
+void QCBORDecode_EndOfInput(QCBORDecodeContext *me)
+{
+   me->bIncremental = 0;
+}
+
+
+/*
+ The state of the caller-configured tag lookup, digest, string
+ references and map checks is in the extension given to
+ QCBORDecode_SetExtension() so that the context stays small when they
+ aren't used.
+ */
+static inline bool HasDigest(const QCBORDecodeContext *me)
+{
+   return me->pExt != NULL && me->pExt->pfDigest != NULL;
+}
+
+static inline bool HasStringRefs(const QCBORDecodeContext *me)
+{
+   return me->pExt != NULL && me->pExt->pStringRefs != NULL;
+}
+
+static inline bool HasMapChecks(const QCBORDecodeContext *me)
+{
+   return me->pExt != NULL && me->pExt->pLabelChecks != NULL;
+}
+
+
 /*
  Public function, see header file
  */
@@ -391,9 +601,155 @@ void QCBORDecode_SetCallerConfiguredTagList(QCBORDecodeContext *me,
                                             const QCBORTagListIn *pTagList)
 {
    me->pCallerConfiguredTagList = pTagList;
+   TagMapper_SetUpCallerConfigured(me);
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORDecode_SetExtension(QCBORDecodeContext *me, QCBORDecodeExtension *pExt)
+{
+   memset(pExt, 0, sizeof(QCBORDecodeExtension));
+   pExt->uStringRefLevel = QCBOR_NO_STRING_REF_NAMESPACE;
+   pExt->uLabelCheckTop  = QCBOR_NO_LABEL_CHECK_MAP;
+   me->pExt = pExt;
+   TagMapper_SetUpCallerConfigured(me);
+}
+
+
+/*
+ Public function, see header file
+ */
+QCBORError QCBORDecode_SetDigest(QCBORDecodeContext *me,
+                                 QCBORDigestUpdate   pfDigest,
+                                 void               *pDigestCtx)
+{
+   if(me->pExt == NULL) {
+      return QCBOR_ERR_NO_EXTENSION;
+   }
+   me->pExt->pfDigest   = pfDigest;
+   me->pExt->pDigestCtx = pDigestCtx;
+   me->pExt->uDigestPos = UsefulInputBuf_Tell(&(me->InBuf));
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_SetStringRefs(QCBORDecodeContext *me,
+                                     QCBORStringRef     *pTable,
+                                     size_t              uTableSize)
+{
+   if(me->pExt == NULL) {
+      return QCBOR_ERR_NO_EXTENSION;
+   }
+   me->pExt->pStringRefs     = pTable;
+   // More than this many is not practical
+   me->pExt->uStringRefsSize = uTableSize > UINT32_MAX ? UINT32_MAX : (uint32_t)uTableSize;
+   me->pExt->uNextStringRef  = 0;
+   me->pExt->uStringRefLevel = QCBOR_NO_STRING_REF_NAMESPACE;
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_SetMapChecks(QCBORDecodeContext *me,
+                                    QCBORLabelCheck    *pScratch,
+                                    size_t              uScratchSize)
+{
+   if(me->pExt == NULL) {
+      return QCBOR_ERR_NO_EXTENSION;
+   }
+   me->pExt->pLabelChecks      = pScratch;
+   // More than this many is not practical
+   me->pExt->uLabelChecksSize  = uScratchSize > UINT32_MAX ? UINT32_MAX : (uint32_t)uScratchSize;
+   me->pExt->uLabelCheckTop    = QCBOR_NO_LABEL_CHECK_MAP;
+   me->pExt->uLabelCheckPos    = UsefulInputBuf_Tell(&(me->InBuf));
+   me->pExt->bNotDeterministic = 0;
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+bool QCBORDecode_IsDeterministic(QCBORDecodeContext *me)
+{
+   return HasMapChecks(me) && !me->pExt->bNotDeterministic;
+}
+
+
+/*
+ Give the input consumed so far to the digest callback. Unless bFlush,
+ this waits until QCBOR_DIGEST_UPDATE_SIZE bytes have been consumed.
+ Rewinds, for example by QCBORDecode_ExitIndexedMap(), never cause
+ input to be given twice because only what is after uDigestPos is
+ given.
+ */
+static void DigestConsumed(QCBORDecodeContext *me, bool bFlush)
+{
+   const size_t uPosition = UsefulInputBuf_Tell(&(me->InBuf));
+
+   if(uPosition > me->pExt->uDigestPos &&
+      (bFlush || uPosition - me->pExt->uDigestPos >= QCBOR_DIGEST_UPDATE_SIZE)) {
+      (*me->pExt->pfDigest)(me->pExt->pDigestCtx,
+                      (UsefulBufC){(const uint8_t *)me->InBuf.UB.ptr + me->pExt->uDigestPos,
+                                   uPosition - me->pExt->uDigestPos});
+      me->pExt->uDigestPos = uPosition;
+   }
 }
 
 
+/*
+ Table for decoding the initial byte of a CBOR data item, indexed by
+ the initial byte. Each entry has the major type in the top three
+ bits, the same as the initial byte, and the number of argument bytes
+ that follow in the low four bits. The additional info values that
+ are reserved are marked HEAD_RESERVED.
+
+ This is built by the preprocessor so it is constant data that takes
+ up 256 bytes and no code. Looking up the argument size is one load
+ rather than the several comparisons of the additional info it
+ replaces.
+ */
+#define HEAD_ARG_LEN_MASK 0x0f
+#define HEAD_RESERVED     0x10
+
+#define HEAD_ENTRY(nMajorType, uArgInfo) \
+   (uint8_t)(((nMajorType) << 5) | (uArgInfo))
+
+#define HEAD_ENTRY_4(m, a) \
+   HEAD_ENTRY(m, a), HEAD_ENTRY(m, a), HEAD_ENTRY(m, a), HEAD_ENTRY(m, a)
+
+// The 32 entries for one major type. The first 24 are additional info
+// values that are the argument, then 1, 2, 4 and 8 argument bytes,
+// then three reserved values and last the indefinite length / break.
+#define HEAD_ROW(m) \
+   HEAD_ENTRY_4(m, 0), HEAD_ENTRY_4(m, 0), HEAD_ENTRY_4(m, 0), \
+   HEAD_ENTRY_4(m, 0), HEAD_ENTRY_4(m, 0), HEAD_ENTRY_4(m, 0), \
+   HEAD_ENTRY(m, 1), HEAD_ENTRY(m, 2), HEAD_ENTRY(m, 4), HEAD_ENTRY(m, 8), \
+   HEAD_ENTRY(m, HEAD_RESERVED), HEAD_ENTRY(m, HEAD_RESERVED), \
+   HEAD_ENTRY(m, HEAD_RESERVED), HEAD_ENTRY(m, 0)
+
+static const uint8_t spHeadTable[256] = {
+   HEAD_ROW(CBOR_MAJOR_TYPE_POSITIVE_INT),
+   HEAD_ROW(CBOR_MAJOR_TYPE_NEGATIVE_INT),
+   HEAD_ROW(CBOR_MAJOR_TYPE_BYTE_STRING),
+   HEAD_ROW(CBOR_MAJOR_TYPE_TEXT_STRING),
+   HEAD_ROW(CBOR_MAJOR_TYPE_ARRAY),
+   HEAD_ROW(CBOR_MAJOR_TYPE_MAP),
+   HEAD_ROW(CBOR_MAJOR_TYPE_OPTIONAL),
+   HEAD_ROW(CBOR_MAJOR_TYPE_SIMPLE)
+};
+
+
 /*
  This decodes the fundamental part of a CBOR data item, the type and
  number
@@ -416,6 +772,10 @@ void QCBORDecode_SetCallerConfiguredTagList(QCBORDecodeContext *me,
  The int type is preferred to uint8_t for some variables as this
  avoids integer promotions, can reduce code size and makes
  static analyzers happier.
+
+ The argument bytes are fetched with one call that does one bounds
+ check and an unaligned big-endian load rather than a byte at a
+ time, so a head is at most two bounds checks.
  */
 inline static QCBORError DecodeTypeAndNumber(UsefulInputBuf *pUInBuf,
                                               int *pnMajorType,
@@ -425,44 +785,61 @@ inline static QCBORError DecodeTypeAndNumber(UsefulInputBuf *pUInBuf,
    QCBORError nReturn;
 
    // Get the initial byte that every CBOR data item has
-   const int nInitialByte = (int)UsefulInputBuf_GetByte(pUInBuf);
+   const uint8_t *pInitialByte = (const uint8_t *)UsefulInputBuf_GetBytes(pUInBuf, 1);
+   if(pInitialByte == NULL) {
+      nReturn = QCBOR_ERR_HIT_END;
+      goto Done;
+   }
 
    // Break down the initial byte
-   const int nTmpMajorType   = nInitialByte >> 5;
+   const int nInitialByte    = *pInitialByte;
+   const int nHeadInfo       = spHeadTable[nInitialByte];
    const int nAdditionalInfo = nInitialByte & 0x1f;
 
    // Where the number or argument accumulates
    uint64_t uArgument;
 
-   if(nAdditionalInfo >= LEN_IS_ONE_BYTE && nAdditionalInfo <= LEN_IS_EIGHT_BYTES) {
-      // Need to get 1,2,4 or 8 additional argument bytes Map
-      // LEN_IS_ONE_BYTE.. LEN_IS_EIGHT_BYTES to actual length
-      static const uint8_t aIterate[] = {1,2,4,8};
+   switch(nHeadInfo & (HEAD_ARG_LEN_MASK | HEAD_RESERVED)) {
+      case 0:
+         // Less than 24, additional info is argument or 31, an
+         // indefinite length. No more bytes to get
+         uArgument = (uint64_t)nAdditionalInfo;
+         break;
 
-      // Loop getting all the bytes in the argument
-      uArgument = 0;
-      for(int i = aIterate[nAdditionalInfo - LEN_IS_ONE_BYTE]; i; i--) {
-         // This shift and add gives the endian conversion
-         uArgument = (uArgument << 8) + UsefulInputBuf_GetByte(pUInBuf);
-      }
-   } else if(nAdditionalInfo >= ADDINFO_RESERVED1 && nAdditionalInfo <= ADDINFO_RESERVED3) {
-      // The reserved and thus-far unused additional info values
-      nReturn = QCBOR_ERR_UNSUPPORTED;
-      goto Done;
-   } else {
-      // Less than 24, additional info is argument or 31, an indefinite length
-      // No more bytes to get
-      uArgument = (uint64_t)nAdditionalInfo;
+      case 1:
+         uArgument = UsefulInputBuf_GetByte(pUInBuf);
+         break;
+
+      case 2:
+         uArgument = UsefulInputBuf_GetUint16(pUInBuf);
+         break;
+
+      case 4:
+         uArgument = UsefulInputBuf_GetUint32(pUInBuf);
+         break;
+
+      case 8:
+         uArgument = UsefulInputBuf_GetUint64(pUInBuf);
+         break;
+
+      default:
+         // The reserved and thus-far unused additional info values
+         nReturn = QCBOR_ERR_UNSUPPORTED;
+         goto Done;
    }
 
    if(UsefulInputBuf_GetError(pUInBuf)) {
+      // The bulk load consumes nothing when there aren't enough bytes.
+      // Consume what is left like a byte at a time would so the next
+      // call and QCBORDecode_Finish() see the end of the input.
+      UsefulInputBuf_Seek(pUInBuf, pUInBuf->UB.len);
       nReturn = QCBOR_ERR_HIT_END;
       goto Done;
    }
 
    // All successful if we got here.
    nReturn           = QCBOR_SUCCESS;
-   *pnMajorType      = nTmpMajorType;
+   *pnMajorType      = nHeadInfo >> 5;
    *puArgument       = uArgument;
    *pnAdditionalInfo = nAdditionalInfo;
 
@@ -631,7 +1008,7 @@ Done:
 /*
  Decode text and byte strings. Call the string allocator if asked to.
  */
-inline static QCBORError DecodeBytes(const QCORInternalAllocator *pAllocator,
+inline static QCBORError DecodeBytes(QCORInternalAllocator *pAllocator,
                                      int nMajorType,
                                      uint64_t uStrLen,
                                      UsefulInputBuf *pUInBuf,
@@ -703,9 +1080,10 @@ Done:
  Errors detected here include: an array that is too long to decode,
  hit end of buffer unexpectedly, a few forms of invalid encoded CBOR
  */
-static QCBORError GetNext_Item(UsefulInputBuf *pUInBuf,
-                               QCBORItem *pDecodedItem,
-                               const QCORInternalAllocator *pAllocator)
+inline static QCBORError
+GetNext_ItemUncleared(UsefulInputBuf *pUInBuf,
+                      QCBORItem *pDecodedItem,
+                      QCORInternalAllocator *pAllocator)
 {
    QCBORError nReturn;
 
@@ -719,8 +1097,6 @@ static QCBORError GetNext_Item(UsefulInputBuf *pUInBuf,
    uint64_t uNumber = 0;
    int      nAdditionalInfo = 0;
 
-   memset(pDecodedItem, 0, sizeof(QCBORItem));
-
    nReturn = DecodeTypeAndNumber(pUInBuf, &nMajorType, &uNumber, &nAdditionalInfo);
 
    // Error out here if we got into trouble on the type and number.  The
@@ -744,10 +1120,14 @@ static QCBORError GetNext_Item(UsefulInputBuf *pUInBuf,
       case CBOR_MAJOR_TYPE_BYTE_STRING: // Major type 2
       case CBOR_MAJOR_TYPE_TEXT_STRING: // Major type 3
          if(nAdditionalInfo == LEN_IS_INDEFINITE) {
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
             const bool bIsBstr = (nMajorType == CBOR_MAJOR_TYPE_BYTE_STRING);
             pDecodedItem->uDataType = (uint8_t)(bIsBstr ? QCBOR_TYPE_BYTE_STRING
                                                         : QCBOR_TYPE_TEXT_STRING);
             pDecodedItem->val.string = (UsefulBufC){NULL, SIZE_MAX};
+#else
+            nReturn = QCBOR_ERR_INDEF_LEN_STRINGS_DISABLED;
+#endif
          } else {
             nReturn = DecodeBytes(pAllocator, nMajorType, uNumber, pUInBuf, pDecodedItem);
          }
@@ -761,10 +1141,15 @@ static QCBORError GetNext_Item(UsefulInputBuf *pUInBuf,
             goto Done;
          }
          if(nAdditionalInfo == LEN_IS_INDEFINITE) {
-            pDecodedItem->val.uCount = UINT16_MAX; // Indicate indefinite length
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
+            pDecodedItem->val.uCount = QCBOR_COUNT_INDEFINITE; // Indicate indefinite length
+#else
+            nReturn = QCBOR_ERR_INDEF_LEN_ARRAYS_DISABLED;
+            goto Done;
+#endif
          } else {
             // type conversion OK because of check above
-            pDecodedItem->val.uCount = (uint16_t)uNumber;
+            pDecodedItem->val.uCount = (QCBORCount)uNumber;
          }
          // C preproc #if above makes sure constants for major types align
          // DecodeTypeAndNumber never returns a major type > 7 so cast is safe
@@ -796,38 +1181,437 @@ Done:
 }
 
 
-
 /*
- This layer deals with indefinite length strings. It pulls all the
- individual chunk items together into one QCBORItem using the string
- allocator.
+ GetNext_ItemUncleared() sets only uDataType, val and, if it
+ allocates, uDataAlloc. Everything above it counts on the rest of the
+ item being zero, so this clears it first. QCBORDecode_GetNextBatch()
+ calls GetNext_ItemUncleared() directly and sets the few other
+ members itself.
+ */
+static QCBORError GetNext_Item(UsefulInputBuf *pUInBuf,
+                               QCBORItem *pDecodedItem,
+                               QCORInternalAllocator *pAllocator)
+{
+   memset(pDecodedItem, 0, sizeof(QCBORItem));
 
- Code Reviewers: THIS FUNCTION DOES A LITTLE POINTER MATH
+   return GetNext_ItemUncleared(pUInBuf, pDecodedItem, pAllocator);
+}
+
+
+
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+/*
+ Add up the lengths of the chunks of an indefinite length string
+ without consuming any input so the whole string can be allocated
+ once. Only the chunk heads are read.
+
+ Returns true if all the chunks through the break are well-formed and
+ of nMajorType. Returns false when there is anything else, including
+ the end of the input, so the loop in GetNext_FullItem() can report
+ the exact error when it gets to it.
  */
-static inline QCBORError
-GetNext_FullItem(QCBORDecodeContext *me, QCBORItem *pDecodedItem)
+static bool
+IndefiniteString_TotalLength(const UsefulInputBuf *pUInBuf,
+                             int                   nMajorType,
+                             size_t               *puTotalLen,
+                             size_t               *puNumChunks)
 {
-   // Stack usage; int/ptr 2 UsefulBuf 2 QCBORItem  -- 96
+   // Stack usage: UsefulInputBuf 40, int/ptr 6 -- 88
 
-   // Get pointer to string allocator. First use is to pass it to
-   // GetNext_Item() when option is set to allocate for *every* string.
-   // Second use here is to allocate space to coallese indefinite
-   // length string items into one.
-   const QCORInternalAllocator *pAllocator = me->StringAllocator.pfAllocator ?
-                                                      &(me->StringAllocator) :
-                                                      NULL;
+   // This is a zero-length get on a copy to find where the cursor is
+   UsefulInputBuf Scan       = *pUInBuf;
+   const uint8_t *pByte      = UsefulInputBuf_GetBytes(&Scan, 0);
+   const uint8_t *pEnd       = pByte + UsefulInputBuf_BytesUnconsumed(&Scan);
+   size_t         uTotal     = 0;
+   size_t         uNumChunks = 0;
 
-   QCBORError nReturn;
-   nReturn = GetNext_Item(&(me->InBuf),
-                          pDecodedItem,
-                          me->bStringAllocateAll ? pAllocator: NULL);
-   if(nReturn) {
-      goto Done;
+   if(pByte == NULL) {
+      return false;
    }
 
-   // To reduce code size by removing support for indefinite length strings, the
-   // code in this function from here down can be eliminated. Run tests, except
-   // indefinite length string tests, to be sure all is OK if this is removed.
+   for(;;) {
+      if(pByte >= pEnd) {
+         return false;
+      }
+      const uint8_t uInitialByte = *pByte++;
+      if(uInitialByte == (CBOR_MAJOR_TYPE_SIMPLE << 5 | CBOR_SIMPLE_BREAK)) {
+         *puTotalLen  = uTotal;
+         *puNumChunks = uNumChunks;
+         return true;
+      }
+
+      const int nHeadInfo = spHeadTable[uInitialByte];
+      if(uInitialByte >> 5 != nMajorType ||
+         (uInitialByte & 0x1f) == LEN_IS_INDEFINITE ||
+         nHeadInfo & HEAD_RESERVED) {
+         return false;
+      }
+
+      // The argument and the chunk must be all there so the total
+      // can't overflow
+      const size_t uArgLen = (size_t)(nHeadInfo & HEAD_ARG_LEN_MASK);
+      if(uArgLen > (size_t)(pEnd - pByte)) {
+         return false;
+      }
+      uint64_t uChunkLen = uArgLen ? 0 : (uint64_t)(uInitialByte & 0x1f);
+      for(size_t u = 0; u < uArgLen; u++) {
+         uChunkLen = (uChunkLen << 8) | pByte[u];
+      }
+      pByte += uArgLen;
+      if(uChunkLen > (uint64_t)(pEnd - pByte)) {
+         return false;
+      }
+
+      // Cast is safe because of the check just above
+      pByte  += (size_t)uChunkLen;
+      uTotal += (size_t)uChunkLen;
+      uNumChunks++;
+   }
+}
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS */
+
+
+/*
+ 64-bit FNV-1a hash of a string label. A hash match is confirmed by
+ comparing the decoded label, so this only has to spread labels out.
+ Also used by the label checks of QCBORDecode_SetMapChecks().
+ */
+static int64_t
+MapIndex_HashString(UsefulBufC String)
+{
+   uint64_t uHash = 0xcbf29ce484222325ULL;
+
+   for(size_t i = 0; i < String.len; i++) {
+      uHash ^= ((const uint8_t *)String.ptr)[i];
+      uHash *= 0x100000001b3ULL;
+   }
+
+   return (int64_t)uHash;
+}
+
+
+/*
+ Whether the head at uOffset in the input is preferred serialization:
+ the argument in its shortest form, not an indefinite length and a
+ float in the smallest size that holds its value exactly. The head was
+ already decoded so all of its bytes are there.
+ */
+static bool
+LabelCheck_IsPreferredHead(const QCBORDecodeContext *me, size_t uOffset)
+{
+   const uint8_t *pHead      = (const uint8_t *)me->InBuf.UB.ptr + uOffset;
+   const int      nMajorType = pHead[0] >> 5;
+   const int      nAddInfo   = pHead[0] & 0x1f;
+
+   if(nAddInfo < LEN_IS_ONE_BYTE) {
+      return true;
+   }
+   if(nAddInfo == LEN_IS_INDEFINITE) {
+      return false;
+   }
+
+   // 1, 2, 4 or 8 bytes for LEN_IS_ONE_BYTE to LEN_IS_EIGHT_BYTES
+   const size_t uArgLen   = (size_t)1 << (nAddInfo - LEN_IS_ONE_BYTE);
+   uint64_t     uArgument = 0;
+   for(size_t u = 1; u <= uArgLen; u++) {
+      uArgument = (uArgument << 8) | pHead[u];
+   }
+
+   if(nMajorType == CBOR_MAJOR_TYPE_SIMPLE) {
+      switch(nAddInfo) {
+#ifndef QCBOR_DISABLE_PREFERRED_FLOAT
+         case SINGLE_PREC_FLOAT:
+            // The cast is safe because the argument is 32 bits
+            return IEEE754_FloatToSmallest(UsefulBufUtil_CopyUint32ToFloat((uint32_t)uArgument)).uSize ==
+                      IEEE754_UNION_IS_SINGLE;
+
+         case DOUBLE_PREC_FLOAT:
+            return IEEE754_DoubleToSmallest(UsefulBufUtil_CopyUint64ToDouble(uArgument)).uSize ==
+                      IEEE754_UNION_IS_DOUBLE;
+#else
+         case SINGLE_PREC_FLOAT:
+         case DOUBLE_PREC_FLOAT:
+            // Can't tell without the conversions in ieee754.c
+            return false;
+#endif /* QCBOR_DISABLE_PREFERRED_FLOAT */
+
+         default:
+            // Half-precision is the smallest float. The one-byte
+            // simple values below 32 are errors when decoded.
+            return true;
+      }
+   }
+
+   if(nAddInfo == LEN_IS_ONE_BYTE) {
+      return uArgument >= LEN_IS_ONE_BYTE;
+   }
+   // It doesn't fit in the next smaller size, which is half as long
+   return (uArgument >> (uArgLen * 4)) != 0;
+}
+
+
+/*
+ The entry after the last one used by the maps that are open.
+ */
+static uint32_t
+LabelCheck_End(const QCBORDecodeContext *me)
+{
+   if(me->pExt->uLabelCheckTop == QCBOR_NO_LABEL_CHECK_MAP) {
+      return 0;
+   }
+   const struct _QCBORLabelCheck *pMap = &(me->pExt->pLabelChecks[me->pExt->uLabelCheckTop]);
+   return me->pExt->uLabelCheckTop + 1 + ((uint32_t)1 << pMap->u.map.uSizeLog2);
+}
+
+
+/*
+ Maps aren't popped when they are closed because that happens in the
+ nesting tracking several layers down. They are popped when a label
+ or map at a lower level turns up instead.
+ */
+static void
+LabelCheck_PopAbove(QCBORDecodeContext *me, uint8_t uLevel)
+{
+   while(me->pExt->uLabelCheckTop != QCBOR_NO_LABEL_CHECK_MAP &&
+         me->pExt->pLabelChecks[me->pExt->uLabelCheckTop].u.map.uLevel > uLevel) {
+      me->pExt->uLabelCheckTop = me->pExt->pLabelChecks[me->pExt->uLabelCheckTop].u.map.uPrevMap;
+   }
+}
+
+
+/*
+ Start the hash table for a map whose labels are at uLevel. It has at
+ least twice as many slots as labels so probe sequences stay short.
+ */
+static QCBORError
+LabelCheck_PushMap(QCBORDecodeContext *me, uint8_t uLevel, QCBORCount uCount)
+{
+   // Closed maps at this level and above
+   LabelCheck_PopAbove(me, (uint8_t)(uLevel - 1));
+
+   const uint32_t uStart    = LabelCheck_End(me);
+   uint8_t        uSizeLog2 = 4; // For an indefinite-length map to start with
+   if(uCount != QCBOR_COUNT_INDEFINITE) {
+      uSizeLog2 = 1;
+      while(((uint64_t)1 << uSizeLog2) < (uint64_t)uCount * 2) {
+         uSizeLog2++;
+      }
+   }
+   // One more for the map entry
+   if(((uint64_t)1 << uSizeLog2) >= (uint64_t)(me->pExt->uLabelChecksSize - uStart)) {
+      return QCBOR_ERR_LABEL_CHECK_FULL;
+   }
+
+   struct _QCBORLabelCheck *pMap = &(me->pExt->pLabelChecks[uStart]);
+   memset(pMap, 0, (((size_t)1 << uSizeLog2) + 1) * sizeof(struct _QCBORLabelCheck));
+   pMap->u.map.uPrevMap  = me->pExt->uLabelCheckTop;
+   pMap->u.map.uSizeLog2 = uSizeLog2;
+   pMap->u.map.uLevel    = uLevel;
+   me->pExt->uLabelCheckTop    = uStart;
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ The first slot to probe for a label. The top bits of the hash are
+ used because they are the best mixed.
+ */
+static inline uint32_t
+LabelCheck_Slot(uint32_t uHash, uint8_t uSizeLog2)
+{
+   return uHash >> (32 - uSizeLog2);
+}
+
+
+/*
+ Double the hash table of the map at the top of the stack, the only
+ one that can grow. The new table is made after the end of the old
+ one and then moved down over it.
+ */
+static QCBORError
+LabelCheck_Grow(QCBORDecodeContext *me)
+{
+   struct _QCBORLabelCheck *pMap      = &(me->pExt->pLabelChecks[me->pExt->uLabelCheckTop]);
+   const uint8_t            uSizeLog2 = (uint8_t)(pMap->u.map.uSizeLog2 + 1);
+   const uint32_t           uEnd      = LabelCheck_End(me);
+   const uint32_t           uNewSize  = (uint32_t)1 << uSizeLog2;
+   const uint32_t           uMask     = uNewSize - 1;
+
+   if(uSizeLog2 >= 32 || uNewSize > me->pExt->uLabelChecksSize - uEnd) {
+      return QCBOR_ERR_LABEL_CHECK_FULL;
+   }
+
+   struct _QCBORLabelCheck *pNew = &(me->pExt->pLabelChecks[uEnd]);
+   memset(pNew, 0, uNewSize * sizeof(struct _QCBORLabelCheck));
+   for(uint32_t u = 1; u <= uNewSize / 2; u++) {
+      if(pMap[u].u.label.uType != QCBOR_TYPE_NONE) {
+         uint32_t uSlot = LabelCheck_Slot(pMap[u].u.label.uHash, uSizeLog2);
+         while(pNew[uSlot].u.label.uType != QCBOR_TYPE_NONE) {
+            uSlot = (uSlot + 1) & uMask;
+         }
+         pNew[uSlot] = pMap[u];
+      }
+   }
+   memmove(pMap + 1, pNew, uNewSize * sizeof(struct _QCBORLabelCheck));
+   pMap->u.map.uSizeLog2 = uSizeLog2;
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Check the label of pItem against the others in its map and for being
+ after the previous one in deterministic order. The label is the input
+ from uLabelStart to uLabelEnd.
+ */
+static QCBORError
+LabelCheck_AddLabel(QCBORDecodeContext *me,
+                    const QCBORItem    *pItem,
+                    uint8_t             uLevel,
+                    size_t              uLabelStart,
+                    size_t              uLabelEnd)
+{
+   LabelCheck_PopAbove(me, uLevel);
+   if(me->pExt->uLabelCheckTop == QCBOR_NO_LABEL_CHECK_MAP ||
+      me->pExt->pLabelChecks[me->pExt->uLabelCheckTop].u.map.uLevel != uLevel) {
+      // The map was opened before QCBORDecode_SetMapChecks()
+      return QCBOR_SUCCESS;
+   }
+   struct _QCBORLabelCheck *pMap = &(me->pExt->pLabelChecks[me->pExt->uLabelCheckTop]);
+
+   // RFC 8949 section 4.2.1 orders labels by their encoded bytes. A
+   // label that is a prefix of another goes first.
+   const uint8_t *pInput    = me->InBuf.UB.ptr;
+   const size_t   uLabelLen = uLabelEnd - uLabelStart;
+   if(uLabelLen > UINT32_MAX) {
+      me->pExt->bNotDeterministic = 1;
+   } else if(pMap->u.map.uPrevLabelLen != 0) {
+      const size_t uPrevLen = pMap->u.map.uPrevLabelLen;
+      const int    nCompare = memcmp(pInput + pMap->u.map.uPrevLabel,
+                                     pInput + uLabelStart,
+                                     uPrevLen < uLabelLen ? uPrevLen : uLabelLen);
+      if(nCompare > 0 || (nCompare == 0 && uPrevLen >= uLabelLen)) {
+         me->pExt->bNotDeterministic = 1;
+      }
+   }
+   pMap->u.map.uPrevLabel    = uLabelStart;
+   pMap->u.map.uPrevLabelLen = (uint32_t)uLabelLen;
+
+   struct _QCBORLabelCheck Label;
+   uint64_t                uHash;
+   Label.u.label.uType = pItem->uLabelType;
+   if(pItem->uLabelType == QCBOR_TYPE_INT64 || pItem->uLabelType == QCBOR_TYPE_UINT64) {
+      // Fibonacci hashing; the multiply mixes the low bits into the top
+      Label.u.label.pStr   = NULL;
+      Label.u.label.uValue = pItem->label.uint64;
+      uHash = Label.u.label.uValue * 0x9e3779b97f4a7c15ULL;
+   } else {
+      Label.u.label.pStr   = pItem->label.string.ptr;
+      Label.u.label.uValue = pItem->label.string.len;
+      uHash = (uint64_t)MapIndex_HashString(pItem->label.string);
+   }
+   Label.u.label.uHash = (uint32_t)(uHash >> 32);
+
+   // Kept at most half full
+   if(pMap->u.map.uUsed >= ((uint32_t)1 << pMap->u.map.uSizeLog2) / 2) {
+      QCBORError nReturn = LabelCheck_Grow(me);
+      if(nReturn) {
+         return nReturn;
+      }
+   }
+
+   struct _QCBORLabelCheck *pSlots = pMap + 1;
+   const uint32_t           uMask  = ((uint32_t)1 << pMap->u.map.uSizeLog2) - 1;
+   uint32_t uSlot = LabelCheck_Slot(Label.u.label.uHash, pMap->u.map.uSizeLog2);
+   while(pSlots[uSlot].u.label.uType != QCBOR_TYPE_NONE) {
+      const struct _QCBORLabelCheck *pSlot = &pSlots[uSlot];
+      if(pSlot->u.label.uHash  == Label.u.label.uHash &&
+         pSlot->u.label.uType  == Label.u.label.uType &&
+         pSlot->u.label.uValue == Label.u.label.uValue &&
+         (Label.u.label.pStr == NULL ||
+          memcmp(pSlot->u.label.pStr, Label.u.label.pStr, (size_t)Label.u.label.uValue) == 0)) {
+         return QCBOR_ERR_DUPLICATE_LABEL;
+      }
+      uSlot = (uSlot + 1) & uMask;
+   }
+   pSlots[uSlot] = Label;
+   pMap->u.map.uUsed++;
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ The label checks for pItem, which is all of the input from uStart.
+ If it has a label, it ends at uLabelEnd. Each item is checked only
+ the first time it is decoded.
+ */
+static QCBORError
+LabelCheck_Item(QCBORDecodeContext *me,
+                const QCBORItem    *pItem,
+                size_t              uStart,
+                size_t              uLabelEnd)
+{
+   QCBORError    nReturn = QCBOR_SUCCESS;
+   const uint8_t uLevel  = DecodeNesting_GetLevel(&(me->nesting));
+
+   if(pItem->uLabelType != QCBOR_TYPE_NONE) {
+      nReturn = LabelCheck_AddLabel(me, pItem, uLevel, uStart, uLabelEnd);
+   }
+   if(nReturn == QCBOR_SUCCESS &&
+      pItem->uDataType == QCBOR_TYPE_MAP &&
+      pItem->val.uCount != 0) {
+      nReturn = LabelCheck_PushMap(me, (uint8_t)(uLevel + 1), pItem->val.uCount);
+   }
+   me->pExt->uLabelCheckPos = UsefulInputBuf_Tell(&(me->InBuf));
+
+   return nReturn;
+}
+
+
+/*
+ This layer deals with indefinite length strings. It pulls all the
+ individual chunk items together into one QCBORItem using the string
+ allocator.
+
+ The chunk heads are scanned first so the string is allocated once
+ with its full length and each chunk is copied only once. If the scan
+ finds a problem, the buffer is grown chunk by chunk until the loop
+ gets to the error.
+
+ Code Reviewers: THIS FUNCTION DOES A LITTLE POINTER MATH
+ */
+static inline QCBORError
+GetNext_FullItem(QCBORDecodeContext *me, QCBORItem *pDecodedItem)
+{
+   // Stack usage; int/ptr 2 UsefulBuf 2 QCBORItem  -- 96
+
+   // Get pointer to string allocator. First use is to pass it to
+   // GetNext_Item() when option is set to allocate for *every* string.
+   // Second use here is to allocate space to coallese indefinite
+   // length string items into one.
+   QCORInternalAllocator *pAllocator = me->StringAllocator.pfAllocator ?
+                                                &(me->StringAllocator) :
+                                                NULL;
+
+   const size_t uHeadStart = UsefulInputBuf_Tell(&(me->InBuf));
+
+   QCBORError nReturn;
+   nReturn = GetNext_Item(&(me->InBuf),
+                          pDecodedItem,
+                          me->bStringAllocateAll ? pAllocator: NULL);
+   if(nReturn) {
+      goto Done;
+   }
+
+   if(HasMapChecks(me) && !LabelCheck_IsPreferredHead(me, uHeadStart)) {
+      me->pExt->bNotDeterministic = 1;
+   }
+
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+   // With QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS GetNext_Item()
+   // errors out on indefinite-length strings so none of this is needed
 
    // Only do indefinite length processing on strings
    const uint8_t uStringType = pDecodedItem->uDataType;
@@ -846,9 +1630,26 @@ GetNext_FullItem(QCBORDecodeContext *me, QCBORItem *pDecodedItem)
       goto Done;
    }
 
-   // Loop getting chunk of indefinite string
+   // Allocate for the whole string up front when possible. The empty
+   // string with no chunks gets nothing allocated as before.
    UsefulBufC FullString = NULLUsefulBufC;
+   UsefulBuf  Mem        = NULLUsefulBuf;
+   size_t     uTotalLen  = 0;
+   size_t     uNumChunks = 0;
+   const int  nMajorType = uStringType == QCBOR_TYPE_BYTE_STRING ?
+                              CBOR_MAJOR_TYPE_BYTE_STRING :
+                              CBOR_MAJOR_TYPE_TEXT_STRING;
+   if(IndefiniteString_TotalLength(&(me->InBuf), nMajorType, &uTotalLen, &uNumChunks) &&
+      uNumChunks > 0) {
+      Mem = StringAllocator_Allocate(pAllocator, uTotalLen);
+      if(UsefulBuf_IsNULL(Mem)) {
+         nReturn = QCBOR_ERR_STRING_ALLOCATE;
+         goto Done;
+      }
+      FullString = (UsefulBufC){Mem.ptr, 0};
+   }
 
+   // Loop getting chunk of indefinite string
    for(;;) {
       // Get item for next chunk
       QCBORItem StringChunkItem;
@@ -876,33 +1677,137 @@ GetNext_FullItem(QCBORDecodeContext *me, QCBORItem *pDecodedItem)
          break;
       }
 
-      // Alloc new buffer or expand previously allocated buffer so it can fit
-      // The first time throurgh FullString.ptr is NULL and this is
-      // equivalent to StringAllocator_Allocate()
-      UsefulBuf NewMem = StringAllocator_Reallocate(pAllocator,
-                                                    UNCONST_POINTER(FullString.ptr),
-                                                    FullString.len + StringChunkItem.val.string.len);
-
-      if(UsefulBuf_IsNULL(NewMem)) {
-         // Allocation of memory for the string failed
-         nReturn = QCBOR_ERR_STRING_ALLOCATE;
-         break;
+      // Expand the buffer if it wasn't allocated for the whole string
+      // up front. The first time through FullString.ptr is NULL and
+      // this is equivalent to StringAllocator_Allocate()
+      if(UsefulBuf_IsNULL(Mem) || FullString.len + StringChunkItem.val.string.len > Mem.len) {
+         Mem = StringAllocator_Reallocate(pAllocator,
+                                          UNCONST_POINTER(FullString.ptr),
+                                          FullString.len + StringChunkItem.val.string.len);
+
+         if(UsefulBuf_IsNULL(Mem)) {
+            // Allocation of memory for the string failed
+            nReturn = QCBOR_ERR_STRING_ALLOCATE;
+            break;
+         }
       }
 
       // Copy new string chunk at the end of string so far.
-      FullString = UsefulBuf_CopyOffset(NewMem, FullString.len, StringChunkItem.val.string);
+      FullString = UsefulBuf_CopyOffset(Mem, FullString.len, StringChunkItem.val.string);
    }
 
    if(nReturn != QCBOR_SUCCESS && !UsefulBuf_IsNULLC(FullString)) {
       // Getting the item failed, clean up the allocated memory
       StringAllocator_Free(pAllocator, UNCONST_POINTER(FullString.ptr));
    }
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS */
 
 Done:
    return nReturn;
 }
 
 
+#ifndef QCBOR_DISABLE_TAGS
+/*
+ Records strings in a string reference namespace and resolves
+ references to them. bNamespace and bReference say whether the item
+ had the tags for them. Called for every item, labels included, when
+ there is a string reference table.
+ */
+static QCBORError
+StringRef_Process(QCBORDecodeContext *me,
+                  QCBORItem          *pDecodedItem,
+                  bool                bNamespace,
+                  bool                bReference)
+{
+   const uint8_t uLevel = DecodeNesting_GetLevel(&(me->nesting));
+
+   // The namespace is the item with the tag and everything in it
+   if(me->pExt->uStringRefLevel != QCBOR_NO_STRING_REF_NAMESPACE &&
+      uLevel <= me->pExt->uStringRefLevel) {
+      me->pExt->uStringRefLevel = QCBOR_NO_STRING_REF_NAMESPACE;
+   }
+
+   if(bNamespace) {
+      if(me->pExt->uStringRefLevel != QCBOR_NO_STRING_REF_NAMESPACE) {
+         return QCBOR_ERR_STRING_REF_NESTED;
+      }
+      me->pExt->uStringRefLevel = uLevel;
+      me->pExt->uNextStringRef  = 0;
+   }
+
+   if(me->pExt->uStringRefLevel == QCBOR_NO_STRING_REF_NAMESPACE) {
+      return bReference ? QCBOR_ERR_BAD_STRING_REF : QCBOR_SUCCESS;
+   }
+
+   if(bReference) {
+      // Unsigned integers larger than INT64_MAX are QCBOR_TYPE_UINT64
+      if(pDecodedItem->uDataType != QCBOR_TYPE_INT64 ||
+         pDecodedItem->val.int64 < 0 ||
+         (uint64_t)pDecodedItem->val.int64 >= me->pExt->uNextStringRef) {
+         return QCBOR_ERR_BAD_STRING_REF;
+      }
+      // Cast is safe because of the check against uNextStringRef
+      const uint32_t uIndex = (uint32_t)pDecodedItem->val.int64;
+      if(uIndex >= me->pExt->uStringRefsSize) {
+         return QCBOR_ERR_STRING_REF_TABLE_FULL;
+      }
+      pDecodedItem->uDataType       = me->pExt->pStringRefs[uIndex].uType;
+      pDecodedItem->val.string.ptr = me->pExt->pStringRefs[uIndex].pStr;
+      pDecodedItem->val.string.len = me->pExt->pStringRefs[uIndex].uLen;
+      return QCBOR_SUCCESS;
+   }
+
+   if((pDecodedItem->uDataType == QCBOR_TYPE_BYTE_STRING ||
+       pDecodedItem->uDataType == QCBOR_TYPE_TEXT_STRING) &&
+      pDecodedItem->val.string.len >= QCBOR_Private_StringRefMinLen(me->pExt->uNextStringRef) &&
+      me->pExt->uNextStringRef != UINT32_MAX) {
+      // Same numbering as StringRef_Number() in qcbor_encode.c
+      if(me->pExt->uNextStringRef < me->pExt->uStringRefsSize) {
+         me->pExt->pStringRefs[me->pExt->uNextStringRef].pStr  = pDecodedItem->val.string.ptr;
+         me->pExt->pStringRefs[me->pExt->uNextStringRef].uLen  = pDecodedItem->val.string.len;
+         me->pExt->pStringRefs[me->pExt->uNextStringRef].uType = pDecodedItem->uDataType;
+      }
+      me->pExt->uNextStringRef++;
+   }
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Turn a byte string into a typed array. uTag is the tag just before
+ it, one of the RFC 8746 typed array tags. The elements stay where
+ they are in the input.
+ */
+static QCBORError DecodeTypedArray(QCBORItem *pDecodedItem, uint64_t uTag)
+{
+   // Cast is safe because uTag is a typed array tag
+   const uint8_t uTagBits     = (uint8_t)(uTag - CBOR_TAG_TYPED_ARRAY_FIRST);
+   const uint8_t uElementType = uTagBits & (uint8_t)~QCBOR_TYPED_ARRAY_LITTLE_ENDIAN_BIT;
+   const size_t  uElementSize = QCBOR_Private_TypedArrayElementSize(uElementType);
+
+   if(uElementSize == 0 ||
+      (uElementType == QCBOR_TYPED_ARRAY_SINT8 && (uTagBits & QCBOR_TYPED_ARRAY_LITTLE_ENDIAN_BIT))) {
+      // A reserved tag. Leave it as a byte string.
+      return QCBOR_SUCCESS;
+   }
+   if(pDecodedItem->val.string.len % uElementSize) {
+      return QCBOR_ERR_BAD_TYPED_ARRAY;
+   }
+
+   const UsefulBufC Elements = pDecodedItem->val.string;
+   pDecodedItem->val.typedArray.Elements      = Elements;
+   pDecodedItem->val.typedArray.uElementType  = uElementType;
+   // The bit is for clamped arithmetic for uint8_t
+   pDecodedItem->val.typedArray.bLittleEndian = uElementSize > 1 &&
+                                                (uTagBits & QCBOR_TYPED_ARRAY_LITTLE_ENDIAN_BIT);
+   pDecodedItem->uDataType = QCBOR_TYPE_TYPED_ARRAY;
+
+   return QCBOR_SUCCESS;
+}
+
+
 /*
  Gets all optional tag data items preceding a data item that is not an
  optional tag and records them as bits in the tag map.
@@ -912,9 +1817,13 @@ GetNext_TaggedItem(QCBORDecodeContext *me,
                    QCBORItem *pDecodedItem,
                    QCBORTagListOut *pTags)
 {
-   // Stack usage: int/ptr: 3 -- 24
+   // Stack usage: int/ptr: 4 -- 32
    QCBORError nReturn;
    uint64_t  uTagBits = 0;
+   uint16_t  uExtTagBits = 0;
+   uint64_t  uLastTag = CBOR_TAG_NONE; // The one on the data item
+   bool      bStringRefNamespace = false;
+   bool      bStringRef = false;
    if(pTags) {
       pTags->uNumUsed = 0;
    }
@@ -928,21 +1837,62 @@ GetNext_TaggedItem(QCBORDecodeContext *me,
 
       if(pDecodedItem->uDataType != QCBOR_TYPE_OPTTAG) {
          // Successful exit from loop; maybe got some tags, maybe not
-         pDecodedItem->uTagBits = uTagBits;
+         pDecodedItem->uTagBits    = uTagBits;
+         pDecodedItem->uExtTagBits = uExtTagBits;
+         if(HasStringRefs(me)) {
+            nReturn = StringRef_Process(me, pDecodedItem, bStringRefNamespace, bStringRef);
+            if(nReturn) {
+               break;
+            }
+         }
+         if(uLastTag >= CBOR_TAG_TYPED_ARRAY_FIRST &&
+            uLastTag <= CBOR_TAG_TYPED_ARRAY_LAST &&
+            pDecodedItem->uDataType == QCBOR_TYPE_BYTE_STRING) {
+            nReturn = DecodeTypedArray(pDecodedItem, uLastTag);
+         }
          break;
       }
 
+      if(HasStringRefs(me)) {
+         if(bStringRef) {
+            // A string reference must be right on the integer
+            nReturn = QCBOR_ERR_BAD_STRING_REF;
+            goto Done;
+         }
+         // These are consumed here and not returned as tags
+         if(pDecodedItem->val.uTagV == CBOR_TAG_STRING_REF_NAMESPACE) {
+            bStringRefNamespace = true;
+            continue;
+         }
+         if(pDecodedItem->val.uTagV == CBOR_TAG_STRING_REF) {
+            bStringRef = true;
+            continue;
+         }
+      }
+      uLastTag = pDecodedItem->val.uTagV;
+
       uint8_t uTagBitIndex;
       // Tag was mapped, tag was not mapped, error with tag list
-      switch(TagMapper_Lookup(me->pCallerConfiguredTagList, pDecodedItem->val.uTagV, &uTagBitIndex)) {
+      nReturn = TagMapper_Lookup(me, pDecodedItem->val.uTagV, &uTagBitIndex);
+      switch(nReturn) {
 
          case QCBOR_SUCCESS:
             // Successfully mapped the tag
-            uTagBits |= 0x01ULL << uTagBitIndex;
+            if(uTagBitIndex < TAG_MAPPER_EXT_TAGS_BASE_INDEX) {
+               uTagBits |= 0x01ULL << uTagBitIndex;
+            } else {
+               uExtTagBits |= (uint16_t)(0x01U << (uTagBitIndex - TAG_MAPPER_EXT_TAGS_BASE_INDEX));
+            }
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+            me->uTagsMapped++;
+#endif
             break;
 
          case QCBOR_ERR_BAD_OPT_TAG:
             // Tag is not recognized. Do nothing
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+            me->uTagsNotMapped++;
+#endif
             break;
 
          default:
@@ -964,6 +1914,39 @@ GetNext_TaggedItem(QCBORDecodeContext *me,
 Done:
    return nReturn;
 }
+#else /* QCBOR_DISABLE_TAGS */
+/*
+ Tags are skipped without being recorded or mapped. uTagBits is only
+ set to say there was a tag so QCBORDecode_GetNextWithTags() can
+ return QCBOR_ERR_TAGS_DISABLED after the nesting is tracked the same
+ as for any other item. That way decoding can continue after the
+ error.
+ */
+static QCBORError
+GetNext_TaggedItem(QCBORDecodeContext *me,
+                   QCBORItem *pDecodedItem,
+                   QCBORTagListOut *pTags)
+{
+   QCBORError nReturn;
+   uint64_t   uTagged = 0;
+
+   if(pTags) {
+      pTags->uNumUsed = 0;
+   }
+
+   for(;;) {
+      nReturn = GetNext_FullItem(me, pDecodedItem);
+      if(nReturn || pDecodedItem->uDataType != QCBOR_TYPE_OPTTAG) {
+         break;
+      }
+      uTagged = 1;
+   }
+
+   pDecodedItem->uTagBits = uTagged;
+
+   return nReturn;
+}
+#endif /* QCBOR_DISABLE_TAGS */
 
 
 /*
@@ -975,7 +1958,10 @@ GetNext_MapEntry(QCBORDecodeContext *me,
                  QCBORItem *pDecodedItem,
                  QCBORTagListOut *pTags)
 {
-   // Stack use: int/ptr 1, QCBORItem  -- 56
+   // Stack use: int/ptr 3, QCBORItem  -- 72
+   const size_t uStart    = UsefulInputBuf_Tell(&(me->InBuf));
+   size_t       uLabelEnd = 0;
+
    QCBORError nReturn = GetNext_TaggedItem(me, pDecodedItem, pTags);
    if(nReturn)
       goto Done;
@@ -994,12 +1980,33 @@ GetNext_MapEntry(QCBORDecodeContext *me,
          // Save label in pDecodedItem and get the next which will
          // be the real data
          QCBORItem LabelItem = *pDecodedItem;
+         uLabelEnd = UsefulInputBuf_Tell(&(me->InBuf));
          nReturn = GetNext_TaggedItem(me, pDecodedItem, pTags);
-         if(nReturn)
+         if(nReturn) {
+            if(LabelItem.uDataAlloc) {
+               // Don't leak the label, particularly when the item is
+               // tried again after QCBOR_ERR_NEED_MORE_DATA
+               StringAllocator_Free(&(me->StringAllocator),
+                                    UNCONST_POINTER(LabelItem.val.string.ptr));
+            }
             goto Done;
+         }
 
          pDecodedItem->uLabelAlloc = LabelItem.uDataAlloc;
 
+#ifdef QCBOR_DISABLE_NON_INTEGER_LABELS
+         if(LabelItem.uDataType == QCBOR_TYPE_INT64) {
+            pDecodedItem->label.int64 = LabelItem.val.int64;
+            pDecodedItem->uLabelType = QCBOR_TYPE_INT64;
+         } else if(LabelItem.uDataType == QCBOR_TYPE_UINT64) {
+            pDecodedItem->label.uint64 = LabelItem.val.uint64;
+            pDecodedItem->uLabelType = QCBOR_TYPE_UINT64;
+         } else {
+            // Only integer labels in this configuration
+            nReturn = QCBOR_ERR_MAP_LABEL_TYPE;
+            goto Done;
+         }
+#else
          if(LabelItem.uDataType == QCBOR_TYPE_TEXT_STRING) {
             // strings are always good labels
             pDecodedItem->label.string = LabelItem.val.string;
@@ -1025,6 +2032,7 @@ GetNext_MapEntry(QCBORDecodeContext *me,
             nReturn = QCBOR_ERR_MAP_LABEL_TYPE;
             goto Done;
          }
+#endif /* QCBOR_DISABLE_NON_INTEGER_LABELS */
       }
    } else {
       if(pDecodedItem->uDataType == QCBOR_TYPE_MAP) {
@@ -1036,21 +2044,85 @@ GetNext_MapEntry(QCBORDecodeContext *me,
          pDecodedItem->uDataType = QCBOR_TYPE_MAP_AS_ARRAY;
          // Cast is safe because of check against QCBOR_MAX_ITEMS_IN_ARRAY/2
          // Cast is needed because of integer promotion
-         pDecodedItem->val.uCount = (uint16_t)(pDecodedItem->val.uCount * 2);
+         pDecodedItem->val.uCount = (QCBORCount)(pDecodedItem->val.uCount * 2);
       }
    }
 
+   // Input that is decoded again, for example after a rewind, was
+   // already checked
+   if(HasMapChecks(me) && uStart >= me->pExt->uLabelCheckPos) {
+      nReturn = LabelCheck_Item(me, pDecodedItem, uStart, uLabelEnd);
+   }
+
 Done:
    return nReturn;
 }
 
 
 /*
- Public function, see header qcbor/qcbor_decode.h file
+ Free the strings for an item the caller never sees. The data is
+ allocated after the label so it is freed first, which is what the
+ MemPool needs to get all the space back.
  */
-QCBORError QCBORDecode_GetNextMapOrArray(QCBORDecodeContext *me,
-                                         QCBORItem *pDecodedItem,
-                                         QCBORTagListOut *pTags)
+static void
+FreeItemStrings(QCBORDecodeContext *me, const QCBORItem *pItem)
+{
+   if(pItem->uDataAlloc) {
+      StringAllocator_Free(&(me->StringAllocator),
+                           UNCONST_POINTER(pItem->val.string.ptr));
+   }
+   if(pItem->uLabelAlloc) {
+      StringAllocator_Free(&(me->StringAllocator),
+                           UNCONST_POINTER(pItem->label.string.ptr));
+   }
+}
+
+
+/*
+ For indefinite length maps/arrays, looking at any and all breaks
+ that might terminate them. The equivalent for definite length
+ maps/arrays happens in DecodeNesting_DecrementCount(). This is done
+ after every item so the next call to get an item never starts on a
+ break.
+ */
+static QCBORError ConsumeTrailingBreaks(QCBORDecodeContext *me)
+{
+   QCBORError nReturn = QCBOR_SUCCESS;
+
+   if(DecodeNesting_IsNested(&(me->nesting)) && DecodeNesting_IsIndefiniteLength(&(me->nesting))) {
+      while(UsefulInputBuf_BytesUnconsumed(&(me->InBuf))) {
+         // Peek forward one item to see if it is a break.
+         QCBORItem Peek;
+         size_t uPeek = UsefulInputBuf_Tell(&(me->InBuf));
+         nReturn = GetNext_Item(&(me->InBuf), &Peek, NULL);
+         if(nReturn) {
+            break;
+         }
+         if(Peek.uDataType != QCBOR_TYPE_BREAK) {
+            // It is not a break, rewind so it can be processed normally.
+            UsefulInputBuf_Seek(&(me->InBuf), uPeek);
+            break;
+         }
+         // It is a break. Ascend one nesting level.
+         // The break is consumed.
+         nReturn = DecodeNesting_BreakAscend(&(me->nesting));
+         if(nReturn) {
+            // break occured outside of an indefinite length array/map
+            break;
+         }
+      }
+   }
+
+   return nReturn;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_GetNextMapOrArray(QCBORDecodeContext *me,
+                                         QCBORItem *pDecodedItem,
+                                         QCBORTagListOut *pTags)
 {
    // Stack ptr/int: 2, QCBORItem : 64
 
@@ -1060,7 +2132,9 @@ QCBORError QCBORDecode_GetNextMapOrArray(QCBORDecodeContext *me,
 
    // Check if there are an
    if(UsefulInputBuf_BytesUnconsumed(&(me->InBuf)) == 0 && !DecodeNesting_IsNested(&(me->nesting))) {
-      nReturn = QCBOR_ERR_NO_MORE_ITEMS;
+      // When decoding incrementally another item in a CBOR sequence
+      // might still be received
+      nReturn = me->bIncremental ? QCBOR_ERR_HIT_END : QCBOR_ERR_NO_MORE_ITEMS;
       goto Done;
    }
 
@@ -1103,32 +2177,25 @@ QCBORError QCBORDecode_GetNextMapOrArray(QCBORDecodeContext *me,
       goto Done;
    }
 
-   // For indefinite length maps/arrays, looking at any and
-   // all breaks that might terminate them. The equivalent
-   // for definite length maps/arrays happens in
-   // DecodeNesting_DecrementCount().
-   if(DecodeNesting_IsNested(&(me->nesting)) && DecodeNesting_IsIndefiniteLength(&(me->nesting))) {
-      while(UsefulInputBuf_BytesUnconsumed(&(me->InBuf))) {
-         // Peek forward one item to see if it is a break.
-         QCBORItem Peek;
-         size_t uPeek = UsefulInputBuf_Tell(&(me->InBuf));
-         nReturn = GetNext_Item(&(me->InBuf), &Peek, NULL);
-         if(nReturn) {
-            goto Done;
-         }
-         if(Peek.uDataType != QCBOR_TYPE_BREAK) {
-            // It is not a break, rewind so it can be processed normally.
-            UsefulInputBuf_Seek(&(me->InBuf), uPeek);
-            break;
-         }
-         // It is a break. Ascend one nesting level.
-         // The break is consumed.
-         nReturn = DecodeNesting_BreakAscend(&(me->nesting));
-         if(nReturn) {
-            // break occured outside of an indefinite length array/map
-            goto Done;
-         }
-      }
+   nReturn = ConsumeTrailingBreaks(me);
+
+   // When decoding incrementally and the input received ends inside an
+   // indefinite length map/array, it isn't known yet whether a break
+   // comes next so this item isn't complete.
+   if(nReturn == QCBOR_SUCCESS &&
+      me->bIncremental &&
+      DecodeNesting_IsNested(&(me->nesting)) &&
+      DecodeNesting_IsIndefiniteLength(&(me->nesting)) &&
+      UsefulInputBuf_BytesUnconsumed(&(me->InBuf)) == 0) {
+      nReturn = QCBOR_ERR_HIT_END;
+   }
+
+   if(nReturn) {
+      // The item was decoded but isn't returned. Don't leak its
+      // strings, particularly when it is tried again after
+      // QCBOR_ERR_NEED_MORE_DATA.
+      FreeItemStrings(me, pDecodedItem);
+      goto Done;
    }
 
    // Tell the caller what level is next. This tells them what maps/arrays
@@ -1145,6 +2212,7 @@ Done:
 }
 
 
+#ifndef QCBOR_DISABLE_TAGS
 /*
  Mostly just assign the right data type for the date string.
  */
@@ -1362,6 +2430,7 @@ Done:
   return nReturn;
 }
 #endif /* QCBOR_CONFIG_DISABLE_EXP_AND_MANTISSA */
+#endif /* QCBOR_DISABLE_TAGS */
 
 
 /*
@@ -1374,11 +2443,26 @@ QCBORDecode_GetNextWithTags(QCBORDecodeContext *me,
 {
    QCBORError nReturn;
 
+   // For going back to where this started if the item isn't all
+   // received yet when decoding incrementally
+   const size_t       uStartPosition = UsefulInputBuf_Tell(&(me->InBuf));
+   QCBORDecodeNesting SavedNesting;
+   uint32_t           uSavedNextStringRef  = 0;
+   uint8_t            uSavedStringRefLevel = 0;
+   if(me->bIncremental) {
+      SavedNesting = me->nesting;
+      if(me->pExt != NULL) {
+         uSavedNextStringRef  = me->pExt->uNextStringRef;
+         uSavedStringRefLevel = me->pExt->uStringRefLevel;
+      }
+   }
+
    nReturn = QCBORDecode_GetNextMapOrArray(me, pDecodedItem, pTags);
    if(nReturn != QCBOR_SUCCESS) {
       goto Done;
    }
 
+#ifndef QCBOR_DISABLE_TAGS
 #ifndef QCBOR_CONFIG_DISABLE_EXP_AND_MANTISSA
 #define TAG_MAPPER_FIRST_XXX TAG_MAPPER_FIRST_SIX
 #else
@@ -1422,12 +2506,46 @@ QCBORDecode_GetNextWithTags(QCBORDecodeContext *me,
          // is tagged as both a string and integer date.
          nReturn = QCBOR_ERR_BAD_OPT_TAG;
    }
+#else
+   if(pDecodedItem->uTagBits) {
+      nReturn = QCBOR_ERR_TAGS_DISABLED;
+   }
+#endif /* QCBOR_DISABLE_TAGS */
 
 Done:
+   if(nReturn == QCBOR_ERR_HIT_END && me->bIncremental) {
+      // Back out of the data item so it can be decoded again after
+      // more input is added. The strings allocated for it were
+      // freed where the error was found.
+      UsefulInputBuf_Rewind(&(me->InBuf), uStartPosition);
+      me->nesting = SavedNesting;
+      if(me->pExt != NULL) {
+         me->pExt->uNextStringRef  = uSavedNextStringRef;
+         me->pExt->uStringRefLevel = uSavedStringRefLevel;
+      }
+      nReturn = QCBOR_ERR_NEED_MORE_DATA;
+   }
+
    if(nReturn != QCBOR_SUCCESS) {
       pDecodedItem->uDataType  = QCBOR_TYPE_NONE;
       pDecodedItem->uLabelType = QCBOR_TYPE_NONE;
    }
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+   else {
+      me->uItemsDecoded++;
+      const uint8_t uNesting = (uint8_t)(pDecodedItem->uNestingLevel +
+                                         (IsMapOrArray(pDecodedItem->uDataType) ||
+                                          pDecodedItem->uDataType == QCBOR_TYPE_MAP_AS_ARRAY));
+      if(uNesting > me->uMaxNesting) {
+         me->uMaxNesting = uNesting;
+      }
+   }
+#endif
+
+   if(HasDigest(me)) {
+      DigestConsumed(me, false);
+   }
+
    return nReturn;
 }
 
@@ -1441,6 +2559,170 @@ QCBORError QCBORDecode_GetNext(QCBORDecodeContext *me, QCBORItem *pDecodedItem)
 }
 
 
+/*
+ The item types that QCBORDecode_GetNextBatch() can finish without the
+ layers above GetNext_Item(). Those layers do nothing more for these
+ than set the nesting levels.
+ */
+static inline bool IsBatchScalar(const QCBORItem *pItem)
+{
+   switch(pItem->uDataType) {
+      case QCBOR_TYPE_BYTE_STRING:
+      case QCBOR_TYPE_TEXT_STRING:
+         // Indefinite-length strings have to be put together by
+         // GetNext_FullItem()
+         return pItem->val.string.len != SIZE_MAX;
+
+      case QCBOR_TYPE_INT64:
+      case QCBOR_TYPE_UINT64:
+      case QCBOR_TYPE_FALSE:
+      case QCBOR_TYPE_TRUE:
+      case QCBOR_TYPE_NULL:
+      case QCBOR_TYPE_UNDEF:
+      case QCBOR_TYPE_UKNOWN_SIMPLE:
+      case QCBOR_TYPE_FLOAT:
+      case QCBOR_TYPE_DOUBLE:
+         return true;
+
+      default:
+         // Tags, breaks, maps and arrays
+         return false;
+   }
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_GetNextBatch(QCBORDecodeContext *me,
+                                    QCBORItem          *pItems,
+                                    size_t              uMaxItems,
+                                    size_t             *puNumDecoded)
+{
+   QCBORError nReturn = QCBOR_SUCCESS;
+   size_t     uNum;
+
+   // Same as in GetNext_FullItem()
+   QCORInternalAllocator *pAllocator = me->bStringAllocateAll &&
+                                       me->StringAllocator.pfAllocator ?
+                                          &(me->StringAllocator) :
+                                          NULL;
+
+   for(uNum = 0; uNum < uMaxItems; uNum++) {
+      QCBORItem *pItem = &pItems[uNum];
+
+      // The fast path is for items in a definite-length array that
+      // don't close it. Closing it may involve looking for breaks
+      // that close enclosing indefinite-length arrays and maps, so
+      // the last item goes the normal way. Definite-length array
+      // levels always have a count of at least one.
+      if(!me->bIncremental &&
+         !HasStringRefs(me) &&
+         !HasMapChecks(me) &&
+         DecodeNesting_IsNested(&(me->nesting)) &&
+         me->nesting.pCurrent->uMajorType == QCBOR_TYPE_ARRAY &&
+         !DecodeNesting_IsIndefiniteLength(&(me->nesting)) &&
+         me->nesting.pCurrent->uCount > 1) {
+
+         const size_t uStart = UsefulInputBuf_Tell(&(me->InBuf));
+
+         pItem->uDataAlloc = 0;
+         if(GetNext_ItemUncleared(&(me->InBuf), pItem, pAllocator) == QCBOR_SUCCESS &&
+            IsBatchScalar(pItem)) {
+            pItem->uLabelType     = QCBOR_TYPE_NONE;
+            pItem->uLabelAlloc    = 0;
+            pItem->uTagBits       = 0;
+            pItem->uExtTagBits    = 0;
+            pItem->uNestingLevel  = DecodeNesting_GetLevel(&(me->nesting));
+            pItem->uNextNestLevel = pItem->uNestingLevel;
+            // Never goes to zero because of the check above
+            me->nesting.pCurrent->uCount--;
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+            me->uItemsDecoded++;
+#endif
+            continue;
+         }
+
+         // An error or something that needs the full decode. Nothing
+         // was allocated either way, so just back up and do it again
+         // the normal way. This also gets the error reported the same.
+         UsefulInputBuf_Rewind(&(me->InBuf), uStart);
+      }
+
+      nReturn = QCBORDecode_GetNext(me, pItem);
+      if(nReturn != QCBOR_SUCCESS) {
+         break;
+      }
+
+      if(IsMapOrArray(pItem->uDataType) ||
+         pItem->uDataType == QCBOR_TYPE_MAP_AS_ARRAY ||
+         pItem->uNextNestLevel != pItem->uNestingLevel) {
+         // At a nesting boundary
+         uNum++;
+         break;
+      }
+   }
+
+   *puNumDecoded = uNum;
+
+   if(HasDigest(me)) {
+      DigestConsumed(me, false);
+   }
+
+   return nReturn;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+
+ Code Reviewers: THIS FUNCTION DOES POINTER MATH
+ */
+QCBORError QCBORDecode_CopyTypedArray(const QCBORItem *pItem,
+                                      UsefulBuf        Dest,
+                                      size_t          *puNumElements)
+{
+   if(pItem->uDataType != QCBOR_TYPE_TYPED_ARRAY) {
+      return QCBOR_ERR_BAD_TYPED_ARRAY;
+   }
+
+   const UsefulBufC Elements     = pItem->val.typedArray.Elements;
+   const size_t     uElementSize = QCBOR_Private_TypedArrayElementSize(pItem->val.typedArray.uElementType);
+
+   if(Elements.len > Dest.len) {
+      return QCBOR_ERR_BUFFER_TOO_SMALL;
+   }
+
+   if(uElementSize == 1 ||
+      pItem->val.typedArray.bLittleEndian == !QCBOR_Private_IsBigEndianHost()) {
+      // Already in the byte order of the CPU
+      memcpy(Dest.ptr, Elements.ptr, Elements.len);
+   } else {
+      uint8_t       *pDest = (uint8_t *)Dest.ptr;
+      const uint8_t *pSrc  = (const uint8_t *)Elements.ptr;
+      // A constant size for each lets the compiler unroll the swap
+      switch(uElementSize) {
+         case 2:
+            QCBOR_Private_ReverseElements(pDest, pSrc, Elements.len, 2);
+            break;
+         case 4:
+            QCBOR_Private_ReverseElements(pDest, pSrc, Elements.len, 4);
+            break;
+         case 8:
+            QCBOR_Private_ReverseElements(pDest, pSrc, Elements.len, 8);
+            break;
+         default:
+            QCBOR_Private_ReverseElements(pDest, pSrc, Elements.len, 16);
+            break;
+      }
+   }
+
+   *puNumElements = Elements.len / uElementSize;
+
+   return QCBOR_SUCCESS;
+}
+
+
 /*
  Decoding items is done in 5 layered functions, one calling the
  next one down. If a layer has no work to do for a particular item
@@ -1491,154 +2773,1907 @@ int QCBORDecode_IsTagged(QCBORDecodeContext *me,
                          const QCBORItem *pItem,
                          uint64_t uTag)
 {
-   const QCBORTagListIn *pCallerConfiguredTagMap = me->pCallerConfiguredTagList;
-
    uint8_t uTagBitIndex;
    // Do not care about errors in pCallerConfiguredTagMap here. They are
    // caught during GetNext() before this is called.
-   if(TagMapper_Lookup(pCallerConfiguredTagMap, uTag, &uTagBitIndex)) {
+   if(TagMapper_Lookup(me, uTag, &uTagBitIndex)) {
       return 0;
    }
 
+   if(uTagBitIndex >= TAG_MAPPER_EXT_TAGS_BASE_INDEX) {
+      const uint16_t uExtTagBit = (uint16_t)(0x01U << (uTagBitIndex - TAG_MAPPER_EXT_TAGS_BASE_INDEX));
+      return (uExtTagBit & pItem->uExtTagBits) != 0;
+   }
+
    const uint64_t uTagBit = 0x01ULL << uTagBitIndex;
    return (uTagBit & pItem->uTagBits) != 0;
 }
 
 
+
+/*===========================================================================
+ MAP INDEX
+
+ QCBORDecode_IndexMap() scans a map once with QCBORDecode_GetNext()
+ recording the offset and position of each entry. The entries are
+ then heap sorted by label type and label so lookups are a binary
+ search. Heap sort is used because it needs no extra memory or
+ recursion and doesn't bring in qsort() from the standard library.
+ ===========================================================================*/
+
+static inline int
+MapIndex_Compare(const QCBORMapIndexEntry *pEntry, uint8_t uLabelType, int64_t nLabel)
+{
+   if(pEntry->uLabelType != uLabelType) {
+      return pEntry->uLabelType < uLabelType ? -1 : 1;
+   }
+   if(pEntry->nLabel != nLabel) {
+      return pEntry->nLabel < nLabel ? -1 : 1;
+   }
+   return 0;
+}
+
+
+static void
+MapIndex_SiftDown(QCBORMapIndexEntry *pEntries, size_t uRoot, size_t uEnd)
+{
+   for(;;) {
+      size_t uChild = 2 * uRoot + 1;
+      if(uChild >= uEnd) {
+         break;
+      }
+      if(uChild + 1 < uEnd &&
+         MapIndex_Compare(&pEntries[uChild],
+                          pEntries[uChild+1].uLabelType,
+                          pEntries[uChild+1].nLabel) < 0) {
+         uChild++;
+      }
+      if(MapIndex_Compare(&pEntries[uRoot],
+                          pEntries[uChild].uLabelType,
+                          pEntries[uChild].nLabel) >= 0) {
+         break;
+      }
+      const QCBORMapIndexEntry Tmp = pEntries[uRoot];
+      pEntries[uRoot]  = pEntries[uChild];
+      pEntries[uChild] = Tmp;
+      uRoot = uChild;
+   }
+}
+
+
+static void
+MapIndex_Sort(QCBORMapIndexEntry *pEntries, size_t uNumEntries)
+{
+   for(size_t i = uNumEntries / 2; i > 0; i--) {
+      MapIndex_SiftDown(pEntries, i - 1, uNumEntries);
+   }
+   for(size_t uEnd = uNumEntries; uEnd > 1; uEnd--) {
+      const QCBORMapIndexEntry Tmp = pEntries[0];
+      pEntries[0]      = pEntries[uEnd-1];
+      pEntries[uEnd-1] = Tmp;
+      MapIndex_SiftDown(pEntries, 0, uEnd - 1);
+   }
+}
+
+
 /*
  Public function, see header qcbor/qcbor_decode.h file
  */
-QCBORError QCBORDecode_Finish(QCBORDecodeContext *me)
+QCBORError QCBORDecode_IndexMap(QCBORDecodeContext *me,
+                                const QCBORItem    *pMapItem,
+                                QCBORMapIndex      *pIndex,
+                                QCBORMapIndexEntry *pEntries,
+                                size_t              uNumEntries)
 {
    QCBORError nReturn = QCBOR_SUCCESS;
+   QCBORItem  Item;
+   size_t     uCount = 0;
 
-   // Error out if all the maps/arrays are not closed out
-   if(DecodeNesting_IsNested(&(me->nesting))) {
-      nReturn = QCBOR_ERR_ARRAY_OR_MAP_STILL_OPEN;
+   pIndex->pEntries    = pEntries;
+   pIndex->uNumEntries = 0;
+
+   if(pMapItem->uDataType != QCBOR_TYPE_MAP) {
+      nReturn = QCBOR_ERR_MAP_NOT_ENTERED;
       goto Done;
    }
 
-   // Error out if not all the bytes are consumed
-   if(UsefulInputBuf_BytesUnconsumed(&(me->InBuf))) {
-      nReturn = QCBOR_ERR_EXTRA_BYTES;
+   if(pMapItem->uNextNestLevel <= pMapItem->uNestingLevel) {
+      // An empty map. The decoder didn't descend into it so it is
+      // already after the end of it.
+      pIndex->MapNesting = me->nesting;
+      goto SaveEnd;
    }
 
-Done:
-   // Call the destructor for the string allocator if there is one.
-   // Always called, even if there are errors; always have to clean up
-   StringAllocator_Destruct(&(me->StringAllocator));
-
-   return nReturn;
-}
+   // Check this is right after the map was returned. For definite
+   // length maps the count of entries can be checked too.
+   const uint8_t uMapLevel = pMapItem->uNextNestLevel;
+   if(!DecodeNesting_TypeIsMap(&(me->nesting)) ||
+      DecodeNesting_GetLevel(&(me->nesting)) != uMapLevel ||
+      (!DecodeNesting_IsIndefiniteLength(&(me->nesting)) &&
+       me->nesting.pCurrent->uCount != pMapItem->val.uCount)) {
+      nReturn = QCBOR_ERR_MAP_NOT_ENTERED;
+      goto Done;
+   }
 
+   pIndex->MapNesting = me->nesting;
 
+   for(;;) {
+      const size_t uOffset = UsefulInputBuf_Tell(&(me->InBuf));
 
-/*
+      nReturn = QCBORDecode_GetNext(me, &Item);
+      if(nReturn != QCBOR_SUCCESS) {
+         goto Done;
+      }
 
-Decoder errors handled in this file
+      if(uCount >= uNumEntries) {
+         FreeItemStrings(me, &Item);
+         nReturn = QCBOR_ERR_INDEX_TOO_SMALL;
+         goto Done;
+      }
 
- - Hit end of input before it was expected while decoding type and
-   number QCBOR_ERR_HIT_END
+      QCBORMapIndexEntry *pEntry = &pEntries[uCount];
+      pEntry->uOffset    = uOffset;
+      // Cast is safe because maps can't have more than
+      // QCBOR_MAX_ITEMS_IN_ARRAY items
+      pEntry->uOrdinal   = (QCBORCount)uCount;
+      pEntry->uLabelType = Item.uLabelType;
+      switch(Item.uLabelType) {
+         case QCBOR_TYPE_INT64:
+            pEntry->nLabel = Item.label.int64;
+            break;
 
- - negative integer that is too large for C QCBOR_ERR_INT_OVERFLOW
+         case QCBOR_TYPE_UINT64:
+            // Only ever compared to other QCBOR_TYPE_UINT64 labels
+            pEntry->nLabel = (int64_t)Item.label.uint64;
+            break;
 
- - Hit end of input while decoding a text or byte string
-   QCBOR_ERR_HIT_END
+         default:
+            // Text and byte strings
+            pEntry->nLabel = MapIndex_HashString(Item.label.string);
+            break;
+      }
+      uCount++;
+      FreeItemStrings(me, &Item);
 
- - Encountered conflicting tags -- e.g., an item is tagged both a date
-   string and an epoch date QCBOR_ERR_UNSUPPORTED
+      // Skip over the contents of any map or array that is the value
+      while(Item.uNextNestLevel > uMapLevel) {
+         nReturn = QCBORDecode_GetNext(me, &Item);
+         if(nReturn != QCBOR_SUCCESS) {
+            goto Done;
+         }
+         FreeItemStrings(me, &Item);
+      }
 
- - Encontered an array or mapp that has too many items
-   QCBOR_ERR_ARRAY_TOO_LONG
+      if(Item.uNextNestLevel < uMapLevel) {
+         // The end of the map
+         break;
+      }
+   }
 
- - Encountered array/map nesting that is too deep
-   QCBOR_ERR_ARRAY_NESTING_TOO_DEEP
+   // Cast is safe because maps can't have more than
+   // QCBOR_MAX_ITEMS_IN_ARRAY items
+   pIndex->uNumEntries = (QCBORCount)uCount;
+   MapIndex_Sort(pEntries, uCount);
 
- - An epoch date > INT64_MAX or < INT64_MIN was encountered
-   QCBOR_ERR_DATE_OVERFLOW
+SaveEnd:
+   pIndex->EndNesting = me->nesting;
+   pIndex->uEndOffset = UsefulInputBuf_Tell(&(me->InBuf));
 
- - The type of a map label is not a string or int
-   QCBOR_ERR_MAP_LABEL_TYPE
+Done:
+   return nReturn;
+}
 
- - Hit end with arrays or maps still open -- QCBOR_ERR_EXTRA_BYTES
 
+/*
+ Find the entries whose key matches with binary search and decode
+ them until one has the label. More than one is tried only if
+ String's hash collides with another label's hash.
  */
+static QCBORError
+MapIndex_GetItem(QCBORDecodeContext  *me,
+                 const QCBORMapIndex *pIndex,
+                 uint8_t              uLabelType,
+                 int64_t              nKey,
+                 UsefulBufC           String,
+                 QCBORItem           *pItem)
+{
+   const QCBORMapIndexEntry *pEntries = pIndex->pEntries;
+
+   // Find the first entry that is not less than the key
+   size_t uLow  = 0;
+   size_t uHigh = pIndex->uNumEntries;
+   while(uLow < uHigh) {
+      const size_t uMid = uLow + (uHigh - uLow) / 2;
+      if(MapIndex_Compare(&pEntries[uMid], uLabelType, nKey) < 0) {
+         uLow = uMid + 1;
+      } else {
+         uHigh = uMid;
+      }
+   }
 
+   for(size_t i = uLow;
+       i < pIndex->uNumEntries && MapIndex_Compare(&pEntries[i], uLabelType, nKey) == 0;
+       i++) {
+      // Put the decoder at the entry with the map's count adjusted
+      // for the entries before it so the end of the map is still
+      // found correctly if decoding continues from here.
+      me->nesting = pIndex->MapNesting;
+      if(!DecodeNesting_IsIndefiniteLength(&(me->nesting))) {
+         me->nesting.pCurrent->uCount = (QCBORCount)(pIndex->uNumEntries - pEntries[i].uOrdinal);
+      }
+      UsefulInputBuf_Rewind(&(me->InBuf), pEntries[i].uOffset);
 
+      QCBORError nReturn = QCBORDecode_GetNext(me, pItem);
+      if(nReturn != QCBOR_SUCCESS) {
+         return nReturn;
+      }
 
+      if(uLabelType == QCBOR_TYPE_TEXT_STRING &&
+         UsefulBuf_Compare(pItem->label.string, String)) {
+         // Hash collision
+         FreeItemStrings(me, pItem);
+         continue;
+      }
 
-/* ===========================================================================
-   MemPool -- BUILT-IN SIMPLE STRING ALLOCATOR
+      return QCBOR_SUCCESS;
+   }
 
-   This implements a simple sting allocator for indefinite length
-   strings that can be enabled by calling QCBORDecode_SetMemPool(). It
-   implements the function type QCBORStringAllocate and allows easy
-   use of it.
+   pItem->uDataType  = QCBOR_TYPE_NONE;
+   pItem->uLabelType = QCBOR_TYPE_NONE;
 
-   This particular allocator is built-in for convenience. The caller
-   can implement their own.  All of this following code will get
-   dead-stripped if QCBORDecode_SetMemPool() is not called.
+   return QCBOR_ERR_LABEL_NOT_FOUND;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_GetItemInIndexN(QCBORDecodeContext  *me,
+                                       const QCBORMapIndex *pIndex,
+                                       int64_t              nLabel,
+                                       QCBORItem           *pItem)
+{
+   return MapIndex_GetItem(me, pIndex, QCBOR_TYPE_INT64, nLabel, NULLUsefulBufC, pItem);
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_GetItemInIndexSZ(QCBORDecodeContext  *me,
+                                        const QCBORMapIndex *pIndex,
+                                        const char          *szLabel,
+                                        QCBORItem           *pItem)
+{
+   const UsefulBufC Label = UsefulBuf_FromSZ(szLabel);
+
+   return MapIndex_GetItem(me,
+                           pIndex,
+                           QCBOR_TYPE_TEXT_STRING,
+                           MapIndex_HashString(Label),
+                           Label,
+                           pItem);
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORDecode_ExitIndexedMap(QCBORDecodeContext *me, const QCBORMapIndex *pIndex)
+{
+   me->nesting = pIndex->EndNesting;
+   UsefulInputBuf_Rewind(&(me->InBuf), pIndex->uEndOffset);
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORDecode_SaveCursor(QCBORDecodeContext *me, QCBORDecodeCursor *pCursor)
+{
+   pCursor->uOffset         = UsefulInputBuf_Tell(&(me->InBuf));
+   pCursor->uLevel          = DecodeNesting_GetLevel(&(me->nesting));
+   pCursor->uCount          = me->nesting.pCurrent->uCount;
+   if(me->pExt != NULL) {
+      pCursor->uNextStringRef  = me->pExt->uNextStringRef;
+      pCursor->uStringRefLevel = me->pExt->uStringRefLevel;
+   }
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_RestoreCursor(QCBORDecodeContext *me, const QCBORDecodeCursor *pCursor)
+{
+   // The levels above the saved one only change when it is left. If
+   // it has been left, their counts are not what they were.
+   if(DecodeNesting_GetLevel(&(me->nesting)) < pCursor->uLevel ||
+      pCursor->uOffset > me->InBuf.UB.len) {
+      return QCBOR_ERR_BAD_CURSOR;
+   }
+
+   me->nesting.pCurrent         = &(me->nesting.pMapsAndArrays[pCursor->uLevel]);
+   me->nesting.pCurrent->uCount = pCursor->uCount;
+   if(me->pExt != NULL) {
+      me->pExt->uNextStringRef  = pCursor->uNextStringRef;
+      me->pExt->uStringRefLevel = pCursor->uStringRefLevel;
+   }
+   UsefulInputBuf_Rewind(&(me->InBuf), pCursor->uOffset);
+
+   return QCBOR_SUCCESS;
+}
+
+
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORDecode_GetStats(QCBORDecodeContext *me, QCBORDecodeStats *pStats)
+{
+   pStats->uItemsDecoded   = me->uItemsDecoded;
+   pStats->uBytesConsumed  = UsefulInputBuf_Tell(&(me->InBuf));
+   pStats->uMaxNesting     = me->uMaxNesting;
+   pStats->uAllocatorCalls = me->StringAllocator.uCalls;
+   pStats->uAllocatorBytes = me->StringAllocator.uBytes;
+   pStats->uTagsMapped     = me->uTagsMapped;
+   pStats->uTagsNotMapped  = me->uTagsNotMapped;
+}
+#endif /* QCBOR_CONFIG_ENABLE_STATS */
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_Finish(QCBORDecodeContext *me)
+{
+   QCBORError nReturn = QCBOR_SUCCESS;
+
+   if(HasDigest(me)) {
+      DigestConsumed(me, true);
+   }
+
+   // Error out if all the maps/arrays are not closed out
+   if(DecodeNesting_IsNested(&(me->nesting))) {
+      nReturn = QCBOR_ERR_ARRAY_OR_MAP_STILL_OPEN;
+      goto Done;
+   }
+
+   // Error out if not all the bytes are consumed
+   if(UsefulInputBuf_BytesUnconsumed(&(me->InBuf))) {
+      nReturn = QCBOR_ERR_EXTRA_BYTES;
+   }
+
+Done:
+   // Call the destructor for the string allocator if there is one.
+   // Always called, even if there are errors; always have to clean up
+   StringAllocator_Destruct(&(me->StringAllocator));
+
+   return nReturn;
+}
+
+
+
+/*
+
+Decoder errors handled in this file
+
+ - Hit end of input before it was expected while decoding type and
+   number QCBOR_ERR_HIT_END
+
+ - negative integer that is too large for C QCBOR_ERR_INT_OVERFLOW
+
+ - Hit end of input while decoding a text or byte string
+   QCBOR_ERR_HIT_END
+
+ - Encountered conflicting tags -- e.g., an item is tagged both a date
+   string and an epoch date QCBOR_ERR_UNSUPPORTED
+
+ - Encontered an array or mapp that has too many items
+   QCBOR_ERR_ARRAY_TOO_LONG
+
+ - Encountered array/map nesting that is too deep
+   QCBOR_ERR_ARRAY_NESTING_TOO_DEEP
+
+ - An epoch date > INT64_MAX or < INT64_MIN was encountered
+   QCBOR_ERR_DATE_OVERFLOW
+
+ - The type of a map label is not a string or int
+   QCBOR_ERR_MAP_LABEL_TYPE
+
+ - Hit end with arrays or maps still open -- QCBOR_ERR_EXTRA_BYTES
+
+ */
+
+
+
+
+/* ===========================================================================
+   Validate -- WELL-FORMEDNESS CHECK WITHOUT DECODING
+
+   This walks the encoded CBOR the same way the decoder does, but only
+   the heads are decoded. String payloads are jumped over using the
+   length in their head and the only state kept is a small stack with
+   the items left at each level of array/map nesting. No QCBORItem is
+   filled in and no string allocator is needed for indefinite-length
+   strings.
+
+   This works directly on a pointer to the input rather than through
+   UsefulInputBuf so the few bounds checks needed per head are all
+   inline. The pointer is never advanced past pEnd.
+
+   The errors returned are the same as those the decoder returns for
+   the same malformation.
+   ========================================================================== */
+
+// Marks a level in the validate stack that is indefinite length
+#define VALIDATE_INDEFINITE SIZE_MAX
+
+typedef struct {
+   size_t  uRemaining; // Items to go in the level or VALIDATE_INDEFINITE
+   uint8_t bIsMap;
+   uint8_t bHaveLabel; // Odd number of items so far in an indefinite map
+} ValidateLevel;
+
+
+/*
+ The same as DecodeTypeAndNumber(), including the errors, but on a
+ pointer into the input. *ppByte is advanced past the head on success.
+ */
+static inline QCBORError
+Validate_DecodeHead(const uint8_t **ppByte,
+                    const uint8_t  *pEnd,
+                    int            *pnMajorType,
+                    uint64_t       *puArgument,
+                    int            *pnAdditionalInfo)
+{
+   const uint8_t *pByte = *ppByte;
+
+   if(pByte >= pEnd) {
+      return QCBOR_ERR_HIT_END;
+   }
+
+   const int nHeadInfo       = spHeadTable[*pByte];
+   const int nAdditionalInfo = *pByte & 0x1f;
+   if(nHeadInfo & HEAD_RESERVED) {
+      return QCBOR_ERR_UNSUPPORTED;
+   }
+
+   const size_t uArgLen = (size_t)(nHeadInfo & HEAD_ARG_LEN_MASK);
+   if(uArgLen >= (size_t)(pEnd - pByte)) {
+      return QCBOR_ERR_HIT_END;
+   }
+
+   uint64_t uArgument = uArgLen ? 0 : (uint64_t)nAdditionalInfo;
+   for(size_t u = 1; u <= uArgLen; u++) {
+      uArgument = (uArgument << 8) | pByte[u];
+   }
+
+   *ppByte           = pByte + 1 + uArgLen;
+   *pnMajorType      = nHeadInfo >> 5;
+   *puArgument       = uArgument;
+   *pnAdditionalInfo = nAdditionalInfo;
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Count the one-byte data items at pByte, up to uMaxItems of them.
+ These are the integers 0 to 23 and -1 to -24 and the simple values 0
+ to 23, including true, false and null. They are very common in
+ arrays of small integers and flags and they are always well-formed
+ so runs of them can be skipped without decoding the heads one at a
+ time.
+
+ Eight bytes are checked at once for integers with a SWAR (SIMD
+ within a register) test. Masking off the major type 1 bit leaves
+ integers as bytes less than 0x18, which is true of a byte exactly
+ when adding 0x68 to its low seven bits doesn't carry into its top
+ bit and the top bit isn't already set.
+ */
+static inline size_t
+Validate_SmallItemRun(const uint8_t *pByte, const uint8_t *pEnd, size_t uMaxItems)
+{
+   size_t uLen = (size_t)(pEnd - pByte);
+   if(uLen > uMaxItems) {
+      uLen = uMaxItems;
+   }
+
+   size_t uRun = 0;
+   while(uRun + sizeof(uint64_t) <= uLen) {
+      uint64_t uWord;
+      memcpy(&uWord, pByte + uRun, sizeof(uWord));
+      uWord &= 0xdfdfdfdfdfdfdfdfULL;
+      if((((uWord & 0x7f7f7f7f7f7f7f7fULL) + 0x6868686868686868ULL) | uWord) & 0x8080808080808080ULL) {
+         break;
+      }
+      uRun += sizeof(uint64_t);
+   }
+
+   while(uRun < uLen) {
+      const uint8_t uByte = pByte[uRun];
+      if((uByte & 0x1f) >= 24) {
+         break;
+      }
+      const int nMajorType = uByte >> 5;
+      if(nMajorType != CBOR_MAJOR_TYPE_POSITIVE_INT &&
+         nMajorType != CBOR_MAJOR_TYPE_NEGATIVE_INT &&
+         nMajorType != CBOR_MAJOR_TYPE_SIMPLE) {
+         break;
+      }
+      uRun++;
+   }
+
+   return uRun;
+}
+
+
+/*
+ Skip over the bytes of a definite-length string or string chunk.
+ *puTotal accumulates the length of all the chunks in an
+ indefinite-length string.
+ */
+static inline QCBORError
+Validate_SkipString(const uint8_t **ppByte,
+                    const uint8_t  *pEnd,
+                    uint64_t        uStrLen,
+                    size_t          uMaxStringLength,
+                    size_t         *puTotal)
+{
+   // Same limit and reasoning as in DecodeBytes()
+   if(uStrLen > uMaxStringLength || uStrLen > uMaxStringLength - *puTotal) {
+      return QCBOR_ERR_STRING_TOO_LONG;
+   }
+
+   if(uStrLen > (uint64_t)(pEnd - *ppByte)) {
+      return QCBOR_ERR_HIT_END;
+   }
+
+   // Cast is safe because of the two checks above
+   *puTotal += (size_t)uStrLen;
+   *ppByte  += (size_t)uStrLen;
+
+   return QCBOR_SUCCESS;
+}
+
+
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+/*
+ Check the chunks of an indefinite-length string up through the
+ break that ends it. *ppHead is set to each chunk so errors are
+ reported against the chunk.
+ */
+static QCBORError
+Validate_IndefiniteString(const uint8_t **ppByte,
+                          const uint8_t  *pEnd,
+                          int             nStringMajorType,
+                          size_t          uMaxStringLength,
+                          const uint8_t **ppHead)
+{
+   QCBORError nReturn;
+   size_t     uTotal = 0;
+
+   for(;;) {
+      int      nMajorType;
+      uint64_t uArgument;
+      int      nAdditionalInfo;
+
+      *ppHead = *ppByte;
+      nReturn = Validate_DecodeHead(ppByte, pEnd, &nMajorType, &uArgument, &nAdditionalInfo);
+      if(nReturn) {
+         break;
+      }
+
+      if(nMajorType == CBOR_MAJOR_TYPE_SIMPLE && nAdditionalInfo == CBOR_SIMPLE_BREAK) {
+         // String is complete
+         break;
+      }
+
+      // Chunks must be definite-length strings of the same type
+      if(nMajorType != nStringMajorType || nAdditionalInfo == LEN_IS_INDEFINITE) {
+         nReturn = QCBOR_ERR_INDEFINITE_STRING_CHUNK;
+         break;
+      }
+
+      nReturn = Validate_SkipString(ppByte, pEnd, uArgument, uMaxStringLength, &uTotal);
+      if(nReturn) {
+         break;
+      }
+   }
+
+   return nReturn;
+}
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS */
+
+
+/*
+ The limits QCBORDecode_Validate(), QCBORDecode_ExitArrayOrMap() and
+ QCBORDecode_SplitSequence() check against.
+ */
+typedef struct {
+   int      nMaxNesting;
+   uint64_t uMaxItemsInArray;
+   size_t   uMaxStringLength;
+} ValidateLimits;
+
+
+/*
+ Check one whole data item, including everything in it if it is an
+ array or map, and advance *ppByte past it.
+
+ This starts at level nLevel of pLevels. When nLevel is 0, one data
+ item at the top level is checked. When it is more than 0, the levels
+ up to nLevel must be filled in and the check goes until the array or
+ map at level 1 ends. *ppHead is set to the head of each item as it
+ is checked so it is the item in error when there is an error.
+ */
+static QCBORError
+Validate_OneItem(const uint8_t       **ppByte,
+                 const uint8_t        *pEnd,
+                 const ValidateLimits *pLimits,
+                 ValidateLevel        *pLevels,
+                 int                   nLevel,
+                 const uint8_t       **ppHead)
+{
+   QCBORError     nReturn;
+   const uint8_t *pByte   = *ppByte;
+   bool           bTagged = false; // Got a tag, but not its content
+
+   for(;;) {
+      *ppHead = pByte;
+
+      if(pByte == pEnd) {
+         // The input can only end after a whole item
+         nReturn = QCBOR_ERR_HIT_END;
+         break;
+      }
+
+      ValidateLevel *pLevel = &pLevels[nLevel];
+
+      // The number of items ended by this head; 0 for tags and for
+      // the opening of non-empty arrays and maps
+      size_t uNumEnded = 0;
+      if(nLevel > 0 && !bTagged && pLevel->uRemaining != VALIDATE_INDEFINITE) {
+         uNumEnded = Validate_SmallItemRun(pByte, pEnd, pLevel->uRemaining);
+         pByte += uNumEnded;
+      }
+
+      if(uNumEnded == 0) {
+         int      nMajorType;
+         uint64_t uArgument;
+         int      nAdditionalInfo;
+
+         nReturn = Validate_DecodeHead(&pByte, pEnd, &nMajorType, &uArgument, &nAdditionalInfo);
+         if(nReturn) {
+            break;
+         }
+
+         uNumEnded = 1;
+
+         switch(nMajorType) {
+            case CBOR_MAJOR_TYPE_POSITIVE_INT: // Major type 0
+            case CBOR_MAJOR_TYPE_NEGATIVE_INT: // Major type 1
+            case CBOR_MAJOR_TYPE_OPTIONAL:     // Major type 6
+               if(nAdditionalInfo == LEN_IS_INDEFINITE) {
+                  nReturn = QCBOR_ERR_BAD_INT;
+               } else if(nMajorType == CBOR_MAJOR_TYPE_OPTIONAL) {
+#ifndef QCBOR_DISABLE_TAGS
+                  // The tag content is the item, not the tag
+                  uNumEnded = 0;
+#else
+                  nReturn = QCBOR_ERR_TAGS_DISABLED;
+#endif
+               }
+               break;
+
+            case CBOR_MAJOR_TYPE_BYTE_STRING: // Major type 2
+            case CBOR_MAJOR_TYPE_TEXT_STRING: // Major type 3
+               if(nAdditionalInfo == LEN_IS_INDEFINITE) {
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+                  nReturn = Validate_IndefiniteString(&pByte,
+                                                      pEnd,
+                                                      nMajorType,
+                                                      pLimits->uMaxStringLength,
+                                                      ppHead);
+#else
+                  nReturn = QCBOR_ERR_INDEF_LEN_STRINGS_DISABLED;
+#endif
+               } else {
+                  size_t uTotal = 0;
+                  nReturn = Validate_SkipString(&pByte,
+                                                pEnd,
+                                                uArgument,
+                                                pLimits->uMaxStringLength,
+                                                &uTotal);
+               }
+               break;
+
+            case CBOR_MAJOR_TYPE_ARRAY: // Major type 4
+            case CBOR_MAJOR_TYPE_MAP:   // Major type 5
+#ifdef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
+               if(nAdditionalInfo == LEN_IS_INDEFINITE) {
+                  nReturn = QCBOR_ERR_INDEF_LEN_ARRAYS_DISABLED;
+                  break;
+               }
+#endif
+               if(nAdditionalInfo != LEN_IS_INDEFINITE) {
+                  if(uArgument > pLimits->uMaxItemsInArray) {
+                     nReturn = QCBOR_ERR_ARRAY_TOO_LONG;
+                     break;
+                  }
+                  if(uArgument == 0) {
+                     // Empty definite-length arrays and maps don't
+                     // nest, the same as in DecodeNesting_Descend()
+                     break;
+                  }
+                  // Every item is at least a byte so too few bytes
+                  // left can be caught now
+                  if(nMajorType == CBOR_MAJOR_TYPE_MAP) {
+                     uArgument *= 2;
+                  }
+                  if(uArgument > (uint64_t)(pEnd - pByte)) {
+                     nReturn = QCBOR_ERR_HIT_END;
+                     break;
+                  }
+               }
+               if(nLevel >= pLimits->nMaxNesting) {
+                  nReturn = QCBOR_ERR_ARRAY_NESTING_TOO_DEEP;
+                  break;
+               }
+               nLevel++;
+               pLevel = &pLevels[nLevel];
+               // Cast is safe because of the check against bytes left
+               pLevel->uRemaining = nAdditionalInfo == LEN_IS_INDEFINITE ?
+                                       VALIDATE_INDEFINITE : (size_t)uArgument;
+               pLevel->bIsMap     = nMajorType == CBOR_MAJOR_TYPE_MAP;
+               pLevel->bHaveLabel = 0;
+               uNumEnded = 0;
+               break;
+
+            case CBOR_MAJOR_TYPE_SIMPLE: // Major type 7
+               if(nAdditionalInfo == CBOR_SIMPLE_BREAK) {
+                  // A break must end an indefinite-length array or map
+                  // that has no tag or label dangling
+                  if(bTagged ||
+                     nLevel == 0 ||
+                     pLevel->uRemaining != VALIDATE_INDEFINITE ||
+                     pLevel->bHaveLabel) {
+                     nReturn = QCBOR_ERR_BAD_BREAK;
+                     break;
+                  }
+                  // The array or map ended is an item in the level above
+                  nLevel--;
+               } else if(nAdditionalInfo == CBOR_SIMPLEV_ONEBYTE &&
+                         uArgument <= CBOR_SIMPLE_BREAK) {
+                  // Same as in DecodeSimple()
+                  nReturn = QCBOR_ERR_BAD_TYPE_7;
+               }
+               break;
+         }
+
+         if(nReturn) {
+            break;
+         }
+
+         bTagged = nMajorType == CBOR_MAJOR_TYPE_OPTIONAL;
+      }
+
+      // Count the items ended against their enclosing levels. This is
+      // the equivalent of DecodeNesting_DecrementCount().
+      while(uNumEnded && nLevel > 0) {
+         pLevel = &pLevels[nLevel];
+         if(pLevel->uRemaining == VALIDATE_INDEFINITE) {
+            // Only one item can end at a time in an indefinite level
+            pLevel->bHaveLabel = pLevel->bIsMap && !pLevel->bHaveLabel;
+            uNumEnded = 0;
+            break;
+         }
+         pLevel->uRemaining -= uNumEnded;
+         if(pLevel->uRemaining) {
+            uNumEnded = 0;
+            break;
+         }
+         // The array or map is complete which ends an item in the
+         // level above
+         nLevel--;
+         uNumEnded = 1;
+      }
+
+      if(uNumEnded) {
+         // An item at the top level ended
+         nReturn = QCBOR_SUCCESS;
+         break;
+      }
+   }
+
+   *ppByte = pByte;
+
+   return nReturn;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_Validate(UsefulBufC                 EncodedCBOR,
+                                const QCBORValidateLimits *pLimits,
+                                size_t                    *puErrorOffset)
+{
+   // Stack usage: ValidateLevel 16 * 16, int/ptr 10 -- 336
+   QCBORError     nReturn;
+   ValidateLevel  Levels[QCBOR_MAX_ARRAY_NESTING + 1];
+   size_t         uNumTopLevel = 0;
+
+   const uint8_t *pByte = EncodedCBOR.ptr;
+   const uint8_t *pEnd  = pByte ? pByte + EncodedCBOR.len : pByte; // NULLUsefulBufC is empty
+   const uint8_t *pHead = pByte; // Head of the item being checked
+
+   // Fill in the limits; zero or NULL is the decoder's limit
+   ValidateLimits Limits = {QCBOR_MAX_ARRAY_NESTING, QCBOR_MAX_ITEMS_IN_ARRAY, SIZE_MAX - 4};
+   bool           bAllowSequence = false;
+   if(pLimits) {
+      if(pLimits->uMaxNesting && pLimits->uMaxNesting < QCBOR_MAX_ARRAY_NESTING) {
+         Limits.nMaxNesting = pLimits->uMaxNesting;
+      }
+      if(pLimits->uMaxItemsInArray && pLimits->uMaxItemsInArray < QCBOR_MAX_ITEMS_IN_ARRAY) {
+         Limits.uMaxItemsInArray = pLimits->uMaxItemsInArray;
+      }
+      if(pLimits->uMaxStringLength && pLimits->uMaxStringLength < SIZE_MAX - 4) {
+         Limits.uMaxStringLength = pLimits->uMaxStringLength;
+      }
+      bAllowSequence = pLimits->bAllowSequence;
+   }
+
+   for(;;) {
+      pHead = pByte;
+
+      if(pByte == pEnd) {
+         if(uNumTopLevel == 0 && !bAllowSequence) {
+            nReturn = QCBOR_ERR_HIT_END;
+         } else {
+            nReturn = QCBOR_SUCCESS;
+         }
+         break;
+      }
+
+      if(uNumTopLevel > 0 && !bAllowSequence) {
+         nReturn = QCBOR_ERR_EXTRA_BYTES;
+         break;
+      }
+
+      nReturn = Validate_OneItem(&pByte, pEnd, &Limits, Levels, 0, &pHead);
+      if(nReturn) {
+         break;
+      }
+      uNumTopLevel++;
+   }
+
+   if(puErrorOffset) {
+      // Cast is safe because pHead is always in the input
+      *puErrorOffset = nReturn ? (size_t)(pHead - (const uint8_t *)EncodedCBOR.ptr) : 0;
+   }
+
+   return nReturn;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+
+ Code Reviewers: THIS FUNCTION DOES POINTER MATH
+ */
+QCBORError QCBORDecode_SplitSequence(UsefulBufC  Sequence,
+                                     UsefulBufC *pItems,
+                                     size_t      uMaxItems,
+                                     size_t     *puNumItems,
+                                     size_t     *puConsumed)
+{
+   // Stack usage: ValidateLevel 16 * 16, int/ptr 10 -- 336
+   QCBORError     nReturn = QCBOR_SUCCESS;
+   ValidateLevel  Levels[QCBOR_MAX_ARRAY_NESTING + 1];
+   size_t         uNum;
+
+   const uint8_t *pStart = Sequence.ptr;
+   const uint8_t *pByte  = pStart;
+   const uint8_t *pEnd   = pByte ? pByte + Sequence.len : pByte; // NULLUsefulBufC is empty
+   const uint8_t *pHead;
+
+   // The decoder's limits so every item split out can be decoded
+   const ValidateLimits Limits = {QCBOR_MAX_ARRAY_NESTING, QCBOR_MAX_ITEMS_IN_ARRAY, SIZE_MAX - 4};
+
+   for(uNum = 0; uNum < uMaxItems && pByte < pEnd; uNum++) {
+      const uint8_t *pItemStart = pByte;
+      nReturn = Validate_OneItem(&pByte, pEnd, &Limits, Levels, 0, &pHead);
+      if(nReturn) {
+         // pByte is not advanced on error
+         pByte = pItemStart;
+         break;
+      }
+      // Cast is safe because Validate_OneItem() doesn't go past pEnd
+      pItems[uNum] = (UsefulBufC){pItemStart, (size_t)(pByte - pItemStart)};
+   }
+
+   *puNumItems = uNum;
+   if(puConsumed) {
+      *puConsumed = (size_t)(pByte - pStart);
+   }
+
+   return nReturn;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORDecode_PartitionSequence(const UsefulBufC *pItems,
+                                   size_t            uNumItems,
+                                   QCBORSequenceJob *pJobs,
+                                   size_t            uNumJobs)
+{
+   size_t uTotal = 0;
+   size_t uItem;
+   size_t uJob;
+
+   for(uItem = 0; uItem < uNumItems; uItem++) {
+      uTotal += pItems[uItem].len;
+   }
+
+   // Each job ends at the first item boundary at or past its share of
+   // the bytes. A job's share is figured from the total rather than
+   // what is left so rounding doesn't accumulate.
+   size_t uDone = 0;
+   uItem = 0;
+   for(uJob = 0; uJob < uNumJobs; uJob++) {
+      pJobs[uJob].pItems      = pItems + uItem;
+      pJobs[uJob].uFirstIndex = uItem;
+
+      const size_t uTarget = uJob + 1 == uNumJobs ?
+                                SIZE_MAX :
+                                uTotal / uNumJobs * (uJob + 1) +
+                                   uTotal % uNumJobs * (uJob + 1) / uNumJobs;
+      const size_t uFirst = uItem;
+      while(uItem < uNumItems && uDone < uTarget) {
+         uDone += pItems[uItem].len;
+         uItem++;
+      }
+      pJobs[uJob].uNumItems = uItem - uFirst;
+   }
+}
+
+
+/*
+ Path queries, QCBORDecode_CompileQuery() and QCBORDecode_RunQuery()
+
+ The paths are merged into a tree when compiled so the input is
+ walked once for all of them. Only the maps, arrays and wrapped byte
+ strings on a path are gone into. Everything else is skipped with
+ Validate_OneItem() without decoding it. The walk is done with a stack
+ of QueryLevel rather than recursion. It is never deeper than the
+ longest path.
+ */
+#define QUERY_LEVEL_MAP     0
+#define QUERY_LEVEL_ARRAY   1
+#define QUERY_LEVEL_WRAPPED 2
+
+typedef struct {
+   const uint8_t *pEnd;       // End of the input outside a wrapped byte string
+   size_t         uRemaining; // Items or pairs to go or VALIDATE_INDEFINITE
+   size_t         uIndex;     // Index of the next array element
+   uint8_t        uNode;      // The node for the map, array or byte string
+   uint8_t        uLevelType; // QUERY_LEVEL_XXX
+} QueryLevel;
+
+
+static inline bool
+Query_StepsMatch(const QCBORPathStep *pStep1, const QCBORPathStep *pStep2)
+{
+   if(pStep1->uKind != pStep2->uKind) {
+      return false;
+   }
+   switch(pStep1->uKind) {
+      case QCBOR_PATH_LABEL_TEXT:
+         return UsefulBuf_Compare(pStep1->Text, pStep2->Text) == 0;
+
+      case QCBOR_PATH_BSTR_WRAPPED:
+         return true;
+
+      default:
+         return pStep1->nValue == pStep2->nValue;
+   }
+}
+
+
+/*
+ Find the child of uNode that matches pStep. QCBOR_QUERY_NOT_NODE is
+ returned if there is none. Children always come after their parent
+ in the steps.
+ */
+static uint8_t
+Query_FindChild(const QCBORQuery *pQuery, uint8_t uNode, const QCBORPathStep *pStep)
+{
+   const uint8_t uFirst = uNode == QCBOR_QUERY_ROOT ? 0 : (uint8_t)(uNode + 1);
+   for(uint8_t u = uFirst; u < pQuery->uNumSteps; u++) {
+      if(pQuery->auParent[u] == uNode && Query_StepsMatch(&(pQuery->pSteps[u]), pStep)) {
+         return u;
+      }
+   }
+   return QCBOR_QUERY_NOT_NODE;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_CompileQuery(QCBORQuery          *pQuery,
+                                    const QCBORPathStep *pSteps,
+                                    size_t               uNumSteps)
+{
+   if(uNumSteps == 0 ||
+      uNumSteps > QCBOR_MAX_QUERY_STEPS ||
+      pSteps[uNumSteps-1].uKind != QCBOR_PATH_END) {
+      return QCBOR_ERR_BAD_QUERY;
+   }
+
+   pQuery->pSteps    = pSteps;
+   // Cast is safe because of the check against QCBOR_MAX_QUERY_STEPS
+   pQuery->uNumSteps = (uint8_t)uNumSteps;
+   pQuery->uNumPaths = 0;
+
+   // Not a node until it is found to be one
+   memset(pQuery->auParent, QCBOR_QUERY_NOT_NODE, sizeof(pQuery->auParent));
+
+   uint8_t uNode  = QCBOR_QUERY_ROOT;
+   int     nDepth = 0;
+   for(uint8_t u = 0; u < pQuery->uNumSteps; u++) {
+      const QCBORPathStep *pStep = &pSteps[u];
+
+      switch(pStep->uKind) {
+         case QCBOR_PATH_END:
+            if(pQuery->uNumPaths >= QCBOR_MAX_QUERY_PATHS) {
+               return QCBOR_ERR_BAD_QUERY;
+            }
+            pQuery->auPathEnd[pQuery->uNumPaths++] = uNode;
+            uNode  = QCBOR_QUERY_ROOT;
+            nDepth = 0;
+            continue;
+
+         case QCBOR_PATH_ARRAY_INDEX:
+            if(pStep->nValue < 0) {
+               return QCBOR_ERR_BAD_QUERY;
+            }
+            break;
+
+         case QCBOR_PATH_LABEL_TEXT:
+            if(pStep->Text.ptr == NULL && pStep->Text.len) {
+               return QCBOR_ERR_BAD_QUERY;
+            }
+            break;
+
+         case QCBOR_PATH_LABEL_INT:
+         case QCBOR_PATH_BSTR_WRAPPED:
+            break;
+
+         default:
+            return QCBOR_ERR_BAD_QUERY;
+      }
+
+      if(++nDepth > QCBOR_MAX_ARRAY_NESTING) {
+         return QCBOR_ERR_BAD_QUERY;
+      }
+
+      // The same step from the same node as an earlier path is
+      // merged with it
+      const uint8_t uChild = Query_FindChild(pQuery, uNode, pStep);
+      if(uChild != QCBOR_QUERY_NOT_NODE) {
+         uNode = uChild;
+      } else {
+         pQuery->auParent[u] = uNode;
+         uNode = u;
+      }
+   }
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Skip one data item. Most of the items skipped are integers and
+ definite-length strings so they are skipped here with just their
+ head. Everything else goes through Validate_OneItem().
+ */
+static inline QCBORError
+Query_SkipItem(const uint8_t        **ppByte,
+               const uint8_t         *pEnd,
+               const ValidateLimits  *pLimits,
+               ValidateLevel         *pLevels)
+{
+   const uint8_t *pByte = *ppByte;
+   int            nMajorType;
+   uint64_t       uArgument;
+   int            nAdditionalInfo;
+
+   if(Validate_DecodeHead(&pByte, pEnd, &nMajorType, &uArgument, &nAdditionalInfo) == QCBOR_SUCCESS &&
+      nAdditionalInfo != LEN_IS_INDEFINITE) {
+      switch(nMajorType) {
+         case CBOR_MAJOR_TYPE_POSITIVE_INT:
+         case CBOR_MAJOR_TYPE_NEGATIVE_INT:
+            *ppByte = pByte;
+            return QCBOR_SUCCESS;
+
+         case CBOR_MAJOR_TYPE_BYTE_STRING:
+         case CBOR_MAJOR_TYPE_TEXT_STRING:
+            if(uArgument <= (uint64_t)(pEnd - pByte) && uArgument <= pLimits->uMaxStringLength) {
+               // Cast is safe because of the check above
+               *ppByte = pByte + (size_t)uArgument;
+               return QCBOR_SUCCESS;
+            }
+            break;
+      }
+   }
+
+   // Everything else, including the errors
+   const uint8_t *pHead;
+   return Validate_OneItem(ppByte, pEnd, pLimits, pLevels, 0, &pHead);
+}
+
+
+/*
+ Decode a data item found by a query and get its encoded extent.
+ This is separate so the decode context is only on the stack when it
+ is needed.
+ */
+static QCBORError
+Query_DecodeFound(const uint8_t        *pByte,
+                  const uint8_t        *pEnd,
+                  const ValidateLimits *pLimits,
+                  ValidateLevel        *pLevels,
+                  QCBORItem            *pItem,
+                  UsefulBufC           *pEncodedItem)
+{
+   QCBORDecodeContext DC;
+   QCBORError         nReturn;
+
+   if(pByte >= pEnd) {
+      // Otherwise an item missing at the end would be no more items
+      return QCBOR_ERR_HIT_END;
+   }
+
+   // Cast is safe because of the check above
+   QCBORDecode_Init(&DC, (UsefulBufC){pByte, (size_t)(pEnd - pByte)}, QCBOR_DECODE_MODE_NORMAL);
+   nReturn = QCBORDecode_GetNext(&DC, pItem);
+   if(nReturn == QCBOR_SUCCESS && pEncodedItem != NULL) {
+      const uint8_t *pItemEnd = pByte;
+      const uint8_t *pHead;
+      nReturn = Validate_OneItem(&pItemEnd, pEnd, pLimits, pLevels, 0, &pHead);
+      // Cast is safe because Validate_OneItem() doesn't go past pEnd
+      *pEncodedItem = (UsefulBufC){pByte, (size_t)(pItemEnd - pByte)};
+   }
+
+   return nReturn;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_RunQuery(const QCBORQuery *pQuery,
+                                UsefulBufC        EncodedCBOR,
+                                QCBORItem        *pItems,
+                                UsefulBufC       *pEncodedItems)
+{
+   // Stack usage: QueryLevel 15 * 32, ValidateLevel 16 * 16, int/ptr 20 -- 896
+   QCBORError     nReturn = QCBOR_SUCCESS;
+   QueryLevel     Levels[QCBOR_MAX_ARRAY_NESTING];
+   ValidateLevel  SkipLevels[QCBOR_MAX_ARRAY_NESTING + 1];
+   int            nDepth = 0;
+
+   const uint8_t *pByte = EncodedCBOR.ptr;
+   const uint8_t *pEnd  = pByte ? pByte + EncodedCBOR.len : pByte; // NULLUsefulBufC is empty
+
+   const ValidateLimits Limits = {QCBOR_MAX_ARRAY_NESTING, QCBOR_MAX_ITEMS_IN_ARRAY, SIZE_MAX - 4};
+
+   const uint32_t uAllFound = (1U << pQuery->uNumPaths) - 1;
+   uint32_t       uFound    = 0;
+   for(uint8_t u = 0; u < pQuery->uNumPaths; u++) {
+      pItems[u].uDataType = QCBOR_TYPE_NONE;
+      if(pEncodedItems != NULL) {
+         pEncodedItems[u] = NULLUsefulBufC;
+      }
+   }
+
+   if(pByte == pEnd) {
+      nReturn = QCBOR_ERR_HIT_END;
+      goto Done;
+   }
+
+   // The item at pByte is on a path when uNode isn't
+   // QCBOR_QUERY_NOT_NODE
+   uint8_t uNode = QCBOR_QUERY_ROOT;
+   for(;;) {
+      if(uNode != QCBOR_QUERY_NOT_NODE) {
+         // ---- An item on a path: get it if a path ends here ----
+         for(uint8_t u = 0; u < pQuery->uNumPaths; u++) {
+            if(pQuery->auPathEnd[u] == uNode && !(uFound & (1U << u))) {
+               nReturn = Query_DecodeFound(pByte, pEnd, &Limits, SkipLevels, &pItems[u],
+                                           pEncodedItems ? &pEncodedItems[u] : NULL);
+               if(nReturn) {
+                  goto Done;
+               }
+               uFound |= 1U << u;
+            }
+         }
+         if(uFound == uAllFound) {
+            goto Done;
+         }
+
+         // ---- Go into it if a path goes on from here ----
+         uint32_t uChildKinds = 0;
+         for(uint8_t u = uNode == QCBOR_QUERY_ROOT ? 0 : (uint8_t)(uNode + 1); u < pQuery->uNumSteps; u++) {
+            if(pQuery->auParent[u] == uNode) {
+               uChildKinds |= 1U << pQuery->pSteps[u].uKind;
+            }
+         }
+
+         const uint8_t *pContent = pByte;
+         int            nMajorType;
+         uint64_t       uArgument;
+         int            nAdditionalInfo;
+         do {
+            nReturn = Validate_DecodeHead(&pContent, pEnd, &nMajorType, &uArgument, &nAdditionalInfo);
+            if(nReturn) {
+               goto Done;
+            }
+         } while(nMajorType == CBOR_MAJOR_TYPE_OPTIONAL);
+
+         const bool bIndefinite = nAdditionalInfo == LEN_IS_INDEFINITE;
+         if((nMajorType == CBOR_MAJOR_TYPE_MAP &&
+             uChildKinds & ((1U << QCBOR_PATH_LABEL_INT) | (1U << QCBOR_PATH_LABEL_TEXT))) ||
+            (nMajorType == CBOR_MAJOR_TYPE_ARRAY &&
+             uChildKinds & (1U << QCBOR_PATH_ARRAY_INDEX))) {
+            if(!bIndefinite && uArgument > QCBOR_MAX_ITEMS_IN_ARRAY) {
+               nReturn = QCBOR_ERR_ARRAY_TOO_LONG;
+               goto Done;
+            }
+            QueryLevel *pLevel = &Levels[nDepth++];
+            pLevel->pEnd       = pEnd;
+            // Cast is safe because of the check above
+            pLevel->uRemaining = bIndefinite ? VALIDATE_INDEFINITE : (size_t)uArgument;
+            pLevel->uIndex     = 0;
+            pLevel->uNode      = uNode;
+            pLevel->uLevelType = nMajorType == CBOR_MAJOR_TYPE_MAP ? QUERY_LEVEL_MAP :
+                                                                     QUERY_LEVEL_ARRAY;
+            pByte = pContent;
+
+         } else if(nMajorType == CBOR_MAJOR_TYPE_BYTE_STRING && !bIndefinite && uArgument &&
+                   uChildKinds & (1U << QCBOR_PATH_BSTR_WRAPPED)) {
+            if(uArgument > (uint64_t)(pEnd - pContent)) {
+               nReturn = QCBOR_ERR_HIT_END;
+               goto Done;
+            }
+            QueryLevel *pLevel = &Levels[nDepth++];
+            pLevel->pEnd       = pEnd;
+            pLevel->uLevelType = QUERY_LEVEL_WRAPPED;
+            pByte = pContent;
+            // Cast is safe because of the check above
+            pEnd  = pContent + (size_t)uArgument;
+
+            // The wrapped item is the next one on the path
+            static const QCBORPathStep Wrapped = QCBORPath_BSTR_WRAPPED;
+            uNode = Query_FindChild(pQuery, uNode, &Wrapped);
+            continue;
+
+         } else {
+            nReturn = Query_SkipItem(&pByte, pEnd, &Limits, SkipLevels);
+            if(nReturn) {
+               goto Done;
+            }
+         }
+
+      } else {
+         nReturn = Query_SkipItem(&pByte, pEnd, &Limits, SkipLevels);
+         if(nReturn) {
+            goto Done;
+         }
+      }
+
+      // ---- Find the next item on a path ----
+      uNode = QCBOR_QUERY_NOT_NODE;
+      while(uNode == QCBOR_QUERY_NOT_NODE) {
+         if(nDepth == 0) {
+            // The top-level item is done
+            goto Done;
+         }
+
+         QueryLevel *pLevel = &Levels[nDepth-1];
+         if(pLevel->uLevelType == QUERY_LEVEL_WRAPPED) {
+            // Anything after the wrapped item is ignored
+            pByte = pEnd;
+            pEnd  = pLevel->pEnd;
+            nDepth--;
+            continue;
+         }
+
+         if(pLevel->uRemaining == VALIDATE_INDEFINITE) {
+            if(pByte >= pEnd) {
+               nReturn = QCBOR_ERR_HIT_END;
+               goto Done;
+            }
+            if(*pByte == (CBOR_MAJOR_TYPE_SIMPLE << 5 | CBOR_SIMPLE_BREAK)) {
+               pByte++;
+               nDepth--;
+               continue;
+            }
+         } else if(pLevel->uRemaining == 0) {
+            nDepth--;
+            continue;
+         } else {
+            pLevel->uRemaining--;
+         }
+
+         QCBORPathStep Step = {QCBOR_PATH_ARRAY_INDEX, 0, {NULL, 0}};
+         if(pLevel->uLevelType == QUERY_LEVEL_ARRAY) {
+            // Cast is safe because an array can't have more than
+            // QCBOR_MAX_ITEMS_IN_ARRAY items
+            Step.nValue = (int64_t)pLevel->uIndex++;
+
+         } else {
+            // Match the label by its head and then skip it
+            const uint8_t *pLabel = pByte;
+            int            nMajorType;
+            uint64_t       uArgument;
+            int            nAdditionalInfo;
+            nReturn = Validate_DecodeHead(&pLabel, pEnd, &nMajorType, &uArgument, &nAdditionalInfo);
+            if(nReturn) {
+               goto Done;
+            }
+            Step.uKind = QCBOR_PATH_END; // Not a label on any path
+            if(nMajorType == CBOR_MAJOR_TYPE_POSITIVE_INT && uArgument <= INT64_MAX) {
+               Step.uKind  = QCBOR_PATH_LABEL_INT;
+               Step.nValue = (int64_t)uArgument;
+               pByte       = pLabel;
+            } else if(nMajorType == CBOR_MAJOR_TYPE_NEGATIVE_INT && uArgument <= INT64_MAX) {
+               Step.uKind  = QCBOR_PATH_LABEL_INT;
+               Step.nValue = -1 - (int64_t)uArgument;
+               pByte       = pLabel;
+            } else if(nMajorType == CBOR_MAJOR_TYPE_TEXT_STRING &&
+                      nAdditionalInfo != LEN_IS_INDEFINITE &&
+                      uArgument <= (uint64_t)(pEnd - pLabel)) {
+               Step.uKind = QCBOR_PATH_LABEL_TEXT;
+               // Cast is safe because of the check above
+               Step.Text  = (UsefulBufC){pLabel, (size_t)uArgument};
+               pByte      = pLabel + (size_t)uArgument;
+            } else {
+               nReturn = Query_SkipItem(&pByte, pEnd, &Limits, SkipLevels);
+               if(nReturn) {
+                  goto Done;
+               }
+            }
+         }
+
+         if(Step.uKind != QCBOR_PATH_END) {
+            uNode = Query_FindChild(pQuery, pLevel->uNode, &Step);
+         }
+         if(uNode == QCBOR_QUERY_NOT_NODE) {
+            // Not on a path
+            nReturn = Query_SkipItem(&pByte, pEnd, &Limits, SkipLevels);
+            if(nReturn) {
+               goto Done;
+            }
+         }
+      }
+   }
+
+Done:
+   return nReturn;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_ExitArrayOrMap(QCBORDecodeContext *me)
+{
+   // Stack usage: ValidateLevel 16 * 16, int/ptr 10 -- 336
+   QCBORError    nReturn;
+   ValidateLevel Levels[QCBOR_MAX_ARRAY_NESTING + 1];
+
+   if(!DecodeNesting_IsNested(&(me->nesting))) {
+      nReturn = QCBOR_ERR_TOO_MANY_CLOSES;
+      goto Done;
+   }
+
+   if(HasMapChecks(me) ||
+      (me->pExt != NULL && me->pExt->uStringRefLevel != QCBOR_NO_STRING_REF_NAMESPACE)) {
+      // The strings in what is skipped have to be numbered and the
+      // maps checked so this decodes all the items rather than just
+      // checking them
+      const uint8_t uLevel = DecodeNesting_GetLevel(&(me->nesting));
+      QCBORItem     Item;
+      do {
+         nReturn = QCBORDecode_GetNext(me, &Item);
+      } while(nReturn == QCBOR_SUCCESS && Item.uNextNestLevel >= uLevel);
+      return nReturn;
+   }
+
+   // The array or map being exited is level 1 of the check. The
+   // nesting limit is what is left of the decoder's.
+   const QCBORCount uCount     = me->nesting.pCurrent->uCount;
+   const uint8_t    uMajorType = me->nesting.pCurrent->uMajorType;
+   const ValidateLimits Limits = {
+      QCBOR_MAX_ARRAY_NESTING - DecodeNesting_GetLevel(&(me->nesting)) + 1,
+      QCBOR_MAX_ITEMS_IN_ARRAY,
+      SIZE_MAX - 4
+   };
+   if(DecodeNesting_IsIndefiniteLength(&(me->nesting))) {
+      Levels[1].uRemaining = VALIDATE_INDEFINITE;
+   } else if(uMajorType == QCBOR_TYPE_MAP) {
+      // The count for maps is of label and value pairs. It is already
+      // doubled for QCBOR_TYPE_MAP_AS_ARRAY.
+      Levels[1].uRemaining = (size_t)uCount * 2;
+   } else {
+      Levels[1].uRemaining = uCount;
+   }
+   // The decoder always stops between the label and value pairs of an
+   // indefinite-length map, except in QCBOR_DECODE_MODE_MAP_AS_ARRAY
+   // when it is treated as an array.
+   Levels[1].bIsMap     = uMajorType == QCBOR_TYPE_MAP;
+   Levels[1].bHaveLabel = 0;
+
+   // This is a zero-length get to find where the cursor is
+   const uint8_t *pStart = UsefulInputBuf_GetBytes(&(me->InBuf), 0);
+   const uint8_t *pByte  = pStart;
+   const uint8_t *pHead;
+   nReturn = Validate_OneItem(&pByte,
+                              pStart + UsefulInputBuf_BytesUnconsumed(&(me->InBuf)),
+                              &Limits,
+                              Levels,
+                              1,
+                              &pHead);
+   if(nReturn) {
+      // Nothing is consumed on error so more input can be added and
+      // this called again when decoding incrementally
+      if(nReturn == QCBOR_ERR_HIT_END && me->bIncremental) {
+         nReturn = QCBOR_ERR_NEED_MORE_DATA;
+      }
+      goto Done;
+   }
+
+   const size_t             uSavedCursor  = UsefulInputBuf_Tell(&(me->InBuf));
+   const QCBORDecodeNesting SavedNesting  = me->nesting;
+
+   // Cast is safe because Validate_OneItem() doesn't go past the end
+   UsefulInputBuf_Seek(&(me->InBuf), uSavedCursor + (size_t)(pByte - pStart));
+
+   // Ascend out of the array or map the same way the decoder does
+   // when it gets the last item in it
+   if(DecodeNesting_IsIndefiniteLength(&(me->nesting))) {
+      me->nesting.pCurrent--;
+      DecodeNesting_DecrementCount(&(me->nesting));
+   } else {
+      me->nesting.pCurrent->uCount = 1;
+      DecodeNesting_DecrementCount(&(me->nesting));
+   }
+
+   nReturn = ConsumeTrailingBreaks(me);
+
+   // Same as at the end of QCBORDecode_GetNextMapOrArray(). An
+   // indefinite-length array or map might be ended by a break that
+   // hasn't been received yet.
+   if(me->bIncremental &&
+      (nReturn == QCBOR_ERR_HIT_END ||
+       (nReturn == QCBOR_SUCCESS &&
+        DecodeNesting_IsNested(&(me->nesting)) &&
+        DecodeNesting_IsIndefiniteLength(&(me->nesting)) &&
+        UsefulInputBuf_BytesUnconsumed(&(me->InBuf)) == 0))) {
+      UsefulInputBuf_Seek(&(me->InBuf), uSavedCursor);
+      me->nesting = SavedNesting;
+      nReturn = QCBOR_ERR_NEED_MORE_DATA;
+   }
+
+Done:
+   if(HasDigest(me)) {
+      DigestConsumed(me, false);
+   }
+
+   return nReturn;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_SkipCurrent(QCBORDecodeContext *me, const QCBORItem *pItem)
+{
+   const uint8_t uType = pItem->uDataType;
+   if(uType != QCBOR_TYPE_ARRAY && uType != QCBOR_TYPE_MAP && uType != QCBOR_TYPE_MAP_AS_ARRAY) {
+      // Nothing to skip for items that aren't arrays or maps
+      return QCBOR_SUCCESS;
+   }
+
+   if(pItem->uNextNestLevel <= pItem->uNestingLevel) {
+      // An empty array or map. The decoder didn't descend into it
+      // so it is already after it.
+      return QCBOR_SUCCESS;
+   }
+
+   return QCBORDecode_ExitArrayOrMap(me);
+}
+
+
+/*
+ Decode the rest of the elements of the array being decoded straight
+ into pnInts or pdDoubles, whichever is not NULL. Each element is
+ decoded with DecodeTypeAndNumber() and DecodeInteger() or
+ DecodeSimple() with none of the layers above, so there is no
+ QCBORItem to clear and no label or tag processing per element.
+ */
+static QCBORError GetNumberArray(QCBORDecodeContext *me,
+                                 const QCBORItem    *pArray,
+                                 int64_t            *pnInts,
+                                 double             *pdDoubles,
+                                 size_t              uMaxValues,
+                                 size_t             *puNumValues)
+{
+   QCBORError nReturn = QCBOR_SUCCESS;
+   QCBORItem  Element;
+   size_t     uNum = 0;
+
+   const size_t             uStartPosition = UsefulInputBuf_Tell(&(me->InBuf));
+   const QCBORDecodeNesting SavedNesting   = me->nesting;
+
+   if(pArray->uDataType != QCBOR_TYPE_ARRAY) {
+      nReturn = QCBOR_ERR_UNEXPECTED_TYPE;
+      goto Done;
+   }
+
+   if(pArray->uNextNestLevel <= pArray->uNestingLevel) {
+      // An empty array. The decoder didn't descend into it.
+      goto Done;
+   }
+
+   if(DecodeNesting_GetLevel(&(me->nesting)) != pArray->uNextNestLevel ||
+      me->nesting.pCurrent->uMajorType != QCBOR_TYPE_ARRAY) {
+      // Not in the array; for example all its elements were already
+      // decoded
+      nReturn = QCBOR_ERR_UNEXPECTED_TYPE;
+      goto Done;
+   }
 
-   This is a very primitive memory allocator. It does not track
-   individual allocations, only a high-water mark. A free or
-   reallocation must be of the last chunk allocated.
+   const bool bIndefinite = DecodeNesting_IsIndefiniteLength(&(me->nesting));
+   QCBORCount uRemaining  = me->nesting.pCurrent->uCount;
 
-   The size of the pool and offset to free memory are packed into the
-   first 8 bytes of the memory pool so we don't have to keep them in
-   the decode context. Since the address of the pool may not be
-   aligned, they have to be packed and unpacked as if they were
-   serialized data of the wire or such.
+   while(bIndefinite || uRemaining) {
+      int      nMajorType;
+      uint64_t uArgument;
+      int      nAdditionalInfo;
 
-   The sizes packed in are uint32_t to be the same on all CPU types
-   and simplify the code.
-   ========================================================================== */
+      const size_t uHeadStart = UsefulInputBuf_Tell(&(me->InBuf));
+      nReturn = DecodeTypeAndNumber(&(me->InBuf), &nMajorType, &uArgument, &nAdditionalInfo);
+      if(nReturn) {
+         goto Done;
+      }
+      if(HasMapChecks(me) && !LabelCheck_IsPreferredHead(me, uHeadStart)) {
+         me->pExt->bNotDeterministic = 1;
+      }
 
+      if(nMajorType == CBOR_MAJOR_TYPE_SIMPLE && nAdditionalInfo == CBOR_SIMPLE_BREAK) {
+         if(!bIndefinite) {
+            nReturn = QCBOR_ERR_BAD_BREAK;
+            goto Done;
+         }
+         break;
+      }
 
-static inline int
-MemPool_Unpack(const void *pMem, uint32_t *puPoolSize, uint32_t *puFreeOffset)
-{
-   // Use of UsefulInputBuf is overkill, but it is convenient.
-   UsefulInputBuf UIB;
+      if(uNum >= uMaxValues) {
+         nReturn = QCBOR_ERR_BUFFER_TOO_SMALL;
+         goto Done;
+      }
+
+      if(pnInts != NULL) {
+         if(nMajorType != CBOR_MAJOR_TYPE_POSITIVE_INT &&
+            nMajorType != CBOR_MAJOR_TYPE_NEGATIVE_INT) {
+            nReturn = QCBOR_ERR_UNEXPECTED_TYPE;
+            goto Done;
+         }
+         if(nAdditionalInfo == LEN_IS_INDEFINITE) {
+            // Not well-formed, the same as in GetNext_Item()
+            nReturn = QCBOR_ERR_BAD_INT;
+            goto Done;
+         }
+         nReturn = DecodeInteger(nMajorType, uArgument, &Element);
+         if(nReturn == QCBOR_SUCCESS && Element.uDataType != QCBOR_TYPE_INT64) {
+            // A positive integer larger than INT64_MAX
+            nReturn = QCBOR_ERR_INT_OVERFLOW;
+         }
+         if(nReturn) {
+            goto Done;
+         }
+         pnInts[uNum] = Element.val.int64;
+      } else {
+         if(nMajorType != CBOR_MAJOR_TYPE_SIMPLE) {
+            nReturn = QCBOR_ERR_UNEXPECTED_TYPE;
+            goto Done;
+         }
+         nReturn = DecodeSimple(nAdditionalInfo, uArgument, &Element);
+         if(nReturn) {
+            goto Done;
+         }
+         if(Element.uDataType == QCBOR_TYPE_DOUBLE) {
+            pdDoubles[uNum] = Element.val.dfnum;
+#ifndef QCBOR_DISABLE_FLOAT_HW_USE
+         } else if(Element.uDataType == QCBOR_TYPE_FLOAT) {
+            // Only when QCBOR_DISABLE_PREFERRED_FLOAT
+            pdDoubles[uNum] = (double)Element.val.fnum;
+#endif
+         } else {
+            nReturn = QCBOR_ERR_UNEXPECTED_TYPE;
+            goto Done;
+         }
+      }
+
+      uNum++;
+      uRemaining--;
+   }
+
+   // Ascend out of the array the same way QCBORDecode_ExitArrayOrMap()
+   // does
+   if(bIndefinite) {
+      me->nesting.pCurrent--;
+      DecodeNesting_DecrementCount(&(me->nesting));
+   } else {
+      me->nesting.pCurrent->uCount = 1;
+      DecodeNesting_DecrementCount(&(me->nesting));
+   }
+
+   nReturn = ConsumeTrailingBreaks(me);
 
-   // Just assume the size here. It was checked during SetUp so
-   // the assumption is safe.
-   UsefulInputBuf_Init(&UIB, (UsefulBufC){pMem, QCBOR_DECODE_MIN_MEM_POOL_SIZE});
-   *puPoolSize     = UsefulInputBuf_GetUint32(&UIB);
-   *puFreeOffset   = UsefulInputBuf_GetUint32(&UIB);
-   return UsefulInputBuf_GetError(&UIB);
+   // Same as at the end of QCBORDecode_GetNextMapOrArray()
+   if(me->bIncremental &&
+      nReturn == QCBOR_SUCCESS &&
+      DecodeNesting_IsNested(&(me->nesting)) &&
+      DecodeNesting_IsIndefiniteLength(&(me->nesting)) &&
+      UsefulInputBuf_BytesUnconsumed(&(me->InBuf)) == 0) {
+      nReturn = QCBOR_ERR_HIT_END;
+   }
+
+Done:
+   if(nReturn != QCBOR_SUCCESS) {
+      // Back up to the start so the elements can be decoded again,
+      // either with QCBORDecode_GetNext() to find out what isn't a
+      // number, or after more input is added
+      UsefulInputBuf_Rewind(&(me->InBuf), uStartPosition);
+      me->nesting = SavedNesting;
+      if(nReturn == QCBOR_ERR_HIT_END && me->bIncremental) {
+         nReturn = QCBOR_ERR_NEED_MORE_DATA;
+      }
+      uNum = 0;
+   }
+
+   *puNumValues = uNum;
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+   me->uItemsDecoded += uNum;
+#endif
+
+   if(HasDigest(me)) {
+      DigestConsumed(me, false);
+   }
+
+   return nReturn;
 }
 
 
-static inline int
-MemPool_Pack(UsefulBuf Pool, uint32_t uFreeOffset)
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_GetInt64Array(QCBORDecodeContext *me,
+                                     const QCBORItem    *pArray,
+                                     int64_t            *pnValues,
+                                     size_t              uMaxValues,
+                                     size_t             *puNumValues)
 {
-   // Use of UsefulOutBuf is overkill, but convenient. The
-   // length check performed here is useful.
-   UsefulOutBuf UOB;
+   return GetNumberArray(me, pArray, pnValues, NULL, uMaxValues, puNumValues);
+}
 
-   UsefulOutBuf_Init(&UOB, Pool);
-   UsefulOutBuf_AppendUint32(&UOB, (uint32_t)Pool.len); // size of pool
-   UsefulOutBuf_AppendUint32(&UOB, uFreeOffset); // first free position
-   return UsefulOutBuf_GetError(&UOB);
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+QCBORError QCBORDecode_GetDoubleArray(QCBORDecodeContext *me,
+                                      const QCBORItem    *pArray,
+                                      double             *pdValues,
+                                      size_t              uMaxValues,
+                                      size_t             *puNumValues)
+{
+   return GetNumberArray(me, pArray, NULL, pdValues, uMaxValues, puNumValues);
 }
 
 
+
 /*
- Internal function for an allocation, reallocation free and destuct.
+ Put one decoded value in the member of the structure for its field.
+ */
+static QCBORError SetRecordMember(const QCBORItem *pItem, uint8_t uType, void *pMember)
+{
+   const uint8_t uDataType = pItem->uDataType;
+
+   switch(uType) {
+      case QCBOR_RECORD_INT64:
+      case QCBOR_RECORD_INT32:
+         if(uDataType == QCBOR_TYPE_UINT64) {
+            return QCBOR_ERR_INT_OVERFLOW;
+         } else if(uDataType != QCBOR_TYPE_INT64) {
+            return QCBOR_ERR_UNEXPECTED_TYPE;
+         }
+         if(uType == QCBOR_RECORD_INT64) {
+            *(int64_t *)pMember = pItem->val.int64;
+         } else if(pItem->val.int64 < INT32_MIN || pItem->val.int64 > INT32_MAX) {
+            return QCBOR_ERR_INT_OVERFLOW;
+         } else {
+            *(int32_t *)pMember = (int32_t)pItem->val.int64;
+         }
+         break;
+
+      case QCBOR_RECORD_UINT64:
+      case QCBOR_RECORD_UINT32:
+      {
+         uint64_t uValue;
+         if(uDataType == QCBOR_TYPE_UINT64) {
+            uValue = pItem->val.uint64;
+         } else if(uDataType == QCBOR_TYPE_INT64) {
+            if(pItem->val.int64 < 0) {
+               return QCBOR_ERR_INT_OVERFLOW;
+            }
+            uValue = (uint64_t)pItem->val.int64;
+         } else {
+            return QCBOR_ERR_UNEXPECTED_TYPE;
+         }
+         if(uType == QCBOR_RECORD_UINT64) {
+            *(uint64_t *)pMember = uValue;
+         } else if(uValue > UINT32_MAX) {
+            return QCBOR_ERR_INT_OVERFLOW;
+         } else {
+            *(uint32_t *)pMember = (uint32_t)uValue;
+         }
+         break;
+      }
+
+      case QCBOR_RECORD_DOUBLE:
+         if(uDataType == QCBOR_TYPE_DOUBLE) {
+            *(double *)pMember = pItem->val.dfnum;
+         } else if(uDataType == QCBOR_TYPE_FLOAT) {
+            *(double *)pMember = (double)pItem->val.fnum;
+         } else {
+            return QCBOR_ERR_UNEXPECTED_TYPE;
+         }
+         break;
 
- Having only one function rather than one each per mode saves space in
- QCBORDecodeContext.
+      case QCBOR_RECORD_BOOL:
+         if(uDataType != QCBOR_TYPE_TRUE && uDataType != QCBOR_TYPE_FALSE) {
+            return QCBOR_ERR_UNEXPECTED_TYPE;
+         }
+         *(bool *)pMember = uDataType == QCBOR_TYPE_TRUE;
+         break;
 
- Code Reviewers: THIS FUNCTION DOES POINTER MATH
+      case QCBOR_RECORD_TEXT:
+      case QCBOR_RECORD_BYTES:
+         if(uDataType != (uType == QCBOR_RECORD_TEXT ? QCBOR_TYPE_TEXT_STRING :
+                                                       QCBOR_TYPE_BYTE_STRING)) {
+            return QCBOR_ERR_UNEXPECTED_TYPE;
+         }
+         *(UsefulBufC *)pMember = pItem->val.string;
+         break;
+   }
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
  */
+QCBORError QCBORDecode_GetRecord(QCBORDecodeContext *me,
+                                 const QCBORRecord  *pRecord,
+                                 void               *pStruct,
+                                 uint32_t           *puFound)
+{
+   QCBORItem  Item;
+   QCBORError nReturn;
+   uint32_t   uFound = 0;
+
+   nReturn = QCBORDecode_GetNext(me, &Item);
+   if(nReturn != QCBOR_SUCCESS) {
+      goto Done;
+   }
+   if(Item.uDataType != QCBOR_TYPE_MAP) {
+      nReturn = QCBOR_ERR_UNEXPECTED_TYPE;
+      goto Done;
+   }
+
+   // The decoder ascends out of the map after its last entry, both
+   // definite and indefinite length, and doesn't descend into an
+   // empty one
+   const uint8_t uMapLevel  = Item.uNestingLevel;
+   const size_t  uNumFields = pRecord->uNumFields;
+   size_t        uNext      = 0; // Where to start looking for a label
+
+   while(DecodeNesting_GetLevel(&(me->nesting)) > uMapLevel) {
+      nReturn = QCBORDecode_GetNext(me, &Item);
+      if(nReturn != QCBOR_SUCCESS) {
+         goto Done;
+      }
+
+      size_t uField = uNumFields;
+      if(Item.uLabelType == QCBOR_TYPE_INT64) {
+         for(size_t i = 0; i < uNumFields; i++) {
+            const size_t uTry = uNext + i < uNumFields ? uNext + i : uNext + i - uNumFields;
+            if(pRecord->pFields[uTry].nLabel == Item.label.int64) {
+               uField = uTry;
+               break;
+            }
+         }
+      }
+
+      if(uField == uNumFields) {
+         // Not a field; skip it and everything in it
+         nReturn = QCBORDecode_SkipCurrent(me, &Item);
+      } else {
+         nReturn = SetRecordMember(&Item,
+                                   pRecord->pFields[uField].uType,
+                                   (uint8_t *)pStruct + pRecord->pFields[uField].uOffset);
+         uNext = uField + 1 < uNumFields ? uField + 1 : 0;
+      }
+      if(nReturn != QCBOR_SUCCESS) {
+         goto Done;
+      }
+      if(uField != uNumFields) {
+         uFound |= (uint32_t)1 << uField;
+      }
+   }
+
+Done:
+   if(puFound) {
+      *puFound = uFound;
+   }
+   return nReturn;
+}
+
+
+
+/* ===========================================================================
+   MemPool -- BUILT-IN SIMPLE STRING ALLOCATOR
+
+   This implements a simple sting allocator for indefinite length
+   strings that can be enabled by calling QCBORDecode_SetMemPool(). It
+   implements the function type QCBORStringAllocate and allows easy
+   use of it.
+
+   This particular allocator is built-in for convenience. The caller
+   can implement their own.  All of this following code will get
+   dead-stripped if QCBORDecode_SetMemPool() is not called.
+
+   This is a very primitive memory allocator. It does not track
+   individual allocations, only a high-water mark. A free or
+   reallocation must be of the last chunk allocated.
+
+   The size of the pool and offset to free memory are kept in the
+   decode context in QCBORInternalMemPool, which is the context passed
+   to MemPool_Function(). They used to be packed into the first 8 bytes
+   of the pool and unpacked on every call. Those bytes are still not
+   used for strings so the pool sizes callers have calculated with
+   QCBOR_DECODE_MIN_MEM_POOL_SIZE are the same.
+
+   The sizes are uint32_t to be the same on all CPU types and simplify
+   the code.
+   ========================================================================== */
+
+
 static UsefulBuf
-MemPool_Function(void *pPool, void *pMem, size_t uNewSize)
+MemPool_Function(void *pCtx, void *pMem, size_t uNewSize)
 {
+   QCBORInternalMemPool *pMe = (QCBORInternalMemPool *)pCtx;
    UsefulBuf ReturnValue = NULLUsefulBuf;
 
-   uint32_t uPoolSize;
-   uint32_t uFreeOffset;
-
    if(uNewSize > UINT32_MAX) {
       // This allocator is only good up to 4GB.  This check should
       // optimize out if sizeof(size_t) == sizeof(uint32_t)
@@ -1646,9 +4681,7 @@ MemPool_Function(void *pPool, void *pMem, size_t uNewSize)
    }
    const uint32_t uNewSize32 = (uint32_t)uNewSize;
 
-   if(MemPool_Unpack(pPool, &uPoolSize, &uFreeOffset)) {
-      goto Done;
-   }
+   uint8_t *pPool = pMe->pPool;
 
    if(uNewSize) {
       if(pMem) {
@@ -1657,28 +4690,28 @@ MemPool_Function(void *pPool, void *pMem, size_t uNewSize)
          // assumed that pPool + uPoolSize won't wrap around by
          // assuming the caller won't pass a pool buffer in that is
          // not in legitimate memory space.
-         const void *pPoolEnd = (uint8_t *)pPool + uPoolSize;
+         const void *pPoolEnd = pPool + pMe->uPoolSize;
 
          // Check that the pointer for reallocation is in the range of the
          // pool. This also makes sure that pointer math further down
          // doesn't wrap under or over.
-         if(pMem >= pPool && pMem < pPoolEnd) {
+         if(pMem >= (void *)pPool && pMem < pPoolEnd) {
             // Offset to start of chunk for reallocation. This won't
             // wrap under because of check that pMem >= pPool.  Cast
             // is safe because the pool is always less than UINT32_MAX
             // because of check in QCBORDecode_SetMemPool().
-            const uint32_t uMemOffset = (uint32_t)((uint8_t *)pMem - (uint8_t *)pPool);
+            const uint32_t uMemOffset = (uint32_t)((uint8_t *)pMem - pPool);
 
             // Check to see if the allocation will fit. uPoolSize -
             // uMemOffset will not wrap under because of check that
             // pMem is in the range of the uPoolSize by check above.
-            if(uNewSize <= uPoolSize - uMemOffset) {
+            if(uNewSize <= pMe->uPoolSize - uMemOffset) {
                ReturnValue.ptr = pMem;
                ReturnValue.len = uNewSize;
 
                // Addition won't wrap around over because uNewSize was
                // checked to be sure it is less than the pool size.
-               uFreeOffset = uMemOffset + uNewSize32;
+               pMe->uFreeOffset = uMemOffset + uNewSize32;
             }
          }
       } else {
@@ -1687,10 +4720,10 @@ MemPool_Function(void *pPool, void *pMem, size_t uNewSize)
          // pool implementation makes sure uFreeOffset is always
          // smaller than uPoolSize through this check here and
          // reallocation case.
-         if(uNewSize <= uPoolSize - uFreeOffset) {
+         if(uNewSize <= pMe->uPoolSize - pMe->uFreeOffset) {
             ReturnValue.len = uNewSize;
-            ReturnValue.ptr = (uint8_t *)pPool + uFreeOffset;
-            uFreeOffset    += (uint32_t)uNewSize;
+            ReturnValue.ptr = pPool + pMe->uFreeOffset;
+            pMe->uFreeOffset += uNewSize32;
          }
       }
    } else {
@@ -1698,16 +4731,13 @@ MemPool_Function(void *pPool, void *pMem, size_t uNewSize)
          // FREE MODE
          // Cast is safe because of limit on pool size in
          // QCBORDecode_SetMemPool()
-         uFreeOffset = (uint32_t)((uint8_t *)pMem - (uint8_t *)pPool);
+         pMe->uFreeOffset = (uint32_t)((uint8_t *)pMem - pPool);
       } else {
          // DESTRUCT MODE
          // Nothing to do for this allocator
       }
    }
 
-   UsefulBuf Pool = {pPool, uPoolSize};
-   MemPool_Pack(Pool, uFreeOffset);
-
 Done:
    return ReturnValue;
 }
@@ -1720,29 +4750,250 @@ QCBORError QCBORDecode_SetMemPool(QCBORDecodeContext *pMe,
                                   UsefulBuf Pool,
                                   bool bAllStrings)
 {
-   // The pool size and free mem offset are packed into the beginning
-   // of the pool memory. This compile time check make sure the
-   // constant in the header is correct.  This check should optimize
-   // down to nothing.
-   if(QCBOR_DECODE_MIN_MEM_POOL_SIZE < 2 * sizeof(uint32_t)) {
-      return QCBOR_ERR_BUFFER_TOO_SMALL;
-   }
-
-   // The pool size and free offset packed in to the beginning of pool
-   // memory are only 32-bits. This check will optimize out on 32-bit
-   // machines.
+   // The pool size and free offset are only 32-bits. This check will
+   // optimize out on 32-bit machines.
    if(Pool.len > UINT32_MAX) {
       return QCBOR_ERR_BUFFER_TOO_LARGE;
    }
 
    // This checks that the pool buffer given is big enough.
-   if(MemPool_Pack(Pool, QCBOR_DECODE_MIN_MEM_POOL_SIZE)) {
+   if(Pool.ptr == NULL || Pool.len < QCBOR_DECODE_MIN_MEM_POOL_SIZE) {
       return QCBOR_ERR_BUFFER_TOO_SMALL;
    }
 
+   pMe->MemPool.pPool       = Pool.ptr;
+   // Cast is safe because of check above
+   pMe->MemPool.uPoolSize   = (uint32_t)Pool.len;
+   pMe->MemPool.uFreeOffset = QCBOR_DECODE_MIN_MEM_POOL_SIZE;
+
    pMe->StringAllocator.pfAllocator    = MemPool_Function;
-   pMe->StringAllocator.pAllocateCxt  = Pool.ptr;
+   pMe->StringAllocator.pAllocateCxt  = &(pMe->MemPool);
    pMe->bStringAllocateAll             = bAllStrings;
 
    return QCBOR_SUCCESS;
 }
+
+
+
+/* ===========================================================================
+   Arena -- BUILT-IN GROWABLE STRING ALLOCATOR
+
+   This is a string allocator like MemPool that allocates by bumping an
+   offset, but it gets its memory in slabs from a backing allocator
+   given by the caller so it never runs out of space in some fixed
+   buffer. It is set up with QCBORArena_Init() and
+   QCBORDecode_SetArena().
+
+   QCBORArena_Reset() goes back to the start of the first slab. The
+   slabs are kept, so once an arena has grown to fit the messages
+   being decoded, decoding more of them allocates nothing from the
+   backing allocator. QCBORArena_Free() gives them back.
+
+   Like MemPool, only the last allocation can be reallocated or freed,
+   which is all the decoder does. A reallocation that doesn't fit in
+   the current slab moves the allocation to a new slab.
+
+   Each slab starts with a QCBORArenaSlab header followed by the memory
+   allocated from. All of this code will be dead-stripped if
+   QCBORArena_Init() is not called.
+   ========================================================================== */
+
+struct _QCBORArenaSlab {
+   struct _QCBORArenaSlab *pNext;
+   size_t                  uDataSize; // Bytes after the header
+};
+
+#define ARENA_SLAB_DATA(pSlab) ((uint8_t *)((pSlab) + 1))
+
+
+/*
+ Take uSize bytes from the current slab, the next one if the current
+ one is full or a new one from the backing allocator if neither has
+ room. Returns NULL if the backing allocator fails.
+ */
+static uint8_t *
+Arena_Take(QCBORArena *pMe, size_t uSize)
+{
+   struct _QCBORArenaSlab *pSlab = pMe->pCurrentSlab;
+
+   if(pSlab != NULL && uSize <= pSlab->uDataSize - pMe->uSlabOffset) {
+      uint8_t *pMem = ARENA_SLAB_DATA(pSlab) + pMe->uSlabOffset;
+      pMe->uSlabOffset += uSize;
+      return pMem;
+   }
+
+   // The slab after the current one is left over from before the last
+   // reset. It is used if it is big enough, otherwise a new slab goes
+   // in front of it so it can still be used later.
+   struct _QCBORArenaSlab *pNext = pSlab ? pSlab->pNext : pMe->pFirstSlab;
+
+   if(pNext == NULL || uSize > pNext->uDataSize) {
+      const size_t uDataSize = uSize > pMe->uSlabSize ? uSize : pMe->uSlabSize;
+      if(uDataSize > SIZE_MAX - sizeof(struct _QCBORArenaSlab)) {
+         return NULL;
+      }
+      UsefulBuf NewSlab = (*pMe->pfBacking)(pMe->pBackingCxt,
+                                            NULL,
+                                            sizeof(struct _QCBORArenaSlab) + uDataSize);
+      if(UsefulBuf_IsNULL(NewSlab)) {
+         return NULL;
+      }
+      struct _QCBORArenaSlab *pNewSlab = (struct _QCBORArenaSlab *)NewSlab.ptr;
+      pNewSlab->pNext     = pNext;
+      pNewSlab->uDataSize = uDataSize;
+      if(pSlab) {
+         pSlab->pNext = pNewSlab;
+      } else {
+         pMe->pFirstSlab = pNewSlab;
+      }
+      pMe->uNumSlabs++;
+      pMe->uSlabBytes += NewSlab.len;
+      pNext = pNewSlab;
+   }
+
+   pMe->pCurrentSlab = pNext;
+   pMe->uSlabOffset  = uSize;
+
+   return ARENA_SLAB_DATA(pNext);
+}
+
+
+static UsefulBuf
+Arena_Function(void *pCtx, void *pMem, size_t uNewSize)
+{
+   QCBORArena *pMe         = (QCBORArena *)pCtx;
+   UsefulBuf   ReturnValue = NULLUsefulBuf;
+
+   // True if the last allocation is the one just before the free
+   // space in the current slab so it can be grown or freed in place
+   const bool bLastIsAtEnd = pMe->pLast != NULL &&
+                             pMe->pLast + pMe->uLastLen ==
+                                ARENA_SLAB_DATA(pMe->pCurrentSlab) + pMe->uSlabOffset;
+
+   if(uNewSize == 0) {
+      if(pMem != NULL && pMem == pMe->pLast) {
+         // FREE MODE
+         if(bLastIsAtEnd) {
+            pMe->uSlabOffset -= pMe->uLastLen;
+         }
+         pMe->uBytesInUse -= pMe->uLastLen;
+         pMe->pLast        = NULL;
+      }
+      // DESTRUCT MODE and frees of anything but the last allocation
+      // do nothing. QCBORArena_Reset() gets the memory back.
+      goto Done;
+   }
+
+   uint8_t *pNewMem;
+   if(pMem) {
+      // REALLOCATION MODE
+      if(pMem != pMe->pLast) {
+         goto Done;
+      }
+      pMe->uReallocations++;
+
+      if(bLastIsAtEnd &&
+         uNewSize <= pMe->pCurrentSlab->uDataSize - (pMe->uSlabOffset - pMe->uLastLen)) {
+         // Grow or shrink in place
+         pMe->uSlabOffset = pMe->uSlabOffset - pMe->uLastLen + uNewSize;
+         pNewMem          = pMe->pLast;
+      } else {
+         pNewMem = Arena_Take(pMe, uNewSize);
+         if(pNewMem == NULL) {
+            goto Done;
+         }
+         memcpy(pNewMem, pMe->pLast, pMe->uLastLen < uNewSize ? pMe->uLastLen : uNewSize);
+      }
+      pMe->uBytesInUse -= pMe->uLastLen;
+   } else {
+      // ALLOCATION MODE
+      pNewMem = Arena_Take(pMe, uNewSize);
+      if(pNewMem == NULL) {
+         goto Done;
+      }
+      pMe->uAllocations++;
+   }
+
+   pMe->pLast        = pNewMem;
+   pMe->uLastLen     = uNewSize;
+   pMe->uBytesInUse += uNewSize;
+   if(pMe->uBytesInUse > pMe->uHighWater) {
+      pMe->uHighWater = pMe->uBytesInUse;
+   }
+
+   ReturnValue.ptr = pNewMem;
+   ReturnValue.len = uNewSize;
+
+Done:
+   return ReturnValue;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORArena_Init(QCBORArena          *pArena,
+                     QCBORStringAllocate  pfBacking,
+                     void                *pBackingCxt,
+                     size_t               uSlabSize)
+{
+   memset(pArena, 0, sizeof(QCBORArena));
+   pArena->pfBacking   = pfBacking;
+   pArena->pBackingCxt = pBackingCxt;
+   pArena->uSlabSize   = uSlabSize ? uSlabSize : QCBOR_ARENA_DEFAULT_SLAB_SIZE;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORDecode_SetArena(QCBORDecodeContext *pMe, QCBORArena *pArena, bool bAllStrings)
+{
+   QCBORDecode_SetUpAllocator(pMe, Arena_Function, pArena, bAllStrings);
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORArena_Reset(QCBORArena *pArena)
+{
+   pArena->pCurrentSlab = NULL;
+   pArena->uSlabOffset  = 0;
+   pArena->pLast        = NULL;
+   pArena->uBytesInUse  = 0;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORArena_Free(QCBORArena *pArena)
+{
+   struct _QCBORArenaSlab *pSlab = pArena->pFirstSlab;
+
+   while(pSlab != NULL) {
+      struct _QCBORArenaSlab *pNext = pSlab->pNext;
+      (*pArena->pfBacking)(pArena->pBackingCxt, pSlab, 0);
+      pSlab = pNext;
+   }
+
+   QCBORArena_Reset(pArena);
+   pArena->pFirstSlab = NULL;
+   pArena->uNumSlabs  = 0;
+   pArena->uSlabBytes = 0;
+}
+
+
+/*
+ Public function, see header qcbor/qcbor_decode.h file
+ */
+void QCBORArena_GetStats(const QCBORArena *pArena, QCBORArenaStats *pStats)
+{
+   pStats->uBytesInUse    = pArena->uBytesInUse;
+   pStats->uHighWater     = pArena->uHighWater;
+   pStats->uSlabBytes     = pArena->uSlabBytes;
+   pStats->uNumSlabs      = pArena->uNumSlabs;
+   pStats->uAllocations   = pArena->uAllocations;
+   pStats->uReallocations = pArena->uReallocations;
+}
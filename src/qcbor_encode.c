@@ -74,7 +74,7 @@ inline static void Nesting_Init(QCBORTrackNesting *pNesting)
 
 inline static uint8_t Nesting_Increase(QCBORTrackNesting *pNesting,
                                           uint8_t uMajorType,
-                                          uint32_t uPos)
+                                          QCBOROffset uPos)
 {
    if(pNesting->pCurrentNesting == &pNesting->pArrays[QCBOR_MAX_ARRAY_NESTING]) {
       // Trying to open one too many
@@ -84,6 +84,7 @@ inline static uint8_t Nesting_Increase(QCBORTrackNesting *pNesting,
       pNesting->pCurrentNesting->uCount     = 0;
       pNesting->pCurrentNesting->uStart     = uPos;
       pNesting->pCurrentNesting->uMajorType = uMajorType;
+      pNesting->pCurrentNesting->uFlushed   = 0;
       return QCBOR_SUCCESS;
    }
 }
@@ -93,18 +94,24 @@ inline static void Nesting_Decrease(QCBORTrackNesting *pNesting)
    pNesting->pCurrentNesting--;
 }
 
-inline static uint8_t Nesting_Increment(QCBORTrackNesting *pNesting)
+inline static uint8_t Nesting_IncrementBy(QCBORTrackNesting *pNesting, size_t uNumItems)
 {
-   if(1 >= QCBOR_MAX_ITEMS_IN_ARRAY - pNesting->pCurrentNesting->uCount) {
+   if(uNumItems >= (size_t)(QCBOR_MAX_ITEMS_IN_ARRAY - pNesting->pCurrentNesting->uCount)) {
       return QCBOR_ERR_ARRAY_TOO_LONG;
    }
 
-   pNesting->pCurrentNesting->uCount++;
+   // Cast is safe because of the check above
+   pNesting->pCurrentNesting->uCount = (QCBORCount)(pNesting->pCurrentNesting->uCount + uNumItems);
 
    return QCBOR_SUCCESS;
 }
 
-inline static uint16_t Nesting_GetCount(QCBORTrackNesting *pNesting)
+inline static uint8_t Nesting_Increment(QCBORTrackNesting *pNesting)
+{
+   return Nesting_IncrementBy(pNesting, 1);
+}
+
+inline static QCBORCount Nesting_GetCount(QCBORTrackNesting *pNesting)
 {
    // The nesting count recorded is always the actual number of individiual
    // data items in the array or map. For arrays CBOR uses the actual item
@@ -115,14 +122,14 @@ inline static uint16_t Nesting_GetCount(QCBORTrackNesting *pNesting)
    // type, hence uDivisor is either 1 or 2.
 
    if(pNesting->pCurrentNesting->uMajorType == CBOR_MAJOR_TYPE_MAP) {
-      // Cast back to uint16_t after integer promotion for bit shift
-      return (uint16_t)(pNesting->pCurrentNesting->uCount >> 1);
+      // Cast back to QCBORCount after integer promotion for bit shift
+      return (QCBORCount)(pNesting->pCurrentNesting->uCount >> 1);
    } else {
       return pNesting->pCurrentNesting->uCount;
    }
 }
 
-inline static uint32_t Nesting_GetStartPos(QCBORTrackNesting *pNesting)
+inline static QCBOROffset Nesting_GetStartPos(QCBORTrackNesting *pNesting)
 {
    return pNesting->pCurrentNesting->uStart;
 }
@@ -137,6 +144,431 @@ inline static bool Nesting_IsInNest(QCBORTrackNesting *pNesting)
    return pNesting->pCurrentNesting == &pNesting->pArrays[0] ? false : true;
 }
 
+inline static uint8_t Nesting_GetLevel(QCBORTrackNesting *pNesting)
+{
+   // Can't be more than QCBOR_MAX_ARRAY_NESTING1 so the cast is safe
+   return (uint8_t)(pNesting->pCurrentNesting - &pNesting->pArrays[0]);
+}
+
+inline static bool Nesting_IsFlushed(QCBORTrackNesting *pNesting)
+{
+   return pNesting->pCurrentNesting->uFlushed ? true : false;
+}
+
+
+
+
+/*
+ No-slide mode, QCBOR_ENCODE_CONFIG_NO_SLIDE
+
+ When a map, array or bstr wrap is opened in this mode, room for the
+ largest head it could need is reserved by appending fill bytes. On
+ close the real head is written over the end of the reserved room
+ and the fill bytes before it remain. They are removed in one pass
+ over the output by RemoveNoSlideFill(), called in
+ QCBOREncode_Finish() for the whole output and in
+ QCBOREncode_CloseBstrWrap2() for the wrapped content.
+
+ The fill byte is major type 0 with the reserved additional info 28.
+ It can never be the first byte of a well-formed CBOR data item, so
+ a walk of the encoded output from one data item head to the next
+ can find all the fill bytes without any other record of where they
+ are.
+
+ The largest head for a map or array is 3 bytes because the count of
+ items is a uint16_t. The largest head for a wrapped bstr is 5 bytes
+ because the output is limited to UINT32_MAX. Both are bigger with
+ QCBOR_USE_LARGE_ARRAYS.
+ */
+#define NO_SLIDE_FILL_BYTE        0x1c
+#define NO_SLIDE_ARRAY_HEAD_SIZE (1 + sizeof(QCBORCount))
+#define NO_SLIDE_BSTR_HEAD_SIZE  (1 + sizeof(QCBOROffset))
+
+static const uint8_t spNoSlideFill[1 + sizeof(uint64_t)] = {
+   NO_SLIDE_FILL_BYTE, NO_SLIDE_FILL_BYTE, NO_SLIDE_FILL_BYTE,
+   NO_SLIDE_FILL_BYTE, NO_SLIDE_FILL_BYTE, NO_SLIDE_FILL_BYTE,
+   NO_SLIDE_FILL_BYTE, NO_SLIDE_FILL_BYTE, NO_SLIDE_FILL_BYTE
+};
+
+/*
+ The state of the sink, references, digest and string references is
+ in the extension given to QCBOREncode_SetExtension() so that the
+ context stays small when they aren't used. These are all that those
+ features cost when they are not used.
+ */
+inline static bool HasSink(const QCBOREncodeContext *me)
+{
+   return me->pExt != NULL && me->pExt->pfSink != NULL;
+}
+
+inline static bool HasDigest(const QCBOREncodeContext *me)
+{
+   return me->pExt != NULL && me->pExt->pfDigest != NULL;
+}
+
+inline static bool HasStringRefs(const QCBOREncodeContext *me)
+{
+   return me->pExt != NULL && me->pExt->pStringRefs != NULL;
+}
+
+inline static uint32_t NumRefs(const QCBOREncodeContext *me)
+{
+   return me->pExt != NULL ? me->pExt->uNumRefs : 0;
+}
+
+inline static bool IsNoSlide(QCBOREncodeContext *me)
+{
+   // Slides are limited to the staging buffer when there is a sink
+   return (me->uConfigFlags & QCBOR_ENCODE_CONFIG_NO_SLIDE) && !HasSink(me);
+}
+
+inline static size_t NoSlideHeadSize(uint8_t uMajorType)
+{
+   return uMajorType == CBOR_MAJOR_TYPE_BYTE_STRING ? NO_SLIDE_BSTR_HEAD_SIZE :
+                                                      NO_SLIDE_ARRAY_HEAD_SIZE;
+}
+
+
+/**
+ @brief Remove the no-slide mode fill bytes from some encoded CBOR.
+
+ @param[in] Storage  The output buffer.
+ @param[in] uStart   Offset of the first data item head to check.
+ @param[in] uEnd     Offset of the end of the encoded CBOR.
+
+ @return The new end offset after fill bytes are removed.
+
+ This walks the data item heads from @c uStart, skipping over the
+ content of strings, and closes up each run of fill bytes it finds.
+ The bytes between runs of fill are moved with one memmove() per run.
+
+ The encoded CBOR is expected to be well-formed because it was output
+ by this encoder. If it isn't, for example because of bad input to
+ QCBOREncode_AddEncoded(), the walk stops and the rest is kept as is.
+ It never reads or writes outside of [uStart, uEnd).
+
+ Code Reviewers: THIS FUNCTION DOES POINTER MATH
+ */
+static size_t RemoveNoSlideFill(UsefulBuf Storage, size_t uStart, size_t uEnd)
+{
+   // Number of argument bytes after the initial byte by additional info
+   static const uint8_t spArgumentLen[32] = {
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 0, 0, 0, 0
+   };
+
+   uint8_t *pBuf      = (uint8_t *)Storage.ptr;
+   size_t   uRead     = uStart; // The next head to check
+   size_t   uWrite    = uStart; // Where the current run of non-fill goes
+   size_t   uRunStart = uStart; // Start of the current run of non-fill
+
+   while(uRead < uEnd) {
+      const uint8_t uInitialByte = pBuf[uRead];
+
+      if(uInitialByte == NO_SLIDE_FILL_BYTE) {
+         // Move the run before the fill down, then skip the fill
+         if(uWrite != uRunStart) {
+            memmove(pBuf + uWrite, pBuf + uRunStart, uRead - uRunStart);
+         }
+         uWrite += uRead - uRunStart;
+         while(uRead < uEnd && pBuf[uRead] == NO_SLIDE_FILL_BYTE) {
+            uRead++;
+         }
+         uRunStart = uRead;
+         continue;
+      }
+
+      const int    nMajorType      = uInitialByte >> 5;
+      const int    nAdditionalInfo = uInitialByte & 0x1f;
+      const size_t uHeadLen        = 1 + spArgumentLen[nAdditionalInfo];
+
+      if((nMajorType == CBOR_MAJOR_TYPE_BYTE_STRING ||
+          nMajorType == CBOR_MAJOR_TYPE_TEXT_STRING) &&
+         nAdditionalInfo != LEN_IS_INDEFINITE) {
+         // Skip the string content. It may contain the fill byte.
+         if(uHeadLen > uEnd - uRead) {
+            break; // Not well-formed; keep the rest
+         }
+         uint64_t uStringLen = nAdditionalInfo < LEN_IS_ONE_BYTE ? (uint64_t)nAdditionalInfo : 0;
+         for(size_t i = 1; i < uHeadLen; i++) {
+            uStringLen = (uStringLen << 8) + pBuf[uRead + i];
+         }
+         if(uStringLen > uEnd - uRead - uHeadLen) {
+            break; // Not well-formed; keep the rest
+         }
+         uRead += (size_t)uStringLen;
+      }
+
+      // This may go past uEnd if not well-formed which ends the loop
+      uRead += uHeadLen;
+   }
+
+   // Move the last run down
+   if(uWrite != uRunStart) {
+      memmove(pBuf + uWrite, pBuf + uRunStart, uEnd - uRunStart);
+   }
+
+   return uWrite + (uEnd - uRunStart);
+}
+
+
+
+
+/*
+ Output to a sink, QCBOREncode_InitWithSink()
+
+ The UsefulOutBuf is the staging buffer. Offsets in it and in the
+ nesting are relative to the start of the staging buffer, not the
+ start of the whole encoded output. When the staging buffer is
+ flushed, what is kept is moved to the start and the offsets are
+ adjusted.
+
+ Everything before the start of the outermost open bstr wrap can be
+ flushed. Open definite-length maps and arrays that start before that
+ point get an indefinite-length head output in front of their
+ content as it is flushed, and are marked so they are closed with a
+ break.
+ */
+static void SinkWrite(QCBOREncodeContext *me, const uint8_t *pBytes, size_t uLen)
+{
+   if(me->uError == QCBOR_SUCCESS && uLen > 0) {
+      if((*me->pExt->pfSink)(me->pExt->pSinkCtx, (UsefulBufC){pBytes, uLen})) {
+         me->uError = QCBOR_ERR_SINK_WRITE;
+      } else {
+         me->pExt->uSinkBytes += uLen;
+      }
+   }
+}
+
+
+/**
+ @brief Flush as much of the staging buffer to the sink as possible.
+
+ @param me  Encoder context.
+
+ Code Reviewers: THIS FUNCTION DOES POINTER MATH
+ */
+static void SinkFlush(QCBOREncodeContext *me)
+{
+   if(me->uError != QCBOR_SUCCESS || UsefulOutBuf_GetError(&(me->OutBuf))) {
+      return;
+   }
+
+   QCBORTrackNesting *pNesting = &(me->nesting);
+   const UsefulBuf    Staging  = UsefulOutBuf_RetrieveOutputStorage(&(me->OutBuf));
+   const uint8_t     *pStaging = (const uint8_t *)Staging.ptr;
+   const size_t       uEnd     = UsefulOutBuf_GetEndPosition(&(me->OutBuf));
+
+   // Find where to stop, the outermost open bstr wrap or the end
+   size_t uLimit = uEnd;
+   for(int nLevel = 1; &pNesting->pArrays[nLevel] <= pNesting->pCurrentNesting; nLevel++) {
+      if(pNesting->pArrays[nLevel].uMajorType == CBOR_MAJOR_TYPE_BYTE_STRING) {
+         uLimit = pNesting->pArrays[nLevel].uStart;
+         break;
+      }
+   }
+
+   // Output up to the limit, with indefinite-length heads for open
+   // definite-length maps and arrays. Outer levels start earlier so
+   // their heads come first.
+   size_t uPosition = 0;
+   for(int nLevel = 1; &pNesting->pArrays[nLevel] <= pNesting->pCurrentNesting; nLevel++) {
+      const uint8_t uMajorType = pNesting->pArrays[nLevel].uMajorType;
+      const size_t  uStart     = pNesting->pArrays[nLevel].uStart;
+
+      if(uStart >= uLimit) {
+         break; // Nothing in this or inner levels is output
+      }
+      if((uMajorType == CBOR_MAJOR_TYPE_ARRAY || uMajorType == CBOR_MAJOR_TYPE_MAP) &&
+         !pNesting->pArrays[nLevel].uFlushed) {
+         const uint8_t uHead = (uint8_t)((uMajorType << 5) + LEN_IS_INDEFINITE);
+         SinkWrite(me, pStaging + uPosition, uStart - uPosition);
+         SinkWrite(me, &uHead, 1);
+         uPosition = uStart;
+         pNesting->pArrays[nLevel].uFlushed = 1;
+      }
+   }
+   SinkWrite(me, pStaging + uPosition, uLimit - uPosition);
+
+   // Keep what wasn't output at the start of the staging buffer
+   memmove(Staging.ptr, pStaging + uLimit, uEnd - uLimit);
+   UsefulOutBuf_Truncate(&(me->OutBuf), uEnd - uLimit);
+   for(int nLevel = 1; &pNesting->pArrays[nLevel] <= pNesting->pCurrentNesting; nLevel++) {
+      const QCBOROffset uStart = pNesting->pArrays[nLevel].uStart;
+      pNesting->pArrays[nLevel].uStart = uStart >= uLimit ? uStart - (QCBOROffset)uLimit : 0;
+   }
+   if(me->pExt->pfDigest != NULL) {
+      // Never before uLimit because the digested wrap is a bstr wrap
+      me->pExt->uDigestPos -= uLimit;
+   }
+}
+
+
+/*
+ Called before anything is added to the staging buffer to flush it if
+ there isn't enough room. This is all that the sink costs when there
+ is no sink.
+ */
+inline static void SinkMakeRoom(QCBOREncodeContext *me, size_t uNeeded)
+{
+   if(HasSink(me) && UsefulOutBuf_RoomLeft(&(me->OutBuf)) < uNeeded) {
+      SinkFlush(me);
+   }
+}
+
+
+
+
+/*
+ Output by reference, QCBOREncode_SetReferences()
+
+ A referenced string has its head in the output buffer, but not its
+ content. The offset of where the content would go in the output
+ buffer is recorded with it. The references are in the order they
+ were added which is the order of their offsets.
+
+ When a closed map, array or bstr wrap has its head inserted, the
+ references after the insertion point move too. A reference recorded
+ at exactly the insertion point was added before the map, array or
+ bstr wrap was opened so the head goes after it and it doesn't move.
+ */
+inline static bool ShouldReference(QCBOREncodeContext *me, size_t uLen)
+{
+   if(me->pExt == NULL ||
+      me->pExt->pRefs == NULL ||
+      uLen < me->pExt->uMinRefLen ||
+      UsefulOutBuf_GetEndPosition(&(me->OutBuf)) >= QCBOR_MAX_ARRAY_OFFSET ||
+      me->pExt->uNumRefs >= me->pExt->uMaxRefs ||
+      me->pExt->pfSink != NULL ||
+      IsNoSlide(me)) {
+      return false;
+   }
+
+   // Bstr-wrapped CBOR has to be in one piece for hashing
+   const QCBORTrackNesting *pNesting = &(me->nesting);
+   for(int nLevel = 1; &pNesting->pArrays[nLevel] <= pNesting->pCurrentNesting; nLevel++) {
+      if(pNesting->pArrays[nLevel].uMajorType == CBOR_MAJOR_TYPE_BYTE_STRING) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+/*
+ The head of the array, map or bstr wrap being closed was inserted at
+ uPosition. A reference exactly at uPosition may be the first thing
+ in it or the last thing before it was opened. It is in it if it was
+ recorded at its level or deeper.
+ */
+static void ShiftReferences(QCBOREncodeContext *me, QCBOROffset uPosition, QCBOROffset uLen)
+{
+   const uint8_t uLevel = (uint8_t)(me->nesting.pCurrentNesting - me->nesting.pArrays);
+
+   // Most recent first because those are after any insertion point
+   for(uint32_t u = me->pExt->uNumRefs; u > 0; u--) {
+      QCBOREncodeRef *pRef = &(me->pExt->pRefs[u-1]);
+      if(pRef->uOffset < uPosition ||
+         (pRef->uOffset == uPosition && pRef->uLevel < uLevel)) {
+         break;
+      }
+      pRef->uOffset += uLen;
+      pRef->uLevel   = (uint8_t)(uLevel - 1);
+   }
+}
+
+
+
+
+/*
+ Hashing of bstr-wrapped CBOR, QCBOREncode_BstrWrapWithDigest()
+
+ The wrapped CBOR is given to the digest callback in order as it
+ becomes final. uDigestPos is the offset of the first byte not given
+ yet. What comes after the start of an open definite-length map,
+ array or bstr wrap inside the digested wrap isn't final because its
+ head hasn't been written. It is given when the outermost of those is
+ closed.
+
+ In no-slide mode it is also where the fill is removed from the
+ closed map, array or bstr wrap. There isn't fill anywhere else in the
+ digested wrap so it never changes after it is given and the walk to
+ remove the fill doesn't have to go over all of the digested wrap
+ again when it is closed.
+
+ With a sink, nothing after the start of the digested wrap is flushed
+ so uDigestPos stays in the staging buffer. It is adjusted with the
+ nesting start positions by SinkFlush().
+ */
+static size_t DigestLimit(QCBOREncodeContext *me)
+{
+   const QCBORTrackNesting *pNesting = &(me->nesting);
+
+   for(int nLevel = me->pExt->uDigestLevel + 1; &pNesting->pArrays[nLevel] <= pNesting->pCurrentNesting; nLevel++) {
+      const uint8_t uMajorType = pNesting->pArrays[nLevel].uMajorType;
+      // Indefinite-length heads are output when opened
+      if(uMajorType == CBOR_MAJOR_TYPE_ARRAY ||
+         uMajorType == CBOR_MAJOR_TYPE_MAP ||
+         uMajorType == CBOR_MAJOR_TYPE_BYTE_STRING) {
+         return pNesting->pArrays[nLevel].uStart;
+      }
+   }
+
+   return UsefulOutBuf_GetEndPosition(&(me->OutBuf));
+}
+
+
+/*
+ Give what is final to the digest callback. Unless bFlush, this waits
+ until QCBOR_DIGEST_UPDATE_SIZE bytes have been output.
+ */
+static void DigestUpdate(QCBOREncodeContext *me, bool bFlush)
+{
+   if(me->uError != QCBOR_SUCCESS || UsefulOutBuf_IsBufferNULL(&(me->OutBuf))) {
+      return;
+   }
+   if(!bFlush &&
+      UsefulOutBuf_GetEndPosition(&(me->OutBuf)) - me->pExt->uDigestPos < QCBOR_DIGEST_UPDATE_SIZE) {
+      return;
+   }
+
+   const size_t uLimit = DigestLimit(me);
+   if(uLimit > me->pExt->uDigestPos) {
+      const UsefulBuf Storage = UsefulOutBuf_RetrieveOutputStorage(&(me->OutBuf));
+      (*me->pExt->pfDigest)(me->pExt->pDigestCtx,
+                      (UsefulBufC){(uint8_t *)Storage.ptr + me->pExt->uDigestPos,
+                                   uLimit - me->pExt->uDigestPos});
+      me->pExt->uDigestPos = uLimit;
+   }
+}
+
+
+/*
+ Called after a map, array or bstr wrap inside the digested wrap is
+ closed and its head is written. uStart is where it starts.
+ */
+static void DigestClosed(QCBOREncodeContext *me, size_t uStart)
+{
+   const size_t uEnd = UsefulOutBuf_GetEndPosition(&(me->OutBuf));
+
+   if(DigestLimit(me) != uEnd) {
+      // Inside another one that is still open
+      return;
+   }
+
+   if(IsNoSlide(me) &&
+      me->uError == QCBOR_SUCCESS &&
+      !UsefulOutBuf_IsBufferNULL(&(me->OutBuf))) {
+      UsefulOutBuf_Truncate(&(me->OutBuf),
+                            RemoveNoSlideFill(UsefulOutBuf_RetrieveOutputStorage(&(me->OutBuf)),
+                                              uStart,
+                                              uEnd));
+   }
+
+   DigestUpdate(me, true);
+}
+
 
 
 
@@ -192,7 +624,7 @@ inline static bool Nesting_IsInNest(QCBORTrackNesting *pNesting)
  The 8 errors returned here fall into three categories:
 
  Sizes
-   QCBOR_ERR_BUFFER_TOO_LARGE        -- Encoded output exceeded UINT32_MAX
+   QCBOR_ERR_BUFFER_TOO_LARGE        -- Encoded output exceeded QCBOR_MAX_ARRAY_OFFSET
    QCBOR_ERR_BUFFER_TOO_SMALL        -- Output buffer too small
    QCBOR_ERR_ARRAY_NESTING_TOO_DEEP  -- Nesting > QCBOR_MAX_ARRAY_NESTING1
    QCBOR_ERR_ARRAY_TOO_LONG          -- Too many things added to an array/map
@@ -218,6 +650,102 @@ void QCBOREncode_Init(QCBOREncodeContext *me, UsefulBuf Storage)
 }
 
 
+/*
+ Public function for configuration. See qcbor/qcbor_encode.h
+ */
+void QCBOREncode_Config(QCBOREncodeContext *me, uint8_t uConfigFlags)
+{
+   me->uConfigFlags = uConfigFlags;
+}
+
+
+/*
+ Public function for initialization. See qcbor/qcbor_encode.h
+ */
+void QCBOREncode_InitWithSink(QCBOREncodeContext   *me,
+                              UsefulBuf             Staging,
+                              QCBOREncodeExtension *pExt,
+                              QCBOREncodeSink       pfSink,
+                              void                 *pSinkCtx)
+{
+   QCBOREncode_Init(me, Staging);
+   QCBOREncode_SetExtension(me, pExt);
+   me->pExt->pfSink   = pfSink;
+   me->pExt->pSinkCtx = pSinkCtx;
+}
+
+
+/*
+ Public function for configuration. See qcbor/qcbor_encode.h
+ */
+void QCBOREncode_SetExtension(QCBOREncodeContext *me, QCBOREncodeExtension *pExt)
+{
+   memset(pExt, 0, sizeof(QCBOREncodeExtension));
+   me->pExt = pExt;
+}
+
+
+/*
+ Public function for configuration. See qcbor/qcbor_encode.h
+ */
+void QCBOREncode_SetReferences(QCBOREncodeContext *me,
+                               QCBOREncodeRef     *pRefs,
+                               size_t              uNumRefs,
+                               size_t              uMinRefLen)
+{
+   if(me->pExt == NULL) {
+      if(me->uError == QCBOR_SUCCESS) {
+         me->uError = QCBOR_ERR_NO_EXTENSION;
+      }
+      return;
+   }
+   me->pExt->pRefs      = pRefs;
+   // More than this many references is not practical
+   me->pExt->uMaxRefs   = uNumRefs > UINT32_MAX ? UINT32_MAX : (uint32_t)uNumRefs;
+   me->pExt->uNumRefs   = 0;
+   me->pExt->uMinRefLen = uMinRefLen;
+}
+
+
+/*
+ Public function for string references. See qcbor/qcbor_encode.h
+ */
+void QCBOREncode_OpenStringRefNamespace(QCBOREncodeContext *me,
+                                        QCBORStringRef     *pTable,
+                                        size_t              uTableSize)
+{
+   if(me->pExt == NULL || me->pExt->pStringRefs != NULL) {
+      if(me->uError == QCBOR_SUCCESS) {
+         me->uError = me->pExt == NULL ? QCBOR_ERR_NO_EXTENSION : QCBOR_ERR_STRING_REF_NESTED;
+      }
+      return;
+   }
+
+   QCBOREncode_AddTag(me, CBOR_TAG_STRING_REF_NAMESPACE);
+
+   // More than this many is not practical
+   uTableSize = uTableSize > UINT32_MAX ? UINT32_MAX : uTableSize;
+   for(size_t u = 0; u < uTableSize; u++) {
+      pTable[u].pStr = NULL;
+   }
+   me->pExt->pStringRefs       = pTable;
+   me->pExt->uStringRefsSize   = (uint32_t)uTableSize;
+   me->pExt->uStringRefsStored = 0;
+   me->pExt->uNextStringRef    = 0;
+}
+
+
+/*
+ Public function for string references. See qcbor/qcbor_encode.h
+ */
+void QCBOREncode_CloseStringRefNamespace(QCBOREncodeContext *me)
+{
+   if(me->pExt != NULL) {
+      me->pExt->pStringRefs = NULL;
+   }
+}
+
+
 /*
  Public function to encode a CBOR head. See qcbor/qcbor_encode.h
  */
@@ -422,7 +950,12 @@ static void AppendCBORHead(QCBOREncodeContext *me, uint8_t uMajorType,  uint64_t
     * no security hole introduced.
     */
 
+   SinkMakeRoom(me, EncodedHead.len);
    UsefulOutBuf_AppendUsefulBuf(&(me->OutBuf), EncodedHead);
+
+   if(HasDigest(me)) {
+      DigestUpdate(me, false);
+   }
 }
 
 
@@ -436,6 +969,13 @@ static void AppendCBORHead(QCBOREncodeContext *me, uint8_t uMajorType,  uint64_t
  When an array, map or bstr was opened, nothing was done but note
  the position. This function goes back to that position and inserts
  the CBOR Head with the major type and length.
+
+ In no-slide mode the room for the head was reserved when it was
+ opened so the head is written there instead of being inserted.
+
+ With a sink, the staging buffer is flushed first if the head won't
+ fit. If that flushed an indefinite-length head for this map or array,
+ a break is appended instead.
  */
 static void InsertCBORHead(QCBOREncodeContext *me, uint8_t uMajorType, size_t uLen)
 {
@@ -445,6 +985,15 @@ static void InsertCBORHead(QCBOREncodeContext *me, uint8_t uMajorType, size_t uL
       } else if(Nesting_GetMajorType(&(me->nesting)) != uMajorType) {
          me->uError = QCBOR_ERR_CLOSE_MISMATCH;
       } else {
+         SinkMakeRoom(me, QCBOR_HEAD_BUFFER_SIZE);
+         if(Nesting_IsFlushed(&(me->nesting))) {
+            // An indefinite-length head was output by a flush so close
+            // with a break (0xff for both arrays and maps)
+            AppendCBORHead(me, CBOR_MAJOR_TYPE_SIMPLE, CBOR_SIMPLE_BREAK, 0);
+            Nesting_Decrease(&(me->nesting));
+            return;
+         }
+
          // A stack buffer large enough for a CBOR head
          UsefulBuf_MAKE_STACK_UB (pBufferForEncodedHead,QCBOR_HEAD_BUFFER_SIZE);
 
@@ -459,9 +1008,32 @@ static void InsertCBORHead(QCBOREncodeContext *me, uint8_t uMajorType, size_t uL
           * UsefulOutBuf_InsertUsefulBuf() will do nothing so there is
           * no security whole introduced.
           */
-         UsefulOutBuf_InsertUsefulBuf(&(me->OutBuf), EncodedHead, Nesting_GetStartPos(&(me->nesting)) );
+         const QCBOROffset uStart = Nesting_GetStartPos(&(me->nesting));
+         if(IsNoSlide(me)) {
+            // Write the head into the end of the room reserved for it
+            // when opened. Nothing to write when only computing size.
+            const size_t uHeadEnd = uStart + NoSlideHeadSize(uMajorType);
+            if(!UsefulOutBuf_IsBufferNULL(&(me->OutBuf))) {
+               UsefulBuf_CopyOffset(UsefulOutBuf_RetrieveOutputStorage(&(me->OutBuf)),
+                                    uHeadEnd - EncodedHead.len,
+                                    EncodedHead);
+            }
+         } else {
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+            me->uBytesMoved += UsefulOutBuf_GetEndPosition(&(me->OutBuf)) - uStart;
+            me->uNumInserts++;
+#endif
+            UsefulOutBuf_InsertUsefulBuf(&(me->OutBuf), EncodedHead, uStart);
+            if(NumRefs(me)) {
+               ShiftReferences(me, uStart, (QCBOROffset)EncodedHead.len);
+            }
+         }
 
          Nesting_Decrease(&(me->nesting));
+
+         if(HasDigest(me)) {
+            DigestClosed(me, uStart);
+         }
       }
    }
 }
@@ -473,8 +1045,10 @@ static void InsertCBORHead(QCBOREncodeContext *me, uint8_t uMajorType, size_t uL
 void QCBOREncode_AddUInt64(QCBOREncodeContext *me, uint64_t uValue)
 {
    if(me->uError == QCBOR_SUCCESS) {
-      AppendCBORHead(me, CBOR_MAJOR_TYPE_POSITIVE_INT, uValue, 0);
+      // Count first so an error from a sink in AppendCBORHead()
+      // isn't overwritten
       me->uError = Nesting_Increment(&(me->nesting));
+      AppendCBORHead(me, CBOR_MAJOR_TYPE_POSITIVE_INT, uValue, 0);
    }
 }
 
@@ -496,13 +1070,115 @@ void QCBOREncode_AddInt64(QCBOREncodeContext *me, int64_t nNum)
          uValue = (uint64_t)nNum;
          uMajorType = CBOR_MAJOR_TYPE_POSITIVE_INT;
       }
+      me->uError = Nesting_Increment(&(me->nesting));
       AppendCBORHead(me, uMajorType, uValue, 0);
+   }
+}
 
-      me->uError = Nesting_Increment(&(me->nesting));
+
+/*
+ Append the content of a string or already-encoded CBOR after its
+ head. It goes straight to the sink, is referenced or is copied into
+ the output buffer.
+ */
+static void AppendContent(QCBOREncodeContext *me, UsefulBufC Bytes)
+{
+   SinkMakeRoom(me, Bytes.len);
+   if(HasSink(me) &&
+      UsefulOutBuf_GetEndPosition(&(me->OutBuf)) == 0 &&
+      UsefulOutBuf_RoomLeft(&(me->OutBuf)) < Bytes.len) {
+      // Too big for the staging buffer and nothing is being held
+      // back in it so it can be output without copying
+      SinkWrite(me, Bytes.ptr, Bytes.len);
+   } else if(ShouldReference(me, Bytes.len)) {
+      // Cast is safe because of the check in ShouldReference()
+      me->pExt->pRefs[me->pExt->uNumRefs].uOffset = (QCBOROffset)UsefulOutBuf_GetEndPosition(&(me->OutBuf));
+      me->pExt->pRefs[me->pExt->uNumRefs].uLevel  = (uint8_t)(me->nesting.pCurrentNesting - me->nesting.pArrays);
+      me->pExt->pRefs[me->pExt->uNumRefs].Bytes   = Bytes;
+      me->pExt->uNumRefs++;
+   } else {
+      // Actually add the bytes
+      UsefulOutBuf_AppendUsefulBuf(&(me->OutBuf), Bytes);
+      if(HasDigest(me)) {
+         DigestUpdate(me, false);
+      }
    }
 }
 
 
+/*
+ Gives a string in a string reference namespace the next reference
+ number if it is long enough for one. The decoder numbers strings the
+ same way so this must be called for every byte and text string in
+ the namespace, even those that aren't kept in the table.
+ */
+static inline bool StringRef_Number(QCBOREncodeContext *me, size_t uLen)
+{
+   if(uLen < QCBOR_Private_StringRefMinLen(me->pExt->uNextStringRef) ||
+      me->pExt->uNextStringRef == UINT32_MAX) {
+      return false;
+   }
+   me->pExt->uNextStringRef++;
+   return true;
+}
+
+
+/*
+ Looks up a string in the string reference table. Returns its
+ reference number if it was seen before. Otherwise it is numbered and
+ added to the table if there is room, and UINT32_MAX is returned.
+
+ The table is a hash table with linear probing. It is only filled to
+ three quarters so the probes stay short.
+ */
+static uint32_t StringRef_Lookup(QCBOREncodeContext *me, uint8_t uMajorType, UsefulBufC String)
+{
+   if(String.len < 3) {
+      // Never numbered
+      return UINT32_MAX;
+   }
+
+   // FNV-1a
+   uint32_t       uHash  = 2166136261U ^ uMajorType;
+   const uint8_t *pBytes = (const uint8_t *)String.ptr;
+   for(size_t u = 0; u < String.len; u++) {
+      uHash = (uHash ^ pBytes[u]) * 16777619U;
+   }
+
+   if(me->pExt->uStringRefsSize == 0) {
+      StringRef_Number(me, String.len);
+      return UINT32_MAX;
+   }
+
+   uint32_t uSlot = uHash % me->pExt->uStringRefsSize;
+   for(;;) {
+      QCBORStringRef *pEntry = &(me->pExt->pStringRefs[uSlot]);
+      if(pEntry->pStr == NULL) {
+         break;
+      }
+      if(pEntry->uLen == String.len &&
+         pEntry->uType == uMajorType &&
+         !memcmp(pEntry->pStr, String.ptr, String.len)) {
+         return pEntry->uIndex;
+      }
+      uSlot = uSlot + 1 == me->pExt->uStringRefsSize ? 0 : uSlot + 1;
+   }
+
+   // Not seen before. uSlot is the empty entry that ended the probe.
+   const uint32_t uIndex = me->pExt->uNextStringRef;
+   if(StringRef_Number(me, String.len) &&
+      me->pExt->uStringRefsStored < (uint32_t)((uint64_t)me->pExt->uStringRefsSize * 3 / 4)) {
+      me->pExt->pStringRefs[uSlot].pStr   = String.ptr;
+      me->pExt->pStringRefs[uSlot].uLen   = String.len;
+      me->pExt->pStringRefs[uSlot].uIndex = uIndex;
+      me->pExt->pStringRefs[uSlot].uType  = uMajorType;
+      me->pExt->uStringRefsStored++;
+   }
+
+   return UINT32_MAX;
+}
+
+
 /*
  Semi-private function. It is exposed to user of the interface, but
  they will usually call one of the inline wrappers rather than this.
@@ -526,22 +1202,126 @@ void QCBOREncode_AddInt64(QCBOREncodeContext *me, int64_t nNum)
 void QCBOREncode_AddBuffer(QCBOREncodeContext *me, uint8_t uMajorType, UsefulBufC Bytes)
 {
    if(me->uError == QCBOR_SUCCESS) {
+      // Update the array counting if there is any nesting at all. This
+      // is first so an error from a sink isn't overwritten.
+      me->uError = Nesting_Increment(&(me->nesting));
+
+      if(HasStringRefs(me)) {
+         if(uMajorType == CBOR_MAJOR_TYPE_BYTE_STRING ||
+            uMajorType == CBOR_MAJOR_TYPE_TEXT_STRING) {
+            const uint32_t uIndex = StringRef_Lookup(me, uMajorType, Bytes);
+            if(uIndex != UINT32_MAX) {
+               // Seen before so output a reference to it
+               AppendCBORHead(me, CBOR_MAJOR_TYPE_OPTIONAL, CBOR_TAG_STRING_REF, 0);
+               AppendCBORHead(me, CBOR_MAJOR_TYPE_POSITIVE_INT, uIndex, 0);
+               return;
+            }
+         } else if(uMajorType == CBOR_MAJOR_NONE_TYPE_BSTR_LEN_ONLY) {
+            StringRef_Number(me, Bytes.len);
+         }
+      }
+
       // If it is not Raw CBOR, add the type and the length
       if(uMajorType != CBOR_MAJOR_NONE_TYPE_RAW) {
          uint8_t uRealMajorType = uMajorType;
          if(uRealMajorType == CBOR_MAJOR_NONE_TYPE_BSTR_LEN_ONLY) {
+            if(IsNoSlide(me) || HasDigest(me)) {
+               // The fill removal pass can't skip content that isn't
+               // there and the digest can't be given it
+               me->uError = QCBOR_ERR_UNSUPPORTED;
+               return;
+            }
             uRealMajorType = CBOR_MAJOR_TYPE_BYTE_STRING;
          }
          AppendCBORHead(me, uRealMajorType, Bytes.len, 0);
       }
 
       if(uMajorType != CBOR_MAJOR_NONE_TYPE_BSTR_LEN_ONLY) {
-         // Actually add the bytes
-         UsefulOutBuf_AppendUsefulBuf(&(me->OutBuf), Bytes);
+         AppendContent(me, Bytes);
       }
+   }
+}
 
-      // Update the array counting if there is any nesting at all
-      me->uError = Nesting_Increment(&(me->nesting));
+
+/*
+ Public function for adding pre-encoded items. See qcbor/qcbor_encode.h
+ */
+void QCBOREncode_AddEncodedFragment(QCBOREncodeContext *me,
+                                    UsefulBufC          Fragment,
+                                    size_t              uNumItems)
+{
+   if(me->uError == QCBOR_SUCCESS) {
+      me->uError = Nesting_IncrementBy(&(me->nesting), uNumItems);
+      if(me->uError == QCBOR_SUCCESS) {
+         AppendContent(me, Fragment);
+      }
+   }
+}
+
+
+/*
+ Public function for adding a typed array. See qcbor/qcbor_encode.h
+
+ Code Reviewers: THIS FUNCTION DOES POINTER MATH
+ */
+void QCBOREncode_AddTypedArray(QCBOREncodeContext *me,
+                               uint8_t             uElementType,
+                               UsefulBufC          Elements,
+                               bool                bBigEndian)
+{
+   if(me->uError != QCBOR_SUCCESS) {
+      return;
+   }
+
+   const size_t uElementSize = QCBOR_Private_TypedArrayElementSize(uElementType);
+   if(uElementSize == 0 || Elements.len % uElementSize) {
+      me->uError = QCBOR_ERR_BAD_TYPED_ARRAY;
+      return;
+   }
+
+   // There is no byte order for one-byte elements. The tag with the
+   // little-endian bit set for uint8_t is for clamped arithmetic.
+   uint64_t uTag = CBOR_TAG_TYPED_ARRAY_FIRST + uElementType;
+   if(uElementSize > 1 && !bBigEndian) {
+      uTag += QCBOR_TYPED_ARRAY_LITTLE_ENDIAN_BIT;
+   }
+   QCBOREncode_AddTag(me, uTag);
+
+   if(uElementSize == 1 || !bBigEndian || QCBOR_Private_IsBigEndianHost()) {
+      QCBOREncode_AddBytes(me, Elements);
+      return;
+   }
+
+   // Swap through a small buffer so there is one append per buffer
+   // full rather than per element
+   me->uError = Nesting_Increment(&(me->nesting));
+   if(me->uError != QCBOR_SUCCESS) {
+      return;
+   }
+   AppendCBORHead(me, CBOR_MAJOR_TYPE_BYTE_STRING, Elements.len, 0);
+   if(HasStringRefs(me)) {
+      // Numbered but not kept because the bytes in the output are
+      // not the same as in Elements
+      StringRef_Number(me, Elements.len);
+   }
+
+   uint8_t        auSwapped[64];
+   const uint8_t *pElements = (const uint8_t *)Elements.ptr;
+   size_t         uDone     = 0;
+   while(uDone < Elements.len && me->uError == QCBOR_SUCCESS) {
+      size_t uChunk = Elements.len - uDone;
+      if(uChunk > sizeof(auSwapped)) {
+         // 64 is a multiple of all the element sizes
+         uChunk = sizeof(auSwapped);
+      }
+      QCBOR_Private_ReverseElements(auSwapped, pElements + uDone, uChunk, uElementSize);
+      SinkMakeRoom(me, uChunk);
+      UsefulOutBuf_AppendData(&(me->OutBuf), auSwapped, uChunk);
+      uDone += uChunk;
+   }
+
+   if(HasDigest(me)) {
+      DigestUpdate(me, false);
    }
 }
 
@@ -567,9 +1347,9 @@ void QCBOREncode_AddType7(QCBOREncodeContext *me, uint8_t uMinLen, uint64_t uNum
       if(uNum >= CBOR_SIMPLEV_RESERVED_START && uNum <= CBOR_SIMPLEV_RESERVED_END) {
          me->uError = QCBOR_ERR_UNSUPPORTED;
       } else {
+         me->uError = Nesting_Increment(&(me->nesting));
          // AppendHead() does endian swapping for the float / double
          AppendCBORHead(me, CBOR_MAJOR_TYPE_SIMPLE, uNum, uMinLen);
-         me->uError = Nesting_Increment(&(me->nesting));
       }
    }
 }
@@ -627,6 +1407,297 @@ void QCBOREncode_AddFloat(QCBOREncodeContext *me, float fNum)
 }
 
 
+/*
+ Public function to compile a record. See qcbor/qcbor_encode.h
+ */
+QCBORError QCBOREncode_CompileRecord(QCBORRecord            *pRecord,
+                                     const QCBORRecordField *pFields,
+                                     size_t                  uNumFields)
+{
+   if(uNumFields > QCBOR_MAX_RECORD_FIELDS) {
+      return QCBOR_ERR_BAD_RECORD;
+   }
+
+   UsefulBuf_MAKE_STACK_UB(HeadBuffer, QCBOR_HEAD_BUFFER_SIZE);
+   UsefulOutBuf Heads;
+   UsefulOutBuf_Init(&Heads, (UsefulBuf){pRecord->auHeads, sizeof(pRecord->auHeads)});
+
+   UsefulOutBuf_AppendUsefulBuf(&Heads, QCBOREncode_EncodeHead(HeadBuffer,
+                                                                CBOR_MAJOR_TYPE_MAP,
+                                                                0,
+                                                                uNumFields));
+   const size_t uMapHeadLen = UsefulOutBuf_GetEndPosition(&Heads);
+   size_t       uMaxFixed   = uMapHeadLen;
+
+   for(size_t i = 0; i < uNumFields; i++) {
+      const int64_t nLabel = pFields[i].nLabel;
+
+      if(pFields[i].uType < QCBOR_RECORD_INT64 || pFields[i].uType > QCBOR_RECORD_BYTES) {
+         return QCBOR_ERR_BAD_RECORD;
+      }
+      for(size_t j = 0; j < i; j++) {
+         if(pFields[j].nLabel == nLabel) {
+            return QCBOR_ERR_BAD_RECORD;
+         }
+      }
+
+      UsefulBufC Head;
+      if(nLabel < 0) {
+         // Written so INT64_MIN doesn't overflow
+         Head = QCBOREncode_EncodeHead(HeadBuffer,
+                                       CBOR_MAJOR_TYPE_NEGATIVE_INT,
+                                       0,
+                                       (uint64_t)(-(nLabel + 1)));
+      } else {
+         Head = QCBOREncode_EncodeHead(HeadBuffer,
+                                       CBOR_MAJOR_TYPE_POSITIVE_INT,
+                                       0,
+                                       (uint64_t)nLabel);
+      }
+      UsefulOutBuf_AppendUsefulBuf(&Heads, Head);
+      // Cast is safe because auHeads is less than UINT16_MAX
+      pRecord->auHeadEnd[i] = (uint16_t)UsefulOutBuf_GetEndPosition(&Heads);
+
+      // No value head is more than 9 bytes
+      uMaxFixed += Head.len + 1 + sizeof(uint64_t);
+   }
+
+   // Casts are safe because of the check of uNumFields above
+   pRecord->pFields     = pFields;
+   pRecord->uNumFields  = (uint8_t)uNumFields;
+   pRecord->uMapHeadLen = (uint8_t)uMapHeadLen;
+   pRecord->uMaxFixed   = (uint16_t)uMaxFixed;
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Write a head straight to the output buffer. The caller has checked
+ there is room. The encoding is the same as QCBOREncode_EncodeHead().
+ This is used by QCBOREncode_AddRecord() instead of AppendCBORHead()
+ so there is no stack buffer, copy or room check for each head.
+
+ Code Reviewers: THIS FUNCTION DOES POINTER MATH
+ */
+static inline uint8_t *WriteHead(uint8_t *pOut, uint8_t uMajorType, uint64_t uArgument, uint8_t uMinLen)
+{
+   int nBytes;
+   int nAdditionalInfo;
+
+   if(uArgument < CBOR_TWENTY_FOUR && uMinLen == 0) {
+      *pOut = (uint8_t)((uMajorType << 5) + (int)uArgument);
+      return pOut + 1;
+   } else if(uArgument <= UINT8_MAX && uMinLen <= 1) {
+      nBytes          = 1;
+      nAdditionalInfo = LEN_IS_ONE_BYTE;
+   } else if(uArgument <= UINT16_MAX && uMinLen <= 2) {
+      nBytes          = 2;
+      nAdditionalInfo = LEN_IS_TWO_BYTES;
+   } else if(uArgument <= UINT32_MAX && uMinLen <= 4) {
+      nBytes          = 4;
+      nAdditionalInfo = LEN_IS_FOUR_BYTES;
+   } else {
+      nBytes          = 8;
+      nAdditionalInfo = LEN_IS_EIGHT_BYTES;
+   }
+
+   *pOut++ = (uint8_t)((uMajorType << 5) + nAdditionalInfo);
+   for(int i = nBytes - 1; i >= 0; i--) {
+      pOut[i] = (uint8_t)(uArgument & 0xff);
+      uArgument >>= 8;
+   }
+   return pOut + nBytes;
+}
+
+
+static inline uint8_t *WriteInt64(uint8_t *pOut, int64_t nNum)
+{
+   if(nNum < 0) {
+      return WriteHead(pOut, CBOR_MAJOR_TYPE_NEGATIVE_INT, (uint64_t)(-(nNum + 1)), 0);
+   } else {
+      return WriteHead(pOut, CBOR_MAJOR_TYPE_POSITIVE_INT, (uint64_t)nNum, 0);
+   }
+}
+
+
+/*
+ Add a record one field at a time through the public functions. This
+ is for when the output doesn't go straight into the output buffer
+ because of a sink, digest or references, or there isn't room. It
+ gives exactly the same encoded output as the direct path.
+ */
+static void AddRecordByField(QCBOREncodeContext *me,
+                             const QCBORRecord  *pRecord,
+                             const uint8_t      *pStruct)
+{
+   QCBOREncode_OpenMap(me);
+   for(size_t i = 0; i < pRecord->uNumFields; i++) {
+      const QCBORRecordField *pField  = &(pRecord->pFields[i]);
+      const void             *pMember = pStruct + pField->uOffset;
+
+      QCBOREncode_AddInt64(me, pField->nLabel);
+      switch(pField->uType) {
+         case QCBOR_RECORD_INT64:
+            QCBOREncode_AddInt64(me, *(const int64_t *)pMember);
+            break;
+
+         case QCBOR_RECORD_INT32:
+            QCBOREncode_AddInt64(me, *(const int32_t *)pMember);
+            break;
+
+         case QCBOR_RECORD_UINT64:
+            QCBOREncode_AddUInt64(me, *(const uint64_t *)pMember);
+            break;
+
+         case QCBOR_RECORD_UINT32:
+            QCBOREncode_AddUInt64(me, *(const uint32_t *)pMember);
+            break;
+
+         case QCBOR_RECORD_DOUBLE:
+            QCBOREncode_AddDouble(me, *(const double *)pMember);
+            break;
+
+         case QCBOR_RECORD_BOOL:
+            QCBOREncode_AddBool(me, *(const bool *)pMember);
+            break;
+
+         case QCBOR_RECORD_TEXT:
+            QCBOREncode_AddText(me, *(const UsefulBufC *)pMember);
+            break;
+
+         default: // QCBOR_RECORD_BYTES
+            QCBOREncode_AddBytes(me, *(const UsefulBufC *)pMember);
+            break;
+      }
+   }
+   QCBOREncode_CloseMap(me);
+}
+
+
+/*
+ Public function for adding a record. See qcbor/qcbor_encode.h
+
+ Code Reviewers: THIS FUNCTION DOES POINTER MATH
+ */
+void QCBOREncode_AddRecord(QCBOREncodeContext *me,
+                           const QCBORRecord  *pRecord,
+                           const void         *pStruct)
+{
+   if(me->uError != QCBOR_SUCCESS) {
+      return;
+   }
+
+   const uint8_t *pBase = (const uint8_t *)pStruct;
+
+   // The content of strings is the only part that isn't known from
+   // compiling the record
+   size_t uMaxLen  = pRecord->uMaxFixed;
+   bool   bTooLong = false;
+   for(size_t i = 0; i < pRecord->uNumFields; i++) {
+      const uint8_t uType = pRecord->pFields[i].uType;
+      if(uType == QCBOR_RECORD_TEXT || uType == QCBOR_RECORD_BYTES) {
+         const size_t uLen = ((const UsefulBufC *)(pBase + pRecord->pFields[i].uOffset))->len;
+         if(uLen > SIZE_MAX - uMaxLen) {
+            bTooLong = true;
+            break;
+         }
+         uMaxLen += uLen;
+      }
+   }
+
+   if(bTooLong ||
+      HasSink(me) ||
+      HasDigest(me) ||
+      (me->pExt != NULL && me->pExt->pRefs != NULL) ||
+      HasStringRefs(me) ||
+      UsefulOutBuf_IsBufferNULL(&(me->OutBuf)) ||
+      !UsefulOutBuf_WillItFit(&(me->OutBuf), uMaxLen)) {
+      AddRecordByField(me, pRecord, pBase);
+      return;
+   }
+
+   // The map is one item in whatever it is in. Its entries don't
+   // have to be counted because its head is already encoded.
+   me->uError = Nesting_Increment(&(me->nesting));
+   if(me->uError != QCBOR_SUCCESS) {
+      return;
+   }
+
+   uint8_t * const pStart = (uint8_t *)UsefulOutBuf_RetrieveOutputStorage(&(me->OutBuf)).ptr +
+                            UsefulOutBuf_GetEndPosition(&(me->OutBuf));
+   uint8_t *pOut = pStart;
+
+   memcpy(pOut, pRecord->auHeads, pRecord->uMapHeadLen);
+   pOut += pRecord->uMapHeadLen;
+
+   size_t uLabelStart = pRecord->uMapHeadLen;
+   for(size_t i = 0; i < pRecord->uNumFields; i++) {
+      const QCBORRecordField *pField  = &(pRecord->pFields[i]);
+      const void             *pMember = pBase + pField->uOffset;
+
+      const size_t uLabelLen = pRecord->auHeadEnd[i] - uLabelStart;
+      memcpy(pOut, pRecord->auHeads + uLabelStart, uLabelLen);
+      pOut += uLabelLen;
+      uLabelStart = pRecord->auHeadEnd[i];
+
+      switch(pField->uType) {
+         case QCBOR_RECORD_INT64:
+            pOut = WriteInt64(pOut, *(const int64_t *)pMember);
+            break;
+
+         case QCBOR_RECORD_INT32:
+            pOut = WriteInt64(pOut, *(const int32_t *)pMember);
+            break;
+
+         case QCBOR_RECORD_UINT64:
+            pOut = WriteHead(pOut, CBOR_MAJOR_TYPE_POSITIVE_INT, *(const uint64_t *)pMember, 0);
+            break;
+
+         case QCBOR_RECORD_UINT32:
+            pOut = WriteHead(pOut, CBOR_MAJOR_TYPE_POSITIVE_INT, *(const uint32_t *)pMember, 0);
+            break;
+
+         case QCBOR_RECORD_DOUBLE:
+         {
+#ifndef QCBOR_DISABLE_PREFERRED_FLOAT
+            const IEEE754_union uNum = IEEE754_DoubleToSmallest(*(const double *)pMember);
+            pOut = WriteHead(pOut, CBOR_MAJOR_TYPE_SIMPLE, uNum.uValue, uNum.uSize);
+#else
+            pOut = WriteHead(pOut,
+                             CBOR_MAJOR_TYPE_SIMPLE,
+                             UsefulBufUtil_CopyDoubleToUint64(*(const double *)pMember),
+                             sizeof(uint64_t));
+#endif
+            break;
+         }
+
+         case QCBOR_RECORD_BOOL:
+            *pOut++ = (uint8_t)((CBOR_MAJOR_TYPE_SIMPLE << 5) +
+                                (*(const bool *)pMember ? CBOR_SIMPLEV_TRUE : CBOR_SIMPLEV_FALSE));
+            break;
+
+         default: // QCBOR_RECORD_TEXT and QCBOR_RECORD_BYTES
+         {
+            const UsefulBufC String = *(const UsefulBufC *)pMember;
+            pOut = WriteHead(pOut,
+                             pField->uType == QCBOR_RECORD_TEXT ? CBOR_MAJOR_TYPE_TEXT_STRING :
+                                                                  CBOR_MAJOR_TYPE_BYTE_STRING,
+                             String.len,
+                             0);
+            if(String.len) {
+               memcpy(pOut, String.ptr, String.len);
+               pOut += String.len;
+            }
+            break;
+         }
+      }
+   }
+
+   UsefulOutBuf_Advance(&(me->OutBuf), (size_t)(pOut - pStart));
+}
+
+
 #ifndef QCBOR_CONFIG_DISABLE_EXP_AND_MANTISSA
 /*
  Semi-public function. It is exposed to the user of the interface, but
@@ -673,13 +1744,25 @@ void QCBOREncode_AddExponentAndMantissa(QCBOREncodeContext *pMe,
 */
 void QCBOREncode_OpenMapOrArray(QCBOREncodeContext *me, uint8_t uMajorType)
 {
+   if(me->uError != QCBOR_SUCCESS) {
+      // Don't overwrite an earlier error, for example from a sink
+      return;
+   }
+
+   if(uMajorType == CBOR_MAJOR_TYPE_BYTE_STRING && HasStringRefs(me)) {
+      // The strings in the wrapped CBOR would be numbered, but a
+      // decoder sees only the one byte string
+      me->uError = QCBOR_ERR_UNSUPPORTED;
+      return;
+   }
+
    // Add one item to the nesting level we are in for the new map or array
    me->uError = Nesting_Increment(&(me->nesting));
    if(me->uError == QCBOR_SUCCESS) {
       /*
        The offset where the length of an array or map will get written
        is stored in a uint32_t, not a size_t to keep stack usage
-       smaller. This checks to be sure there is no wrap around when
+       smaller, unless QCBOR_USE_LARGE_ARRAYS is defined. This checks to be sure there is no wrap around when
        recording the offset.  Note that on 64-bit machines CBOR larger
        than 4GB can be encoded as long as no array / map offsets occur
        past the 4GB mark, but the public interface says that the
@@ -699,8 +1782,14 @@ void QCBOREncode_OpenMapOrArray(QCBOREncodeContext *me, uint8_t uMajorType)
 
       } else {
          // Increase nesting level because this is a map or array.  Cast
-         // from size_t to uin32_t is safe because of check above
-         me->uError = Nesting_Increase(&(me->nesting), uMajorType, (uint32_t)uEndPosition);
+         // from size_t to QCBOROffset is safe because of check above
+         me->uError = Nesting_Increase(&(me->nesting), uMajorType, (QCBOROffset)uEndPosition);
+
+         if(IsNoSlide(me) && uMajorType <= CBOR_MAJOR_TYPE_MAP) {
+            // Reserve room for the head. Not done for the indefinite
+            // length types which are larger than CBOR_MAJOR_TYPE_MAP
+            UsefulOutBuf_AppendData(&(me->OutBuf), spNoSlideFill, NoSlideHeadSize(uMajorType));
+         }
       }
    }
 }
@@ -723,6 +1812,32 @@ void QCBOREncode_OpenMapOrArrayIndefiniteLength(QCBOREncodeContext *me, uint8_t
 }
 
 
+/*
+ Public function for bstr wrapping with hashing. See qcbor/qcbor_encode.h
+ */
+void QCBOREncode_BstrWrapWithDigest(QCBOREncodeContext *me,
+                                    QCBORDigestUpdate   pfDigest,
+                                    void               *pDigestCtx)
+{
+   if(me->pExt == NULL || me->pExt->pfDigest != NULL) {
+      if(me->uError == QCBOR_SUCCESS) {
+         me->uError = me->pExt == NULL ? QCBOR_ERR_NO_EXTENSION : QCBOR_ERR_UNSUPPORTED;
+      }
+      return;
+   }
+
+   QCBOREncode_BstrWrap(me);
+
+   if(me->uError == QCBOR_SUCCESS) {
+      me->pExt->pfDigest     = pfDigest;
+      me->pExt->pDigestCtx   = pDigestCtx;
+      me->pExt->uDigestLevel = Nesting_GetLevel(&(me->nesting));
+      // After the room for the head in no-slide mode
+      me->pExt->uDigestPos   = UsefulOutBuf_GetEndPosition(&(me->OutBuf));
+   }
+}
+
+
 /*
  Public functions for closing arrays and maps. See qcbor/qcbor_encode.h
  */
@@ -732,13 +1847,79 @@ void QCBOREncode_CloseMapOrArray(QCBOREncodeContext *me, uint8_t uMajorType)
 }
 
 
+/*
+ Close bstr wrapping in no-slide mode. The fill in the wrapped content
+ is removed first so the length is known and the content is final for
+ hashing. In size calculation mode there is no content to remove fill
+ from so the length used is what is needed for the buffer. There is
+ no fill before uFillStart which is past the start of the content
+ when it was given to a digest callback.
+ */
+static void CloseBstrWrapNoSlide(QCBOREncodeContext *me,
+                                 bool                bIncludeCBORHead,
+                                 UsefulBufC         *pWrappedCBOR,
+                                 size_t              uFillStart)
+{
+   const size_t uContentStart = Nesting_GetStartPos(&(me->nesting)) + NO_SLIDE_BSTR_HEAD_SIZE;
+   size_t       uEndPosition  = UsefulOutBuf_GetEndPosition(&(me->OutBuf));
+
+   if(me->uError == QCBOR_SUCCESS &&
+      Nesting_IsInNest(&(me->nesting)) &&
+      Nesting_GetMajorType(&(me->nesting)) == CBOR_MAJOR_TYPE_BYTE_STRING &&
+      uContentStart <= uFillStart &&
+      uFillStart <= uEndPosition &&
+      !UsefulOutBuf_IsBufferNULL(&(me->OutBuf))) {
+      uEndPosition = RemoveNoSlideFill(UsefulOutBuf_RetrieveOutputStorage(&(me->OutBuf)),
+                                       uFillStart,
+                                       uEndPosition);
+      UsefulOutBuf_Truncate(&(me->OutBuf), uEndPosition);
+   }
+
+   // Checks for close mismatch and such are in here
+   InsertCBORHead(me, CBOR_MAJOR_TYPE_BYTE_STRING, uEndPosition - uContentStart);
+
+   if(pWrappedCBOR) {
+      if(me->uError != QCBOR_SUCCESS) {
+         *pWrappedCBOR = NULLUsefulBufC;
+         return;
+      }
+      size_t uStartOfNew = uContentStart;
+      if(bIncludeCBORHead) {
+         UsefulBuf_MAKE_STACK_UB(HeadBuffer, QCBOR_HEAD_BUFFER_SIZE);
+         uStartOfNew -= QCBOREncode_EncodeHead(HeadBuffer,
+                                               CBOR_MAJOR_TYPE_BYTE_STRING,
+                                               0,
+                                               uEndPosition - uContentStart).len;
+      }
+      const UsefulBufC PartialResult = UsefulOutBuf_OutUBuf(&(me->OutBuf));
+      *pWrappedCBOR = UsefulBuf_Tail(PartialResult, uStartOfNew);
+   }
+}
+
+
 /*
  Public functions for closing bstr wrapping. See qcbor/qcbor_encode.h
  */
 void QCBOREncode_CloseBstrWrap2(QCBOREncodeContext *me, bool bIncludeCBORHead, UsefulBufC *pWrappedCBOR)
 {
+   // Flush now if needed so that positions don't move below
+   SinkMakeRoom(me, QCBOR_HEAD_BUFFER_SIZE);
+
    const size_t uInsertPosition = Nesting_GetStartPos(&(me->nesting));
-   const size_t uEndPosition    = UsefulOutBuf_GetEndPosition(&(me->OutBuf));
+   size_t       uEndPosition    = UsefulOutBuf_GetEndPosition(&(me->OutBuf));
+   size_t       uFillStart      = uInsertPosition + NO_SLIDE_BSTR_HEAD_SIZE;
+
+   if(HasDigest(me) && Nesting_GetLevel(&(me->nesting)) == me->pExt->uDigestLevel) {
+      // Closing the digested wrap. All of it is final now.
+      DigestUpdate(me, true);
+      me->pExt->pfDigest = NULL;
+      uFillStart   = me->pExt->uDigestPos;
+   }
+
+   if(IsNoSlide(me)) {
+      CloseBstrWrapNoSlide(me, bIncludeCBORHead, pWrappedCBOR, uFillStart);
+      return;
+   }
 
    // This can't go negative because the UsefulOutBuf always only grows
    // and never shrinks. UsefulOutBut itself also has defenses such that
@@ -790,9 +1971,10 @@ void QCBOREncode_CloseMapOrArrayIndefiniteLength(QCBOREncodeContext *me, uint8_t
 
 
 /*
- Public functions to finish and get the encoded result. See qcbor/qcbor_encode.h
+ Check for errors, remove fill and flush to the sink. This is all of
+ QCBOREncode_Finish() except for the check for references.
  */
-QCBORError QCBOREncode_Finish(QCBOREncodeContext *me, UsefulBufC *pEncodedCBOR)
+static QCBORError FinishOutBuf(QCBOREncodeContext *me, UsefulBufC *pEncodedCBOR)
 {
    QCBORError uReturn = QCBOREncode_GetErrorState(me);
 
@@ -805,6 +1987,26 @@ QCBORError QCBOREncode_Finish(QCBOREncodeContext *me, UsefulBufC *pEncodedCBOR)
       goto Done;
    }
 
+   if(IsNoSlide(me) && !UsefulOutBuf_IsBufferNULL(&(me->OutBuf))) {
+      // Finish may be called more than once. This does nothing the
+      // second time because all the fill is gone.
+      const size_t uEnd = RemoveNoSlideFill(UsefulOutBuf_RetrieveOutputStorage(&(me->OutBuf)),
+                                            0,
+                                            UsefulOutBuf_GetEndPosition(&(me->OutBuf)));
+      UsefulOutBuf_Truncate(&(me->OutBuf), uEnd);
+   }
+
+   if(HasSink(me)) {
+      // Nothing is open so this outputs everything
+      SinkFlush(me);
+      uReturn = (QCBORError)me->uError;
+      if(uReturn != QCBOR_SUCCESS) {
+         goto Done;
+      }
+      *pEncodedCBOR = (UsefulBufC){NULL, me->pExt->uSinkBytes};
+      goto Done;
+   }
+
    *pEncodedCBOR = UsefulOutBuf_OutUBuf(&(me->OutBuf));
 
 Done:
@@ -812,6 +2014,22 @@ Done:
 }
 
 
+/*
+ Public functions to finish and get the encoded result. See qcbor/qcbor_encode.h
+ */
+QCBORError QCBOREncode_Finish(QCBOREncodeContext *me, UsefulBufC *pEncodedCBOR)
+{
+   QCBORError uReturn = FinishOutBuf(me, pEncodedCBOR);
+
+   if(uReturn == QCBOR_SUCCESS && NumRefs(me)) {
+      // The output buffer is not all of the output
+      uReturn = QCBOR_ERR_OUTPUT_HAS_REFERENCES;
+   }
+
+   return uReturn;
+}
+
+
 /*
  Public functions to finish and get the encoded result. See qcbor/qcbor_encode.h
  */
@@ -819,16 +2037,191 @@ QCBORError QCBOREncode_FinishGetSize(QCBOREncodeContext *me, size_t *puEncodedLe
 {
    UsefulBufC Enc;
 
-   QCBORError nReturn = QCBOREncode_Finish(me, &Enc);
+   QCBORError nReturn = FinishOutBuf(me, &Enc);
 
    if(nReturn == QCBOR_SUCCESS) {
-      *puEncodedLen = Enc.len;
+      size_t uLen = Enc.len;
+      for(uint32_t u = 0; u < NumRefs(me); u++) {
+         uLen += me->pExt->pRefs[u].Bytes.len;
+      }
+      *puEncodedLen = uLen;
    }
 
    return nReturn;
 }
 
 
+/*
+ Public functions to finish and get the encoded result. See qcbor/qcbor_encode.h
+ */
+QCBORError QCBOREncode_FinishSegments(QCBOREncodeContext *me,
+                                      UsefulBufC         *pSegments,
+                                      size_t              uNumSegments,
+                                      size_t             *puNumSegments)
+{
+   UsefulBufC Enc;
+   size_t     uSegment = 0;
+
+   QCBORError uReturn = FinishOutBuf(me, &Enc);
+   if(uReturn != QCBOR_SUCCESS) {
+      goto Done;
+   }
+
+   // Alternate between the output buffer up to the next reference and
+   // the referenced string, leaving out empty parts of the output
+   // buffer
+   const uint32_t uNumRefs  = NumRefs(me);
+   size_t         uPosition = 0;
+   for(uint32_t u = 0; u <= uNumRefs; u++) {
+      const size_t uNextOffset = u < uNumRefs ? me->pExt->pRefs[u].uOffset : Enc.len;
+      const int    nNeeded     = (uNextOffset > uPosition) + (u < uNumRefs);
+
+      if(uNumSegments - uSegment < (size_t)nNeeded) {
+         uReturn = QCBOR_ERR_BUFFER_TOO_SMALL;
+         goto Done;
+      }
+      if(uNextOffset > uPosition) {
+         pSegments[uSegment++] = UsefulBuf_Tail(UsefulBuf_Head(Enc, uNextOffset), uPosition);
+         uPosition = uNextOffset;
+      }
+      if(u < uNumRefs) {
+         pSegments[uSegment++] = me->pExt->pRefs[u].Bytes;
+      }
+   }
+
+Done:
+   *puNumSegments = uSegment;
+   return uReturn;
+}
+
+
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+/*
+ Public function. See qcbor/qcbor_encode.h
+ */
+void QCBOREncode_GetStats(QCBOREncodeContext *me, QCBOREncodeStats *pStats)
+{
+   pStats->uBytesMoved = me->uBytesMoved;
+   pStats->uNumInserts = me->uNumInserts;
+}
+#endif /* QCBOR_CONFIG_ENABLE_STATS */
+
+
+/*
+ The ring is the only thing in QCBOR shared between threads. The
+ producer and consumer each store the position they own with release
+ semantics and load the other's with acquire semantics. Acquiring
+ uRead before writing a record means the consumer is done with the
+ bytes. Acquiring uWrite before reading records means they, and
+ uWrapEnd, are all written.
+ */
+#ifdef QCBOR_RING_LOAD_ACQUIRE
+
+/*
+ Public function. See qcbor/qcbor_encode.h
+ */
+void QCBORRing_Init(QCBORRing *pRing, UsefulBuf Storage)
+{
+   pRing->pStorage  = Storage.ptr;
+   pRing->uSize     = Storage.len;
+   pRing->uWrite    = 0;
+   pRing->uRead     = 0;
+   pRing->uWrapEnd  = 0;
+   pRing->uReserved = 0;
+}
+
+
+/*
+ Public function. See qcbor/qcbor_encode.h
+
+ uWrite never catches up to uRead from below because that would look
+ the same as empty. So when the records have wrapped there must be
+ more than uMaxSize free, not just uMaxSize.
+ */
+QCBORError QCBORRing_StartRecord(QCBORRing *pRing, QCBOREncodeContext *pCtx, size_t uMaxSize)
+{
+   const size_t uRead  = QCBOR_RING_LOAD_ACQUIRE(&(pRing->uRead));
+   const size_t uWrite = pRing->uWrite;
+
+   if(uWrite >= uRead) {
+      // Free is from uWrite to the end and from the start to uRead
+      if(pRing->uSize - uWrite >= uMaxSize) {
+         pRing->uReserved = uWrite;
+      } else if(uRead > uMaxSize) {
+         pRing->uReserved = 0;
+      } else {
+         return QCBOR_ERR_RING_FULL;
+      }
+   } else {
+      // Free is from uWrite to uRead
+      if(uRead - uWrite > uMaxSize) {
+         pRing->uReserved = uWrite;
+      } else {
+         return QCBOR_ERR_RING_FULL;
+      }
+   }
+
+   QCBOREncode_Init(pCtx, (UsefulBuf){pRing->pStorage + pRing->uReserved, uMaxSize});
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Public function. See qcbor/qcbor_encode.h
+ */
+QCBORError QCBORRing_PublishRecord(QCBORRing *pRing, QCBOREncodeContext *pCtx)
+{
+   UsefulBufC Record;
+
+   QCBORError uErr = QCBOREncode_Finish(pCtx, &Record);
+   if(uErr != QCBOR_SUCCESS) {
+      return uErr;
+   }
+
+   if(pRing->uReserved != pRing->uWrite) {
+      // Went back to the start. The consumer only reads this after
+      // the store of uWrite below.
+      pRing->uWrapEnd = pRing->uWrite;
+   }
+   QCBOR_RING_STORE_RELEASE(&(pRing->uWrite), pRing->uReserved + Record.len);
+
+   return QCBOR_SUCCESS;
+}
+
+
+/*
+ Public function. See qcbor/qcbor_encode.h
+ */
+UsefulBufC QCBORRing_Peek(QCBORRing *pRing)
+{
+   const size_t uWrite = QCBOR_RING_LOAD_ACQUIRE(&(pRing->uWrite));
+   size_t       uRead  = pRing->uRead;
+
+   if(uRead > uWrite) {
+      // The producer went back to the start
+      if(uRead != pRing->uWrapEnd) {
+         return (UsefulBufC){pRing->pStorage + uRead, pRing->uWrapEnd - uRead};
+      }
+      uRead = 0;
+      QCBOR_RING_STORE_RELEASE(&(pRing->uRead), uRead);
+   }
+
+   return (UsefulBufC){pRing->pStorage + uRead, uWrite - uRead};
+}
+
+
+/*
+ Public function. See qcbor/qcbor_encode.h
+ */
+void QCBORRing_Consume(QCBORRing *pRing, size_t uBytes)
+{
+   QCBOR_RING_STORE_RELEASE(&(pRing->uRead), pRing->uRead + uBytes);
+}
+
+#endif /* QCBOR_RING_LOAD_ACQUIRE */
+
+
 
 
 /*
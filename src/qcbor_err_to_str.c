@@ -41,6 +41,29 @@ const char *qcbor_err_to_str(QCBORError err) {
 	_ERR_TO_STR(ERR_NO_MORE_ITEMS)
 	_ERR_TO_STR(ERR_BAD_EXP_AND_MANTISSA)
 	_ERR_TO_STR(ERR_STRING_TOO_LONG)
+	_ERR_TO_STR(ERR_FLOAT_DATE_UNSUPPORTED)
+	_ERR_TO_STR(ERR_HALF_PRECISION_UNSUPPORTED)
+	_ERR_TO_STR(ERR_SINK_WRITE)
+	_ERR_TO_STR(ERR_NEED_MORE_DATA)
+	_ERR_TO_STR(ERR_MAP_NOT_ENTERED)
+	_ERR_TO_STR(ERR_INDEX_TOO_SMALL)
+	_ERR_TO_STR(ERR_LABEL_NOT_FOUND)
+	_ERR_TO_STR(ERR_OUTPUT_HAS_REFERENCES)
+	_ERR_TO_STR(ERR_BAD_TYPED_ARRAY)
+	_ERR_TO_STR(ERR_UNEXPECTED_TYPE)
+	_ERR_TO_STR(ERR_BAD_QUERY)
+	_ERR_TO_STR(ERR_INDEF_LEN_STRINGS_DISABLED)
+	_ERR_TO_STR(ERR_INDEF_LEN_ARRAYS_DISABLED)
+	_ERR_TO_STR(ERR_TAGS_DISABLED)
+	_ERR_TO_STR(ERR_BAD_RECORD)
+	_ERR_TO_STR(ERR_BAD_STRING_REF)
+	_ERR_TO_STR(ERR_STRING_REF_TABLE_FULL)
+	_ERR_TO_STR(ERR_STRING_REF_NESTED)
+	_ERR_TO_STR(ERR_BAD_CURSOR)
+	_ERR_TO_STR(ERR_RING_FULL)
+	_ERR_TO_STR(ERR_DUPLICATE_LABEL)
+	_ERR_TO_STR(ERR_LABEL_CHECK_FULL)
+	_ERR_TO_STR(ERR_NO_EXTENSION)
 
 	default:
 		return "Invalid error";
@@ -595,6 +595,95 @@ const char *UBUtilTests()
 }
 
 
+/* Odd size so the word-at-a-time code has a tail */
+#define BIG_BUF_SIZE 65543
+static uint8_t spBigBuf[BIG_BUF_SIZE];
+static uint8_t spBigBuf2[BIG_BUF_SIZE];
+
+const char *UBUtilBigBufferTests()
+{
+   const UsefulBufC Big = {spBigBuf, BIG_BUF_SIZE};
+   const size_t     puPositions[] = {0, 1, 7, 8, 31, 32, 33, 63, 64, 4097,
+                                     BIG_BUF_SIZE - 40, BIG_BUF_SIZE - 33,
+                                     BIG_BUF_SIZE - 32, BIG_BUF_SIZE - 31,
+                                     BIG_BUF_SIZE - 1};
+   size_t           i, uOffset;
+
+   memset(spBigBuf, 0xa5, BIG_BUF_SIZE);
+   if(UsefulBuf_IsValue(Big, 0xa5) != SIZE_MAX) {
+      return "IsValue failed to match all of big buffer";
+   }
+   for(i = 0; i < sizeof(puPositions)/sizeof(size_t); i++) {
+      spBigBuf[puPositions[i]] = 0xa4;
+      if(UsefulBuf_IsValue(Big, 0xa5) != puPositions[i]) {
+         return "IsValue failed to find non-matching byte";
+      }
+      // Not aligned and odd length
+      for(uOffset = 1; uOffset < 4; uOffset++) {
+         if(puPositions[i] < uOffset) {
+            continue;
+         }
+         const UsefulBufC Tail = UsefulBuf_Tail(Big, uOffset);
+         if(UsefulBuf_IsValue(Tail, 0xa5) != puPositions[i] - uOffset) {
+            return "IsValue failed to find non-matching byte unaligned";
+         }
+      }
+      spBigBuf[puPositions[i]] = 0xa5;
+   }
+   if(UsefulBuf_IsValue(Big, 0x5a) != 0) {
+      return "IsValue matched the wrong value";
+   }
+
+   memcpy(spBigBuf2, spBigBuf, BIG_BUF_SIZE);
+   const UsefulBufC Big2 = {spBigBuf2, BIG_BUF_SIZE};
+   if(UsefulBuf_Compare(Big, Big2)) {
+      return "Compare of big buffers failed";
+   }
+   spBigBuf2[BIG_BUF_SIZE - 1] = 0xa6;
+   if(UsefulBuf_Compare(Big, Big2) >= 0 || UsefulBuf_Compare(Big2, Big) <= 0) {
+      return "Compare of big buffers different at the end failed";
+   }
+
+   // Lots of false starts for the marker before the real one
+   static const char szPartial[] = "QCBO";
+   for(i = 0; i + sizeof(szPartial) - 1 <= BIG_BUF_SIZE; i += sizeof(szPartial) - 1) {
+      memcpy(spBigBuf + i, szPartial, sizeof(szPartial) - 1);
+   }
+   const UsefulBufC Marker = UsefulBuf_FROM_SZ_LITERAL("QCBOR");
+   if(UsefulBuf_FindBytes(Big, Marker) != SIZE_MAX) {
+      return "FindBytes found marker that isn't there";
+   }
+   for(i = 0; i < sizeof(puPositions)/sizeof(size_t); i++) {
+      if(puPositions[i] + Marker.len > BIG_BUF_SIZE) {
+         continue;
+      }
+      memcpy(spBigBuf2, spBigBuf, BIG_BUF_SIZE);
+      memcpy(spBigBuf2 + puPositions[i], Marker.ptr, Marker.len);
+      if(UsefulBuf_FindBytes(Big2, Marker) != puPositions[i]) {
+         return "FindBytes didn't find marker in big buffer";
+      }
+   }
+   // Right at the end
+   memcpy(spBigBuf2, spBigBuf, BIG_BUF_SIZE);
+   memcpy(spBigBuf2 + BIG_BUF_SIZE - Marker.len, Marker.ptr, Marker.len);
+   if(UsefulBuf_FindBytes(Big2, Marker) != BIG_BUF_SIZE - Marker.len) {
+      return "FindBytes didn't find marker at end of big buffer";
+   }
+   // Cut off by one byte
+   if(UsefulBuf_FindBytes(UsefulBuf_Head(Big2, BIG_BUF_SIZE - 1), Marker) != SIZE_MAX) {
+      return "FindBytes found marker past the end";
+   }
+
+   if(UsefulBuf_FindBytes(Big, UsefulBuf_FROM_SZ_LITERAL("R")) != SIZE_MAX ||
+      UsefulBuf_FindBytes(Big, UsefulBuf_FROM_SZ_LITERAL("O")) != 3 ||
+      UsefulBuf_FindBytes(Big, NULLUsefulBufC) != 0) {
+      return "FindBytes of one or zero bytes failed";
+   }
+
+   return NULL;
+}
+
+
 const char *  UIBTest_IntegerFormat()
 {
    UsefulOutBuf_MakeOnStack(UOB,100);
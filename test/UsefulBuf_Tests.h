@@ -43,6 +43,8 @@ const char *  UBMacroConversionsTest(void);
 
 const char *  UBUtilTests(void);
 
+const char *  UBUtilBigBufferTests(void);
+
 const char *  UIBTest_IntegerFormat(void);
 
 const char *  UBUTest_CopyUtil(void);
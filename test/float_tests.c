@@ -277,6 +277,174 @@ int32_t HalfPrecisionAgainstRFCCodeTest()
 }
 
 
+/*
+ Decode one half, single or double from hand-constructed CBOR and
+ return the bits of the resulting double. uSize is 2, 4 or 8.
+ Returns 1 (which is never a valid result here) on error.
+ */
+static uint64_t DecodeFloatBits(uint64_t uNum, uint8_t uSize)
+{
+   UsefulBuf_MAKE_STACK_UB(Storage, 9);
+   UsefulOutBuf UOB;
+   UsefulOutBuf_Init(&UOB, Storage);
+
+   switch(uSize) {
+      case 2:
+         UsefulOutBuf_AppendByte(&UOB, HALF_PREC_FLOAT + (CBOR_MAJOR_TYPE_SIMPLE << 5));
+         UsefulOutBuf_AppendUint16(&UOB, (uint16_t)uNum);
+         break;
+      case 4:
+         UsefulOutBuf_AppendByte(&UOB, SINGLE_PREC_FLOAT + (CBOR_MAJOR_TYPE_SIMPLE << 5));
+         UsefulOutBuf_AppendUint32(&UOB, (uint32_t)uNum);
+         break;
+      default:
+         UsefulOutBuf_AppendByte(&UOB, DOUBLE_PREC_FLOAT + (CBOR_MAJOR_TYPE_SIMPLE << 5));
+         UsefulOutBuf_AppendUint64(&UOB, uNum);
+         break;
+   }
+
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   QCBORDecode_Init(&DC, UsefulOutBuf_OutUBuf(&UOB), 0);
+   if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_DOUBLE) {
+      return 1;
+   }
+   return UsefulBufUtil_CopyDoubleToUint64(Item.val.dfnum);
+}
+
+
+/*
+ Every half-precision value is decoded and the exact bits of the
+ double are checked against a reference computed here with no
+ conversion code or instructions. Each is then encoded again with
+ preferred serialization and checked. This is the oracle for the
+ optional use of conversion instructions in ieee754.c.
+ */
+int32_t HalfPrecisionAllValuesTest()
+{
+   for(uint32_t uHalf = 0; uHalf <= 0xffff; uHalf++) {
+      const uint64_t uSign        = (uint64_t)(uHalf >> 15) << 63;
+      const uint32_t uExponent    = (uHalf >> 10) & 0x1f;
+      const uint32_t uSignificand = uHalf & 0x3ff;
+      uint64_t       uExpected;
+
+      if(uExponent == 0x1f) {
+         uExpected = uSign | 0x7ff0000000000000ULL;
+         if(uSignificand) {
+            // NaN payload aligned on the LSB and the qNaN bit copied
+            uExpected |= uSignificand & 0x1ff;
+            if(uSignificand & 0x200) {
+               uExpected |= 0x0008000000000000ULL;
+            }
+         }
+      } else {
+         // Scaling by a power of two is exact so this is the value
+         double d = uExponent ? (double)(0x400 + uSignificand) : (double)uSignificand;
+         int nScale = (uExponent ? (int)uExponent : 1) - 25;
+         while(nScale < 0) {
+            d /= 2;
+            nScale++;
+         }
+         while(nScale > 0) {
+            d *= 2;
+            nScale--;
+         }
+         uExpected = UsefulBufUtil_CopyDoubleToUint64(d) | uSign;
+      }
+
+      const uint64_t uDecoded = DecodeFloatBits(uHalf, 2);
+      if(uDecoded != uExpected) {
+         return (int32_t)(uHalf + 1);
+      }
+
+      // Subnormal half-precision is encoded as single-precision
+      UsefulBuf_MAKE_STACK_UB(Storage, 9);
+      QCBOREncodeContext EC;
+      UsefulBufC         Encoded;
+      QCBOREncode_Init(&EC, Storage);
+      QCBOREncode_AddDouble(&EC, UsefulBufUtil_CopyUint64ToDouble(uDecoded));
+      if(QCBOREncode_Finish(&EC, &Encoded)) {
+         return -1;
+      }
+      if(uExponent || !uSignificand) {
+         const uint8_t *pBytes = Encoded.ptr;
+         if(Encoded.len != 3 || (uint32_t)(pBytes[1] << 8 | pBytes[2]) != uHalf) {
+            return -(int32_t)(uHalf + 1);
+         }
+      } else if(Encoded.len != 5 || DecodeFloatBits(uDecoded, 8) != uDecoded) {
+         return -(int32_t)(uHalf + 1);
+      }
+   }
+
+   return 0;
+}
+
+
+static const uint32_t spSingles[] = {
+   0x00000001, /* Smallest subnormal */
+   0x00000401,
+   0x00400000,
+   0x007fffff, /* Largest subnormal */
+   0x80000001, /* Negative subnormal */
+   0x7f800000, /* Infinity */
+   0x7fc00000, /* qNaN */
+   0x7f800001, /* sNaN */
+   0xffc0f00f  /* Negative qNaN with payload */
+};
+
+/*
+ Decode single-precision values, including subnormals and NaNs, and
+ a sampling of all others.
+ */
+int32_t SinglePrecisionDecodeTest()
+{
+   const int32_t nNumListed = (int32_t)(sizeof(spSingles)/sizeof(uint32_t));
+   uint32_t      uSingle;
+   int32_t       nCount;
+
+   for(nCount = 0; nCount < nNumListed + 0x10000; nCount++) {
+      if(nCount < nNumListed) {
+         uSingle = spSingles[nCount];
+      } else {
+         uSingle = (uint32_t)nCount * 0x10001U + 0x1234U;
+      }
+
+      const uint64_t uSign        = (uint64_t)(uSingle >> 31) << 63;
+      const uint32_t uExponent    = (uSingle >> 23) & 0xff;
+      const uint32_t uSignificand = uSingle & 0x7fffff;
+      uint64_t       uExpected;
+
+      if(uExponent == 0xff && uSignificand) {
+         // NaN payload aligned on the LSB and the qNaN bit copied
+         uExpected = uSign | 0x7ff0000000000000ULL | (uSignificand & 0x3fffff);
+         if(uSignificand & 0x400000) {
+            uExpected |= 0x0008000000000000ULL;
+         }
+      } else if(uExponent == 0xff) {
+         uExpected = uSign | 0x7ff0000000000000ULL;
+      } else {
+         double d = uExponent ? (double)(0x800000 + uSignificand) : (double)uSignificand;
+         int nScale = (uExponent ? (int)uExponent : 1) - 150;
+         while(nScale < 0) {
+            d /= 2;
+            nScale++;
+         }
+         while(nScale > 0) {
+            d *= 2;
+            nScale--;
+         }
+         uExpected = UsefulBufUtil_CopyDoubleToUint64(d) | uSign;
+      }
+
+      if(DecodeFloatBits(uSingle, 4) != uExpected) {
+         return nCount + 1;
+      }
+   }
+
+   return 0;
+}
+
+
 /*
  Expected output from preferred serialization of some of floating-point numbers
 {"zero": 0.0,
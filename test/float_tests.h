@@ -23,6 +23,14 @@ int32_t DoubleAsSmallestTest(void);
 
 int32_t HalfPrecisionAgainstRFCCodeTest(void);
 
+/*
+ Checks decoding and encoding of every half-precision value and
+ decoding of single-precision including subnormals.
+ */
+int32_t HalfPrecisionAllValuesTest(void);
+
+int32_t SinglePrecisionDecodeTest(void);
+
 #endif /* QCBOR_DISABLE_PREFERRED_FLOAT */
 
 /*
@@ -91,14 +91,18 @@ static const struct someBinaryBytes paNotWellFormedCBOR[] = {
     {(uint8_t[]){0x9f, 0x80, 0x00}, 3},
     // Definite length array containing an unclosed indefinite array
     {(uint8_t[]){0x81, 0x9f}, 2},
+#if QCBOR_MAX_ARRAY_NESTING >= 9
     // Deeply nested definite length arrays with deepest one unclosed
     {(uint8_t[]){0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81}, 9},
+#endif
+#if QCBOR_MAX_ARRAY_NESTING >= 6
     // Deeply nested indefinite length arrays with deepest one unclosed
     {(uint8_t[]){0x9f, 0x9f, 0x9f, 0x9f, 0x9f, 0xff, 0xff, 0xff, 0xff}, 9},
     // Mixed nesting with indefinite unclosed
     {(uint8_t[]){0x9f, 0x81, 0x9f, 0x81, 0x9f, 0x9f, 0xff, 0xff, 0xff}, 9},
     // Mixed nesting with definite unclosed
     {(uint8_t[]){0x9f, 0x82, 0x9f, 0x81, 0x9f, 0x9f, 0xff, 0xff, 0xff, 0xff}, 10},
+#endif
 
 
     // The "argument" for the data item is missing bytes
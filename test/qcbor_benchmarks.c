@@ -0,0 +1,1513 @@
+/*==============================================================================
+ qcbor_benchmarks.c -- encode and decode throughput benchmarks
+
+ Copyright (c) 2026, Laurence Lundblade. All rights reserved.
+
+ SPDX-License-Identifier: BSD-3-Clause
+
+ See BSD-3-Clause license in README.md
+
+ Created on 10/14/26
+ =============================================================================*/
+
+#include "qcbor_benchmarks.h"
+#include "qcbor/qcbor_encode.h"
+#include "qcbor/qcbor_decode.h"
+#include "pose_cddl.h" /* Generated from pose.cddl by qcborcddl */
+
+
+/*
+ A corpus is defined by the function that encodes it. It is encoded
+ once on first use into static storage so it can be the input to the
+ decode benchmarks. The number of items the decoder returns for it is
+ counted at the same time and used as the item count for both the
+ encode and decode benchmarks. The encode configuration flags,
+ QCBOR_ENCODE_CONFIG_XXX, are 0 for the corpus.
+ */
+typedef UsefulBufC (encode_fun_t)(UsefulBuf Buffer, uint8_t uConfigFlags);
+
+typedef struct {
+   encode_fun_t *pfEncode;
+   UsefulBuf     Storage;
+   UsefulBufC    Encoded;
+   uint32_t      uItems;
+} BenchCorpus;
+
+
+#define BENCH_NUM_INTS             4096
+#define BENCH_NUM_FLOATS           4096
+#define BENCH_NUM_INDEF_STRINGS      64
+#define BENCH_NUM_CHUNKS              8
+#define BENCH_CHUNK_SIZE             32
+#define BENCH_NUM_POSES             256
+
+static uint8_t spCOSESign1Storage[512];
+static uint8_t spCWTClaimsStorage[512];
+static uint8_t spDeepNestedStorage[1024];
+static uint8_t spIntArrayStorage[BENCH_NUM_INTS * 9 + 8];
+static uint8_t spFloatArrayStorage[BENCH_NUM_FLOATS * 9 + 8];
+static uint8_t spFloatTypedArrayStorage[BENCH_NUM_FLOATS * 8 + 16];
+static uint8_t spIndefStringsStorage[BENCH_NUM_INDEF_STRINGS *
+                                     (BENCH_NUM_CHUNKS * (BENCH_CHUNK_SIZE + 2) + 2) + 8];
+static uint8_t spPosesStorage[BENCH_NUM_POSES * 64 + 8];
+
+/* Encode output goes here rather than on the stack so it isn't
+   counted in the stack use reported by the harness. */
+static uint8_t spEncodeOutput[BENCH_NUM_INTS * 9 + 8];
+
+/* The MemPool for decoding the indefinite-length strings. */
+static uint8_t spMemPool[BENCH_NUM_INDEF_STRINGS *
+                         BENCH_NUM_CHUNKS * BENCH_CHUNK_SIZE + 1024];
+
+
+/*
+ Not a QCBOREncodeConfig flag. It tells the encode functions to output
+ through a sink with a small staging buffer. The sink copies into the
+ buffer the encode functions are given, like writing to a file would.
+ */
+#define BENCH_CONFIG_SINK 0x80
+
+/*
+ Also not a QCBOREncodeConfig flag. It tells the encode functions to
+ output strings of BENCH_MIN_REF_LEN or more by reference.
+ */
+#define BENCH_CONFIG_REFS 0x40
+#define BENCH_MIN_REF_LEN   64
+
+/*
+ Also not a QCBOREncodeConfig flag. It tells EncodePoses() to use
+ QCBOREncode_AddRecord() rather than adding the fields one by one.
+ */
+#define BENCH_CONFIG_RECORD 0x20
+
+/*
+ Also not a QCBOREncodeConfig flag. It tells EncodePoses() to use
+ Encode_pose(), which qcborcddl generated from pose.cddl.
+ */
+#define BENCH_CONFIG_CDDL 0x10
+
+static QCBOREncodeExtension sEncodeExt;
+static QCBOREncodeRef saRefs[4];
+static UsefulBufC     saSegments[2 * 4 + 1];
+
+static uint8_t spStaging[256];
+
+static int CopySink(void *pSinkCtx, UsefulBufC Bytes)
+{
+   UsefulOutBuf_AppendUsefulBuf((UsefulOutBuf *)pSinkCtx, Bytes);
+   return UsefulOutBuf_GetError((UsefulOutBuf *)pSinkCtx);
+}
+
+static void BenchEncodeInit(QCBOREncodeContext *pEC,
+                            UsefulOutBuf       *pSinkOutBuf,
+                            UsefulBuf           Buffer,
+                            uint8_t             uConfigFlags)
+{
+   if(uConfigFlags & BENCH_CONFIG_SINK) {
+      UsefulOutBuf_Init(pSinkOutBuf, Buffer);
+      QCBOREncode_InitWithSink(pEC, UsefulBuf_FROM_BYTE_ARRAY(spStaging), &sEncodeExt, CopySink, pSinkOutBuf);
+   } else {
+      QCBOREncode_Init(pEC, Buffer);
+   }
+   if(uConfigFlags & BENCH_CONFIG_REFS) {
+      QCBOREncode_SetExtension(pEC, &sEncodeExt);
+      QCBOREncode_SetReferences(pEC, saRefs, sizeof(saRefs)/sizeof(saRefs[0]), BENCH_MIN_REF_LEN);
+   }
+   QCBOREncode_Config(pEC, (uint8_t)(uConfigFlags & ~(BENCH_CONFIG_SINK |
+                                                      BENCH_CONFIG_REFS |
+                                                      BENCH_CONFIG_RECORD |
+                                                      BENCH_CONFIG_CDDL)));
+}
+
+
+/*
+ With references, the output is gathered into segments and the
+ returned length is the total of them.
+ */
+static UsefulBufC BenchEncodeFinish(QCBOREncodeContext *pEC, uint8_t uConfigFlags)
+{
+   UsefulBufC Encoded;
+
+   if(uConfigFlags & BENCH_CONFIG_REFS) {
+      size_t uNumSegments;
+      if(QCBOREncode_FinishSegments(pEC, saSegments, sizeof(saSegments)/sizeof(saSegments[0]), &uNumSegments) ||
+         QCBOREncode_FinishGetSize(pEC, &Encoded.len)) {
+         return NULLUsefulBufC;
+      }
+      Encoded.ptr = saSegments[0].ptr;
+      return Encoded;
+   }
+
+   if(QCBOREncode_Finish(pEC, &Encoded)) {
+      return NULLUsefulBufC;
+   }
+   return Encoded;
+}
+
+
+static const uint8_t spPayload[256] = {
+   0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+   0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10
+};
+
+static const uint8_t spSignature[64] = {
+   0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+   0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf
+};
+
+
+static UsefulBufC EncodeCOSESign1(UsefulBuf Buffer, uint8_t uConfigFlags)
+{
+   QCBOREncodeContext EC;
+   UsefulOutBuf       SinkOutBuf;
+   UsefulBufC         Protected;
+
+   BenchEncodeInit(&EC, &SinkOutBuf, Buffer, uConfigFlags);
+   QCBOREncode_AddTag(&EC, CBOR_TAG_COSE_SIGN1);
+   QCBOREncode_OpenArray(&EC);
+
+   /* The protected headers, bstr-wrapped */
+   QCBOREncode_BstrWrap(&EC);
+   QCBOREncode_OpenMap(&EC);
+   QCBOREncode_AddInt64ToMapN(&EC, 1, -7); /* alg: ES256 */
+   QCBOREncode_CloseMap(&EC);
+   QCBOREncode_CloseBstrWrap2(&EC, false, &Protected);
+
+   /* The unprotected headers */
+   QCBOREncode_OpenMap(&EC);
+   QCBOREncode_AddBytesToMapN(&EC, 4, UsefulBuf_FROM_SZ_LITERAL("kid-0001"));
+   QCBOREncode_CloseMap(&EC);
+
+   QCBOREncode_AddBytes(&EC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spPayload));
+   QCBOREncode_AddBytes(&EC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSignature));
+   QCBOREncode_CloseArray(&EC);
+
+   return BenchEncodeFinish(&EC, uConfigFlags);
+}
+
+
+#define CBOR_TAG_CWT 61
+
+static UsefulBufC EncodeCWTClaims(UsefulBuf Buffer, uint8_t uConfigFlags)
+{
+   QCBOREncodeContext EC;
+   UsefulOutBuf       SinkOutBuf;
+
+   BenchEncodeInit(&EC, &SinkOutBuf, Buffer, uConfigFlags);
+   QCBOREncode_AddTag(&EC, CBOR_TAG_CWT);
+   QCBOREncode_OpenMap(&EC);
+   QCBOREncode_AddSZStringToMapN(&EC, 1, "coap://as.example.com");
+   QCBOREncode_AddSZStringToMapN(&EC, 2, "erikw");
+   QCBOREncode_AddSZStringToMapN(&EC, 3, "coap://light.example.com");
+   QCBOREncode_AddDateEpochToMapN(&EC, 4, 1444064944);
+   QCBOREncode_AddDateEpochToMapN(&EC, 5, 1443944944);
+   QCBOREncode_AddDateEpochToMapN(&EC, 6, 1443944944);
+   QCBOREncode_AddBytesToMapN(&EC, 7, UsefulBuf_FROM_SZ_LITERAL("\x0b\x71"));
+   QCBOREncode_AddInt64ToMap(&EC, "seq", 8752);
+   QCBOREncode_AddBoolToMap(&EC, "debug", false);
+   QCBOREncode_AddSZStringToMap(&EC, "fw", "1.4.2-rc1");
+   QCBOREncode_OpenArrayInMap(&EC, "scope");
+   QCBOREncode_AddSZString(&EC, "read");
+   QCBOREncode_AddSZString(&EC, "write");
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_CloseMap(&EC);
+
+   return BenchEncodeFinish(&EC, uConfigFlags);
+}
+
+
+static UsefulBufC EncodeDeepNestedMaps(UsefulBuf Buffer, uint8_t uConfigFlags)
+{
+   QCBOREncodeContext EC;
+   UsefulOutBuf       SinkOutBuf;
+   UsefulBufC         Encoded;
+   int64_t            nLevel;
+
+   BenchEncodeInit(&EC, &SinkOutBuf, Buffer, uConfigFlags);
+   QCBOREncode_OpenMap(&EC);
+   for(nLevel = 1; nLevel < QCBOR_MAX_ARRAY_NESTING; nLevel++) {
+      QCBOREncode_AddInt64ToMapN(&EC, 1, nLevel);
+      QCBOREncode_AddSZStringToMapN(&EC, 2, "level");
+      QCBOREncode_AddBoolToMapN(&EC, 3, true);
+      QCBOREncode_OpenMapInMapN(&EC, 4);
+   }
+   QCBOREncode_AddInt64ToMapN(&EC, 1, nLevel);
+   QCBOREncode_AddSZStringToMapN(&EC, 2, "bottom");
+   for(nLevel = 0; nLevel < QCBOR_MAX_ARRAY_NESTING; nLevel++) {
+      QCBOREncode_CloseMap(&EC);
+   }
+
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return NULLUsefulBufC;
+   }
+   return Encoded;
+}
+
+
+static UsefulBufC EncodeIntArray(UsefulBuf Buffer, uint8_t uConfigFlags)
+{
+   QCBOREncodeContext EC;
+   UsefulOutBuf       SinkOutBuf;
+   UsefulBufC         Encoded;
+   uint32_t           u;
+
+   BenchEncodeInit(&EC, &SinkOutBuf, Buffer, uConfigFlags);
+   QCBOREncode_OpenArray(&EC);
+   for(u = 0; u < BENCH_NUM_INTS; u++) {
+      /* Shift by varying amounts to get a mix of argument sizes */
+      int64_t nValue = (int64_t)(((uint64_t)u * 2654435761U) >> (u % 40));
+      if(u & 0x01) {
+         nValue = -nValue;
+      }
+      QCBOREncode_AddInt64(&EC, nValue);
+   }
+   QCBOREncode_CloseArray(&EC);
+
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return NULLUsefulBufC;
+   }
+   return Encoded;
+}
+
+
+static UsefulBufC EncodeFloatArray(UsefulBuf Buffer, uint8_t uConfigFlags)
+{
+   QCBOREncodeContext EC;
+   UsefulOutBuf       SinkOutBuf;
+   UsefulBufC         Encoded;
+   uint32_t           u;
+
+   BenchEncodeInit(&EC, &SinkOutBuf, Buffer, uConfigFlags);
+   QCBOREncode_OpenArray(&EC);
+   for(u = 0; u < BENCH_NUM_FLOATS; u++) {
+      double d;
+      switch(u % 3) {
+         case 0: d = (double)u * 0.5; break;         /* Half when small */
+         case 1: d = (double)(float)u * 1.1f; break; /* Single */
+         default: d = (double)u / 3.0; break;        /* Double */
+      }
+      QCBOREncode_AddDouble(&EC, d);
+   }
+   QCBOREncode_CloseArray(&EC);
+
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return NULLUsefulBufC;
+   }
+   return Encoded;
+}
+
+
+/* The doubles for the typed array and the output of decoding it */
+static double spFloats[BENCH_NUM_FLOATS];
+
+/* The output of decoding the integer array into a C array */
+static int64_t spInts[BENCH_NUM_INTS];
+
+
+/*
+ The same doubles as EncodeFloatArray(), but as one big-endian RFC
+ 8746 typed array so they are byte swapped rather than encoded one by
+ one on a little-endian host.
+ */
+static UsefulBufC EncodeFloatTypedArray(UsefulBuf Buffer, uint8_t uConfigFlags)
+{
+   QCBOREncodeContext EC;
+   UsefulOutBuf       SinkOutBuf;
+   UsefulBufC         Encoded;
+   uint32_t           u;
+
+   for(u = 0; u < BENCH_NUM_FLOATS; u++) {
+      switch(u % 3) {
+         case 0: spFloats[u] = (double)u * 0.5; break;
+         case 1: spFloats[u] = (double)(float)u * 1.1f; break;
+         default: spFloats[u] = (double)u / 3.0; break;
+      }
+   }
+
+   BenchEncodeInit(&EC, &SinkOutBuf, Buffer, uConfigFlags);
+   QCBOREncode_AddTypedArray(&EC,
+                             QCBOR_TYPED_ARRAY_FLOAT64,
+                             (UsefulBufC){spFloats, sizeof(spFloats)},
+                             true);
+
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return NULLUsefulBufC;
+   }
+   return Encoded;
+}
+
+
+static UsefulBufC EncodeIndefiniteStrings(UsefulBuf Buffer, uint8_t uConfigFlags)
+{
+   UsefulOutBuf OB;
+   uint8_t      auHead[QCBOR_HEAD_BUFFER_SIZE];
+
+   (void)uConfigFlags;
+   uint8_t      auChunk[BENCH_CHUNK_SIZE];
+   uint32_t     uString;
+   uint32_t     uChunk;
+
+   for(uChunk = 0; uChunk < sizeof(auChunk); uChunk++) {
+      auChunk[uChunk] = (uint8_t)('a' + uChunk % 26);
+   }
+
+   UsefulOutBuf_Init(&OB, Buffer);
+   UsefulOutBuf_AppendUsefulBuf(&OB, QCBOREncode_EncodeHead(UsefulBuf_FROM_BYTE_ARRAY(auHead),
+                                                            CBOR_MAJOR_TYPE_ARRAY,
+                                                            0,
+                                                            BENCH_NUM_INDEF_STRINGS));
+   for(uString = 0; uString < BENCH_NUM_INDEF_STRINGS; uString++) {
+      UsefulOutBuf_AppendByte(&OB, CBOR_MAJOR_TYPE_TEXT_STRING << 5 | LEN_IS_INDEFINITE);
+      for(uChunk = 0; uChunk < BENCH_NUM_CHUNKS; uChunk++) {
+         UsefulOutBuf_AppendUsefulBuf(&OB, QCBOREncode_EncodeHead(UsefulBuf_FROM_BYTE_ARRAY(auHead),
+                                                                  CBOR_MAJOR_TYPE_TEXT_STRING,
+                                                                  0,
+                                                                  sizeof(auChunk)));
+         UsefulOutBuf_AppendData(&OB, auChunk, sizeof(auChunk));
+      }
+      UsefulOutBuf_AppendByte(&OB, CBOR_MAJOR_TYPE_SIMPLE << 5 | CBOR_SIMPLE_BREAK);
+   }
+
+   if(UsefulOutBuf_GetError(&OB)) {
+      return NULLUsefulBufC;
+   }
+   return UsefulOutBuf_OutUBuf(&OB);
+}
+
+
+/*
+ A robot pose with a time stamp and status, the kind of fixed
+ structure sent over and over on an internal link.
+ */
+typedef struct {
+   int64_t  nTime;
+   double   dX;
+   double   dY;
+   double   dTheta;
+   uint32_t uStatus;
+   bool     bMoving;
+} BenchPose;
+
+static const QCBORRecordField spPoseFields[] = {
+   QCBORField_INT64(1, BenchPose, nTime),
+   QCBORField_DOUBLE(2, BenchPose, dX),
+   QCBORField_DOUBLE(3, BenchPose, dY),
+   QCBORField_DOUBLE(4, BenchPose, dTheta),
+   QCBORField_UINT32(5, BenchPose, uStatus),
+   QCBORField_BOOL(6, BenchPose, bMoving),
+};
+
+static BenchPose   spPoses[BENCH_NUM_POSES];
+static pose        spCDDLPoses[BENCH_NUM_POSES];
+static QCBORRecord sPoseRecord;
+static bool        bPosesSetUp;
+
+static int SetUpPoses(void)
+{
+   uint32_t u;
+
+   if(bPosesSetUp) {
+      return 0;
+   }
+   for(u = 0; u < BENCH_NUM_POSES; u++) {
+      spPoses[u].nTime   = 1602000000000 + (int64_t)u * 10;
+      spPoses[u].dX      = (double)u * 0.25;       /* Half when small */
+      spPoses[u].dY      = (double)(float)u * 1.1f; /* Single */
+      spPoses[u].dTheta  = (double)u / 3.0;         /* Double */
+      spPoses[u].uStatus = u * 2654435761U >> (u % 32);
+      spPoses[u].bMoving = u & 0x01;
+
+      spCDDLPoses[u].time   = spPoses[u].nTime;
+      spCDDLPoses[u].x      = spPoses[u].dX;
+      spCDDLPoses[u].y      = spPoses[u].dY;
+      spCDDLPoses[u].theta  = spPoses[u].dTheta;
+      spCDDLPoses[u].status = spPoses[u].uStatus;
+      spCDDLPoses[u].moving = spPoses[u].bMoving;
+   }
+   if(QCBOREncode_CompileRecord(&sPoseRecord,
+                                spPoseFields,
+                                sizeof(spPoseFields)/sizeof(spPoseFields[0])) ||
+      pose_cddl_Init()) {
+      return 1;
+   }
+   bPosesSetUp = true;
+   return 0;
+}
+
+
+static UsefulBufC EncodePoses(UsefulBuf Buffer, uint8_t uConfigFlags)
+{
+   QCBOREncodeContext EC;
+   UsefulOutBuf       SinkOutBuf;
+   UsefulBufC         Encoded;
+   uint32_t           u;
+
+   if(SetUpPoses()) {
+      return NULLUsefulBufC;
+   }
+
+   BenchEncodeInit(&EC, &SinkOutBuf, Buffer, uConfigFlags);
+   QCBOREncode_OpenArray(&EC);
+   for(u = 0; u < BENCH_NUM_POSES; u++) {
+      if(uConfigFlags & BENCH_CONFIG_CDDL) {
+         Encode_pose(&EC, &spCDDLPoses[u]);
+      } else if(uConfigFlags & BENCH_CONFIG_RECORD) {
+         QCBOREncode_AddRecord(&EC, &sPoseRecord, &spPoses[u]);
+      } else {
+         QCBOREncode_OpenMap(&EC);
+         QCBOREncode_AddInt64ToMapN(&EC, 1, spPoses[u].nTime);
+         QCBOREncode_AddDoubleToMapN(&EC, 2, spPoses[u].dX);
+         QCBOREncode_AddDoubleToMapN(&EC, 3, spPoses[u].dY);
+         QCBOREncode_AddDoubleToMapN(&EC, 4, spPoses[u].dTheta);
+         QCBOREncode_AddUInt64ToMapN(&EC, 5, spPoses[u].uStatus);
+         QCBOREncode_AddBoolToMapN(&EC, 6, spPoses[u].bMoving);
+         QCBOREncode_CloseMap(&EC);
+      }
+   }
+   QCBOREncode_CloseArray(&EC);
+
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return NULLUsefulBufC;
+   }
+   return Encoded;
+}
+
+
+static BenchCorpus sCOSESign1Corpus = {
+   EncodeCOSESign1, {spCOSESign1Storage, sizeof(spCOSESign1Storage)}, {NULL, 0}, 0
+};
+static BenchCorpus sCWTClaimsCorpus = {
+   EncodeCWTClaims, {spCWTClaimsStorage, sizeof(spCWTClaimsStorage)}, {NULL, 0}, 0
+};
+static BenchCorpus sDeepNestedCorpus = {
+   EncodeDeepNestedMaps, {spDeepNestedStorage, sizeof(spDeepNestedStorage)}, {NULL, 0}, 0
+};
+static BenchCorpus sIntArrayCorpus = {
+   EncodeIntArray, {spIntArrayStorage, sizeof(spIntArrayStorage)}, {NULL, 0}, 0
+};
+static BenchCorpus sFloatArrayCorpus = {
+   EncodeFloatArray, {spFloatArrayStorage, sizeof(spFloatArrayStorage)}, {NULL, 0}, 0
+};
+static BenchCorpus sFloatTypedArrayCorpus = {
+   EncodeFloatTypedArray, {spFloatTypedArrayStorage, sizeof(spFloatTypedArrayStorage)}, {NULL, 0}, 0
+};
+static BenchCorpus sIndefStringsCorpus = {
+   EncodeIndefiniteStrings, {spIndefStringsStorage, sizeof(spIndefStringsStorage)}, {NULL, 0}, 0
+};
+static BenchCorpus sPosesCorpus = {
+   EncodePoses, {spPosesStorage, sizeof(spPosesStorage)}, {NULL, 0}, 0
+};
+
+
+static const uint64_t spCWTTags[] = {CBOR_TAG_CWT};
+
+static const QCBORTagListIn sCWTTagList = {
+   sizeof(spCWTTags)/sizeof(uint64_t), spCWTTags
+};
+
+
+/*
+ The ways the decode benchmarks get items.
+ */
+#define BENCH_DECODE_GET_NEXT  0 /* QCBORDecode_GetNext() */
+#define BENCH_DECODE_WITH_TAGS 1 /* QCBORDecode_GetNextWithTags() */
+#define BENCH_DECODE_BATCH     2 /* QCBORDecode_GetNextBatch() */
+#define BENCH_DECODE_VALIDATE  3 /* QCBORDecode_Validate(), no items */
+#define BENCH_DECODE_SKIP      4 /* QCBORDecode_SkipCurrent() of the top item */
+#define BENCH_DECODE_MOVING    5 /* QCBORDecode_GetNext() with MovingAllocate() */
+#define BENCH_DECODE_CHECKED   6 /* QCBORDecode_GetNext() with QCBORDecode_SetMapChecks() */
+
+#define BENCH_BATCH_SIZE 32
+#define BENCH_LABEL_CHECKS 256
+
+/* Static so they aren't counted as stack use of the other methods */
+static QCBORItem            saBatchItems[BENCH_BATCH_SIZE];
+static QCBORLabelCheck      saLabelChecks[BENCH_LABEL_CHECKS];
+static QCBORDecodeExtension sDecodeExt;
+
+
+/*
+ A string allocator that behaves like realloc() in a general-purpose
+ heap by always moving and copying on reallocation. It does the
+ allocations from the end of spMemPool and never frees.
+ */
+typedef struct {
+   size_t    uUsed;
+   UsefulBuf Last;
+} MovingAllocator;
+
+static MovingAllocator sMovingAllocator;
+
+static UsefulBuf MovingAllocate(void *pCtx, void *pOldMem, size_t uNewSize)
+{
+   MovingAllocator *pMe = (MovingAllocator *)pCtx;
+
+   if(uNewSize == 0 || uNewSize > sizeof(spMemPool) - pMe->uUsed) {
+      // Free, destruct or out of memory
+      return NULLUsefulBuf;
+   }
+
+   UsefulBuf NewMem = {spMemPool + pMe->uUsed, uNewSize};
+   pMe->uUsed += uNewSize;
+   if(pOldMem != NULL && pOldMem == pMe->Last.ptr) {
+      memcpy(NewMem.ptr, pOldMem, pMe->Last.len);
+   }
+   pMe->Last = NewMem;
+
+   return NewMem;
+}
+
+
+/*
+ Decode the whole of the input with one of the BENCH_DECODE_XXX
+ methods and count the items. Returns 0 on success or the QCBORError
+ plus an offset on failure.
+ */
+static int32_t DecodeAll(UsefulBufC Encoded,
+                         int        nDecodeMethod,
+                         bool       bUseMemPool,
+                         uint32_t  *puItems)
+{
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   size_t             uNumInBatch;
+   QCBORTagListOut    Tags;
+   uint64_t           puTags[4];
+   QCBORError         uErr;
+   uint32_t           uItems;
+
+   QCBORDecode_Init(&DC, Encoded, QCBOR_DECODE_MODE_NORMAL);
+   if(nDecodeMethod == BENCH_DECODE_MOVING) {
+      sMovingAllocator.uUsed = 0;
+      sMovingAllocator.Last  = NULLUsefulBuf;
+      QCBORDecode_SetUpAllocator(&DC, MovingAllocate, &sMovingAllocator, false);
+   } else if(bUseMemPool) {
+      if(QCBORDecode_SetMemPool(&DC, UsefulBuf_FROM_BYTE_ARRAY(spMemPool), false)) {
+         return 100;
+      }
+   }
+   if(nDecodeMethod == BENCH_DECODE_WITH_TAGS) {
+      QCBORDecode_SetExtension(&DC, &sDecodeExt);
+      QCBORDecode_SetCallerConfiguredTagList(&DC, &sCWTTagList);
+   }
+   if(nDecodeMethod == BENCH_DECODE_CHECKED) {
+      QCBORDecode_SetExtension(&DC, &sDecodeExt);
+      if(QCBORDecode_SetMapChecks(&DC, saLabelChecks, BENCH_LABEL_CHECKS)) {
+         return 101;
+      }
+   }
+
+   uItems = 0;
+   while(1) {
+      if(nDecodeMethod == BENCH_DECODE_BATCH) {
+         uErr = QCBORDecode_GetNextBatch(&DC, saBatchItems, BENCH_BATCH_SIZE, &uNumInBatch);
+         uItems += (uint32_t)uNumInBatch;
+      } else if(nDecodeMethod == BENCH_DECODE_WITH_TAGS) {
+         Tags.uNumAllocated = sizeof(puTags)/sizeof(uint64_t);
+         Tags.puTags        = puTags;
+         uErr = QCBORDecode_GetNextWithTags(&DC, &Item, &Tags);
+         uItems++;
+      } else {
+         uErr = QCBORDecode_GetNext(&DC, &Item);
+         uItems++;
+      }
+      if(uErr != QCBOR_SUCCESS) {
+         break;
+      }
+   }
+   if(nDecodeMethod != BENCH_DECODE_BATCH) {
+      // The last call was the error, not an item
+      uItems--;
+   }
+   if(uErr != QCBOR_ERR_NO_MORE_ITEMS) {
+      return 200 + (int32_t)uErr;
+   }
+
+   uErr = QCBORDecode_Finish(&DC);
+   if(uErr) {
+      return 300 + (int32_t)uErr;
+   }
+
+   *puItems = uItems;
+   return 0;
+}
+
+
+/*
+ Encode the corpus once, the first time it is used, and count its
+ items.
+ */
+static int32_t SetUpCorpus(BenchCorpus *pCorpus)
+{
+   if(!UsefulBuf_IsNULLC(pCorpus->Encoded)) {
+      return 0;
+   }
+
+   pCorpus->Encoded = (*pCorpus->pfEncode)(pCorpus->Storage, 0);
+   if(UsefulBuf_IsNULLC(pCorpus->Encoded)) {
+      return 1;
+   }
+
+   const bool bUseMemPool = pCorpus == &sIndefStringsCorpus;
+   if(DecodeAll(pCorpus->Encoded, BENCH_DECODE_GET_NEXT, bUseMemPool, &pCorpus->uItems)) {
+      pCorpus->Encoded = NULLUsefulBufC;
+      return 2;
+   }
+
+   return 0;
+}
+
+
+static int32_t RunEncode(BenchCorpus   *pCorpus,
+                         uint8_t        uConfigFlags,
+                         uint32_t       uIterations,
+                         BenchmarkWork *pWork)
+{
+   int32_t nReturn = SetUpCorpus(pCorpus);
+   if(nReturn) {
+      return nReturn;
+   }
+
+   while(uIterations--) {
+      UsefulBufC Encoded = (*pCorpus->pfEncode)(UsefulBuf_FROM_BYTE_ARRAY(spEncodeOutput),
+                                                 uConfigFlags);
+      // Output through a sink may have indefinite lengths so is not
+      // the same length as the corpus
+      if(uConfigFlags & BENCH_CONFIG_SINK ? Encoded.len == 0 :
+                                            Encoded.len != pCorpus->Encoded.len) {
+         return 10;
+      }
+   }
+
+   pWork->uItems = pCorpus->uItems;
+   pWork->uBytes = (uint32_t)pCorpus->Encoded.len;
+
+   return 0;
+}
+
+
+static int32_t RunDecode(BenchCorpus   *pCorpus,
+                         int            nDecodeMethod,
+                         uint32_t       uIterations,
+                         BenchmarkWork *pWork)
+{
+   const bool bUseMemPool = pCorpus == &sIndefStringsCorpus;
+   uint32_t   uItems;
+
+   int32_t nReturn = SetUpCorpus(pCorpus);
+   if(nReturn) {
+      return nReturn;
+   }
+
+   while(uIterations--) {
+      if(nDecodeMethod == BENCH_DECODE_VALIDATE) {
+         // Reported per item of the corpus so it compares to decoding
+         if(QCBORDecode_Validate(pCorpus->Encoded, NULL, NULL)) {
+            return 30;
+         }
+         continue;
+      }
+      if(nDecodeMethod == BENCH_DECODE_SKIP) {
+         QCBORDecodeContext DC;
+         QCBORItem          Item;
+
+         QCBORDecode_Init(&DC, pCorpus->Encoded, QCBOR_DECODE_MODE_NORMAL);
+         if(QCBORDecode_GetNext(&DC, &Item) ||
+            QCBORDecode_SkipCurrent(&DC, &Item) ||
+            QCBORDecode_GetNext(&DC, &Item) != QCBOR_ERR_NO_MORE_ITEMS) {
+            return 40;
+         }
+         continue;
+      }
+      nReturn = DecodeAll(pCorpus->Encoded, nDecodeMethod, bUseMemPool, &uItems);
+      if(nReturn) {
+         return nReturn;
+      }
+      if(uItems != pCorpus->uItems) {
+         return 20;
+      }
+   }
+
+   pWork->uItems = pCorpus->uItems;
+   pWork->uBytes = (uint32_t)pCorpus->Encoded.len;
+
+   return 0;
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchEncodeCOSESign1(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sCOSESign1Corpus, 0, uIterations, pWork);
+}
+
+int32_t BenchEncodeCOSESign1NoSlide(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sCOSESign1Corpus, QCBOR_ENCODE_CONFIG_NO_SLIDE, uIterations, pWork);
+}
+
+int32_t BenchEncodeCOSESign1Sink(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sCOSESign1Corpus, BENCH_CONFIG_SINK, uIterations, pWork);
+}
+
+int32_t BenchEncodeCOSESign1Refs(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sCOSESign1Corpus, BENCH_CONFIG_REFS, uIterations, pWork);
+}
+
+int32_t BenchDecodeCOSESign1(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sCOSESign1Corpus, BENCH_DECODE_GET_NEXT, uIterations, pWork);
+}
+
+int32_t BenchDecodeCOSESign1WithTags(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sCOSESign1Corpus, BENCH_DECODE_WITH_TAGS, uIterations, pWork);
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchValidateCOSESign1(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sCOSESign1Corpus, BENCH_DECODE_VALIDATE, uIterations, pWork);
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchEncodeCWTClaims(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sCWTClaimsCorpus, 0, uIterations, pWork);
+}
+
+int32_t BenchDecodeCWTClaims(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sCWTClaimsCorpus, BENCH_DECODE_GET_NEXT, uIterations, pWork);
+}
+
+int32_t BenchDecodeCWTClaimsWithTags(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sCWTClaimsCorpus, BENCH_DECODE_WITH_TAGS, uIterations, pWork);
+}
+
+int32_t BenchDecodeCWTClaimsBatch(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sCWTClaimsCorpus, BENCH_DECODE_BATCH, uIterations, pWork);
+}
+
+int32_t BenchDecodeCWTClaimsChecked(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sCWTClaimsCorpus, BENCH_DECODE_CHECKED, uIterations, pWork);
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchValidateCWTClaims(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sCWTClaimsCorpus, BENCH_DECODE_VALIDATE, uIterations, pWork);
+}
+
+
+/*
+ Decode the CWT claims in two passes, the way a caller that looks at
+ the first claim before decoding the rest does. The first pass gets
+ the map and the first claim. The second goes back to the start by
+ setting up the context again or, if bCursor, with
+ QCBORDecode_RestoreCursor(). If bReset, the context is set up once
+ and QCBORDecode_Reset() is used for each iteration.
+ */
+static int32_t DecodeCWTClaimsTwoPass(bool           bCursor,
+                                      bool           bReset,
+                                      uint32_t       uIterations,
+                                      BenchmarkWork *pWork)
+{
+   QCBORDecodeContext DC;
+   QCBORDecodeCursor  Start;
+   QCBORItem          Item;
+   QCBORTagListOut    Tags;
+   uint64_t           puTags[4];
+   QCBORError         uErr;
+   uint32_t           uItems;
+
+   int32_t nReturn = SetUpCorpus(&sCWTClaimsCorpus);
+   if(nReturn) {
+      return nReturn;
+   }
+
+   if(bReset) {
+      QCBORDecode_Init(&DC, sCWTClaimsCorpus.Encoded, QCBOR_DECODE_MODE_NORMAL);
+      QCBORDecode_SetExtension(&DC, &sDecodeExt);
+      QCBORDecode_SetCallerConfiguredTagList(&DC, &sCWTTagList);
+   }
+
+   while(uIterations--) {
+      if(bReset) {
+         QCBORDecode_Reset(&DC, sCWTClaimsCorpus.Encoded);
+      } else {
+         QCBORDecode_Init(&DC, sCWTClaimsCorpus.Encoded, QCBOR_DECODE_MODE_NORMAL);
+         QCBORDecode_SetExtension(&DC, &sDecodeExt);
+         QCBORDecode_SetCallerConfiguredTagList(&DC, &sCWTTagList);
+      }
+      QCBORDecode_SaveCursor(&DC, &Start);
+      if(QCBORDecode_GetNext(&DC, &Item) || QCBORDecode_GetNext(&DC, &Item)) {
+         return 80;
+      }
+
+      if(bCursor) {
+         if(QCBORDecode_RestoreCursor(&DC, &Start)) {
+            return 81;
+         }
+      } else {
+         QCBORDecode_Init(&DC, sCWTClaimsCorpus.Encoded, QCBOR_DECODE_MODE_NORMAL);
+         QCBORDecode_SetExtension(&DC, &sDecodeExt);
+         QCBORDecode_SetCallerConfiguredTagList(&DC, &sCWTTagList);
+      }
+
+      uItems = 0;
+      do {
+         Tags.uNumAllocated = sizeof(puTags)/sizeof(uint64_t);
+         Tags.puTags        = puTags;
+         uErr = QCBORDecode_GetNextWithTags(&DC, &Item, &Tags);
+         uItems++;
+      } while(uErr == QCBOR_SUCCESS);
+      if(uErr != QCBOR_ERR_NO_MORE_ITEMS ||
+         uItems - 1 != sCWTClaimsCorpus.uItems ||
+         QCBORDecode_Finish(&DC)) {
+         return 82;
+      }
+   }
+
+   pWork->uItems = sCWTClaimsCorpus.uItems;
+   pWork->uBytes = (uint32_t)sCWTClaimsCorpus.Encoded.len;
+
+   return 0;
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchDecodeCWTClaimsTwoPass(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return DecodeCWTClaimsTwoPass(false, false, uIterations, pWork);
+}
+
+int32_t BenchDecodeCWTClaimsTwoPassCursor(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return DecodeCWTClaimsTwoPass(true, false, uIterations, pWork);
+}
+
+int32_t BenchDecodeCWTClaimsTwoPassReset(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return DecodeCWTClaimsTwoPass(true, true, uIterations, pWork);
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchEncodeDeepNestedMaps(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sDeepNestedCorpus, 0, uIterations, pWork);
+}
+
+int32_t BenchEncodeDeepNestedMapsNoSlide(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sDeepNestedCorpus, QCBOR_ENCODE_CONFIG_NO_SLIDE, uIterations, pWork);
+}
+
+int32_t BenchDecodeDeepNestedMaps(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sDeepNestedCorpus, BENCH_DECODE_GET_NEXT, uIterations, pWork);
+}
+
+int32_t BenchDecodeDeepNestedMapsChecked(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sDeepNestedCorpus, BENCH_DECODE_CHECKED, uIterations, pWork);
+}
+
+int32_t BenchSkipDeepNestedMaps(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sDeepNestedCorpus, BENCH_DECODE_SKIP, uIterations, pWork);
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchEncodeIntArray(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sIntArrayCorpus, 0, uIterations, pWork);
+}
+
+int32_t BenchEncodeIntArraySink(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sIntArrayCorpus, BENCH_CONFIG_SINK, uIterations, pWork);
+}
+
+int32_t BenchDecodeIntArray(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sIntArrayCorpus, BENCH_DECODE_GET_NEXT, uIterations, pWork);
+}
+
+int32_t BenchSkipIntArray(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sIntArrayCorpus, BENCH_DECODE_SKIP, uIterations, pWork);
+}
+
+int32_t BenchDecodeIntArrayBatch(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sIntArrayCorpus, BENCH_DECODE_BATCH, uIterations, pWork);
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchValidateIntArray(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sIntArrayCorpus, BENCH_DECODE_VALIDATE, uIterations, pWork);
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchEncodeFloatArray(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sFloatArrayCorpus, 0, uIterations, pWork);
+}
+
+int32_t BenchDecodeFloatArray(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sFloatArrayCorpus, BENCH_DECODE_GET_NEXT, uIterations, pWork);
+}
+
+int32_t BenchDecodeFloatArrayBatch(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sFloatArrayCorpus, BENCH_DECODE_BATCH, uIterations, pWork);
+}
+
+/*
+ Decode the integer or float array corpus into spInts or spFloats
+ with QCBORDecode_GetInt64Array() or QCBORDecode_GetDoubleArray().
+ */
+static int32_t RunDecodeNative(BenchCorpus   *pCorpus,
+                               uint32_t       uIterations,
+                               BenchmarkWork *pWork)
+{
+   QCBORDecodeContext DC;
+   QCBORItem          Array;
+   size_t             uNum;
+   QCBORError         uErr;
+
+   int32_t nReturn = SetUpCorpus(pCorpus);
+   if(nReturn) {
+      return nReturn;
+   }
+
+   while(uIterations--) {
+      QCBORDecode_Init(&DC, pCorpus->Encoded, QCBOR_DECODE_MODE_NORMAL);
+      if(QCBORDecode_GetNext(&DC, &Array)) {
+         return 60;
+      }
+      if(pCorpus == &sIntArrayCorpus) {
+         uErr = QCBORDecode_GetInt64Array(&DC, &Array, spInts, BENCH_NUM_INTS, &uNum);
+      } else {
+         uErr = QCBORDecode_GetDoubleArray(&DC, &Array, spFloats, BENCH_NUM_FLOATS, &uNum);
+      }
+      if(uErr || uNum + 1 != pCorpus->uItems || QCBORDecode_Finish(&DC)) {
+         return 61;
+      }
+   }
+
+   pWork->uItems = pCorpus->uItems;
+   pWork->uBytes = (uint32_t)pCorpus->Encoded.len;
+
+   return 0;
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchDecodeIntArrayNative(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecodeNative(&sIntArrayCorpus, uIterations, pWork);
+}
+
+int32_t BenchDecodeFloatArrayNative(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecodeNative(&sFloatArrayCorpus, uIterations, pWork);
+}
+
+
+/* The items split out of the integer array. Static so they aren't
+   counted as stack use. */
+static UsefulBufC saSequenceItems[BENCH_NUM_INTS];
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchSplitIntSequence(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   size_t uNum;
+
+   int32_t nReturn = SetUpCorpus(&sIntArrayCorpus);
+   if(nReturn) {
+      return nReturn;
+   }
+
+   // The integers without the 3-byte head of the array are a CBOR
+   // sequence
+   const UsefulBufC Sequence = UsefulBuf_Tail(sIntArrayCorpus.Encoded, 3);
+
+   while(uIterations--) {
+      if(QCBORDecode_SplitSequence(Sequence, saSequenceItems, BENCH_NUM_INTS, &uNum, NULL) ||
+         uNum != BENCH_NUM_INTS) {
+         return 70;
+      }
+   }
+
+   pWork->uItems = BENCH_NUM_INTS;
+   pWork->uBytes = (uint32_t)Sequence.len;
+
+   return 0;
+}
+
+
+/*
+ The typed array is one item, so these report per double so they
+ compare to the float array benchmarks above.
+ */
+int32_t BenchEncodeFloatTypedArray(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   int32_t nReturn = RunEncode(&sFloatTypedArrayCorpus, 0, uIterations, pWork);
+   pWork->uItems = BENCH_NUM_FLOATS;
+   return nReturn;
+}
+
+int32_t BenchDecodeFloatTypedArray(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   size_t             uNumElements;
+
+   int32_t nReturn = SetUpCorpus(&sFloatTypedArrayCorpus);
+   if(nReturn) {
+      return nReturn;
+   }
+
+   while(uIterations--) {
+      QCBORDecode_Init(&DC, sFloatTypedArrayCorpus.Encoded, QCBOR_DECODE_MODE_NORMAL);
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_CopyTypedArray(&Item,
+                                    (UsefulBuf){spFloats, sizeof(spFloats)},
+                                    &uNumElements) ||
+         uNumElements != BENCH_NUM_FLOATS ||
+         QCBORDecode_Finish(&DC)) {
+         return 50;
+      }
+   }
+
+   pWork->uItems = BENCH_NUM_FLOATS;
+   pWork->uBytes = (uint32_t)sFloatTypedArrayCorpus.Encoded.len;
+
+   return 0;
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchDecodeIndefiniteStrings(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sIndefStringsCorpus, BENCH_DECODE_GET_NEXT, uIterations, pWork);
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchValidateIndefiniteStrings(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sIndefStringsCorpus, BENCH_DECODE_VALIDATE, uIterations, pWork);
+}
+
+int32_t BenchDecodeIndefiniteStringsMoving(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sIndefStringsCorpus, BENCH_DECODE_MOVING, uIterations, pWork);
+}
+
+
+/*
+ Run a compiled query over a corpus and check the found items with
+ pfCheck. Reported per item found.
+ */
+static int32_t RunQuery(BenchCorpus         *pCorpus,
+                        const QCBORPathStep *pSteps,
+                        size_t               uNumSteps,
+                        int                (*pfCheck)(const QCBORItem *pItems),
+                        uint32_t             uIterations,
+                        BenchmarkWork       *pWork)
+{
+   QCBORQuery Query;
+   QCBORItem  aItems[QCBOR_MAX_QUERY_PATHS];
+
+   int32_t nReturn = SetUpCorpus(pCorpus);
+   if(nReturn) {
+      return nReturn;
+   }
+
+   if(QCBORDecode_CompileQuery(&Query, pSteps, uNumSteps)) {
+      return 80;
+   }
+
+   while(uIterations--) {
+      if(QCBORDecode_RunQuery(&Query, pCorpus->Encoded, aItems, NULL)) {
+         return 81;
+      }
+      if(!(*pfCheck)(aItems)) {
+         return 82;
+      }
+   }
+
+   pWork->uItems = Query.uNumPaths;
+   pWork->uBytes = (uint32_t)pCorpus->Encoded.len;
+
+   return 0;
+}
+
+
+/* The alg in the protected headers and the kid in the unprotected */
+static const QCBORPathStep spCOSESign1Query[] = {
+   QCBORPath_INDEX(0), QCBORPath_BSTR_WRAPPED, QCBORPath_INT(1), QCBORPath_END,
+   QCBORPath_INDEX(1), QCBORPath_INT(4), QCBORPath_END,
+};
+
+static int CheckCOSESign1Query(const QCBORItem *pItems)
+{
+   return pItems[0].uDataType == QCBOR_TYPE_INT64 &&
+          pItems[0].val.int64 == -7 &&
+          pItems[1].uDataType == QCBOR_TYPE_BYTE_STRING &&
+          pItems[1].val.string.len == 8;
+}
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchQueryCOSESign1(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunQuery(&sCOSESign1Corpus,
+                   spCOSESign1Query,
+                   sizeof(spCOSESign1Query)/sizeof(spCOSESign1Query[0]),
+                   CheckCOSESign1Query,
+                   uIterations,
+                   pWork);
+}
+
+
+/* The expiration and the last of the scopes */
+static const QCBORPathStep spCWTClaimsQuery[] = {
+   QCBORPath_INT(4), QCBORPath_END,
+   QCBORPath_TEXT_LITERAL("scope"), QCBORPath_INDEX(1), QCBORPath_END,
+};
+
+static int CheckCWTClaimsQuery(const QCBORItem *pItems)
+{
+   return pItems[0].uDataType == QCBOR_TYPE_DATE_EPOCH &&
+          pItems[0].val.epochDate.nSeconds == 1444064944 &&
+          pItems[1].uDataType == QCBOR_TYPE_TEXT_STRING &&
+          pItems[1].val.string.len == 5;
+}
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchQueryCWTClaims(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunQuery(&sCWTClaimsCorpus,
+                   spCWTClaimsQuery,
+                   sizeof(spCWTClaimsQuery)/sizeof(spCWTClaimsQuery[0]),
+                   CheckCWTClaimsQuery,
+                   uIterations,
+                   pWork);
+}
+
+
+static int CheckDeepNestedQuery(const QCBORItem *pItems)
+{
+   return pItems[0].uDataType == QCBOR_TYPE_TEXT_STRING &&
+          pItems[0].val.string.len == 6;
+}
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchQueryDeepNestedMaps(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   /* The "bottom" string in the most deeply nested map */
+   QCBORPathStep aSteps[QCBOR_MAX_ARRAY_NESTING + 1];
+   int           nLevel;
+
+   for(nLevel = 0; nLevel < QCBOR_MAX_ARRAY_NESTING - 1; nLevel++) {
+      aSteps[nLevel] = (QCBORPathStep)QCBORPath_INT(4);
+   }
+   aSteps[nLevel++] = (QCBORPathStep)QCBORPath_INT(2);
+   aSteps[nLevel++] = (QCBORPathStep)QCBORPath_END;
+
+   return RunQuery(&sDeepNestedCorpus,
+                   aSteps,
+                   (size_t)nLevel,
+                   CheckDeepNestedQuery,
+                   uIterations,
+                   pWork);
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchEncodePoses(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sPosesCorpus, 0, uIterations, pWork);
+}
+
+int32_t BenchEncodePosesRecord(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sPosesCorpus, BENCH_CONFIG_RECORD, uIterations, pWork);
+}
+
+int32_t BenchDecodePoses(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunDecode(&sPosesCorpus, BENCH_DECODE_GET_NEXT, uIterations, pWork);
+}
+
+int32_t BenchDecodePosesRecord(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   BenchPose          Pose;
+   uint32_t           uFound;
+   uint32_t           u;
+
+   int32_t nReturn = SetUpCorpus(&sPosesCorpus);
+   if(nReturn) {
+      return nReturn;
+   }
+
+   while(uIterations--) {
+      QCBORDecode_Init(&DC, sPosesCorpus.Encoded, QCBOR_DECODE_MODE_NORMAL);
+      if(QCBORDecode_GetNext(&DC, &Item)) {
+         return 90;
+      }
+      for(u = 0; u < BENCH_NUM_POSES; u++) {
+         if(QCBORDecode_GetRecord(&DC, &sPoseRecord, &Pose, &uFound) ||
+            uFound != 0x3f ||
+            Pose.nTime != spPoses[u].nTime) {
+            return 91;
+         }
+      }
+      if(QCBORDecode_Finish(&DC)) {
+         return 92;
+      }
+   }
+
+   pWork->uItems = sPosesCorpus.uItems;
+   pWork->uBytes = (uint32_t)sPosesCorpus.Encoded.len;
+
+   return 0;
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchEncodePosesCDDL(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return RunEncode(&sPosesCorpus, BENCH_CONFIG_CDDL, uIterations, pWork);
+}
+
+int32_t BenchDecodePosesCDDL(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   pose               Pose;
+   uint32_t           u;
+
+   int32_t nReturn = SetUpCorpus(&sPosesCorpus);
+   if(nReturn) {
+      return nReturn;
+   }
+
+   while(uIterations--) {
+      QCBORDecode_Init(&DC, sPosesCorpus.Encoded, QCBOR_DECODE_MODE_NORMAL);
+      if(QCBORDecode_GetNext(&DC, &Item)) {
+         return 90;
+      }
+      for(u = 0; u < BENCH_NUM_POSES; u++) {
+         if(Decode_pose(&DC, &Pose) ||
+            Pose.time != spCDDLPoses[u].time) {
+            return 91;
+         }
+      }
+      if(QCBORDecode_Finish(&DC)) {
+         return 92;
+      }
+   }
+
+   pWork->uItems = sPosesCorpus.uItems;
+   pWork->uBytes = (uint32_t)sPosesCorpus.Encoded.len;
+
+   return 0;
+}
+
+
+#ifdef QCBOR_RING_LOAD_ACQUIRE
+
+#define BENCH_RING_BATCH       32 /* Records between consumer runs */
+#define BENCH_POSE_MAX_SIZE    64
+
+static uint8_t spRingStorage[BENCH_RING_BATCH * BENCH_POSE_MAX_SIZE * 2];
+
+
+/*
+ Encode each pose as its own record as a telemetry producer would.
+ If bRing, they are encoded in place in a QCBORRing. If not, each is
+ encoded in its own context and buffer and copied into a queue, the
+ way it is done without the ring, but without the lock a real queue
+ would need. Every BENCH_RING_BATCH records the queue is emptied.
+ */
+static int32_t EncodePoseRecords(bool bRing, uint32_t uIterations, BenchmarkWork *pWork)
+{
+   QCBOREncodeContext EC;
+   QCBORRing          Ring;
+   UsefulBufC         Encoded;
+   size_t             uQueued;
+   size_t             uBytes = 0;
+   uint32_t           u;
+
+   if(SetUpPoses()) {
+      return 120;
+   }
+   QCBORRing_Init(&Ring, UsefulBuf_FROM_BYTE_ARRAY(spRingStorage));
+   uQueued = 0;
+
+   while(uIterations--) {
+      uBytes = 0;
+      for(u = 0; u < BENCH_NUM_POSES; u++) {
+         if(bRing) {
+            if(QCBORRing_StartRecord(&Ring, &EC, BENCH_POSE_MAX_SIZE)) {
+               return 121;
+            }
+            QCBOREncode_AddRecord(&EC, &sPoseRecord, &spPoses[u]);
+            if(QCBORRing_PublishRecord(&Ring, &EC)) {
+               return 122;
+            }
+         } else {
+            UsefulBuf_MAKE_STACK_UB(Record, BENCH_POSE_MAX_SIZE);
+            QCBOREncode_Init(&EC, Record);
+            QCBOREncode_AddRecord(&EC, &sPoseRecord, &spPoses[u]);
+            if(QCBOREncode_Finish(&EC, &Encoded)) {
+               return 123;
+            }
+            memcpy(spRingStorage + uQueued, Encoded.ptr, Encoded.len);
+            uQueued += Encoded.len;
+         }
+
+         if(u % BENCH_RING_BATCH == BENCH_RING_BATCH - 1) {
+            if(bRing) {
+               while((Encoded = QCBORRing_Peek(&Ring)).len) {
+                  uBytes += Encoded.len;
+                  QCBORRing_Consume(&Ring, Encoded.len);
+               }
+            } else {
+               uBytes += uQueued;
+               uQueued = 0;
+            }
+         }
+      }
+   }
+
+   pWork->uItems = BENCH_NUM_POSES * 7;
+   pWork->uBytes = (uint32_t)uBytes;
+
+   return 0;
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchEncodePosesCopied(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return EncodePoseRecords(false, uIterations, pWork);
+}
+
+int32_t BenchEncodePosesRing(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   return EncodePoseRecords(true, uIterations, pWork);
+}
+
+#endif /* QCBOR_RING_LOAD_ACQUIRE */
+
+#define BENCH_SCAN_SIZE 65536
+
+static uint8_t spScanBuf[BENCH_SCAN_SIZE];
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchUsefulBufIsValue(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   const UsefulBufC Scan = {spScanBuf, BENCH_SCAN_SIZE};
+
+   memset(spScanBuf, 0, BENCH_SCAN_SIZE);
+   while(uIterations--) {
+      if(UsefulBuf_IsValue(Scan, 0) != SIZE_MAX) {
+         return 110;
+      }
+   }
+
+   pWork->uItems = 1;
+   pWork->uBytes = BENCH_SCAN_SIZE;
+
+   return 0;
+}
+
+
+/*
+ Public function, see qcbor_benchmarks.h
+ */
+int32_t BenchUsefulBufFindBytes(uint32_t uIterations, BenchmarkWork *pWork)
+{
+   const UsefulBufC Scan   = {spScanBuf, BENCH_SCAN_SIZE};
+   const UsefulBufC Marker = UsefulBuf_FROM_SZ_LITERAL("QCBOR marker");
+   size_t           i;
+
+   /* Text-like content with some false starts */
+   for(i = 0; i < BENCH_SCAN_SIZE; i++) {
+      spScanBuf[i] = (uint8_t)('A' + i % 23);
+   }
+   memcpy(spScanBuf + BENCH_SCAN_SIZE - Marker.len, Marker.ptr, Marker.len);
+
+   while(uIterations--) {
+      if(UsefulBuf_FindBytes(Scan, Marker) != BENCH_SCAN_SIZE - Marker.len) {
+         return 111;
+      }
+   }
+
+   pWork->uItems = 1;
+   pWork->uBytes = BENCH_SCAN_SIZE;
+
+   return 0;
+}
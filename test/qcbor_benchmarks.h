@@ -0,0 +1,203 @@
+/*==============================================================================
+ qcbor_benchmarks.h -- encode and decode throughput benchmarks
+
+ Copyright (c) 2026, Laurence Lundblade. All rights reserved.
+
+ SPDX-License-Identifier: BSD-3-Clause
+
+ See BSD-3-Clause license in README.md
+
+ Created on 10/14/26
+ =============================================================================*/
+
+#ifndef qcbor_benchmarks_h
+#define qcbor_benchmarks_h
+
+#include <stdint.h>
+
+
+/*
+ Each benchmark runs its operation uIterations times over one
+ corpus and reports the amount of work done by one iteration so the
+ harness in run_benchmarks.c can compute per-item and per-byte
+ rates. Like the tests, the benchmarks check their results and
+ return non-zero on failure so a benchmark run also catches
+ regressions.
+
+ The corpora are built once with the encoder and kept in static
+ memory so they are not counted as stack use.
+ */
+
+
+/*
+ The work done by one iteration of a benchmark.
+ */
+typedef struct {
+   uint32_t uItems; /* Number of data items encoded or decoded */
+   uint32_t uBytes; /* Number of bytes of encoded CBOR */
+} BenchmarkWork;
+
+
+/*
+ Encode / decode a COSE_Sign1 message with a bstr-wrapped protected
+ header, an unprotected header, a 256-byte payload and a 64-byte
+ signature. The tagged decode uses QCBORDecode_GetNextWithTags().
+ This, the CWT claims, the integer array and the indefinite-length
+ strings are also checked with QCBORDecode_Validate(). The payload
+ and signature are also output by reference with
+ QCBOREncode_SetReferences().
+ */
+int32_t BenchEncodeCOSESign1(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchEncodeCOSESign1NoSlide(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchEncodeCOSESign1Sink(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchEncodeCOSESign1Refs(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeCOSESign1(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeCOSESign1WithTags(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchValidateCOSESign1(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Encode / decode a CWT claims set, a map of integer-labeled claims
+ including epoch dates, plus some text-labeled private claims. This
+ and the deeply nested maps are also decoded with duplicate label and
+ deterministic encoding checks.
+ */
+int32_t BenchEncodeCWTClaims(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeCWTClaims(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeCWTClaimsWithTags(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeCWTClaimsBatch(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeCWTClaimsChecked(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchValidateCWTClaims(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Decode the CWT claims set twice, first just the first claim and then
+ all of it with tags, to compare going back to the start by setting
+ up the decoder again, with QCBORDecode_RestoreCursor() and with
+ QCBORDecode_Reset() of a context set up once.
+ */
+int32_t BenchDecodeCWTClaimsTwoPass(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeCWTClaimsTwoPassCursor(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeCWTClaimsTwoPassReset(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Encode / decode maps nested to the maximum nesting depth. This and
+ the COSE_Sign1 encode are also run with QCBOR_ENCODE_CONFIG_NO_SLIDE.
+ This and the integer array are also skipped over whole with
+ QCBORDecode_SkipCurrent().
+ */
+int32_t BenchEncodeDeepNestedMaps(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchEncodeDeepNestedMapsNoSlide(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeDeepNestedMaps(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeDeepNestedMapsChecked(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchSkipDeepNestedMaps(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Encode / decode a large array of integers of mixed sizes and signs.
+ This and the COSE_Sign1 encode are also run with output through
+ QCBOREncode_InitWithSink() and a 256-byte staging buffer. This, the
+ float array and the CWT claims are also decoded with
+ QCBORDecode_GetNextBatch() in batches of 32.
+ */
+int32_t BenchEncodeIntArray(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchEncodeIntArraySink(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeIntArray(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeIntArrayBatch(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchValidateIntArray(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchSkipIntArray(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Encode / decode a large array of doubles with preferred
+ serialization so a mix of half, single and double precision is
+ output.
+ */
+int32_t BenchEncodeFloatArray(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeFloatArray(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeFloatArrayBatch(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Decode the integer and float arrays straight into C arrays with
+ QCBORDecode_GetInt64Array() and QCBORDecode_GetDoubleArray().
+ */
+int32_t BenchDecodeIntArrayNative(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeFloatArrayNative(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Split the integers in the integer array as a CBOR sequence with
+ QCBORDecode_SplitSequence().
+ */
+int32_t BenchSplitIntSequence(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Encode / decode the same doubles as one big-endian RFC 8746 typed
+ array with QCBOREncode_AddTypedArray() and
+ QCBORDecode_CopyTypedArray(). Reported per double.
+ */
+int32_t BenchEncodeFloatTypedArray(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeFloatTypedArray(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Decode an array of indefinite-length text strings using a MemPool
+ to coalesce the chunks. There is no encode benchmark because the
+ encoder doesn't output indefinite-length strings. The corpus is
+ made with QCBOREncode_EncodeHead(). The strings are also decoded
+ with an allocator that moves and copies on every reallocation like
+ realloc() in a general-purpose heap.
+ */
+int32_t BenchDecodeIndefiniteStrings(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchValidateIndefiniteStrings(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodeIndefiniteStringsMoving(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Pull a few items out of the COSE_Sign1 message, the CWT claims and
+ the most deeply nested map with QCBORDecode_RunQuery(), skipping
+ everything else. Reported per item found.
+ */
+int32_t BenchQueryCOSESign1(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchQueryCWTClaims(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchQueryDeepNestedMaps(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+
+/*
+ Encode / decode an array of robot poses, small maps of integer
+ labeled numbers, field by field and as records with
+ QCBOREncode_AddRecord() and QCBORDecode_GetRecord().
+ */
+int32_t BenchEncodePoses(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchEncodePosesRecord(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodePoses(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodePosesRecord(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ The same poses with the code qcborcddl generated from test/pose.cddl.
+ */
+int32_t BenchEncodePosesCDDL(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchDecodePosesCDDL(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Encode the poses one record at a time as telemetry, each in its own
+ context and copied into a queue, and in place in a QCBORRing.
+ */
+int32_t BenchEncodePosesCopied(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchEncodePosesRing(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+/*
+ Scan 64KB with UsefulBuf_IsValue() and UsefulBuf_FindBytes(), for a
+ marker at the end. The bytes are the buffer, not CBOR.
+ */
+int32_t BenchUsefulBufIsValue(uint32_t uIterations, BenchmarkWork *pWork);
+int32_t BenchUsefulBufFindBytes(uint32_t uIterations, BenchmarkWork *pWork);
+
+#endif /* qcbor_benchmarks_h */
@@ -795,11 +795,20 @@ int32_t ParseDeepArrayTest()
    return(nReturn);
 }
 
-// Big enough to test nesting to the depth of 24
-static uint8_t spTooDeepArrays[] = {0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
-                                    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
-                                    0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
-                                    0x81, 0x81, 0x81, 0x80};
+// uDepth arrays of one nested in each other with an empty array in
+// the innermost, like spDeepArrays
+static UsefulBufC MakeNestedArrays(size_t uDepth, UsefulBuf Storage)
+{
+   UsefulOutBuf UOB;
+   UsefulOutBuf_Init(&UOB, Storage);
+
+   for(size_t u = 0; u < uDepth; u++) {
+      UsefulOutBuf_AppendByte(&UOB, 0x81);
+   }
+   UsefulOutBuf_AppendByte(&UOB, 0x80);
+
+   return UsefulOutBuf_OutUBuf(&UOB);
+}
 
 int32_t ParseTooDeepArrayTest()
 {
@@ -808,12 +817,14 @@ int32_t ParseTooDeepArrayTest()
    int i;
    QCBORItem Item;
 
+   // One level deeper than the limit
+   UsefulBuf_MAKE_STACK_UB(Storage, QCBOR_MAX_ARRAY_NESTING + 2);
 
    QCBORDecode_Init(&DCtx,
-                    UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spTooDeepArrays),
+                    MakeNestedArrays(QCBOR_MAX_ARRAY_NESTING + 1, Storage),
                     QCBOR_DECODE_MODE_NORMAL);
 
-   for(i = 0; i < QCBOR_MAX_ARRAY_NESTING1; i++) {
+   for(i = 0; i < QCBOR_MAX_ARRAY_NESTING; i++) {
 
       if(QCBORDecode_GetNext(&DCtx, &Item) != 0 ||
          Item.uDataType != QCBOR_TYPE_ARRAY ||
@@ -850,6 +861,21 @@ int32_t ShortBufferParseTest()
          goto Done;
       }
    }
+
+   // A head cut off in its argument consumes the rest of the input
+   // the same as when the argument was read a byte at a time
+   static const uint8_t spCutArgument[] = {0x1a, 0x01, 0x02};
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   QCBORDecode_Init(&DCtx,
+                    UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCutArgument),
+                    QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_HIT_END ||
+      QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NO_MORE_ITEMS ||
+      QCBORDecode_Finish(&DCtx) != QCBOR_SUCCESS) {
+      nResult = -2;
+   }
+
 Done:
    return nResult;
 }
@@ -1213,7 +1239,11 @@ int32_t ParseMapAsArrayTest()
     map that when interpreted as an array will be too many. Test
     data just has the start of the map, not all the items in the map.
     */
+#ifdef QCBOR_USE_LARGE_ARRAYS
+   static const uint8_t pTooLargeMap[] = {0xba, 0xff, 0xff, 0xff, 0xfd};
+#else
    static const uint8_t pTooLargeMap[] = {0xb9, 0xff, 0xfd};
+#endif
 
    QCBORDecode_Init(&DCtx,
                     UsefulBuf_FROM_BYTE_ARRAY_LITERAL(pTooLargeMap),
@@ -1702,16 +1732,21 @@ struct FailInput  Failures[] = {
    { {(uint8_t[]){0x9f, 0x80, 0x00}, 3}, QCBOR_ERR_HIT_END },
    // Definite length array containing an unclosed indefinite array
    { {(uint8_t[]){0x81, 0x9f}, 2}, QCBOR_ERR_HIT_END },
+#if QCBOR_MAX_ARRAY_NESTING >= 9
    // Deeply nested definite length arrays with deepest one unclosed
    { {(uint8_t[]){0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81}, 9}, QCBOR_ERR_HIT_END },
+#endif
+#if QCBOR_MAX_ARRAY_NESTING >= 6
    // Deeply nested indefinite length arrays with deepest one unclosed
    { {(uint8_t[]){0x9f, 0x9f, 0x9f, 0x9f, 0x9f, 0xff, 0xff, 0xff, 0xff}, 9}, QCBOR_ERR_HIT_END },
-   // Mixed nesting with indefinite unclosed
-   // TODO: think through this one
-   { {(uint8_t[]){0x9f, 0x81, 0x9f, 0x81, 0x9f, 0x9f, 0xff, 0xff, 0xff}, 9}, QCBOR_ERR_BAD_BREAK },
-   // Mixed nesting with definite unclosed
-   // TODO: think through this one
+   // Mixed nesting with indefinite unclosed. The breaks close the
+   // four innermost; the definite-length arrays are closed by the
+   // indefinite-length ones in them.
+   { {(uint8_t[]){0x9f, 0x81, 0x9f, 0x81, 0x9f, 0x9f, 0xff, 0xff, 0xff}, 9}, QCBOR_ERR_HIT_END },
+   // Mixed nesting with definite unclosed. The last break is where
+   // the second item of the 0x82 array should be.
    { {(uint8_t[]){0x9f, 0x82, 0x9f, 0x81, 0x9f, 0x9f, 0xff, 0xff, 0xff, 0xff}, 10}, QCBOR_ERR_BAD_BREAK },
+#endif
 
 
    // The "argument" for the data item is incomplete
@@ -1984,11 +2019,16 @@ int32_t DecodeFailureTests()
 
 /* Try all 256 values of the byte at nLen including recursing for
  each of the values to try values at nLen+1 ... up to nLenMax
+
+ Returns the number of inputs where QCBORDecode_Validate() disagrees
+ with the decoder.
  */
-static void ComprehensiveInputRecurser(uint8_t *pBuf, size_t nLen, size_t nLenMax)
+static int32_t ComprehensiveInputRecurser(uint8_t *pBuf, size_t nLen, size_t nLenMax)
 {
+   int32_t nMismatches = 0;
+
    if(nLen >= nLenMax) {
-      return;
+      return 0;
    }
 
    for(int inputByte = 0; inputByte < 256; inputByte++) {
@@ -2005,16 +2045,32 @@ static void ComprehensiveInputRecurser(uint8_t *pBuf, size_t nLen, size_t nLenMa
       // The goal of this test is not to check for the correct
       // error since that is not really possible. It is to
       // see that there is no crash on hostile input.
+      QCBORError nCBORError;
       while(1) {
          QCBORItem Item;
-         QCBORError nCBORError = QCBORDecode_GetNext(&DCtx, &Item);
+         nCBORError = QCBORDecode_GetNext(&DCtx, &Item);
          if(nCBORError != QCBOR_SUCCESS) {
             break;
          }
       }
 
-      ComprehensiveInputRecurser(pBuf, nLen+1, nLenMax);
+      // Input the decoder gets all the way through must validate and
+      // input that is not well-formed must not. QCBOR_ERR_HIT_END is
+      // left out because the decoder doesn't count an
+      // indefinite-length array or map against a definite-length one
+      // it is in and gives that error for some well-formed input.
+      const QCBORValidateLimits Limits = {0, 1, 0, 0};
+      const QCBORError nValidateError = QCBORDecode_Validate(Input, &Limits, NULL);
+      if(nCBORError == QCBOR_ERR_NO_MORE_ITEMS) {
+         nMismatches += nValidateError != QCBOR_SUCCESS;
+      } else if(IsNotWellFormedError(nCBORError) && nCBORError != QCBOR_ERR_HIT_END) {
+         nMismatches += nValidateError == QCBOR_SUCCESS;
+      }
+
+      nMismatches += ComprehensiveInputRecurser(pBuf, nLen+1, nLenMax);
    }
+
+   return nMismatches;
 }
 
 
@@ -2023,9 +2079,7 @@ int32_t ComprehensiveInputTest()
    // Size 2 tests 64K inputs and runs quickly
    uint8_t pBuf[2];
 
-   ComprehensiveInputRecurser(pBuf, 0, sizeof(pBuf));
-
-   return 0;
+   return ComprehensiveInputRecurser(pBuf, 0, sizeof(pBuf));
 }
 
 
@@ -2039,9 +2093,7 @@ int32_t BigComprehensiveInputTest()
    // of them as a very frequent regression.
    uint8_t pBuf[3]; //
 
-   ComprehensiveInputRecurser(pBuf, 0, sizeof(pBuf));
-
-   return 0;
+   return ComprehensiveInputRecurser(pBuf, 0, sizeof(pBuf));
 }
 
 
@@ -2255,6 +2307,7 @@ static int32_t CheckCSRMaps(QCBORDecodeContext *pDC);
 int32_t OptTagParseTest()
 {
    QCBORDecodeContext DCtx;
+   QCBORDecodeExtension Ext;
    QCBORItem Item;
 
    QCBORDecode_Init(&DCtx,
@@ -2302,23 +2355,29 @@ int32_t OptTagParseTest()
 
    // ----------------------------------
    // This test sets up a caller-config list that includes the very large
-   // tage and then matches it.
-   QCBORDecode_Init(&DCtx,
-                    UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spEncodedLargeTag),
-                    QCBOR_DECODE_MODE_NORMAL);
+   // tage and then matches it. The first time the list is searched
+   // linearly and the second time, with the extension, with the filter.
    const uint64_t puList[] = {0x9192939495969798, 257};
    const QCBORTagListIn TL = {2, puList};
-   QCBORDecode_SetCallerConfiguredTagList(&DCtx, &TL);
+   for(int nPass = 0; nPass < 2; nPass++) {
+      QCBORDecode_Init(&DCtx,
+                       UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spEncodedLargeTag),
+                       QCBOR_DECODE_MODE_NORMAL);
+      QCBORDecode_SetCallerConfiguredTagList(&DCtx, &TL);
+      if(nPass) {
+         QCBORDecode_SetExtension(&DCtx, &Ext);
+      }
 
-   if(QCBORDecode_GetNext(&DCtx, &Item)) {
-      return -8;
-   }
-   if(Item.uDataType != QCBOR_TYPE_ARRAY ||
-      !QCBORDecode_IsTagged(&DCtx, &Item, 0x9192939495969798) ||
-      QCBORDecode_IsTagged(&DCtx, &Item, 257) ||
-      QCBORDecode_IsTagged(&DCtx, &Item, CBOR_TAG_BIGFLOAT) ||
-      Item.val.uCount != 0) {
-      return -9;
+      if(QCBORDecode_GetNext(&DCtx, &Item)) {
+         return -8;
+      }
+      if(Item.uDataType != QCBOR_TYPE_ARRAY ||
+         !QCBORDecode_IsTagged(&DCtx, &Item, 0x9192939495969798) ||
+         QCBORDecode_IsTagged(&DCtx, &Item, 257) ||
+         QCBORDecode_IsTagged(&DCtx, &Item, CBOR_TAG_BIGFLOAT) ||
+         Item.val.uCount != 0) {
+         return -9;
+      }
    }
 
    //------------------------
@@ -2870,7 +2929,7 @@ static int32_t parse_indeflen_nested(UsefulBufC Nested, int nNestLevel)
 
 int32_t IndefiniteLengthNestTest()
 {
-   UsefulBuf_MAKE_STACK_UB(Storage, 50);
+   UsefulBuf_MAKE_STACK_UB(Storage, 2 * (QCBOR_MAX_ARRAY_NESTING + 4));
    int i;
    for(i=1; i < QCBOR_MAX_ARRAY_NESTING+4; i++) {
       const UsefulBufC Nested = make_nested_indefinite_arrays(i, Storage);
@@ -2895,6 +2954,8 @@ static const uint8_t spIndefiniteArrayBad3[] = {0x9f, 0x02, 0xff, 0xff};
 static const uint8_t spIndefiniteArrayBad4[] = {0x81, 0x9f};
 // confused tag
 static const uint8_t spIndefiniteArrayBad5[] = {0x9f, 0xd1, 0xff};
+// {2: [_ 1], 3: []}, the indefinite-length array is an item of the map
+static const uint8_t spIndefiniteArrayInMap[] = {0xa2, 0x02, 0x9f, 0x01, 0xff, 0x03, 0x80};
 
 int32_t IndefiniteLengthArrayMapTest()
 {
@@ -3053,6 +3114,46 @@ int32_t IndefiniteLengthArrayMapTest()
       return -19;
    }
 
+   // --- next test -----
+   IndefLen = UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteArrayInMap);
+
+   // Closed by its break, by QCBORDecode_ExitArrayOrMap() and by
+   // QCBORDecode_GetInt64Array()
+   for(int nClose = 0; nClose < 3; nClose++) {
+      QCBORDecode_Init(&DC, IndefLen, QCBOR_DECODE_MODE_NORMAL);
+
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_GetNext(&DC, &Item) ||
+         Item.uDataType != QCBOR_TYPE_ARRAY) {
+         return -20;
+      }
+      if(nClose == 0) {
+         nResult = QCBORDecode_GetNext(&DC, &Item);
+      } else if(nClose == 1) {
+         nResult = QCBORDecode_ExitArrayOrMap(&DC);
+      } else {
+         int64_t nInt;
+         size_t  uNum;
+         nResult = QCBORDecode_GetInt64Array(&DC, &Item, &nInt, 1, &uNum);
+      }
+      if(nResult) {
+         return -21;
+      }
+
+      nResult = QCBORDecode_GetNext(&DC, &Item);
+      if(nResult ||
+         Item.uDataType != QCBOR_TYPE_ARRAY ||
+         Item.label.int64 != 3 ||
+         Item.uNestingLevel != 1 ||
+         Item.uNextNestLevel != 0) {
+         return -22;
+      }
+
+      if(QCBORDecode_Finish(&DC)) {
+         return -23;
+      }
+   }
+
     return 0;
 }
 
@@ -3334,6 +3435,247 @@ int32_t IndefiniteLengthStringTest()
 }
 
 
+/*
+ An allocator that counts the calls to it and remembers the size of
+ the last one. Frees are not counted.
+ */
+typedef struct {
+   UsefulBuf Buffer;
+   int       nAllocations;
+   size_t    uLastSize;
+} CountingAllocator;
+
+static UsefulBuf CountingAllocateFunction(void *pCtx, void *pOldMem, size_t uNewSize)
+{
+   CountingAllocator *pMe = (CountingAllocator *)pCtx;
+
+   (void)pOldMem; // Always reallocates in place
+
+   if(uNewSize == 0 || uNewSize > pMe->Buffer.len) {
+      return NULLUsefulBuf;
+   }
+   pMe->nAllocations++;
+   pMe->uLastSize = uNewSize;
+   return (UsefulBuf){pMe->Buffer.ptr, uNewSize};
+}
+
+
+int32_t IndefiniteStringOneAllocTest()
+{
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   CountingAllocator  Counter;
+
+   UsefulBuf_MAKE_STACK_UB(BigIndefBStrStorage, 290);
+   const UsefulBufC BigIndefBStr = MakeIndefiniteBigBstr(BigIndefBStrStorage);
+
+   UsefulBuf_MAKE_STACK_UB(StringStorage, 300);
+   Counter.Buffer       = StringStorage;
+   Counter.nAllocations = 0;
+
+   // Many chunks are one allocation of the whole length
+   QCBORDecode_Init(&DC, BigIndefBStr, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetUpAllocator(&DC, CountingAllocateFunction, &Counter, false);
+   if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY) {
+      return -1;
+   }
+   if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_BYTE_STRING) {
+      return -2;
+   }
+   if(CheckBigString(Item.val.string)) {
+      return -3;
+   }
+   if(Counter.nAllocations != 1 || Counter.uLastSize != 255) {
+      return -4;
+   }
+   if(QCBORDecode_Finish(&DC)) {
+      return -5;
+   }
+
+   // The chunks are not all there so the buffer is grown chunk by
+   // chunk until the end is hit
+   Counter.nAllocations = 0;
+   QCBORDecode_Init(&DC, (UsefulBufC){BigIndefBStr.ptr, BigIndefBStr.len - 1}, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetUpAllocator(&DC, CountingAllocateFunction, &Counter, false);
+   QCBORDecode_GetNext(&DC, &Item);
+   if(QCBORDecode_GetNext(&DC, &Item) != QCBOR_ERR_HIT_END) {
+      return -6;
+   }
+   if(Counter.nAllocations <= 1) {
+      return -7;
+   }
+
+   // A chunk of the wrong type is still an error
+   Counter.nAllocations = 0;
+   QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteLenStringBad2), QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetUpAllocator(&DC, CountingAllocateFunction, &Counter, false);
+   QCBORDecode_GetNext(&DC, &Item);
+   if(QCBORDecode_GetNext(&DC, &Item) != QCBOR_ERR_INDEFINITE_STRING_CHUNK) {
+      return -8;
+   }
+
+   return 0;
+}
+
+
+/*
+ The backing allocator for the arena test. It allocates from the
+ buffer it is given and counts the allocations and frees. One
+ allocation can be made to fail.
+ */
+typedef struct {
+   UsefulBuf Buffer;
+   size_t    uUsed;
+   int       nAllocations;
+   int       nFrees;
+   int       nFailAllocation; // Fail this allocation, counting from 1
+} ArenaBacking;
+
+static UsefulBuf ArenaBackingFunction(void *pCtx, void *pOldMem, size_t uNewSize)
+{
+   ArenaBacking *pMe = (ArenaBacking *)pCtx;
+
+   if(uNewSize == 0) {
+      if(pOldMem != NULL) {
+         pMe->nFrees++;
+      }
+      return NULLUsefulBuf;
+   }
+   if(pOldMem != NULL || uNewSize > pMe->Buffer.len - pMe->uUsed) {
+      // The arena should never reallocate its slabs
+      return NULLUsefulBuf;
+   }
+   pMe->nAllocations++;
+   if(pMe->nAllocations == pMe->nFailAllocation) {
+      return NULLUsefulBuf;
+   }
+   UsefulBuf Mem = {(uint8_t *)pMe->Buffer.ptr + pMe->uUsed, uNewSize};
+   // Keep the slabs aligned like malloc() would
+   pMe->uUsed += (uNewSize + 15) & ~(size_t)15;
+   return Mem;
+}
+
+
+int32_t ArenaTest()
+{
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   QCBORArena         Arena;
+   QCBORArenaStats    Stats;
+   ArenaBacking       Backing;
+   static uint8_t     spBackingBuffer[2000];
+
+   memset(&Backing, 0, sizeof(Backing));
+   Backing.Buffer = UsefulBuf_FROM_BYTE_ARRAY(spBackingBuffer);
+
+   UsefulBuf_MAKE_STACK_UB(BigIndefBStrStorage, 290);
+   const UsefulBufC BigIndefBStr = MakeIndefiniteBigBstr(BigIndefBStrStorage);
+
+   // Slabs smaller than the big string so it gets one of its own
+   QCBORArena_Init(&Arena, ArenaBackingFunction, &Backing, 64);
+
+   // Decode several times. Only the first time gets slabs.
+   for(int nPass = 0; nPass < 3; nPass++) {
+      // All strings are allocated so the CSR map strings go in the
+      // first slab
+      QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInput), QCBOR_DECODE_MODE_NORMAL);
+      QCBORDecode_SetArena(&DC, &Arena, true);
+      if(CheckCSRMaps(&DC)) {
+         return -1;
+      }
+
+      QCBORDecode_Init(&DC, BigIndefBStr, QCBOR_DECODE_MODE_NORMAL);
+      QCBORDecode_SetArena(&DC, &Arena, false);
+      if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY) {
+         return -2;
+      }
+      if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_BYTE_STRING) {
+         return -3;
+      }
+      if(CheckBigString(Item.val.string) || !Item.uDataAlloc) {
+         return -4;
+      }
+      if(QCBORDecode_Finish(&DC)) {
+         return -5;
+      }
+
+      QCBORArena_GetStats(&Arena, &Stats);
+      if(Stats.uBytesInUse < 255 || Stats.uHighWater != Stats.uBytesInUse) {
+         return -6;
+      }
+      if(nPass == 0) {
+         if(Stats.uNumSlabs != 2 || (int)Stats.uNumSlabs != Backing.nAllocations) {
+            return -7;
+         }
+      } else if((int)Stats.uNumSlabs != Backing.nAllocations) {
+         return -8;
+      }
+
+      QCBORArena_Reset(&Arena);
+      QCBORArena_GetStats(&Arena, &Stats);
+      if(Stats.uBytesInUse != 0 || Stats.uHighWater == 0) {
+         return -9;
+      }
+   }
+
+   // Reallocating the last allocation in place and freeing it
+   void *pAllocCtx = &Arena;
+   UsefulBuf Mem1 = (DC.StringAllocator.pfAllocator)(pAllocCtx, NULL, 10);
+   UsefulBuf Mem2 = (DC.StringAllocator.pfAllocator)(pAllocCtx, Mem1.ptr, 20);
+   if(UsefulBuf_IsNULL(Mem1) || Mem2.ptr != Mem1.ptr || Mem2.len != 20) {
+      return -10;
+   }
+   // Only the last allocation can be reallocated
+   UsefulBuf Mem3 = (DC.StringAllocator.pfAllocator)(pAllocCtx, NULL, 10);
+   if(!UsefulBuf_IsNULL((DC.StringAllocator.pfAllocator)(pAllocCtx, Mem1.ptr, 30))) {
+      return -11;
+   }
+   (DC.StringAllocator.pfAllocator)(pAllocCtx, Mem3.ptr, 0);
+   UsefulBuf Mem4 = (DC.StringAllocator.pfAllocator)(pAllocCtx, NULL, 10);
+   if(Mem4.ptr != Mem3.ptr) {
+      return -12;
+   }
+   QCBORArena_GetStats(&Arena, &Stats);
+   if(Stats.uBytesInUse != 30) {
+      return -13;
+   }
+
+   // Growing past the end of the slab moves to the next slab
+   memset(Mem4.ptr, 'x', Mem4.len);
+   UsefulBuf Mem5 = (DC.StringAllocator.pfAllocator)(pAllocCtx, Mem4.ptr, 100);
+   if(UsefulBuf_IsNULL(Mem5) || Mem5.ptr == Mem4.ptr || Mem5.len != 100 ||
+      memcmp(Mem5.ptr, "xxxxxxxxxx", 10)) {
+      return -16;
+   }
+   QCBORArena_GetStats(&Arena, &Stats);
+   if(Stats.uBytesInUse != 120 || (int)Stats.uNumSlabs != Backing.nAllocations) {
+      return -17;
+   }
+
+   // Give the slabs back
+   const int nAllocations = Backing.nAllocations;
+   QCBORArena_Free(&Arena);
+   QCBORArena_GetStats(&Arena, &Stats);
+   if(Backing.nFrees != nAllocations || Stats.uNumSlabs != 0 || Stats.uSlabBytes != 0) {
+      return -14;
+   }
+
+   // The backing allocator failing is a string allocation error
+   Backing.uUsed           = 0;
+   Backing.nAllocations    = 0;
+   Backing.nFailAllocation = 1;
+   QCBORArena_Init(&Arena, ArenaBackingFunction, &Backing, 0);
+   QCBORDecode_Init(&DC, BigIndefBStr, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetArena(&DC, &Arena, false);
+   QCBORDecode_GetNext(&DC, &Item);
+   if(QCBORDecode_GetNext(&DC, &Item) != QCBOR_ERR_STRING_ALLOCATE) {
+      return -15;
+   }
+
+   return 0;
+}
+
+
 int32_t AllocAllStringsTest()
 {
    QCBORDecodeContext DC;
@@ -4126,3 +4468,3198 @@ int32_t IntToTests()
    return 0;
 }
 
+
+
+/*
+ Compare items decoded from the same input in two different ways.
+ Strings are compared by value since one of the two may be allocated.
+ */
+static int DecodedItemsMatch(const QCBORItem *pItem1, const QCBORItem *pItem2)
+{
+   if(pItem1->uDataType != pItem2->uDataType ||
+      pItem1->uLabelType != pItem2->uLabelType ||
+      pItem1->uNestingLevel != pItem2->uNestingLevel ||
+      pItem1->uNextNestLevel != pItem2->uNextNestLevel ||
+      pItem1->uTagBits != pItem2->uTagBits) {
+      return 0;
+   }
+
+   switch(pItem1->uDataType) {
+      case QCBOR_TYPE_BYTE_STRING:
+      case QCBOR_TYPE_TEXT_STRING:
+      case QCBOR_TYPE_DATE_STRING:
+         if(UsefulBuf_Compare(pItem1->val.string, pItem2->val.string)) {
+            return 0;
+         }
+         break;
+
+      case QCBOR_TYPE_INT64:
+      case QCBOR_TYPE_UINT64:
+      case QCBOR_TYPE_DATE_EPOCH:
+         if(pItem1->val.int64 != pItem2->val.int64) {
+            return 0;
+         }
+         break;
+
+      case QCBOR_TYPE_DOUBLE:
+         if(memcmp(&(pItem1->val.dfnum), &(pItem2->val.dfnum), sizeof(double))) {
+            return 0;
+         }
+         break;
+
+      case QCBOR_TYPE_UKNOWN_SIMPLE:
+         if(pItem1->val.uSimple != pItem2->val.uSimple) {
+            return 0;
+         }
+         break;
+
+      case QCBOR_TYPE_ARRAY:
+      case QCBOR_TYPE_MAP:
+         if(pItem1->val.uCount != pItem2->val.uCount) {
+            return 0;
+         }
+         break;
+   }
+
+   switch(pItem1->uLabelType) {
+      case QCBOR_TYPE_BYTE_STRING:
+      case QCBOR_TYPE_TEXT_STRING:
+         if(UsefulBuf_Compare(pItem1->label.string, pItem2->label.string)) {
+            return 0;
+         }
+         break;
+
+      case QCBOR_TYPE_INT64:
+         if(pItem1->label.int64 != pItem2->label.int64) {
+            return 0;
+         }
+         break;
+   }
+
+   return 1;
+}
+
+
+/*
+ Decode Input all at once and then again adding uChunkSize bytes at a
+ time with QCBORDecode_AddInput(). The items from the two must be the
+ same. If uTruncate is non-zero, that many bytes are withheld from the
+ incremental decode and the end of input is expected to result in
+ QCBOR_ERR_HIT_END.
+ */
+/*
+ Decoding goes on after these because they are about the content of
+ an item that was consumed rather than the structure of the input.
+ */
+static bool IsContentError(QCBORError uErr)
+{
+   return uErr == QCBOR_ERR_DATE_OVERFLOW ||
+          uErr == QCBOR_ERR_BAD_OPT_TAG ||
+          uErr == QCBOR_ERR_FLOAT_DATE_UNSUPPORTED ||
+          uErr == QCBOR_ERR_HALF_PRECISION_UNSUPPORTED ||
+          uErr == QCBOR_ERR_BAD_EXP_AND_MANTISSA ||
+          uErr == QCBOR_ERR_INT_OVERFLOW;
+}
+
+
+static int32_t IncrementalDecodeOne(UsefulBufC Input,
+                                    size_t     uChunkSize,
+                                    size_t     uTruncate,
+                                    UsefulBuf  Pool)
+{
+   QCBORDecodeContext DCtx;
+   QCBORDecodeContext DCtxInc;
+   QCBORItem          Item;
+   QCBORItem          ItemInc;
+   QCBORError         uErr;
+   QCBORError         uErrInc;
+
+   QCBORDecode_Init(&DCtx, Input, QCBOR_DECODE_MODE_NORMAL);
+
+   const size_t uAvailable = Input.len - uTruncate;
+   size_t       uAdded     = uChunkSize < uAvailable ? uChunkSize : uAvailable;
+   bool         bEnded     = false;
+   QCBORDecode_InitIncremental(&DCtxInc,
+                               (UsefulBufC){Input.ptr, uAdded},
+                               QCBOR_DECODE_MODE_NORMAL);
+
+   // The one-shot decode gets the front of the pool and the
+   // incremental decode the back
+   if(!UsefulBuf_IsNULL(Pool)) {
+      const size_t uHalf = Pool.len / 2;
+      QCBORDecode_SetMemPool(&DCtx, (UsefulBuf){Pool.ptr, uHalf}, false);
+      QCBORDecode_SetMemPool(&DCtxInc,
+                             (UsefulBuf){(uint8_t *)Pool.ptr + uHalf, uHalf},
+                             false);
+   }
+
+   for(;;) {
+      uErr = QCBORDecode_GetNext(&DCtx, &Item);
+
+      for(;;) {
+         uErrInc = QCBORDecode_GetNext(&DCtxInc, &ItemInc);
+         if(uErrInc != QCBOR_ERR_NEED_MORE_DATA) {
+            break;
+         }
+         if(uAdded == uAvailable) {
+            QCBORDecode_EndOfInput(&DCtxInc);
+            bEnded = true;
+         } else {
+            // Nothing was consumed, so the next call starts over from
+            // the beginning of the item
+            const size_t uMore = uChunkSize < uAvailable - uAdded ?
+                                 uChunkSize : uAvailable - uAdded;
+            QCBORDecode_AddInput(&DCtxInc, uMore);
+            uAdded += uMore;
+         }
+      }
+
+      if(uTruncate) {
+         // Truncation on an item boundary at the top level is the
+         // end of a shorter CBOR sequence
+         if(uErrInc == QCBOR_ERR_HIT_END || uErrInc == QCBOR_ERR_NO_MORE_ITEMS) {
+            return 0;
+         }
+         if(uErrInc != uErr) {
+            return -1;
+         }
+      } else if(uErrInc != uErr) {
+         return -2;
+      }
+
+      if(uErr == QCBOR_ERR_NO_MORE_ITEMS) {
+         break;
+      }
+      if(uErr != QCBOR_SUCCESS && !IsContentError(uErr)) {
+         // Both stopped with the same error. Going on could return it
+         // forever, for example QCBOR_ERR_HIT_END for arrays left
+         // open by QCBOR_ERR_ARRAY_NESTING_TOO_DEEP.
+         return 0;
+      }
+      // Some of the inputs have dates that are errors, but decoding
+      // can continue after them. The last item before truncation
+      // can't be compared because of breaks that are missing.
+      if(uErr == QCBOR_SUCCESS &&
+         !bEnded &&
+         !DecodedItemsMatch(&Item, &ItemInc)) {
+         return -4;
+      }
+   }
+
+   if(uTruncate) {
+      // Should have run out of input before the end
+      return -5;
+   }
+
+   if(QCBORDecode_Finish(&DCtxInc) != QCBOR_SUCCESS) {
+      return -6;
+   }
+
+   return 0;
+}
+
+
+int32_t IncrementalDecodeTest()
+{
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+
+   UsefulBuf_MAKE_STACK_UB(Pool, 600);
+   UsefulBuf_MAKE_STACK_UB(BigBstrStorage, 290);
+   UsefulBuf_MAKE_STACK_UB(NestedStorage, 30);
+
+   const UsefulBufC aInputs[] = {
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInput),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInputIndefLen),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spDateTestInput),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRWithTags),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(sEmpties),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteLenStringLabel),
+      MakeIndefiniteBigBstr(BigBstrStorage),
+      make_nested_indefinite_arrays(10, NestedStorage),
+   };
+
+   for(size_t i = 0; i < sizeof(aInputs)/sizeof(aInputs[0]); i++) {
+      // Chunks of 1 byte result in QCBOR_ERR_NEED_MORE_DATA for
+      // every part of every item
+      static const size_t auChunkSizes[] = {1, 2, 3, 7, 64, SIZE_MAX};
+      for(size_t j = 0; j < sizeof(auChunkSizes)/sizeof(auChunkSizes[0]); j++) {
+         const int32_t nResult = IncrementalDecodeOne(aInputs[i],
+                                                      auChunkSizes[j],
+                                                      0,
+                                                      Pool);
+         if(nResult) {
+            return (int32_t)(i * 100 + j * 10) + nResult;
+         }
+      }
+
+      for(size_t uTruncate = 1; uTruncate <= aInputs[i].len; uTruncate++) {
+         const int32_t nResult = IncrementalDecodeOne(aInputs[i],
+                                                      1,
+                                                      uTruncate,
+                                                      Pool);
+         if(nResult) {
+            return (int32_t)(i * 100 + 90) + nResult;
+         }
+      }
+   }
+
+   // --- Nothing is consumed when more data is needed ---
+   QCBORDecode_InitIncremental(&DCtx,
+                               (UsefulBufC){spCSRInput, 3},
+                               QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP) {
+      return 1000;
+   }
+   const size_t uPosition = UsefulInputBuf_Tell(&(DCtx.InBuf));
+   if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NEED_MORE_DATA ||
+      QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NEED_MORE_DATA) {
+      return 1001;
+   }
+   if(UsefulInputBuf_Tell(&(DCtx.InBuf)) != uPosition ||
+      Item.uDataType != QCBOR_TYPE_NONE) {
+      return 1002;
+   }
+   QCBORDecode_AddInput(&DCtx, sizeof(spCSRInput) - 3);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP ||
+      Item.uLabelType != QCBOR_TYPE_INT64 ||
+      Item.label.int64 != -20) {
+      return 1003;
+   }
+
+   // --- Adding more than can be addressed is ignored ---
+   QCBORDecode_AddInput(&DCtx, SIZE_MAX);
+   if(DCtx.InBuf.UB.len != sizeof(spCSRInput)) {
+      return 1004;
+   }
+
+   // --- The end of input on an item boundary is OK ---
+   QCBORDecode_InitIncremental(&DCtx,
+                               UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInput),
+                               QCBOR_DECODE_MODE_NORMAL);
+   QCBORError uErr;
+   do {
+      uErr = QCBORDecode_GetNext(&DCtx, &Item);
+   } while(uErr == QCBOR_SUCCESS);
+   if(uErr != QCBOR_ERR_NEED_MORE_DATA) {
+      return 1005;
+   }
+   QCBORDecode_EndOfInput(&DCtx);
+   if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NO_MORE_ITEMS ||
+      QCBORDecode_Finish(&DCtx) != QCBOR_SUCCESS) {
+      return 1006;
+   }
+
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS) && \
+    !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS)
+   // --- Retries don't leak the strings of the item tried ---
+   // [_ (_ "a", "b")] with the last break not received yet. The
+   // string is decoded and allocated every time, then given up on
+   // because the array might end after it. The pool only has room for
+   // a few copies of it.
+   static const uint8_t spIndefStringInIndefArray[] = {
+      0x9f, 0x7f, 0x61, 0x61, 0x61, 0x62, 0xff, 0xff
+   };
+   UsefulBuf_MAKE_STACK_UB(SmallPool, QCBOR_DECODE_MIN_MEM_POOL_SIZE + 8);
+   QCBORDecode_InitIncremental(&DCtx,
+                               (UsefulBufC){spIndefStringInIndefArray,
+                                            sizeof(spIndefStringInIndefArray) - 1},
+                               QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetMemPool(&DCtx, SmallPool, false);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_ARRAY) {
+      return 1010;
+   }
+   for(int i = 0; i < 20; i++) {
+      QCBORDecode_AddInput(&DCtx, 0);
+      if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NEED_MORE_DATA) {
+         return 1011;
+      }
+   }
+   QCBORDecode_AddInput(&DCtx, 1);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_TEXT_STRING ||
+      UsefulBuf_Compare(Item.val.string, UsefulBuf_FROM_SZ_LITERAL("ab")) ||
+      Item.uNextNestLevel != 0) {
+      return 1012;
+   }
+   QCBORDecode_EndOfInput(&DCtx);
+   if(QCBORDecode_Finish(&DCtx)) {
+      return 1013;
+   }
+#endif /* !QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS && !QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS */
+
+   return 0;
+}
+
+
+/*
+ An array of scalars with some nesting, tags and a map part way
+ through to break up the batches.
+ */
+static UsefulBufC MakeBatchInput(UsefulBuf Storage)
+{
+   QCBOREncodeContext ECtx;
+
+   QCBOREncode_Init(&ECtx, Storage);
+   QCBOREncode_OpenArray(&ECtx);
+   for(int64_t n = -300; n < 300; n += 7) {
+      QCBOREncode_AddInt64(&ECtx, n * n * n);
+   }
+   QCBOREncode_AddDouble(&ECtx, 1.5);
+   QCBOREncode_AddDouble(&ECtx, -0.0);
+   QCBOREncode_AddDouble(&ECtx, 3.14159265358979);
+   QCBOREncode_AddSZString(&ECtx, "batch");
+   QCBOREncode_AddBytes(&ECtx, ((UsefulBufC){"\x01\x02\x03", 3}));
+   QCBOREncode_AddBool(&ECtx, true);
+   QCBOREncode_AddNULL(&ECtx);
+   QCBOREncode_AddUndef(&ECtx);
+   QCBOREncode_AddSimple(&ECtx, 99);
+   QCBOREncode_AddDateEpoch(&ECtx, 1400000000);
+   QCBOREncode_OpenArray(&ECtx);
+   QCBOREncode_AddUInt64(&ECtx, UINT64_MAX);
+   QCBOREncode_OpenArray(&ECtx);
+   QCBOREncode_CloseArray(&ECtx);
+   QCBOREncode_AddInt64(&ECtx, 2);
+   QCBOREncode_CloseArray(&ECtx);
+   QCBOREncode_OpenMap(&ECtx);
+   QCBOREncode_AddInt64ToMapN(&ECtx, 1, 1);
+   QCBOREncode_AddSZStringToMap(&ECtx, "two", "2");
+   QCBOREncode_CloseMap(&ECtx);
+   QCBOREncode_AddInt64(&ECtx, 42);
+   QCBOREncode_AddInt64(&ECtx, 43);
+   QCBOREncode_CloseArray(&ECtx);
+
+   UsefulBufC Encoded;
+   if(QCBOREncode_Finish(&ECtx, &Encoded)) {
+      return NULLUsefulBufC;
+   }
+   return Encoded;
+}
+
+
+/*
+ Decode Input with QCBORDecode_GetNext() and again with
+ QCBORDecode_GetNextBatch() in batches of uBatchSize and check the
+ items and errors are the same. Errors are continued after as long
+ as QCBORDecode_GetNext() makes progress.
+ */
+static int32_t BatchDecodeOne(UsefulBufC Input,
+                              QCBORDecodeMode nMode,
+                              size_t uBatchSize,
+                              UsefulBuf Pool)
+{
+   QCBORDecodeContext DCtx;
+   QCBORDecodeContext DCtxBatch;
+   QCBORItem          Item;
+   QCBORItem          aBatch[16];
+   size_t             uNumInBatch = 0;
+   size_t             uNext       = 0;
+   QCBORError         uErr;
+   QCBORError         uErrBatch   = QCBOR_SUCCESS;
+
+   if(uBatchSize > sizeof(aBatch)/sizeof(aBatch[0])) {
+      return -1;
+   }
+
+   QCBORDecode_Init(&DCtx, Input, nMode);
+   QCBORDecode_Init(&DCtxBatch, Input, nMode);
+   if(!UsefulBuf_IsNULL(Pool)) {
+      const size_t uHalf = Pool.len / 2;
+      QCBORDecode_SetMemPool(&DCtx, (UsefulBuf){Pool.ptr, uHalf}, true);
+      QCBORDecode_SetMemPool(&DCtxBatch,
+                             (UsefulBuf){(uint8_t *)Pool.ptr + uHalf, uHalf},
+                             true);
+   }
+
+   for(int nGuard = 0; nGuard < 2000; nGuard++) {
+      uErr = QCBORDecode_GetNext(&DCtx, &Item);
+
+      if(uNext == uNumInBatch) {
+         if(uErrBatch != QCBOR_SUCCESS) {
+            // The error is after the last item of the previous batch
+            if(uErrBatch != uErr) {
+               return -2;
+            }
+            uErrBatch   = QCBOR_SUCCESS;
+            uNumInBatch = 0;
+            uNext       = 0;
+            goto Next;
+         }
+
+         uErrBatch = QCBORDecode_GetNextBatch(&DCtxBatch, aBatch, uBatchSize, &uNumInBatch);
+         uNext = 0;
+         if(uNumInBatch > uBatchSize) {
+            return -3;
+         }
+         if(uNumInBatch == 0) {
+            if(uErrBatch != uErr) {
+               return -4;
+            }
+            uErrBatch = QCBOR_SUCCESS;
+            goto Next;
+         }
+         // All the items in a batch are at the same level and only the
+         // last may open or close a map or array
+         for(size_t i = 0; i + 1 < uNumInBatch; i++) {
+            if(aBatch[i].uNestingLevel != aBatch[0].uNestingLevel ||
+               aBatch[i].uNextNestLevel != aBatch[i].uNestingLevel ||
+               aBatch[i].uDataType == QCBOR_TYPE_ARRAY ||
+               aBatch[i].uDataType == QCBOR_TYPE_MAP) {
+               return -5;
+            }
+         }
+         if(uErrBatch == QCBOR_SUCCESS &&
+            uNumInBatch < uBatchSize &&
+            aBatch[uNumInBatch-1].uNextNestLevel == aBatch[uNumInBatch-1].uNestingLevel &&
+            aBatch[uNumInBatch-1].uDataType != QCBOR_TYPE_ARRAY &&
+            aBatch[uNumInBatch-1].uDataType != QCBOR_TYPE_MAP &&
+            aBatch[uNumInBatch-1].uDataType != QCBOR_TYPE_MAP_AS_ARRAY) {
+            // Stopped early for no reason
+            return -6;
+         }
+      }
+
+      if(uErr != QCBOR_SUCCESS) {
+         return -7;
+      }
+      if(!DecodedItemsMatch(&Item, &aBatch[uNext])) {
+         return -8;
+      }
+      uNext++;
+
+   Next:
+      if(uErr == QCBOR_ERR_NO_MORE_ITEMS || uErr == QCBOR_ERR_HIT_END) {
+         return 0;
+      }
+   }
+
+   return -9;
+}
+
+
+int32_t BatchDecodeTest()
+{
+   QCBORDecodeContext DCtx;
+   QCBORItem          aItems[4];
+   size_t             uNum;
+
+   UsefulBuf_MAKE_STACK_UB(Pool, 1200);
+   UsefulBuf_MAKE_STACK_UB(BigBstrStorage, 290);
+   UsefulBuf_MAKE_STACK_UB(NestedStorage, 30);
+   UsefulBuf_MAKE_STACK_UB(BatchStorage, 800);
+
+   const UsefulBufC BatchInput = MakeBatchInput(BatchStorage);
+   if(UsefulBuf_IsNULLC(BatchInput)) {
+      return 1;
+   }
+
+   const UsefulBufC aInputs[] = {
+      BatchInput,
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spExpectedEncodedInts),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSimpleValues),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInput),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInputIndefLen),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spDateTestInput),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRWithTags),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(sEmpties),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spDeepArrays),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteLenStringLabel),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteArrayBad3),
+      MakeIndefiniteBigBstr(BigBstrStorage),
+      make_nested_indefinite_arrays(10, NestedStorage),
+      {BatchInput.ptr, BatchInput.len - 3}, // Truncated
+   };
+
+   static const size_t auBatchSizes[] = {1, 2, 3, 16};
+
+   for(size_t i = 0; i < sizeof(aInputs)/sizeof(aInputs[0]); i++) {
+      for(size_t j = 0; j < sizeof(auBatchSizes)/sizeof(auBatchSizes[0]); j++) {
+         int32_t nResult;
+
+         nResult = BatchDecodeOne(aInputs[i], QCBOR_DECODE_MODE_NORMAL, auBatchSizes[j], Pool);
+         if(nResult) {
+            return (int32_t)(1000 + i * 100 + j * 10) - nResult;
+         }
+         nResult = BatchDecodeOne(aInputs[i], QCBOR_DECODE_MODE_MAP_AS_ARRAY, auBatchSizes[j], NULLUsefulBuf);
+         if(nResult) {
+            return (int32_t)(3000 + i * 100 + j * 10) - nResult;
+         }
+      }
+   }
+
+   // --- The items in the fast path are the same as from GetNext() ---
+   QCBORDecode_Init(&DCtx, BatchInput, QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNextBatch(&DCtx, aItems, 4, &uNum) ||
+      uNum != 1 ||
+      aItems[0].uDataType != QCBOR_TYPE_ARRAY ||
+      aItems[0].uNextNestLevel != 1) {
+      return 10;
+   }
+   if(QCBORDecode_GetNextBatch(&DCtx, aItems, 4, &uNum) ||
+      uNum != 4 ||
+      aItems[0].uDataType != QCBOR_TYPE_INT64 ||
+      aItems[0].val.int64 != -27000000 ||
+      aItems[3].val.int64 != -(279 * 279 * 279) ||
+      aItems[3].uLabelType != QCBOR_TYPE_NONE ||
+      aItems[3].uTagBits != 0 ||
+      aItems[3].uNestingLevel != 1 ||
+      aItems[3].uNextNestLevel != 1) {
+      return 11;
+   }
+
+   // --- A batch of zero ---
+   if(QCBORDecode_GetNextBatch(&DCtx, aItems, 0, &uNum) || uNum != 0) {
+      return 12;
+   }
+
+   // --- An error comes with the good items before it ---
+   QCBORDecode_Init(&DCtx,
+                    UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spDateTestInput),
+                    QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNextBatch(&DCtx, aItems, 4, &uNum) != QCBOR_ERR_DATE_OVERFLOW ||
+      uNum != 3 ||
+      aItems[0].uDataType != QCBOR_TYPE_DATE_STRING ||
+      aItems[2].uDataType != QCBOR_TYPE_DATE_EPOCH) {
+      return 13;
+   }
+#ifndef QCBOR_DISABLE_FLOAT_HW_USE
+   // The next good item is a float date
+   if(QCBORDecode_GetNextBatch(&DCtx, aItems, 4, &uNum) != QCBOR_ERR_DATE_OVERFLOW ||
+      uNum != 1) {
+      return 14;
+   }
+#endif /* QCBOR_DISABLE_FLOAT_HW_USE */
+
+   return 0;
+}
+
+
+/*
+ Label strings for IndexedMapTest(), "k0" to "k99"
+ */
+static const char *IndexTestLabel(int n, char *szBuf)
+{
+   szBuf[0] = 'k';
+   if(n >= 10) {
+      szBuf[1] = (char)('0' + n / 10);
+      szBuf[2] = (char)('0' + n % 10);
+      szBuf[3] = '\0';
+   } else {
+      szBuf[1] = (char)('0' + n);
+      szBuf[2] = '\0';
+   }
+   return szBuf;
+}
+
+
+/*
+ [ {300 integer labels out of order, 100 text labels, a nested map,
+    an array}, 99 ]
+ */
+static UsefulBufC MakeIndexTestInput(UsefulBuf Storage)
+{
+   QCBOREncodeContext ECtx;
+   char               szLabel[4];
+
+   QCBOREncode_Init(&ECtx, Storage);
+   QCBOREncode_OpenArray(&ECtx);
+   QCBOREncode_OpenMap(&ECtx);
+   for(int64_t n = 0; n < 300; n++) {
+      const int64_t nLabel = (n * 37) % 300 - 100;
+      QCBOREncode_AddInt64ToMapN(&ECtx, nLabel, nLabel * 1000);
+   }
+   for(int n = 0; n < 100; n++) {
+      QCBOREncode_AddSZStringToMap(&ECtx, IndexTestLabel(n, szLabel), szLabel);
+   }
+   QCBOREncode_OpenMapInMapN(&ECtx, 1000);
+   QCBOREncode_AddInt64ToMapN(&ECtx, 1, 11);
+   QCBOREncode_OpenArrayInMapN(&ECtx, 2);
+   QCBOREncode_AddInt64(&ECtx, 22);
+   QCBOREncode_CloseArray(&ECtx);
+   QCBOREncode_CloseMap(&ECtx);
+   QCBOREncode_OpenArrayInMap(&ECtx, "array");
+   QCBOREncode_AddInt64(&ECtx, 1);
+   QCBOREncode_AddInt64(&ECtx, 2);
+   QCBOREncode_CloseArray(&ECtx);
+   QCBOREncode_CloseMap(&ECtx);
+   QCBOREncode_AddInt64(&ECtx, 99);
+   QCBOREncode_CloseArray(&ECtx);
+
+   UsefulBufC Encoded;
+   if(QCBOREncode_Finish(&ECtx, &Encoded)) {
+      return NULLUsefulBufC;
+   }
+   return Encoded;
+}
+
+
+/*
+ Look up items in the CSR input with a map index. This is run on both
+ the definite and indefinite-length versions.
+ */
+static int32_t IndexCSRMaps(UsefulBufC Input)
+{
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   QCBORMapIndex      Index;
+   QCBORMapIndex      InnerIndex;
+   QCBORMapIndexEntry aEntries[5];
+   QCBORMapIndexEntry aInnerEntries[5];
+
+   QCBORDecode_Init(&DCtx, Input, QCBOR_DECODE_MODE_NORMAL);
+
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP ||
+      Item.label.int64 != -23) {
+      return 1;
+   }
+
+   if(QCBORDecode_IndexMap(&DCtx, &Item, &Index, aEntries, 5)) {
+      return 2;
+   }
+
+   // Out of order
+   if(QCBORDecode_GetItemInIndexN(&DCtx, &Index, -19, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP ||
+      Item.uNestingLevel != 2) {
+      return 3;
+   }
+   // Index the map that was just found
+   if(QCBORDecode_IndexMap(&DCtx, &Item, &InnerIndex, aInnerEntries, 5)) {
+      return 4;
+   }
+   if(QCBORDecode_GetItemInIndexN(&DCtx, &InnerIndex, -10, &Item) ||
+      Item.uDataType != QCBOR_TYPE_BYTE_STRING ||
+      Item.val.string.len != 10) {
+      return 5;
+   }
+   if(QCBORDecode_GetItemInIndexN(&DCtx, &InnerIndex, -11, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.label.int64 != -9 ||
+      Item.val.int64 != -7 ||
+      Item.uNestingLevel != 4) {
+      return 6;
+   }
+
+   if(QCBORDecode_GetItemInIndexN(&DCtx, &Index, -20, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP ||
+      Item.val.uCount != (Input.len == sizeof(spCSRInput) ? 5 : QCBOR_COUNT_INDEFINITE)) {
+      return 7;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_TEXT_STRING ||
+      Item.label.int64 != -18 ||
+      UsefulBuf_Compare(Item.val.string, UsefulBuf_FromSZ("Organization"))) {
+      return 8;
+   }
+
+   if(QCBORDecode_GetItemInIndexN(&DCtx, &Index, -21, &Item) != QCBOR_ERR_LABEL_NOT_FOUND ||
+      Item.uDataType != QCBOR_TYPE_NONE) {
+      return 9;
+   }
+
+   // Continuing with GetNext() from an entry is the same as
+   // decoding the map in order from that entry
+   if(QCBORDecode_GetItemInIndexN(&DCtx, &Index, -19, &Item) ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.label.int64 != -11 ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.label.int64 != -9 ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.label.int64 != -10 ||
+      Item.uNextNestLevel != 1 ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.label.int64 != -22 ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.label.int64 != -5 ||
+      Item.uNextNestLevel != 0) {
+      return 10;
+   }
+
+   // Exit and the end of the outer map is where GetNext() continues
+   QCBORDecode_ExitIndexedMap(&DCtx, &Index);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.label.int64 != -22 ||
+      Item.uNestingLevel != 1) {
+      return 11;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NO_MORE_ITEMS ||
+      QCBORDecode_Finish(&DCtx)) {
+      return 12;
+   }
+
+   return 0;
+}
+
+
+int32_t IndexedMapTest()
+{
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   QCBORItem          MapItem;
+   QCBORMapIndex      Index;
+   QCBORMapIndexEntry aEntries[410];
+   char               szLabel[4];
+   int32_t            nResult;
+
+   UsefulBuf_MAKE_STACK_UB(Storage, 5000);
+   const UsefulBufC Input = MakeIndexTestInput(Storage);
+   if(UsefulBuf_IsNULLC(Input)) {
+      return 1;
+   }
+
+   QCBORDecode_Init(&DCtx, Input, QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) || QCBORDecode_GetNext(&DCtx, &MapItem)) {
+      return 2;
+   }
+   if(QCBORDecode_IndexMap(&DCtx, &MapItem, &Index, aEntries, 410)) {
+      return 3;
+   }
+
+   // The decoder is now after the map
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.val.int64 != 99 ||
+      Item.uNestingLevel != 1) {
+      return 4;
+   }
+
+   // Every label, in an order different from the encoding
+   for(int64_t n = 0; n < 300; n++) {
+      const int64_t nLabel = (n * 53) % 300 - 100;
+      if(QCBORDecode_GetItemInIndexN(&DCtx, &Index, nLabel, &Item) ||
+         Item.uLabelType != QCBOR_TYPE_INT64 ||
+         Item.label.int64 != nLabel ||
+         Item.val.int64 != nLabel * 1000 ||
+         Item.uNestingLevel != 2) {
+         return 100 + (int32_t)n;
+      }
+   }
+   for(int n = 99; n >= 0; n--) {
+      if(QCBORDecode_GetItemInIndexSZ(&DCtx, &Index, IndexTestLabel(n, szLabel), &Item) ||
+         Item.uDataType != QCBOR_TYPE_TEXT_STRING ||
+         UsefulBuf_Compare(Item.val.string, UsefulBuf_FromSZ(szLabel))) {
+         return 400 + n;
+      }
+   }
+   if(QCBORDecode_GetItemInIndexSZ(&DCtx, &Index, "k100", &Item) != QCBOR_ERR_LABEL_NOT_FOUND ||
+      QCBORDecode_GetItemInIndexN(&DCtx, &Index, 200, &Item) != QCBOR_ERR_LABEL_NOT_FOUND) {
+      return 500;
+   }
+
+   // The nested map and array can be decoded after they are found
+   if(QCBORDecode_GetItemInIndexN(&DCtx, &Index, 1000, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.val.int64 != 11 ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_ARRAY ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.val.int64 != 22 ||
+      Item.uNextNestLevel != 2) {
+      return 501;
+   }
+   if(QCBORDecode_GetItemInIndexSZ(&DCtx, &Index, "array", &Item) ||
+      Item.uDataType != QCBOR_TYPE_ARRAY ||
+      Item.val.uCount != 2) {
+      return 502;
+   }
+
+   QCBORDecode_ExitIndexedMap(&DCtx, &Index);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.val.int64 != 99 ||
+      QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NO_MORE_ITEMS ||
+      QCBORDecode_Finish(&DCtx)) {
+      return 503;
+   }
+
+   // --- Not enough entries ---
+   QCBORDecode_Init(&DCtx, Input, QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) || QCBORDecode_GetNext(&DCtx, &MapItem)) {
+      return 600;
+   }
+   if(QCBORDecode_IndexMap(&DCtx, &MapItem, &Index, aEntries, 401) != QCBOR_ERR_INDEX_TOO_SMALL) {
+      return 601;
+   }
+
+   // --- Not right after the map ---
+   QCBORDecode_Init(&DCtx, Input, QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item)) {
+      return 700;
+   }
+   if(QCBORDecode_IndexMap(&DCtx, &Item, &Index, aEntries, 410) != QCBOR_ERR_MAP_NOT_ENTERED) {
+      return 701;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &MapItem) || QCBORDecode_GetNext(&DCtx, &Item)) {
+      return 702;
+   }
+   if(QCBORDecode_IndexMap(&DCtx, &MapItem, &Index, aEntries, 410) != QCBOR_ERR_MAP_NOT_ENTERED) {
+      return 703;
+   }
+
+   // --- Empty maps ---
+   static const uint8_t spEmptyMaps[] = {0x9f, 0xa0, 0xbf, 0xff, 0x01, 0xff};
+   QCBORDecode_Init(&DCtx,
+                    UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spEmptyMaps),
+                    QCBOR_DECODE_MODE_NORMAL);
+   for(int i = 0; i < 2; i++) {
+      if(QCBORDecode_GetNext(&DCtx, &Item) || (i == 0 && QCBORDecode_GetNext(&DCtx, &Item))) {
+         return 800;
+      }
+      if(QCBORDecode_IndexMap(&DCtx, &Item, &Index, aEntries, 0) ||
+         QCBORDecode_GetItemInIndexN(&DCtx, &Index, 1, &Item) != QCBOR_ERR_LABEL_NOT_FOUND) {
+         return 801;
+      }
+      QCBORDecode_ExitIndexedMap(&DCtx, &Index);
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.val.int64 != 1 ||
+      QCBORDecode_Finish(&DCtx)) {
+      return 802;
+   }
+
+   // --- Definite and indefinite lengths ---
+   nResult = IndexCSRMaps(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInput));
+   if(nResult) {
+      return 900 + nResult;
+   }
+   nResult = IndexCSRMaps(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInputIndefLen));
+   if(nResult) {
+      return 950 + nResult;
+   }
+
+   // --- Strings allocated while scanning are freed ---
+   // The pool is big enough for the strings of a few entries, but not
+   // for all the strings in the map.
+   UsefulBuf_MAKE_STACK_UB(Pool, 200);
+   QCBORDecode_Init(&DCtx, Input, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetMemPool(&DCtx, Pool, true);
+   if(QCBORDecode_GetNext(&DCtx, &Item) || QCBORDecode_GetNext(&DCtx, &MapItem)) {
+      return 1000;
+   }
+   if(QCBORDecode_IndexMap(&DCtx, &MapItem, &Index, aEntries, 410)) {
+      return 1001;
+   }
+   if(QCBORDecode_GetItemInIndexSZ(&DCtx, &Index, "k42", &Item) ||
+      Item.uDataAlloc != 1 ||
+      Item.uLabelAlloc != 1 ||
+      UsefulBuf_Compare(Item.val.string, UsefulBuf_FromSZ("k42"))) {
+      return 1002;
+   }
+
+   return 0;
+}
+
+
+/*
+ An array of 33 integers. Item n is tagged with the custom tag
+ puTags[n] and with the built-in tag CBOR_TAG_CWT . The last item is
+ also tagged CBOR_TAG_CBOR_MAGIC.
+ */
+static UsefulBufC MakeCustomTagsInput(UsefulBuf Storage, const uint64_t *puTags)
+{
+   QCBOREncodeContext ECtx;
+
+   QCBOREncode_Init(&ECtx, Storage);
+   QCBOREncode_OpenArray(&ECtx);
+   for(int n = 0; n < 33; n++) {
+      if(n == 32) {
+         QCBOREncode_AddTag(&ECtx, CBOR_TAG_CBOR_MAGIC);
+      }
+      QCBOREncode_AddTag(&ECtx, puTags[n]);
+      QCBOREncode_AddTag(&ECtx, CBOR_TAG_CWT);
+      QCBOREncode_AddInt64(&ECtx, n);
+   }
+   QCBOREncode_CloseArray(&ECtx);
+
+   UsefulBufC Encoded;
+   if(QCBOREncode_Finish(&ECtx, &Encoded)) {
+      return NULLUsefulBufC;
+   }
+   return Encoded;
+}
+
+
+/*
+ Decode the output of MakeCustomTagsInput() with a list of the first
+ uNumTags of puTags configured. Each item must have exactly its own
+ tag set and the custom tags not in the list must not be reported.
+ */
+static int32_t CustomTagsDecodeOne(UsefulBufC Encoded, const uint64_t *puTags, uint8_t uNumTags)
+{
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+
+   QCBORDecode_Init(&DCtx, Encoded, QCBOR_DECODE_MODE_NORMAL);
+   const QCBORTagListIn TagList = {uNumTags, puTags};
+   QCBORDecode_SetCallerConfiguredTagList(&DCtx, &TagList);
+
+   if(QCBORDecode_GetNext(&DCtx, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY) {
+      return -1;
+   }
+
+   for(int n = 0; n < 33; n++) {
+      if(QCBORDecode_GetNext(&DCtx, &Item) ||
+         Item.uDataType != QCBOR_TYPE_INT64 ||
+         Item.val.int64 != n) {
+         return -(n * 10 + 2);
+      }
+      if(!QCBORDecode_IsTagged(&DCtx, &Item, CBOR_TAG_CWT) ||
+         QCBORDecode_IsTagged(&DCtx, &Item, CBOR_TAG_COSE_SIGN1) ||
+         QCBORDecode_IsTagged(&DCtx, &Item, CBOR_TAG_CBOR_MAGIC) != (n == 32)) {
+         return -(n * 10 + 3);
+      }
+      for(int m = 0; m < 33; m++) {
+         const int bExpected = m == n && m < uNumTags;
+         if(QCBORDecode_IsTagged(&DCtx, &Item, puTags[m]) != bExpected) {
+            return -(n * 10 + 4);
+         }
+      }
+   }
+
+   if(QCBORDecode_Finish(&DCtx)) {
+      return -400;
+   }
+
+   return 0;
+}
+
+
+int32_t CustomTagsTest()
+{
+   UsefulBuf_MAKE_STACK_UB(Storage, 600);
+   int32_t nResult;
+
+   // Sorted tags, with large ones and ones near the built-in tags
+   uint64_t puSorted[33];
+   for(int n = 0; n < 33; n++) {
+      puSorted[n] = n < 30 ? 256 + (uint64_t)n * 1013 : UINT64_MAX - 32 + (uint64_t)n;
+   }
+   const UsefulBufC Sorted = MakeCustomTagsInput(Storage, puSorted);
+   if(UsefulBuf_IsNULLC(Sorted)) {
+      return -1;
+   }
+
+   nResult = CustomTagsDecodeOne(Sorted, puSorted, 32);
+   if(nResult) {
+      return nResult - 1000;
+   }
+   nResult = CustomTagsDecodeOne(Sorted, puSorted, 16);
+   if(nResult) {
+      return nResult - 2000;
+   }
+   nResult = CustomTagsDecodeOne(Sorted, puSorted, 0);
+   if(nResult) {
+      return nResult - 3000;
+   }
+
+   // The same tags unsorted so the linear search is used
+   uint64_t puUnsorted[33];
+   for(int n = 0; n < 33; n++) {
+      puUnsorted[n] = puSorted[(n * 7) % 33];
+   }
+   UsefulBuf_MAKE_STACK_UB(Storage2, 600);
+   const UsefulBufC Unsorted = MakeCustomTagsInput(Storage2, puUnsorted);
+   if(UsefulBuf_IsNULLC(Unsorted)) {
+      return -2;
+   }
+   nResult = CustomTagsDecodeOne(Unsorted, puUnsorted, 32);
+   if(nResult) {
+      return nResult - 4000;
+   }
+   nResult = CustomTagsDecodeOne(Unsorted, puUnsorted, 17);
+   if(nResult) {
+      return nResult - 5000;
+   }
+
+   // One more than the maximum is an error when a tag is looked up
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   QCBORDecode_Init(&DCtx, Sorted, QCBOR_DECODE_MODE_NORMAL);
+   const QCBORTagListIn TooMany = {QCBOR_MAX_CUSTOM_TAGS_EXTENDED + 1, puSorted};
+   QCBORDecode_SetCallerConfiguredTagList(&DCtx, &TooMany);
+   if(QCBORDecode_GetNext(&DCtx, &Item)) {
+      return -3;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_TOO_MANY_TAGS) {
+      return -4;
+   }
+
+   return 0;
+}
+
+
+struct ValidateInput {
+   UsefulBufC Input;
+   QCBORError nError;
+   size_t     uOffset;
+};
+
+static const struct ValidateInput spValidateInputs[] = {
+   // Empty input is not a data item
+   { {(uint8_t[]){0x00}, 0}, QCBOR_ERR_HIT_END, 0 },
+   // Two data items when one is expected
+   { {(uint8_t[]){0x01, 0x02}, 2}, QCBOR_ERR_EXTRA_BYTES, 1 },
+   // Reserved additional info in the third item of an array
+   { {(uint8_t[]){0x83, 0x01, 0x02, 0x1c}, 4}, QCBOR_ERR_UNSUPPORTED, 3 },
+   // String that runs off the end
+   { {(uint8_t[]){0x82, 0x00, 0x63, 0x61, 0x62}, 5}, QCBOR_ERR_HIT_END, 2 },
+   // Array whose count is more than the bytes left
+   { {(uint8_t[]){0x99, 0x01, 0x00, 0x00, 0x00}, 5}, QCBOR_ERR_HIT_END, 0 },
+   // Map with a label and no value before the break
+   { {(uint8_t[]){0xbf, 0x01, 0x02, 0x03, 0xff}, 5}, QCBOR_ERR_BAD_BREAK, 4 },
+   // Tag with no content before the break
+   { {(uint8_t[]){0x9f, 0xc1, 0xff}, 3}, QCBOR_ERR_BAD_BREAK, 2 },
+   // Tag at the end of the input
+   { {(uint8_t[]){0xd9, 0xd9, 0xf7}, 3}, QCBOR_ERR_HIT_END, 3 },
+   // Indefinite-length tag
+   { {(uint8_t[]){0x81, 0xdf, 0x00}, 3}, QCBOR_ERR_BAD_INT, 1 },
+   // Text chunk in a byte string
+   { {(uint8_t[]){0x5f, 0x41, 0x00, 0x61, 0x00, 0xff}, 6}, QCBOR_ERR_INDEFINITE_STRING_CHUNK, 3 },
+   // Two byte encoding of a simple value less than 32
+   { {(uint8_t[]){0x82, 0xf5, 0xf8, 0x1f}, 4}, QCBOR_ERR_BAD_TYPE_7, 2 },
+   // An indefinite-length array in a definite-length one
+   { {(uint8_t[]){0x82, 0x9f, 0x01, 0xff, 0x02}, 5}, QCBOR_SUCCESS, 0 },
+   // Indefinite-length string of two chunks as a map label
+   { {(uint8_t[]){0xa1, 0x7f, 0x61, 0x61, 0x60, 0xff, 0x01}, 7}, QCBOR_SUCCESS, 0 },
+   // Tagged empty map and zero-length strings
+   { {(uint8_t[]){0x83, 0xc1, 0xa0, 0x40, 0x60}, 5}, QCBOR_SUCCESS, 0 },
+};
+
+
+int32_t ValidateTest()
+{
+   QCBORError nReturn;
+   size_t     uOffset;
+
+   // Everything in the not-well-formed corpus must fail. It is
+   // checked as a sequence the same as NotWellFormedTests() does.
+   const QCBORValidateLimits Sequence = {0, 1, 0, 0};
+   const size_t uNumNotWellFormed = sizeof(paNotWellFormedCBOR)/sizeof(struct someBinaryBytes);
+   for(size_t u = 0; u < uNumNotWellFormed; u++) {
+      const struct someBinaryBytes *pBytes = &paNotWellFormedCBOR[u];
+      nReturn = QCBORDecode_Validate((UsefulBufC){pBytes->p, pBytes->n}, &Sequence, &uOffset);
+      if(!IsNotWellFormedError(nReturn) || uOffset > pBytes->n) {
+         return (int32_t)(1000 + u);
+      }
+   }
+
+   // The not-well-formed input in the decode failure list must fail
+   for(size_t u = 0; u < sizeof(Failures)/sizeof(struct FailInput); u++) {
+      if(IsNotWellFormedError(Failures[u].nError) &&
+         !IsNotWellFormedError(QCBORDecode_Validate(Failures[u].Input, &Sequence, NULL))) {
+         return (int32_t)(2000 + u);
+      }
+   }
+
+   // Errors and where they are found
+   for(size_t u = 0; u < sizeof(spValidateInputs)/sizeof(struct ValidateInput); u++) {
+      const struct ValidateInput *pV = &spValidateInputs[u];
+      uOffset = SIZE_MAX;
+      nReturn = QCBORDecode_Validate(pV->Input, NULL, &uOffset);
+      if(nReturn != pV->nError || uOffset != pV->uOffset) {
+         return (int32_t)(3000 + u * 100 + nReturn);
+      }
+   }
+
+   // Well-formed input used in other tests. Some are sequences.
+   const UsefulBufC pWellFormed[] = {
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spExpectedEncodedInts),
+#if QCBOR_MAX_ARRAY_NESTING >= 9
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spDeepArrays),
+#endif
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spDateTestInput),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRWithTags),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInput),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInputIndefLen),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteArray),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteLenString),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteLenStringLabel),
+   };
+   for(size_t u = 0; u < sizeof(pWellFormed)/sizeof(UsefulBufC); u++) {
+      nReturn = QCBORDecode_Validate(pWellFormed[u], &Sequence, &uOffset);
+      if(nReturn != QCBOR_SUCCESS || uOffset != 0) {
+         return (int32_t)(4000 + u * 100 + nReturn);
+      }
+   }
+
+   // Nesting one past the decoder's limit and one past a lower one
+   UsefulBuf_MAKE_STACK_UB(TooDeepStorage, QCBOR_MAX_ARRAY_NESTING + 2);
+   nReturn = QCBORDecode_Validate(MakeNestedArrays(QCBOR_MAX_ARRAY_NESTING + 1, TooDeepStorage), NULL, &uOffset);
+   if(nReturn != QCBOR_ERR_ARRAY_NESTING_TOO_DEEP || uOffset != QCBOR_MAX_ARRAY_NESTING) {
+      return -1;
+   }
+   const QCBORValidateLimits Shallow = {3, 0, 0, 0};
+   nReturn = QCBORDecode_Validate(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spDeepArrays), &Shallow, &uOffset);
+   if(nReturn != QCBOR_ERR_ARRAY_NESTING_TOO_DEEP || uOffset != 3) {
+      return -2;
+   }
+
+   // Lengths of strings, all the chunks of an indefinite-length string
+   // together, and arrays
+   const QCBORValidateLimits Short = {0, 0, 0, 8};
+   nReturn = QCBORDecode_Validate(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteLenString), &Short, &uOffset);
+   if(nReturn != QCBOR_ERR_STRING_TOO_LONG || uOffset != 8) {
+      return -3;
+   }
+   const QCBORValidateLimits FewItems = {0, 0, 4, 0};
+   nReturn = QCBORDecode_Validate(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spExpectedEncodedInts), &FewItems, &uOffset);
+   if(nReturn != QCBOR_ERR_ARRAY_TOO_LONG || uOffset != 0) {
+      return -4;
+   }
+   static const uint8_t spLongString[] = {0x5b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+   nReturn = QCBORDecode_Validate(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spLongString), NULL, &uOffset);
+   if(nReturn != QCBOR_ERR_STRING_TOO_LONG) {
+      return -5;
+   }
+
+   // Runs of one-byte items are skipped in bulk. Check runs ending at
+   // every position with and without the array ending there.
+   uint8_t pRun[40];
+   for(size_t uLen = 1; uLen < 30; uLen++) {
+      pRun[0] = (uint8_t)(0x80 + 24);
+      pRun[1] = (uint8_t)uLen;
+      for(size_t u = 0; u < uLen; u++) {
+         // Mix of positive, negative and simple
+         pRun[2 + u] = (uint8_t)(u % 3 == 0 ? u % 24 : u % 3 == 1 ? 0x20 + u % 24 : 0xf4);
+      }
+      const UsefulBufC Run = {pRun, 2 + uLen};
+      if(QCBORDecode_Validate(Run, NULL, NULL) != QCBOR_SUCCESS) {
+         return -100 - (int32_t)uLen;
+      }
+
+      // Not enough items, which is caught at the array head
+      pRun[1] = (uint8_t)(uLen + 1);
+      if(QCBORDecode_Validate(Run, NULL, &uOffset) != QCBOR_ERR_HIT_END || uOffset != 0) {
+         return -200 - (int32_t)uLen;
+      }
+
+      // An item at the end of the run that is not a one-byte item
+      pRun[2 + uLen] = 0x18;
+      pRun[3 + uLen] = 0x18;
+      if(QCBORDecode_Validate((UsefulBufC){pRun, 4 + uLen}, NULL, NULL) != QCBOR_SUCCESS) {
+         return -300 - (int32_t)uLen;
+      }
+      pRun[2 + uLen] = 0x1c;
+      if(QCBORDecode_Validate((UsefulBufC){pRun, 4 + uLen}, NULL, &uOffset) != QCBOR_ERR_UNSUPPORTED ||
+         uOffset != 2 + uLen) {
+         return -400 - (int32_t)uLen;
+      }
+   }
+
+   return 0;
+}
+
+
+/*
+ Decode Input with QCBORDecode_GetNext() once into pItems as the
+ reference for the skip tests. Returns the number of items or -1.
+ */
+static int SkipTestReference(UsefulBufC Input, QCBORDecodeMode nMode, QCBORItem *pItems, int nMaxItems)
+{
+   QCBORDecodeContext DCtx;
+   int                nNumItems;
+
+   QCBORDecode_Init(&DCtx, Input, nMode);
+   for(nNumItems = 0; nNumItems < nMaxItems; nNumItems++) {
+      const QCBORError uErr = QCBORDecode_GetNext(&DCtx, &pItems[nNumItems]);
+      if(uErr == QCBOR_ERR_NO_MORE_ITEMS) {
+         return nNumItems;
+      }
+      if(uErr != QCBOR_SUCCESS) {
+         return -1;
+      }
+   }
+   return -1;
+}
+
+
+/*
+ Decode up to and including item nItem, then skip with either
+ QCBORDecode_SkipCurrent() or QCBORDecode_ExitArrayOrMap(). The items
+ decoded after that must be the same as the reference items starting
+ at nResume.
+ */
+static int32_t SkipTestOne(UsefulBufC       Input,
+                           QCBORDecodeMode  nMode,
+                           const QCBORItem *pItems,
+                           int              nNumItems,
+                           int              nItem,
+                           int              bExit,
+                           int              nResume)
+{
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   QCBORError         uErr;
+
+   QCBORDecode_Init(&DCtx, Input, nMode);
+   for(int i = 0; i <= nItem; i++) {
+      if(QCBORDecode_GetNext(&DCtx, &Item) || !DecodedItemsMatch(&Item, &pItems[i])) {
+         return -1;
+      }
+   }
+
+   if(bExit) {
+      uErr = QCBORDecode_ExitArrayOrMap(&DCtx);
+   } else {
+      uErr = QCBORDecode_SkipCurrent(&DCtx, &Item);
+   }
+   if(uErr != QCBOR_SUCCESS) {
+      return -2;
+   }
+
+   for(int i = nResume; i < nNumItems; i++) {
+      if(QCBORDecode_GetNext(&DCtx, &Item) || !DecodedItemsMatch(&Item, &pItems[i])) {
+         return -3;
+      }
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NO_MORE_ITEMS) {
+      return -4;
+   }
+   if(QCBORDecode_Finish(&DCtx) != QCBOR_SUCCESS) {
+      return -5;
+   }
+
+   return 0;
+}
+
+
+/*
+ Skip every array and map in Input and exit every array and map from
+ every item in it, comparing the result with plain decoding.
+ */
+static int32_t SkipTestAll(UsefulBufC Input, QCBORDecodeMode nMode)
+{
+   QCBORItem aItems[40];
+   int32_t   nResult;
+
+   const int nNumItems = SkipTestReference(Input, nMode, aItems, 40);
+   if(nNumItems < 0) {
+      return -100;
+   }
+
+   for(int nItem = 0; nItem < nNumItems; nItem++) {
+      const QCBORItem *pItem = &aItems[nItem];
+
+      // SkipCurrent() resumes with the first item that isn't in the
+      // array or map. For other items it does nothing.
+      int nResume = nItem + 1;
+      while(nResume < nNumItems && aItems[nResume].uNestingLevel > pItem->uNestingLevel) {
+         nResume++;
+      }
+      if(pItem->uDataType != QCBOR_TYPE_ARRAY &&
+         pItem->uDataType != QCBOR_TYPE_MAP &&
+         pItem->uDataType != QCBOR_TYPE_MAP_AS_ARRAY) {
+         nResume = nItem + 1;
+      }
+      nResult = SkipTestOne(Input, nMode, aItems, nNumItems, nItem, 0, nResume);
+      if(nResult) {
+         return nItem * 10 + nResult;
+      }
+
+      // ExitArrayOrMap() resumes with the first item that is not in
+      // the array or map the decoder is in after this item
+      if(pItem->uNextNestLevel == 0) {
+         continue;
+      }
+      nResume = nItem + 1;
+      while(nResume < nNumItems && aItems[nResume].uNestingLevel >= pItem->uNextNestLevel) {
+         nResume++;
+      }
+      nResult = SkipTestOne(Input, nMode, aItems, nNumItems, nItem, 1, nResume);
+      if(nResult) {
+         return -(nItem * 10 - nResult);
+      }
+   }
+
+   return 0;
+}
+
+
+static const uint8_t spSkipNested[] = {
+   0x9f, // indefinite-length array
+      0x9f, // indefinite-length array
+         0xbf, 0x01, 0x9f, 0x02, 0x03, 0xff, 0xff, // {_ 1: [_ 2, 3]}
+         0x80, // []
+      0xff,
+      0xd8, 0x64, 0x82, 0x42, 0x00, 0x01, 0x61, 0x78, // 100([h'0001', "x"])
+      0xbf, 0x61, 0x61, 0xa0, 0x61, 0x62, 0x81, 0xf5, 0xff, // {_ "a": {}, "b": [true]}
+   0xff
+};
+
+static const uint8_t spSkipMalformed[] = {
+   0x82, 0x81, 0x1c, 0x00
+};
+
+
+int32_t SkipTest()
+{
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   int32_t            nResult;
+
+   struct {
+      UsefulBufC      Input;
+      QCBORDecodeMode nMode;
+   } aInputs[] = {
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInput), QCBOR_DECODE_MODE_NORMAL},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInputIndefLen), QCBOR_DECODE_MODE_NORMAL},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInput), QCBOR_DECODE_MODE_MAP_AS_ARRAY},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSkipNested), QCBOR_DECODE_MODE_NORMAL},
+   };
+
+   for(int i = 0; i < (int)(sizeof(aInputs)/sizeof(aInputs[0])); i++) {
+      nResult = SkipTestAll(aInputs[i].Input, aInputs[i].nMode);
+      if(nResult) {
+         return (i + 1) * 10000 + nResult;
+      }
+   }
+
+   // Not in an array or map
+   QCBORDecode_Init(&DCtx, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSkipNested), QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_ExitArrayOrMap(&DCtx) != QCBOR_ERR_TOO_MANY_CLOSES) {
+      return -1;
+   }
+
+   // A non-container item and an empty array need no skipping
+   QCBORDecode_Init(&DCtx, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSkipNested), QCBOR_DECODE_MODE_NORMAL);
+   for(int i = 0; i < 5; i++) {
+      QCBORDecode_GetNext(&DCtx, &Item);
+   }
+   if(QCBORDecode_SkipCurrent(&DCtx, &Item) != QCBOR_SUCCESS) {
+      return -2;
+   }
+   QCBORDecode_GetNext(&DCtx, &Item);
+   if(Item.uDataType != QCBOR_TYPE_INT64 || Item.val.int64 != 3) {
+      return -2;
+   }
+   QCBORDecode_GetNext(&DCtx, &Item);
+   if(Item.uDataType != QCBOR_TYPE_ARRAY || Item.val.uCount != 0) {
+      return -3;
+   }
+   if(QCBORDecode_SkipCurrent(&DCtx, &Item) != QCBOR_SUCCESS) {
+      return -4;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY || Item.uNestingLevel != 1) {
+      return -5;
+   }
+
+   // Errors in the skipped items are reported and nothing is consumed
+   QCBORDecode_Init(&DCtx, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSkipMalformed), QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_GetNext(&DCtx, &Item);
+   if(QCBORDecode_SkipCurrent(&DCtx, &Item) != QCBOR_ERR_UNSUPPORTED) {
+      return -6;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY || Item.uNestingLevel != 1) {
+      return -7;
+   }
+
+   // Too short
+   QCBORDecode_Init(&DCtx, (UsefulBufC){spSkipNested, sizeof(spSkipNested) - 1}, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_GetNext(&DCtx, &Item);
+   if(QCBORDecode_SkipCurrent(&DCtx, &Item) != QCBOR_ERR_HIT_END) {
+      return -8;
+   }
+
+   // Incrementally, the skip waits until all of the array or map has
+   // been received
+   const UsefulBufC Indef = UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInputIndefLen);
+   size_t uReceived = 1;
+   int    nNeedMore = 0;
+   QCBORDecode_InitIncremental(&DCtx, (UsefulBufC){Indef.ptr, uReceived}, QCBOR_DECODE_MODE_NORMAL);
+   while(QCBORDecode_GetNext(&DCtx, &Item) == QCBOR_ERR_NEED_MORE_DATA) {
+      QCBORDecode_AddInput(&DCtx, 1);
+      uReceived++;
+   }
+   if(Item.uDataType != QCBOR_TYPE_MAP) {
+      return -9;
+   }
+   for(;;) {
+      const QCBORError uErr = QCBORDecode_SkipCurrent(&DCtx, &Item);
+      if(uErr == QCBOR_SUCCESS) {
+         break;
+      }
+      if(uErr != QCBOR_ERR_NEED_MORE_DATA || uReceived >= Indef.len) {
+         return -10;
+      }
+      QCBORDecode_AddInput(&DCtx, 1);
+      uReceived++;
+      nNeedMore++;
+   }
+   if(uReceived != Indef.len || nNeedMore == 0) {
+      return -11;
+   }
+   QCBORDecode_EndOfInput(&DCtx);
+   if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NO_MORE_ITEMS) {
+      return -12;
+   }
+   if(QCBORDecode_Finish(&DCtx) != QCBOR_SUCCESS) {
+      return -13;
+   }
+
+   return 0;
+}
+
+
+/* Collects what is given to a digest callback */
+typedef struct {
+   UsefulOutBuf OutBuf;
+   int          nCalls;
+} DigestCollector;
+
+static void DigestToOutBuf(void *pDigestCtx, UsefulBufC Bytes)
+{
+   DigestCollector *pCollector = (DigestCollector *)pDigestCtx;
+
+   UsefulOutBuf_AppendUsefulBuf(&(pCollector->OutBuf), Bytes);
+   pCollector->nCalls++;
+}
+
+
+int32_t DigestDecodeTest()
+{
+   QCBORDecodeContext   DCtx;
+   QCBORDecodeExtension Ext;
+   QCBORItem            Item;
+   QCBORItem            aItems[8];
+   size_t               uNumDecoded;
+   DigestCollector      Collector;
+   QCBORError           uErr;
+
+   UsefulBuf_MAKE_STACK_UB(CollectorStorage, 300);
+
+   const UsefulBufC Ints = UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spExpectedEncodedInts);
+   const UsefulBufC CSR  = UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCSRInput);
+
+   // ---- Given as it is decoded, the rest at the finish ----
+   UsefulOutBuf_Init(&(Collector.OutBuf), CollectorStorage);
+   Collector.nCalls = 0;
+   QCBORDecode_Init(&DCtx, Ints, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DCtx, &Ext);
+   QCBORDecode_SetDigest(&DCtx, DigestToOutBuf, &Collector);
+   while((uErr = QCBORDecode_GetNext(&DCtx, &Item)) == QCBOR_SUCCESS);
+   if(uErr != QCBOR_ERR_NO_MORE_ITEMS) {
+      return -1;
+   }
+   if(Collector.nCalls < 2) {
+      return -2;
+   }
+   if(QCBORDecode_Finish(&DCtx) ||
+      UsefulBuf_Compare(UsefulOutBuf_OutUBuf(&(Collector.OutBuf)), Ints)) {
+      return -3;
+   }
+
+   // ---- In batches ----
+   UsefulOutBuf_Init(&(Collector.OutBuf), CollectorStorage);
+   QCBORDecode_Init(&DCtx, Ints, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DCtx, &Ext);
+   QCBORDecode_SetDigest(&DCtx, DigestToOutBuf, &Collector);
+   do {
+      uErr = QCBORDecode_GetNextBatch(&DCtx, aItems, 8, &uNumDecoded);
+   } while(uErr == QCBOR_SUCCESS);
+   if(uErr != QCBOR_ERR_NO_MORE_ITEMS ||
+      QCBORDecode_Finish(&DCtx) ||
+      UsefulBuf_Compare(UsefulOutBuf_OutUBuf(&(Collector.OutBuf)), Ints)) {
+      return -4;
+   }
+
+   // ---- What is skipped is given too ----
+   UsefulOutBuf_Init(&(Collector.OutBuf), CollectorStorage);
+   QCBORDecode_Init(&DCtx, CSR, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DCtx, &Ext);
+   QCBORDecode_SetDigest(&DCtx, DigestToOutBuf, &Collector);
+   if(QCBORDecode_GetNext(&DCtx, &Item) || QCBORDecode_SkipCurrent(&DCtx, &Item)) {
+      return -5;
+   }
+   if(QCBORDecode_Finish(&DCtx) ||
+      UsefulBuf_Compare(UsefulOutBuf_OutUBuf(&(Collector.OutBuf)), CSR)) {
+      return -6;
+   }
+
+   // ---- Only what is consumed after it is set ----
+   UsefulOutBuf_Init(&(Collector.OutBuf), CollectorStorage);
+   QCBORDecode_Init(&DCtx, Ints, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DCtx, &Ext);
+   if(QCBORDecode_GetNext(&DCtx, &Item)) {
+      return -7;
+   }
+   QCBORDecode_SetDigest(&DCtx, DigestToOutBuf, &Collector);
+   while(QCBORDecode_GetNext(&DCtx, &Item) == QCBOR_SUCCESS);
+   if(QCBORDecode_Finish(&DCtx) ||
+      UsefulBuf_Compare(UsefulOutBuf_OutUBuf(&(Collector.OutBuf)), UsefulBuf_Tail(Ints, 2))) {
+      return -8;
+   }
+
+   // ---- Incrementally, nothing is given twice ----
+   UsefulOutBuf_Init(&(Collector.OutBuf), CollectorStorage);
+   QCBORDecode_InitIncremental(&DCtx, (UsefulBufC){Ints.ptr, 1}, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DCtx, &Ext);
+   QCBORDecode_SetDigest(&DCtx, DigestToOutBuf, &Collector);
+   size_t uReceived = 1;
+   for(;;) {
+      uErr = QCBORDecode_GetNext(&DCtx, &Item);
+      if(uErr == QCBOR_ERR_NEED_MORE_DATA && uReceived < Ints.len) {
+         QCBORDecode_AddInput(&DCtx, 1);
+         uReceived++;
+      } else if(uErr == QCBOR_ERR_NEED_MORE_DATA) {
+         QCBORDecode_EndOfInput(&DCtx);
+      } else if(uErr != QCBOR_SUCCESS) {
+         break;
+      }
+   }
+   if(uErr != QCBOR_ERR_NO_MORE_ITEMS ||
+      QCBORDecode_Finish(&DCtx) ||
+      UsefulBuf_Compare(UsefulOutBuf_OutUBuf(&(Collector.OutBuf)), Ints)) {
+      return -9;
+   }
+
+   // ---- Not without the extension ----
+   QCBORDecode_Init(&DCtx, Ints, QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_SetDigest(&DCtx, DigestToOutBuf, &Collector) != QCBOR_ERR_NO_EXTENSION) {
+      return -10;
+   }
+
+   return 0;
+}
+
+
+static const uint8_t spTypedArrays[] = {
+   0x88,
+   // Little-endian uint16_t
+   0xd8, 0x45, 0x44, 0x01, 0x02, 0x03, 0x04,
+   // Big-endian double
+   0xd8, 0x52, 0x48, 0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   // Clamped uint8_t
+   0xd8, 0x44, 0x41, 0x07,
+   // Reserved tag for little-endian int8_t
+   0xd8, 0x4c, 0x41, 0x07,
+   // Big-endian 128-bit float, 1.0
+   0xd8, 0x53, 0x50, 0x3f, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   // Another tag outside of the typed array tag
+   0xd8, 0x64, 0xd8, 0x41, 0x42, 0x01, 0x02,
+   // Not a byte string
+   0xd8, 0x41, 0x62, 0x61, 0x62,
+   // Empty
+   0xd8, 0x46, 0x40
+};
+
+static const uint8_t spTypedArrayBadLength[] = {0xd8, 0x41, 0x43, 0x01, 0x02, 0x03};
+
+
+int32_t TypedArrayDecodeTest()
+{
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   size_t             uNum;
+   uint16_t           au16[4];
+   double             ad[2];
+   uint8_t            au128[16];
+   uint64_t           auTags[4];
+   QCBORTagListOut    Tags = {0, 4, auTags};
+
+   QCBORDecode_Init(&DCtx, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spTypedArrays), QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY) {
+      return -1;
+   }
+
+   // ---- Decoded in place and copied in the CPU's byte order ----
+   if(QCBORDecode_GetNextWithTags(&DCtx, &Item, &Tags) ||
+      Item.uDataType != QCBOR_TYPE_TYPED_ARRAY ||
+      Item.val.typedArray.uElementType != QCBOR_TYPED_ARRAY_UINT16 ||
+      !Item.val.typedArray.bLittleEndian ||
+      Item.val.typedArray.Elements.len != 4 ||
+      Item.val.typedArray.Elements.ptr != &spTypedArrays[4] ||
+      Tags.uNumUsed != 1 || auTags[0] != 69) {
+      return -2;
+   }
+   if(QCBORDecode_CopyTypedArray(&Item, UsefulBuf_FROM_BYTE_ARRAY(au16), &uNum) ||
+      uNum != 2 || au16[0] != 0x0201 || au16[1] != 0x0403) {
+      return -3;
+   }
+   if(QCBORDecode_CopyTypedArray(&Item, (UsefulBuf){au16, 3}, &uNum) != QCBOR_ERR_BUFFER_TOO_SMALL) {
+      return -4;
+   }
+
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_TYPED_ARRAY ||
+      Item.val.typedArray.uElementType != QCBOR_TYPED_ARRAY_FLOAT64 ||
+      Item.val.typedArray.bLittleEndian) {
+      return -5;
+   }
+   if(QCBORDecode_CopyTypedArray(&Item, UsefulBuf_FROM_BYTE_ARRAY(ad), &uNum) ||
+      uNum != 1 || ad[0] != 1.0) {
+      return -6;
+   }
+
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_TYPED_ARRAY ||
+      Item.val.typedArray.uElementType != QCBOR_TYPED_ARRAY_UINT8 ||
+      Item.val.typedArray.bLittleEndian) {
+      return -7;
+   }
+
+   // ---- Left as byte strings ----
+   if(QCBORDecode_GetNext(&DCtx, &Item) || Item.uDataType != QCBOR_TYPE_BYTE_STRING) {
+      return -8;
+   }
+   if(QCBORDecode_CopyTypedArray(&Item, UsefulBuf_FROM_BYTE_ARRAY(au16), &uNum) != QCBOR_ERR_BAD_TYPED_ARRAY) {
+      return -9;
+   }
+
+   // ---- 128-bit floats are swapped if needed, but not converted ----
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_TYPED_ARRAY ||
+      Item.val.typedArray.uElementType != QCBOR_TYPED_ARRAY_FLOAT128) {
+      return -10;
+   }
+   if(QCBORDecode_CopyTypedArray(&Item, UsefulBuf_FROM_BYTE_ARRAY(au128), &uNum) || uNum != 1) {
+      return -11;
+   }
+   const uint16_t uOne = 1;
+   const uint8_t  uLittleEndian = *(const uint8_t *)&uOne;
+   if(au128[uLittleEndian ? 15 : 0] != 0x3f || au128[uLittleEndian ? 14 : 1] != 0xff) {
+      return -12;
+   }
+
+   // ---- Only the tag on the byte string matters ----
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_TYPED_ARRAY ||
+      Item.val.typedArray.uElementType != QCBOR_TYPED_ARRAY_UINT16 ||
+      Item.val.typedArray.bLittleEndian) {
+      return -13;
+   }
+   if(QCBORDecode_CopyTypedArray(&Item, UsefulBuf_FROM_BYTE_ARRAY(au16), &uNum) ||
+      uNum != 1 || au16[0] != 0x0102) {
+      return -14;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) || Item.uDataType != QCBOR_TYPE_TEXT_STRING) {
+      return -15;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_TYPED_ARRAY ||
+      Item.val.typedArray.Elements.len != 0) {
+      return -16;
+   }
+   if(QCBORDecode_Finish(&DCtx)) {
+      return -17;
+   }
+
+   // ---- Length isn't a multiple of the element size ----
+   QCBORDecode_Init(&DCtx, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spTypedArrayBadLength), QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_BAD_TYPED_ARRAY) {
+      return -18;
+   }
+
+   return 0;
+}
+
+
+static const uint8_t spNumberArrays[] = {
+   0xbf,
+   // 1: [1, -1, 24, INT64_MAX, INT64_MIN]
+   0x01, 0x85, 0x01, 0x20, 0x18, 0x18,
+   0x1b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+   0x3b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+   // 2: [_ 1.0 as half, 1.5 as single, 0.1]
+   0x02, 0x9f, 0xf9, 0x3c, 0x00, 0xfa, 0x3f, 0xc0, 0x00, 0x00,
+   0xfb, 0x3f, 0xb9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a, 0xff,
+   // 3: []
+   0x03, 0x80,
+   // 4: [1, 2, 3]
+   0x04, 0x83, 0x01, 0x02, 0x03,
+   0xff
+};
+
+static const uint8_t spNumberArrayErrors[] = {
+   0x86,
+   // [1, "a"]
+   0x82, 0x01, 0x61, 0x61,
+   // [1, 2, 3]
+   0x83, 0x01, 0x02, 0x03,
+   // [UINT64_MAX]
+   0x81, 0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+   // [1.0]
+   0x81, 0xf9, 0x3c, 0x00,
+   // [1(1)]
+   0x81, 0xc1, 0x01,
+   0x05
+};
+
+
+int32_t NumberArrayDecodeTest()
+{
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   QCBORItem          Array;
+   int64_t            an[5];
+   double             ad[3];
+   size_t             uNum;
+
+#ifndef QCBOR_DISABLE_PREFERRED_FLOAT
+   // ---- The same with QCBORDecode_GetNext() ----
+   QCBORDecode_Init(&DCtx, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spNumberArrays), QCBOR_DECODE_MODE_NORMAL);
+   for(uNum = 0; QCBORDecode_GetNext(&DCtx, &Item) == QCBOR_SUCCESS; uNum++);
+   // The map, its four arrays and their 11 elements
+   if(uNum != 16 || QCBORDecode_Finish(&DCtx)) {
+      return -100;
+   }
+#endif /* QCBOR_DISABLE_PREFERRED_FLOAT */
+
+   // ---- Definite and indefinite length, in a map ----
+   QCBORDecode_Init(&DCtx, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spNumberArrays), QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      QCBORDecode_GetNext(&DCtx, &Array) ||
+      Array.uDataType != QCBOR_TYPE_ARRAY ||
+      Array.label.int64 != 1) {
+      return -1;
+   }
+   if(QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) ||
+      uNum != 5 ||
+      an[0] != 1 || an[1] != -1 || an[2] != 24 ||
+      an[3] != INT64_MAX || an[4] != INT64_MIN) {
+      return -2;
+   }
+#ifndef QCBOR_DISABLE_PREFERRED_FLOAT
+   // The next array starts with a half-precision float
+   if(QCBORDecode_GetNext(&DCtx, &Array) ||
+      Array.uDataType != QCBOR_TYPE_ARRAY ||
+      Array.label.int64 != 2 ||
+      Array.uNestingLevel != 1) {
+      return -3;
+   }
+   if(QCBORDecode_GetDoubleArray(&DCtx, &Array, ad, 3, &uNum) ||
+      uNum != 3 || ad[0] != 1.0 || ad[1] != 1.5 || ad[2] != 0.1) {
+      return -4;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Array) ||
+      Array.label.int64 != 3 ||
+      QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) ||
+      uNum != 0) {
+      return -5;
+   }
+   // After some of the elements have been decoded
+   if(QCBORDecode_GetNext(&DCtx, &Array) ||
+      Array.label.int64 != 4 ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.val.int64 != 1 ||
+      QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) ||
+      uNum != 2 || an[0] != 2 || an[1] != 3) {
+      return -6;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_NO_MORE_ITEMS ||
+      QCBORDecode_Finish(&DCtx)) {
+      return -7;
+   }
+#endif /* QCBOR_DISABLE_PREFERRED_FLOAT */
+
+   // ---- Nothing is consumed on error ----
+   QCBORDecode_Init(&DCtx, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spNumberArrayErrors), QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      QCBORDecode_GetNext(&DCtx, &Array)) {
+      return -10;
+   }
+   uNum = 99;
+   if(QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) != QCBOR_ERR_UNEXPECTED_TYPE ||
+      uNum != 0) {
+      return -11;
+   }
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_INT64 ||
+      QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_TEXT_STRING) {
+      return -12;
+   }
+
+   if(QCBORDecode_GetNext(&DCtx, &Array) ||
+      QCBORDecode_GetInt64Array(&DCtx, &Array, an, 2, &uNum) != QCBOR_ERR_BUFFER_TOO_SMALL ||
+      QCBORDecode_GetInt64Array(&DCtx, &Array, an, 3, &uNum) ||
+      uNum != 3 || an[2] != 3) {
+      return -13;
+   }
+
+   if(QCBORDecode_GetNext(&DCtx, &Array) ||
+      QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) != QCBOR_ERR_INT_OVERFLOW ||
+      QCBORDecode_SkipCurrent(&DCtx, &Array)) {
+      return -14;
+   }
+
+   if(QCBORDecode_GetNext(&DCtx, &Array)) {
+      return -15;
+   }
+#ifndef QCBOR_DISABLE_PREFERRED_FLOAT
+   if(QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) != QCBOR_ERR_UNEXPECTED_TYPE ||
+      QCBORDecode_GetDoubleArray(&DCtx, &Array, ad, 3, &uNum) ||
+      uNum != 1 || ad[0] != 1.0) {
+      return -15;
+   }
+#else
+   // The element is a half-precision float
+   if(QCBORDecode_GetDoubleArray(&DCtx, &Array, ad, 3, &uNum) != QCBOR_ERR_HALF_PRECISION_UNSUPPORTED ||
+      QCBORDecode_SkipCurrent(&DCtx, &Array)) {
+      return -15;
+   }
+#endif /* QCBOR_DISABLE_PREFERRED_FLOAT */
+   QCBORItem Stale = Array;
+
+   // Tags on elements are not allowed
+   if(QCBORDecode_GetNext(&DCtx, &Array) ||
+      QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) != QCBOR_ERR_UNEXPECTED_TYPE ||
+      QCBORDecode_SkipCurrent(&DCtx, &Array)) {
+      return -16;
+   }
+
+   // Not an array, or not the array being decoded
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      QCBORDecode_GetInt64Array(&DCtx, &Item, an, 5, &uNum) != QCBOR_ERR_UNEXPECTED_TYPE ||
+      QCBORDecode_GetDoubleArray(&DCtx, &Stale, ad, 3, &uNum) != QCBOR_ERR_UNEXPECTED_TYPE) {
+      return -17;
+   }
+   if(QCBORDecode_Finish(&DCtx)) {
+      return -18;
+   }
+
+   // ---- Incremental ----
+   QCBORDecode_InitIncremental(&DCtx,
+                               (UsefulBufC){spNumberArrays, 10},
+                               QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      QCBORDecode_GetNext(&DCtx, &Array)) {
+      return -20;
+   }
+   const size_t uPosition = UsefulInputBuf_Tell(&(DCtx.InBuf));
+   if(QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) != QCBOR_ERR_NEED_MORE_DATA ||
+      UsefulInputBuf_Tell(&(DCtx.InBuf)) != uPosition) {
+      return -21;
+   }
+   QCBORDecode_AddInput(&DCtx, sizeof(spNumberArrays) - 10);
+   if(QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) ||
+      uNum != 5 || an[4] != INT64_MIN) {
+      return -22;
+   }
+#ifndef QCBOR_DISABLE_PREFERRED_FLOAT
+   if(QCBORDecode_GetNext(&DCtx, &Array) ||
+      Array.label.int64 != 2) {
+      return -23;
+   }
+#endif /* QCBOR_DISABLE_PREFERRED_FLOAT */
+
+   // ---- Integers with indefinite length aren't well-formed ----
+   static const uint8_t spIndefPosInt[] = {0x82, 0x01, 0x1f};
+   static const uint8_t spIndefNegInt[] = {0x82, 0x01, 0x3f};
+   const UsefulBufC aBadInts[] = {
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefPosInt),
+      UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefNegInt)
+   };
+   for(int i = 0; i < 2; i++) {
+      QCBORDecode_Init(&DCtx, aBadInts[i], QCBOR_DECODE_MODE_NORMAL);
+      if(QCBORDecode_GetNext(&DCtx, &Array) ||
+         QCBORDecode_GetInt64Array(&DCtx, &Array, an, 5, &uNum) != QCBOR_ERR_BAD_INT) {
+         return -30 - i;
+      }
+      // The same error as QCBORDecode_GetNext() for the element
+      if(QCBORDecode_GetNext(&DCtx, &Item) ||
+         Item.val.int64 != 1 ||
+         QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_BAD_INT) {
+         return -32 - i;
+      }
+   }
+
+   return 0;
+}
+
+
+static const uint8_t spSequence[] = {
+   0x01,
+   0x82, 0x01, 0x02,
+   0x9f, 0x61, 0x61, 0xff,
+   0xa1, 0x01, 0x5f, 0x41, 0x00, 0xff,
+   0xc1, 0x1a, 0x00, 0x00, 0x00, 0x01,
+   0x40
+};
+
+static const size_t spSequenceLengths[] = {1, 3, 4, 6, 6, 1};
+
+
+int32_t SplitSequenceTest()
+{
+   UsefulBufC       aItems[8];
+   QCBORSequenceJob aJobs[8];
+   size_t           uNum;
+   size_t           uConsumed;
+   size_t           uOffset;
+   size_t           u;
+
+   // ---- All at once ----
+   if(QCBORDecode_SplitSequence(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSequence),
+                                aItems, 8, &uNum, &uConsumed) ||
+      uNum != 6 || uConsumed != sizeof(spSequence)) {
+      return -1;
+   }
+   uOffset = 0;
+   for(u = 0; u < uNum; u++) {
+      if(aItems[u].ptr != spSequence + uOffset || aItems[u].len != spSequenceLengths[u]) {
+         return -2;
+      }
+      uOffset += aItems[u].len;
+   }
+
+   // Each item decodes on its own
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   QCBORDecode_Init(&DCtx, aItems[4], QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_DATE_EPOCH ||
+      QCBORDecode_Finish(&DCtx)) {
+      return -3;
+   }
+
+   // ---- A few at a time ----
+   if(QCBORDecode_SplitSequence(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSequence),
+                                aItems, 2, &uNum, &uConsumed) ||
+      uNum != 2 || uConsumed != 4) {
+      return -4;
+   }
+   if(QCBORDecode_SplitSequence(UsefulBuf_Tail(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSequence), uConsumed),
+                                aItems, 8, &uNum, NULL) ||
+      uNum != 4 || aItems[0].ptr != spSequence + 4) {
+      return -5;
+   }
+
+   // ---- The last item isn't all there ----
+   if(QCBORDecode_SplitSequence((UsefulBufC){spSequence, 19},
+                                aItems, 8, &uNum, &uConsumed) != QCBOR_ERR_HIT_END ||
+      uNum != 4 || uConsumed != 14) {
+      return -6;
+   }
+
+   // ---- Not well-formed and empty ----
+   if(QCBORDecode_SplitSequence((UsefulBufC){spSequence + 7, 4},
+                                aItems, 8, &uNum, &uConsumed) != QCBOR_ERR_BAD_BREAK ||
+      uNum != 0 || uConsumed != 0) {
+      return -7;
+   }
+   if(QCBORDecode_SplitSequence(NULLUsefulBufC, aItems, 8, &uNum, &uConsumed) ||
+      uNum != 0 || uConsumed != 0) {
+      return -8;
+   }
+
+   // ---- Partitioned by bytes ----
+   QCBORDecode_SplitSequence(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spSequence),
+                             aItems, 8, &uNum, NULL);
+   QCBORDecode_PartitionSequence(aItems, uNum, aJobs, 3);
+   if(aJobs[0].pItems != &aItems[0] || aJobs[0].uNumItems != 3 ||
+      aJobs[1].pItems != &aItems[3] || aJobs[1].uNumItems != 1 || aJobs[1].uFirstIndex != 3 ||
+      aJobs[2].pItems != &aItems[4] || aJobs[2].uNumItems != 2 || aJobs[2].uFirstIndex != 4) {
+      return -9;
+   }
+
+   // More jobs than items; every item is in exactly one job in order
+   QCBORDecode_PartitionSequence(aItems, uNum, aJobs, 8);
+   size_t uNext = 0;
+   for(u = 0; u < 8; u++) {
+      if(aJobs[u].uFirstIndex != uNext || aJobs[u].pItems != &aItems[uNext]) {
+         return -10;
+      }
+      uNext += aJobs[u].uNumItems;
+   }
+   if(uNext != uNum) {
+      return -11;
+   }
+
+   return 0;
+}
+
+
+/*
+ {_ 1: [_ 10, 11], 2: 3}
+ */
+static const uint8_t spQueryIndefinite[] = {
+   0xbf, 0x01, 0x9f, 0x0a, 0x0b, 0xff, 0x02, 0x03, 0xff
+};
+
+/*
+ {1: 2, 3: ... not all there, but everything queried is before it
+ */
+static const uint8_t spQueryTruncated[] = {
+   0xa2, 0x01, 0x02, 0x03
+};
+
+/*
+ 18({1: 2, 1: 3}), a duplicate label and a tag before the map
+ */
+static const uint8_t spQueryTaggedDup[] = {
+   0xd2, 0xa2, 0x01, 0x02, 0x01, 0x03
+};
+
+
+int32_t QueryTest()
+{
+   QCBORQuery Query;
+   QCBORItem  aItems[QCBOR_MAX_QUERY_PATHS];
+   UsefulBufC aEncoded[QCBOR_MAX_QUERY_PATHS];
+
+   // ---- The input ----
+   UsefulBuf_MAKE_STACK_UB(Big, 100);
+   memset(Big.ptr, 0x55, Big.len);
+   UsefulBuf_MAKE_STACK_UB(WrappedStorage, 20);
+   UsefulBuf_MAKE_STACK_UB(Storage, 300);
+
+   QCBOREncodeContext EC;
+   UsefulBufC         Wrapped;
+   QCBOREncode_Init(&EC, WrappedStorage);
+   QCBOREncode_OpenMap(&EC);
+   QCBOREncode_AddInt64ToMapN(&EC, 3, -7);
+   QCBOREncode_AddBytesToMapN(&EC, 4, ((UsefulBufC){"\x01\x02", 2}));
+   QCBOREncode_CloseMap(&EC);
+   if(QCBOREncode_Finish(&EC, &Wrapped)) {
+      return -1;
+   }
+
+   UsefulBufC Encoded;
+   QCBOREncode_Init(&EC, Storage);
+   QCBOREncode_OpenMap(&EC);
+   QCBOREncode_AddInt64ToMapN(&EC, 1, 42);
+   QCBOREncode_OpenArrayInMap(&EC, "arr");
+   QCBOREncode_AddInt64(&EC, 7);
+   QCBOREncode_OpenMap(&EC);
+   QCBOREncode_AddSZStringToMap(&EC, "claim", "yes");
+   QCBOREncode_AddInt64ToMapN(&EC, 9, 1);
+   QCBOREncode_CloseMap(&EC);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddInt64(&EC, 1);
+   QCBOREncode_AddInt64(&EC, 2);
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_AddBytesToMapN(&EC, 2, Wrapped);
+   QCBOREncode_AddBytesToMapN(&EC, 5, UsefulBuf_Const(Big));
+   QCBOREncode_AddDateEpochToMapN(&EC, 6, 1600000000);
+   QCBOREncode_AddSZStringToMapN(&EC, -8, "neg label");
+   QCBOREncode_CloseMap(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -2;
+   }
+
+   // ---- Several paths, some sharing a prefix ----
+   static const QCBORPathStep aSteps[] = {
+      QCBORPath_INT(1), QCBORPath_END,
+      QCBORPath_TEXT_LITERAL("arr"), QCBORPath_INDEX(1), QCBORPath_TEXT_LITERAL("claim"), QCBORPath_END,
+      QCBORPath_TEXT_LITERAL("arr"), QCBORPath_INDEX(1), QCBORPath_INT(9), QCBORPath_END,
+      QCBORPath_INT(2), QCBORPath_BSTR_WRAPPED, QCBORPath_INT(3), QCBORPath_END,
+      QCBORPath_INT(6), QCBORPath_END,
+      QCBORPath_INT(-8), QCBORPath_END,
+      QCBORPath_INT(99), QCBORPath_END,
+      QCBORPath_TEXT_LITERAL("arr"), QCBORPath_INDEX(2), QCBORPath_END,
+      QCBORPath_END,
+      QCBORPath_TEXT_LITERAL("arr"), QCBORPath_INDEX(5), QCBORPath_END,
+   };
+   if(QCBORDecode_CompileQuery(&Query, aSteps, sizeof(aSteps)/sizeof(aSteps[0]))) {
+      return -3;
+   }
+   if(QCBORDecode_RunQuery(&Query, Encoded, aItems, aEncoded)) {
+      return -4;
+   }
+   if(aItems[0].uDataType != QCBOR_TYPE_INT64 || aItems[0].val.int64 != 42 ||
+      aItems[0].uLabelType != QCBOR_TYPE_NONE || aItems[0].uNestingLevel != 0) {
+      return -5;
+   }
+   if(aItems[1].uDataType != QCBOR_TYPE_TEXT_STRING ||
+      UsefulBuf_Compare(aItems[1].val.string, UsefulBuf_FROM_SZ_LITERAL("yes"))) {
+      return -6;
+   }
+   if(aItems[2].uDataType != QCBOR_TYPE_INT64 || aItems[2].val.int64 != 1) {
+      return -7;
+   }
+   if(aItems[3].uDataType != QCBOR_TYPE_INT64 || aItems[3].val.int64 != -7) {
+      return -8;
+   }
+   if(aItems[4].uDataType != QCBOR_TYPE_DATE_EPOCH ||
+      aItems[4].val.epochDate.nSeconds != 1600000000) {
+      return -9;
+   }
+   if(aItems[5].uDataType != QCBOR_TYPE_TEXT_STRING ||
+      UsefulBuf_Compare(aItems[5].val.string, UsefulBuf_FROM_SZ_LITERAL("neg label"))) {
+      return -10;
+   }
+   if(aItems[6].uDataType != QCBOR_TYPE_NONE || !UsefulBuf_IsNULLC(aEncoded[6])) {
+      return -11;
+   }
+   // A container gives its head and the extent of the whole of it
+   if(aItems[7].uDataType != QCBOR_TYPE_ARRAY || aItems[7].val.uCount != 2 ||
+      UsefulBuf_Compare(aEncoded[7], ((UsefulBufC){"\x82\x01\x02", 3}))) {
+      return -12;
+   }
+   if(aItems[8].uDataType != QCBOR_TYPE_MAP || aItems[8].val.uCount != 6 ||
+      aEncoded[8].ptr != Encoded.ptr || aEncoded[8].len != Encoded.len) {
+      return -13;
+   }
+   if(aItems[9].uDataType != QCBOR_TYPE_NONE) {
+      return -14;
+   }
+   // The extent of a wrapped item is inside the wrapping byte string
+   if(UsefulBuf_Compare(aEncoded[3], ((UsefulBufC){"\x26", 1}))) {
+      return -15;
+   }
+
+   // The encoded extents aren't needed
+   if(QCBORDecode_RunQuery(&Query, Encoded, aItems, NULL) ||
+      aItems[3].uDataType != QCBOR_TYPE_INT64 || aItems[3].val.int64 != -7) {
+      return -16;
+   }
+
+   // ---- Indefinite-length map and array ----
+   static const QCBORPathStep aIndefSteps[] = {
+      QCBORPath_INT(1), QCBORPath_INDEX(1), QCBORPath_END,
+      QCBORPath_INT(2), QCBORPath_END,
+      QCBORPath_INT(3), QCBORPath_END,
+   };
+   QCBORDecode_CompileQuery(&Query, aIndefSteps, sizeof(aIndefSteps)/sizeof(aIndefSteps[0]));
+   if(QCBORDecode_RunQuery(&Query, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spQueryIndefinite), aItems, NULL) ||
+      aItems[0].uDataType != QCBOR_TYPE_INT64 || aItems[0].val.int64 != 11 ||
+      aItems[1].uDataType != QCBOR_TYPE_INT64 || aItems[1].val.int64 != 3 ||
+      aItems[2].uDataType != QCBOR_TYPE_NONE) {
+      return -17;
+   }
+
+   // ---- Stops when everything is found ----
+   static const QCBORPathStep aOneSteps[] = {
+      QCBORPath_INT(1), QCBORPath_END,
+   };
+   QCBORDecode_CompileQuery(&Query, aOneSteps, 2);
+   if(QCBORDecode_RunQuery(&Query, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spQueryTruncated), aItems, NULL) ||
+      aItems[0].uDataType != QCBOR_TYPE_INT64 || aItems[0].val.int64 != 2) {
+      return -18;
+   }
+
+   // ---- Tags before a map are skipped and the first duplicate wins ----
+   if(QCBORDecode_RunQuery(&Query, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spQueryTaggedDup), aItems, NULL) ||
+      aItems[0].uDataType != QCBOR_TYPE_INT64 || aItems[0].val.int64 != 2) {
+      return -19;
+   }
+
+   // ---- Not well-formed and empty input ----
+   QCBORDecode_CompileQuery(&Query, aIndefSteps, sizeof(aIndefSteps)/sizeof(aIndefSteps[0]));
+   if(QCBORDecode_RunQuery(&Query, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spQueryTruncated), aItems, NULL) != QCBOR_ERR_HIT_END) {
+      return -20;
+   }
+   if(QCBORDecode_RunQuery(&Query, (UsefulBufC){spQueryIndefinite, 8}, aItems, NULL) != QCBOR_ERR_HIT_END ||
+      aItems[0].uDataType != QCBOR_TYPE_INT64) {
+      return -21;
+   }
+   if(QCBORDecode_RunQuery(&Query, NULLUsefulBufC, aItems, NULL) != QCBOR_ERR_HIT_END ||
+      aItems[0].uDataType != QCBOR_TYPE_NONE) {
+      return -22;
+   }
+   // Not a map so none of the paths are found
+   if(QCBORDecode_RunQuery(&Query, (UsefulBufC){spQueryTruncated + 1, 1}, aItems, NULL) ||
+      aItems[0].uDataType != QCBOR_TYPE_NONE) {
+      return -23;
+   }
+
+   // ---- Bad queries ----
+   static const QCBORPathStep aNoEnd[] = {
+      QCBORPath_INT(1)
+   };
+   if(QCBORDecode_CompileQuery(&Query, aNoEnd, 1) != QCBOR_ERR_BAD_QUERY) {
+      return -24;
+   }
+   if(QCBORDecode_CompileQuery(&Query, aNoEnd, 0) != QCBOR_ERR_BAD_QUERY) {
+      return -25;
+   }
+   static const QCBORPathStep aBadIndex[] = {
+      QCBORPath_INDEX(-1), QCBORPath_END
+   };
+   if(QCBORDecode_CompileQuery(&Query, aBadIndex, 2) != QCBOR_ERR_BAD_QUERY) {
+      return -26;
+   }
+   static const QCBORPathStep aBadKind[] = {
+      {99, 0, {NULL, 0}}, QCBORPath_END
+   };
+   if(QCBORDecode_CompileQuery(&Query, aBadKind, 2) != QCBOR_ERR_BAD_QUERY) {
+      return -27;
+   }
+
+   QCBORPathStep aMany[QCBOR_MAX_QUERY_STEPS + 1];
+   for(size_t u = 0; u < sizeof(aMany)/sizeof(aMany[0]); u++) {
+      aMany[u] = (QCBORPathStep)QCBORPath_END;
+   }
+   if(QCBORDecode_CompileQuery(&Query, aMany, QCBOR_MAX_QUERY_STEPS + 1) != QCBOR_ERR_BAD_QUERY) {
+      return -28;
+   }
+   // Too many paths
+   if(QCBORDecode_CompileQuery(&Query, aMany, QCBOR_MAX_QUERY_PATHS + 1) != QCBOR_ERR_BAD_QUERY) {
+      return -29;
+   }
+   if(QCBORDecode_CompileQuery(&Query, aMany, QCBOR_MAX_QUERY_PATHS)) {
+      return -30;
+   }
+#if QCBOR_MAX_ARRAY_NESTING < QCBOR_MAX_QUERY_STEPS
+   // One path nested deeper than QCBOR_MAX_ARRAY_NESTING, which only
+   // fits in the steps when the nesting limit is lower than the default
+   for(size_t u = 0; u <= QCBOR_MAX_ARRAY_NESTING; u++) {
+      aMany[u] = (QCBORPathStep)QCBORPath_INDEX(0);
+   }
+   if(QCBORDecode_CompileQuery(&Query, aMany, QCBOR_MAX_ARRAY_NESTING + 2) != QCBOR_ERR_BAD_QUERY) {
+      return -31;
+   }
+   if(QCBORDecode_CompileQuery(&Query, &aMany[1], QCBOR_MAX_ARRAY_NESTING + 1)) {
+      return -32;
+   }
+#endif /* QCBOR_MAX_ARRAY_NESTING < QCBOR_MAX_QUERY_STEPS */
+
+   return 0;
+}
+
+
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+/*
+ [{1: 1(1)}, 50000(_ "ab" "cd")]
+ */
+static const uint8_t spStatsInput[] = {
+   0x82,
+      0xa1, 0x01, 0xc1, 0x01,
+      0xd9, 0xc3, 0x50, 0x7f, 0x62, 0x61, 0x62, 0x62, 0x63, 0x64, 0xff
+};
+
+
+int32_t StatsTest()
+{
+   // ---- Decode ----
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   QCBORDecodeStats   DStats;
+
+   UsefulBuf_MAKE_STACK_UB(Pool, 100);
+
+   QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spStatsInput), QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetMemPool(&DC, Pool, false);
+
+   QCBORDecode_GetStats(&DC, &DStats);
+   if(DStats.uItemsDecoded != 0 || DStats.uBytesConsumed != 0 || DStats.uMaxNesting != 0) {
+      return -1;
+   }
+
+   while(QCBORDecode_GetNext(&DC, &Item) == QCBOR_SUCCESS);
+   if(QCBORDecode_Finish(&DC)) {
+      return -2;
+   }
+
+   QCBORDecode_GetStats(&DC, &DStats);
+   if(DStats.uItemsDecoded != 4 ||
+      DStats.uBytesConsumed != sizeof(spStatsInput) ||
+      DStats.uMaxNesting != 2 ||
+      DStats.uTagsMapped != 1 ||
+      DStats.uTagsNotMapped != 1) {
+      return -3;
+   }
+   // One allocation for the whole string and then the destructor
+   if(DStats.uAllocatorCalls != 2 || DStats.uAllocatorBytes != 4) {
+      return -4;
+   }
+
+   // ---- Encode ----
+   QCBOREncodeContext EC;
+   QCBOREncodeStats   EStats;
+   UsefulBufC         Encoded;
+   UsefulBuf_MAKE_STACK_UB(Storage, 50);
+
+   QCBOREncode_Init(&EC, Storage);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_OpenMap(&EC);
+   QCBOREncode_AddInt64ToMapN(&EC, 1, 2);
+   QCBOREncode_CloseMap(&EC);
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -5;
+   }
+
+   // The map head moves its two bytes, then the array head moves
+   // those and the map head
+   QCBOREncode_GetStats(&EC, &EStats);
+   if(EStats.uNumInserts != 2 || EStats.uBytesMoved != 5) {
+      return -6;
+   }
+
+   // Nothing moves in no-slide mode
+   QCBOREncode_Init(&EC, Storage);
+   QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddInt64(&EC, 1);
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_GetStats(&EC, &EStats);
+   if(EStats.uNumInserts != 0 || EStats.uBytesMoved != 0) {
+      return -7;
+   }
+
+   return 0;
+}
+#endif /* QCBOR_CONFIG_ENABLE_STATS */
+
+
+/*
+ One input for each of the features that can be left out of the
+ decoder and the error expected for it with that feature left out.
+ */
+static const uint8_t spIndefString[]  = {0x7f, 0x61, 0x61, 0xff};        // (_ "a")
+static const uint8_t spIndefArray[]   = {0x9f, 0x01, 0xff};              // [_ 1]
+static const uint8_t spTagged[]       = {0xc1, 0x01};                    // 1(1)
+static const uint8_t spTextLabel[]    = {0xa1, 0x61, 0x61, 0x01};        // {"a": 1}
+static const uint8_t spIntLabel[]     = {0xa1, 0x01, 0x02};              // {1: 2}
+static const uint8_t spTagInArray[]   = {0x82, 0xc1, 0x01, 0x02};        // [1(1), 2]
+
+struct DisabledFeatureTest {
+   UsefulBufC Input;
+   QCBORError uExpected;
+};
+
+int32_t DisabledFeaturesTest()
+{
+   const struct DisabledFeatureTest aTests[] = {
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefString),
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+         QCBOR_SUCCESS},
+#else
+         QCBOR_ERR_INDEF_LEN_STRINGS_DISABLED},
+#endif
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefArray),
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
+         QCBOR_SUCCESS},
+#else
+         QCBOR_ERR_INDEF_LEN_ARRAYS_DISABLED},
+#endif
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spTagged),
+#ifndef QCBOR_DISABLE_TAGS
+         QCBOR_SUCCESS},
+#else
+         QCBOR_ERR_TAGS_DISABLED},
+#endif
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spTextLabel),
+#ifndef QCBOR_DISABLE_NON_INTEGER_LABELS
+         QCBOR_SUCCESS},
+#else
+         QCBOR_ERR_MAP_LABEL_TYPE},
+#endif
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIntLabel), QCBOR_SUCCESS},
+   };
+
+   UsefulBuf_MAKE_STACK_UB(Pool, 100);
+
+   for(size_t i = 0; i < sizeof(aTests)/sizeof(aTests[0]); i++) {
+      QCBORDecodeContext DCtx;
+      QCBORItem          Item;
+      QCBORError         uErr;
+
+      QCBORDecode_Init(&DCtx, aTests[i].Input, QCBOR_DECODE_MODE_NORMAL);
+      QCBORDecode_SetMemPool(&DCtx, Pool, false);
+
+      // The error comes from whichever item uses the feature
+      do {
+         uErr = QCBORDecode_GetNext(&DCtx, &Item);
+      } while(uErr == QCBOR_SUCCESS);
+      if(uErr == QCBOR_ERR_NO_MORE_ITEMS) {
+         uErr = QCBORDecode_Finish(&DCtx);
+      }
+      if(uErr != aTests[i].uExpected) {
+         return (int32_t)(i * 10 + 1);
+      }
+
+      // QCBORDecode_Validate() rejects the same input, except for
+      // labels which it doesn't check the type of
+      uErr = QCBORDecode_Validate(aTests[i].Input, NULL, NULL);
+      if(aTests[i].uExpected == QCBOR_ERR_MAP_LABEL_TYPE) {
+         if(uErr != QCBOR_SUCCESS) {
+            return (int32_t)(i * 10 + 2);
+         }
+      } else if(uErr != aTests[i].uExpected) {
+         return (int32_t)(i * 10 + 3);
+      }
+   }
+
+   // Decoding can go on after a tag, the same as after a bad date
+   QCBORDecodeContext DCtx;
+   QCBORItem          Item;
+   QCBORDecode_Init(&DCtx,
+                    UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spTagInArray),
+                    QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DCtx, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY) {
+      return 100;
+   }
+#ifndef QCBOR_DISABLE_TAGS
+   if(QCBORDecode_GetNext(&DCtx, &Item) || Item.uDataType != QCBOR_TYPE_DATE_EPOCH) {
+      return 101;
+   }
+#else
+   if(QCBORDecode_GetNext(&DCtx, &Item) != QCBOR_ERR_TAGS_DISABLED) {
+      return 101;
+   }
+#endif
+   if(QCBORDecode_GetNext(&DCtx, &Item) ||
+      Item.uDataType != QCBOR_TYPE_INT64 ||
+      Item.val.int64 != 2) {
+      return 102;
+   }
+   if(QCBORDecode_Finish(&DCtx)) {
+      return 103;
+   }
+
+   return 0;
+}
+
+
+#ifndef QCBOR_DISABLE_TAGS
+/*
+ The example from the stringref specification. "1" and "4" are too
+ short to be numbered. "rrr" comes when three bytes is too short, so
+ it is not referenced later, but "ssss" is.
+ */
+static const uint8_t spStringRefExample[] = {
+   0xd9, 0x01, 0x00, 0x98, 0x20, 0x61, 0x31, 0x63, 0x32, 0x32, 0x32,
+   0x63, 0x33, 0x33, 0x33, 0x61, 0x34, 0x63, 0x35, 0x35, 0x35, 0x63,
+   0x36, 0x36, 0x36, 0x63, 0x37, 0x37, 0x37, 0x63, 0x38, 0x38, 0x38,
+   0x63, 0x39, 0x39, 0x39, 0x63, 0x61, 0x61, 0x61, 0x63, 0x62, 0x62,
+   0x62, 0x63, 0x63, 0x63, 0x63, 0x63, 0x64, 0x64, 0x64, 0x63, 0x65,
+   0x65, 0x65, 0x63, 0x66, 0x66, 0x66, 0x63, 0x67, 0x67, 0x67, 0x63,
+   0x68, 0x68, 0x68, 0x63, 0x69, 0x69, 0x69, 0x63, 0x6a, 0x6a, 0x6a,
+   0x63, 0x6b, 0x6b, 0x6b, 0x63, 0x6c, 0x6c, 0x6c, 0x63, 0x6d, 0x6d,
+   0x6d, 0x63, 0x6e, 0x6e, 0x6e, 0x63, 0x6f, 0x6f, 0x6f, 0x63, 0x70,
+   0x70, 0x70, 0x63, 0x71, 0x71, 0x71, 0x63, 0x72, 0x72, 0x72, 0xd8,
+   0x19, 0x01, 0x64, 0x73, 0x73, 0x73, 0x73, 0xd8, 0x19, 0x17, 0x63,
+   0x72, 0x72, 0x72, 0xd8, 0x19, 0x18, 0x18};
+
+static const char *szStringRefExample[] = {
+   "1", "222", "333", "4", "555", "666", "777", "888", "999", "aaa",
+   "bbb", "ccc", "ddd", "eee", "fff", "ggg", "hhh", "iii", "jjj", "kkk",
+   "lll", "mmm", "nnn", "ooo", "ppp", "qqq", "rrr", "333", "ssss", "qqq",
+   "rrr", "ssss"};
+
+#define NUM_STRING_REF_EXAMPLE (sizeof(szStringRefExample)/sizeof(szStringRefExample[0]))
+
+
+/* Each is decoded with GetNext() until an error */
+struct StringRefFailTest {
+   UsefulBufC Input;
+   size_t     uTableSize;
+   QCBORError uExpected;
+};
+
+static const uint8_t spRefOutside[]   = {0xd8, 0x19, 0x00};
+static const uint8_t spRefUnseen[]    = {0xd9, 0x01, 0x00, 0x82, 0x63, 0x61, 0x62, 0x63, 0xd8, 0x19, 0x01};
+static const uint8_t spRefOnText[]    = {0xd9, 0x01, 0x00, 0x82, 0x63, 0x61, 0x62, 0x63, 0xd8, 0x19, 0x61, 0x61};
+static const uint8_t spRefNegative[]  = {0xd9, 0x01, 0x00, 0x82, 0x63, 0x61, 0x62, 0x63, 0xd8, 0x19, 0x20};
+static const uint8_t spRefTagged[]    = {0xd9, 0x01, 0x00, 0x82, 0x63, 0x61, 0x62, 0x63, 0xd8, 0x19, 0xc1, 0x00};
+static const uint8_t spRefNested[]    = {0xd9, 0x01, 0x00, 0x81, 0xd9, 0x01, 0x00, 0x80};
+static const uint8_t spRefAfterEnd[]  = {0x82, 0xd9, 0x01, 0x00, 0x81, 0x63, 0x61, 0x62, 0x63, 0xd8, 0x19, 0x00};
+static const uint8_t spRefTwoStrings[] = {0xd9, 0x01, 0x00, 0x83, 0x63, 0x61, 0x62, 0x63, 0x63, 0x64, 0x65, 0x66, 0xd8, 0x19, 0x01};
+
+/* 256([["abc", "def"], 25(1)]) */
+static const uint8_t spRefAfterSkip[] = {0xd9, 0x01, 0x00, 0x82, 0x82, 0x63, 0x61, 0x62, 0x63, 0x63, 0x64, 0x65, 0x66, 0xd8, 0x19, 0x01};
+
+
+int32_t StringRefTest()
+{
+   QCBOREncodeContext   EC;
+   QCBOREncodeExtension EncodeExt;
+   QCBORDecodeContext   DC;
+   QCBORDecodeExtension DecodeExt;
+   QCBORItem            Item;
+   QCBORStringRef       aTable[40];
+   UsefulBufC           Encoded;
+   size_t               i;
+   UsefulBuf_MAKE_STACK_UB(Buffer, 300);
+
+   // ---- The example from the specification ----
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_SetExtension(&EC, &EncodeExt);
+   QCBOREncode_OpenStringRefNamespace(&EC, aTable, 40);
+   QCBOREncode_OpenArray(&EC);
+   for(i = 0; i < NUM_STRING_REF_EXAMPLE; i++) {
+      QCBOREncode_AddSZString(&EC, szStringRefExample[i]);
+   }
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_CloseStringRefNamespace(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded) ||
+      UsefulBuf_Compare(Encoded, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spStringRefExample))) {
+      return 1;
+   }
+
+   QCBORDecode_Init(&DC, Encoded, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &DecodeExt);
+   QCBORDecode_SetStringRefs(&DC, aTable, 40);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_ARRAY ||
+      Item.uTagBits != 0) {
+      return 2;
+   }
+   for(i = 0; i < NUM_STRING_REF_EXAMPLE; i++) {
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         Item.uDataType != QCBOR_TYPE_TEXT_STRING ||
+         UsefulBuf_Compare(Item.val.string, UsefulBuf_FromSZ(szStringRefExample[i])) ||
+         Item.uTagBits != 0) {
+         return (int32_t)(10 + i);
+      }
+   }
+   if(QCBORDecode_Finish(&DC)) {
+      return 3;
+   }
+
+   // A table that holds only one string, "222". The other strings are
+   // still numbered so the reference to "ssss" is right.
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_SetExtension(&EC, &EncodeExt);
+   QCBOREncode_OpenStringRefNamespace(&EC, aTable, 2);
+   QCBOREncode_OpenArray(&EC);
+   for(i = 0; i < NUM_STRING_REF_EXAMPLE; i++) {
+      QCBOREncode_AddSZString(&EC, szStringRefExample[i]);
+   }
+   QCBOREncode_AddSZString(&EC, "222");
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_CloseStringRefNamespace(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return 4;
+   }
+   QCBORDecode_Init(&DC, Encoded, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &DecodeExt);
+   QCBORDecode_SetStringRefs(&DC, aTable, 40);
+   QCBORDecode_GetNext(&DC, &Item);
+   for(i = 0; i <= NUM_STRING_REF_EXAMPLE; i++) {
+      const char *szExpected = i < NUM_STRING_REF_EXAMPLE ? szStringRefExample[i] : "222";
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         UsefulBuf_Compare(Item.val.string, UsefulBuf_FromSZ(szExpected))) {
+         return 5;
+      }
+   }
+   // The three references in the example are strings instead and
+   // the only reference is the 3 bytes at the end
+   if(Encoded.len != sizeof(spStringRefExample) - 10 + 4 + 4 + 5 + 3 ||
+      QCBORDecode_Finish(&DC)) {
+      return 6;
+   }
+
+#ifndef QCBOR_DISABLE_NON_INTEGER_LABELS
+   // ---- Map labels and values, and byte strings ----
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_SetExtension(&EC, &EncodeExt);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_OpenStringRefNamespace(&EC, aTable, 40);
+   QCBOREncode_OpenArray(&EC);
+   for(i = 0; i < 3; i++) {
+      QCBOREncode_OpenMap(&EC);
+      QCBOREncode_AddInt64ToMap(&EC, "temperature", (int64_t)i);
+      QCBOREncode_AddSZStringToMap(&EC, "unit", "celsius");
+      QCBOREncode_AddBytesToMap(&EC, "id", UsefulBuf_FROM_SZ_LITERAL("abc"));
+      QCBOREncode_CloseMap(&EC);
+   }
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_CloseStringRefNamespace(&EC);
+   // Out of the namespace so this is not a reference
+   QCBOREncode_AddSZString(&EC, "celsius");
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return 20;
+   }
+   // The first map is 34 bytes. The others are 17 because all the
+   // strings but "id" are references.
+   if(Encoded.len != 1 + 3 + 1 + 34 + 17 + 17 + 8) {
+      return 21;
+   }
+
+   QCBORDecode_Init(&DC, Encoded, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &DecodeExt);
+   QCBORDecode_SetStringRefs(&DC, aTable, 40);
+   QCBORDecode_GetNext(&DC, &Item);
+   QCBORDecode_GetNext(&DC, &Item);
+   for(i = 0; i < 3; i++) {
+      if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_MAP) {
+         return 22;
+      }
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         Item.uLabelType != QCBOR_TYPE_TEXT_STRING ||
+         UsefulBuf_Compare(Item.label.string, UsefulBuf_FROM_SZ_LITERAL("temperature")) ||
+         Item.uDataType != QCBOR_TYPE_INT64 ||
+         Item.val.int64 != (int64_t)i) {
+         return 23;
+      }
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         UsefulBuf_Compare(Item.label.string, UsefulBuf_FROM_SZ_LITERAL("unit")) ||
+         Item.uDataType != QCBOR_TYPE_TEXT_STRING ||
+         UsefulBuf_Compare(Item.val.string, UsefulBuf_FROM_SZ_LITERAL("celsius"))) {
+         return 24;
+      }
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         Item.uDataType != QCBOR_TYPE_BYTE_STRING ||
+         UsefulBuf_Compare(Item.val.string, UsefulBuf_FROM_SZ_LITERAL("abc"))) {
+         return 25;
+      }
+   }
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      UsefulBuf_Compare(Item.val.string, UsefulBuf_FROM_SZ_LITERAL("celsius")) ||
+      QCBORDecode_Finish(&DC)) {
+      return 26;
+   }
+#endif /* QCBOR_DISABLE_NON_INTEGER_LABELS */
+
+   // ---- Encoding errors ----
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_SetExtension(&EC, &EncodeExt);
+   QCBOREncode_OpenStringRefNamespace(&EC, aTable, 40);
+   QCBOREncode_OpenStringRefNamespace(&EC, aTable, 40);
+   if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_STRING_REF_NESTED) {
+      return 30;
+   }
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_SetExtension(&EC, &EncodeExt);
+   QCBOREncode_OpenStringRefNamespace(&EC, aTable, 40);
+   QCBOREncode_BstrWrap(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_UNSUPPORTED) {
+      return 31;
+   }
+
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_OpenStringRefNamespace(&EC, aTable, 40);
+   if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_NO_EXTENSION) {
+      return 32;
+   }
+
+   // ---- Decoding errors ----
+   const struct StringRefFailTest aFailTests[] = {
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefOutside),    40, QCBOR_ERR_BAD_STRING_REF},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefUnseen),     40, QCBOR_ERR_BAD_STRING_REF},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefOnText),     40, QCBOR_ERR_BAD_STRING_REF},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefNegative),   40, QCBOR_ERR_BAD_STRING_REF},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefTagged),     40, QCBOR_ERR_BAD_STRING_REF},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefNested),     40, QCBOR_ERR_STRING_REF_NESTED},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefAfterEnd),   40, QCBOR_ERR_BAD_STRING_REF},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefTwoStrings), 1,  QCBOR_ERR_STRING_REF_TABLE_FULL},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefTwoStrings), 2,  QCBOR_ERR_NO_MORE_ITEMS},
+   };
+   for(i = 0; i < sizeof(aFailTests)/sizeof(aFailTests[0]); i++) {
+      QCBORError uErr;
+      QCBORDecode_Init(&DC, aFailTests[i].Input, QCBOR_DECODE_MODE_NORMAL);
+      QCBORDecode_SetExtension(&DC, &DecodeExt);
+      QCBORDecode_SetStringRefs(&DC, aTable, aFailTests[i].uTableSize);
+      do {
+         uErr = QCBORDecode_GetNext(&DC, &Item);
+      } while(uErr == QCBOR_SUCCESS);
+      if(uErr != aFailTests[i].uExpected) {
+         return (int32_t)(40 + i);
+      }
+   }
+
+   // Without a table the tags are passed on
+   QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefOutside), QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_INT64 ||
+      Item.val.int64 != 0 ||
+      QCBORDecode_Finish(&DC)) {
+      return 60;
+   }
+
+   // Skipped strings are still numbered
+   QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefAfterSkip), QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &DecodeExt);
+   QCBORDecode_SetStringRefs(&DC, aTable, 40);
+   QCBORDecode_GetNext(&DC, &Item);
+   QCBORDecode_GetNext(&DC, &Item);
+   if(QCBORDecode_SkipCurrent(&DC, &Item)) {
+      return 61;
+   }
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_TEXT_STRING ||
+      UsefulBuf_Compare(Item.val.string, UsefulBuf_FROM_SZ_LITERAL("def")) ||
+      QCBORDecode_Finish(&DC)) {
+      return 62;
+   }
+
+   // Batch decoding can't take its fast path for the strings
+   QCBORItem aItems[6];
+   size_t    uNum;
+   QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefTwoStrings), QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &DecodeExt);
+   QCBORDecode_SetStringRefs(&DC, aTable, 40);
+   QCBORDecode_GetNext(&DC, &Item);
+   if(QCBORDecode_GetNextBatch(&DC, aItems, 6, &uNum) ||
+      uNum != 3 ||
+      aItems[2].uDataType != QCBOR_TYPE_TEXT_STRING ||
+      UsefulBuf_Compare(aItems[2].val.string, UsefulBuf_FROM_SZ_LITERAL("def"))) {
+      return 63;
+   }
+   if(QCBORDecode_GetNextBatch(&DC, aItems, 6, &uNum) != QCBOR_ERR_NO_MORE_ITEMS) {
+      return 64;
+   }
+
+   return 0;
+}
+#endif /* QCBOR_DISABLE_TAGS */
+
+
+/* [1, [2, 3], "abc", {1: 2}] */
+static const uint8_t spCursorInput[] = {0x84, 0x01, 0x82, 0x02, 0x03, 0x63, 0x61, 0x62, 0x63, 0xa1, 0x01, 0x02};
+
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+/* (_ "abcd", "efgh") */
+static const uint8_t spCursorIndefString[] = {0x7f, 0x64, 0x61, 0x62, 0x63, 0x64, 0x64, 0x65, 0x66, 0x67, 0x68, 0xff};
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS */
+
+int32_t CursorTest()
+{
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   QCBORDecodeCursor  Start, InOuter, InInner, LastInInner;
+   int                i;
+
+   QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCursorInput), QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SaveCursor(&DC, &Start);
+   if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY) {
+      return 1;
+   }
+   QCBORDecode_SaveCursor(&DC, &InOuter);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_ARRAY) {
+      return 2;
+   }
+   QCBORDecode_SaveCursor(&DC, &InInner);
+   if(QCBORDecode_GetNext(&DC, &Item) || Item.val.int64 != 2) {
+      return 3;
+   }
+   QCBORDecode_SaveCursor(&DC, &LastInInner);
+
+   // Back within the inner array
+   if(QCBORDecode_RestoreCursor(&DC, &InInner)) {
+      return 4;
+   }
+   if(QCBORDecode_GetNext(&DC, &Item) || Item.val.int64 != 2 ||
+      QCBORDecode_GetNext(&DC, &Item) || Item.val.int64 != 3 ||
+      Item.uNestingLevel != 2 || Item.uNextNestLevel != 1) {
+      return 5;
+   }
+
+   // The inner array has been left
+   if(QCBORDecode_RestoreCursor(&DC, &LastInInner) != QCBOR_ERR_BAD_CURSOR) {
+      return 6;
+   }
+   if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_TEXT_STRING) {
+      return 7;
+   }
+
+   // Back out of the map into the outer array twice
+   for(i = 0; i < 2; i++) {
+      if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_MAP) {
+         return 8;
+      }
+      if(QCBORDecode_RestoreCursor(&DC, &InOuter)) {
+         return 9;
+      }
+      if(QCBORDecode_GetNext(&DC, &Item) || Item.val.int64 != 1 || Item.uNestingLevel != 1) {
+         return 10;
+      }
+      if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY ||
+         QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_TEXT_STRING) {
+         return 11;
+      }
+   }
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) || Item.val.int64 != 2 || Item.uNextNestLevel != 0 ||
+      QCBORDecode_GetNext(&DC, &Item) != QCBOR_ERR_NO_MORE_ITEMS ||
+      QCBORDecode_Finish(&DC)) {
+      return 12;
+   }
+
+   // A cursor at the top level can always be restored
+   if(QCBORDecode_RestoreCursor(&DC, &Start) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_ARRAY ||
+      Item.val.uCount != 4) {
+      return 13;
+   }
+
+   // ---- Reset keeps the configuration ----
+   QCBORDecode_InitIncremental(&DC,
+                               UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCursorInput),
+                               QCBOR_DECODE_MODE_MAP_AS_ARRAY);
+   QCBORDecode_Reset(&DC, (UsefulBufC){&spCursorInput[9], 3});
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP_AS_ARRAY ||
+      Item.val.uCount != 2 ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) != QCBOR_ERR_NO_MORE_ITEMS ||
+      QCBORDecode_Finish(&DC)) {
+      return 20;
+   }
+
+   // Reset in the middle of a map
+   QCBORDecode_Reset(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCursorInput));
+   if(QCBORDecode_GetNext(&DC, &Item) || Item.uDataType != QCBOR_TYPE_ARRAY) {
+      return 21;
+   }
+   QCBORDecode_Reset(&DC, (UsefulBufC){&spCursorInput[1], 1});
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uNestingLevel != 0 ||
+      QCBORDecode_Finish(&DC)) {
+      return 22;
+   }
+
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+   // The MemPool only has room for one string. It is emptied by a
+   // reset, but not by restoring a cursor.
+   UsefulBuf_MAKE_STACK_UB(Pool, QCBOR_DECODE_MIN_MEM_POOL_SIZE + 10);
+   QCBORDecode_Init(&DC,
+                    UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCursorIndefString),
+                    QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_SetMemPool(&DC, Pool, false)) {
+      return 30;
+   }
+   for(i = 0; i < 3; i++) {
+      QCBORDecode_SaveCursor(&DC, &Start);
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         UsefulBuf_Compare(Item.val.string, UsefulBuf_FROM_SZ_LITERAL("abcdefgh")) ||
+         QCBORDecode_Finish(&DC)) {
+         return 31;
+      }
+      if(QCBORDecode_RestoreCursor(&DC, &Start) ||
+         QCBORDecode_GetNext(&DC, &Item) != QCBOR_ERR_STRING_ALLOCATE) {
+         return 32;
+      }
+      QCBORDecode_Reset(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spCursorIndefString));
+   }
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS */
+
+#ifndef QCBOR_DISABLE_TAGS
+   // The string reference numbering goes back too
+   QCBORStringRef       aTable[2];
+   QCBORDecodeExtension Ext;
+   QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spRefTwoStrings), QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &Ext);
+   QCBORDecode_SetStringRefs(&DC, aTable, 2);
+   QCBORDecode_SaveCursor(&DC, &Start);
+   for(i = 0; i < 2; i++) {
+      if(QCBORDecode_RestoreCursor(&DC, &Start) ||
+         QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_GetNext(&DC, &Item) ||
+         UsefulBuf_Compare(Item.val.string, UsefulBuf_FROM_SZ_LITERAL("def"))) {
+         return 41;
+      }
+   }
+   if(QCBORDecode_Finish(&DC)) {
+      return 42;
+   }
+#endif /* QCBOR_DISABLE_TAGS */
+
+   return 0;
+}
+
+
+/*
+ Decode all of Input with map checks using uScratchSize entries of
+ scratch memory
+ */
+static QCBORError
+MapCheckDecodeAll(UsefulBufC Input, size_t uScratchSize, bool *pbDeterministic)
+{
+   QCBORDecodeContext   DC;
+   QCBORDecodeExtension Ext;
+   QCBORItem            Item;
+   QCBORLabelCheck      aScratch[300];
+   QCBORError           uErr;
+
+   QCBORDecode_Init(&DC, Input, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &Ext);
+   QCBORDecode_SetMapChecks(&DC, aScratch, uScratchSize);
+   do {
+      uErr = QCBORDecode_GetNext(&DC, &Item);
+   } while(uErr == QCBOR_SUCCESS);
+   if(uErr == QCBOR_ERR_NO_MORE_ITEMS) {
+      uErr = QCBORDecode_Finish(&DC);
+   }
+   *pbDeterministic = QCBORDecode_IsDeterministic(&DC);
+
+   return uErr;
+}
+
+
+typedef struct {
+   UsefulBufC Input;
+   QCBORError uExpectedErr;
+   bool       bDeterministic; // Only checked for QCBOR_SUCCESS
+} MapCheckCase;
+
+static const MapCheckCase sMapCheckCases[] = {
+   // {1: 2, 2: {1: 1, 2: 2}, 3: 4, -1: 0}; the same labels in a
+   // nested map aren't duplicates
+   {{"\xa4\x01\x02\x02\xa2\x01\x01\x02\x02\x03\x04\x20\x00", 13}, QCBOR_SUCCESS, true},
+   // {2: 0, 1: 0}
+   {{"\xa2\x02\x00\x01\x00", 5}, QCBOR_SUCCESS, false},
+   // {10: 0, 100: 0, -1: 0} is in bytewise order
+   {{"\xa3\x0a\x00\x18\x64\x00\x20\x00", 8}, QCBOR_SUCCESS, true},
+   // {1: 0, 1: 1}
+   {{"\xa2\x01\x00\x01\x01", 5}, QCBOR_ERR_DUPLICATE_LABEL, false},
+   // {1: 0, 1: 1} with the second 1 not in preferred serialization
+   {{"\xa2\x01\x00\x18\x01\x01", 6}, QCBOR_ERR_DUPLICATE_LABEL, false},
+   // {1: 1} with the value not in preferred serialization
+   {{"\xa1\x01\x18\x01", 4}, QCBOR_SUCCESS, false},
+   // {1: 1} with the map head not in preferred serialization
+   {{"\xb8\x01\x01\x01", 4}, QCBOR_SUCCESS, false},
+   // A sequence of two {1: 0}
+   {{"\xa1\x01\x00\xa1\x01\x00", 6}, QCBOR_SUCCESS, true},
+   // [{1: 0}, {1: 0}]
+   {{"\x82\xa1\x01\x00\xa1\x01\x00", 7}, QCBOR_SUCCESS, true},
+   // {1: [{1: 0}], 2: 0}
+   {{"\xa2\x01\x81\xa1\x01\x00\x02\x00", 8}, QCBOR_SUCCESS, true},
+   // {1: {2: 0}, 1: 0}
+   {{"\xa2\x01\xa1\x02\x00\x01\x00", 7}, QCBOR_ERR_DUPLICATE_LABEL, false},
+   // {18446744073709551615: 0, -1: 0} have the same uint64 value
+   {{"\xa2\x1b\xff\xff\xff\xff\xff\xff\xff\xff\x00\x20\x00", 13}, QCBOR_SUCCESS, true},
+#ifndef QCBOR_DISABLE_NON_INTEGER_LABELS
+   // {"a": 0, "b": 0, "a": 1}
+   {{"\xa3\x61\x61\x00\x61\x62\x00\x61\x61\x01", 10}, QCBOR_ERR_DUPLICATE_LABEL, false},
+   // {h'61': 0, "a": 0}
+   {{"\xa2\x41\x61\x00\x61\x61\x00", 7}, QCBOR_SUCCESS, true},
+   // {"b": 0, "a": 0}
+   {{"\xa2\x61\x62\x00\x61\x61\x00", 7}, QCBOR_SUCCESS, false},
+   // {"b": 0, "ab": 0} is in bytewise order, but not length first
+   {{"\xa2\x61\x62\x00\x62\x61\x62\x00", 8}, QCBOR_SUCCESS, true},
+   // {1: 0, "": 0, "": 1}
+   {{"\xa3\x01\x00\x60\x00\x60\x01", 7}, QCBOR_ERR_DUPLICATE_LABEL, false},
+#endif /* QCBOR_DISABLE_NON_INTEGER_LABELS */
+#ifndef QCBOR_DISABLE_PREFERRED_FLOAT
+   // [1.5] as half, single and double
+   {{"\x81\xf9\x3e\x00", 4}, QCBOR_SUCCESS, true},
+   {{"\x81\xfa\x3f\xc0\x00\x00", 6}, QCBOR_SUCCESS, false},
+   {{"\x81\xfb\x3f\xf8\x00\x00\x00\x00\x00\x00", 10}, QCBOR_SUCCESS, false},
+   // [0.1] as single and double
+   {{"\x81\xfa\x3d\xcc\xcc\xcd", 6}, QCBOR_SUCCESS, true},
+   {{"\x81\xfb\x3f\xb9\x99\x99\x99\x99\x99\x9a", 10}, QCBOR_SUCCESS, true},
+#else
+   // Floats can't be checked
+   {{"\x81\xfa\x3d\xcc\xcc\xcd", 6}, QCBOR_SUCCESS, false},
+#endif /* QCBOR_DISABLE_PREFERRED_FLOAT */
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
+   // {_ 1: 0, 1: 1}
+   {{"\xbf\x01\x00\x01\x01\xff", 6}, QCBOR_ERR_DUPLICATE_LABEL, false},
+   // {_ 1: 0}
+   {{"\xbf\x01\x00\xff", 4}, QCBOR_SUCCESS, false},
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS */
+};
+
+
+/*
+ Public function, see header file
+ */
+int32_t MapCheckTest()
+{
+   QCBORDecodeContext   DC;
+   QCBORDecodeExtension Ext;
+   QCBORItem            Item;
+   QCBORLabelCheck      aScratch[10];
+   bool                 bDeterministic;
+   int64_t              nInts[2];
+   size_t               uNum;
+   int                  i;
+
+   for(size_t u = 0; u < sizeof(sMapCheckCases)/sizeof(MapCheckCase); u++) {
+      const MapCheckCase *pCase = &sMapCheckCases[u];
+      if(MapCheckDecodeAll(pCase->Input, 300, &bDeterministic) != pCase->uExpectedErr ||
+         (pCase->uExpectedErr == QCBOR_SUCCESS && bDeterministic != pCase->bDeterministic)) {
+         return (int32_t)(u + 1);
+      }
+   }
+
+   // {1: {1: 0}} needs three entries for each map
+   const UsefulBufC Nested = {"\xa1\x01\xa1\x01\x00", 5};
+   if(MapCheckDecodeAll(Nested, 5, &bDeterministic) != QCBOR_ERR_LABEL_CHECK_FULL ||
+      MapCheckDecodeAll(Nested, 6, &bDeterministic) != QCBOR_SUCCESS ||
+      !bDeterministic) {
+      return 100;
+   }
+
+   // A map of 100 labels and then one of them again. The hash table
+   // takes 256 entries plus one for the map.
+   UsefulBuf_MAKE_STACK_UB(Buffer, 400);
+   QCBOREncodeContext EC;
+   UsefulBufC         Encoded;
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_OpenMap(&EC);
+   for(i = 0; i < 100; i++) {
+      QCBOREncode_AddInt64ToMapN(&EC, i, i);
+   }
+   QCBOREncode_CloseMap(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded) ||
+      MapCheckDecodeAll(Encoded, 256, &bDeterministic) != QCBOR_ERR_LABEL_CHECK_FULL ||
+      MapCheckDecodeAll(Encoded, 257, &bDeterministic) != QCBOR_SUCCESS ||
+      !bDeterministic) {
+      return 101;
+   }
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_OpenMap(&EC);
+   for(i = 0; i < 100; i++) {
+      QCBOREncode_AddInt64ToMapN(&EC, i, i);
+   }
+   QCBOREncode_AddInt64ToMapN(&EC, 77, 0);
+   QCBOREncode_CloseMap(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded) ||
+      MapCheckDecodeAll(Encoded, 300, &bDeterministic) != QCBOR_ERR_DUPLICATE_LABEL) {
+      return 102;
+   }
+
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
+   // An indefinite-length map grows from 16 to 128 entries. The last
+   // doubling needs 1 + 64 + 128.
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_OpenMapIndefiniteLength(&EC);
+   for(i = 0; i < 60; i++) {
+      QCBOREncode_AddInt64ToMapN(&EC, i, i);
+   }
+   QCBOREncode_CloseMapIndefiniteLength(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded) ||
+      MapCheckDecodeAll(Encoded, 192, &bDeterministic) != QCBOR_ERR_LABEL_CHECK_FULL ||
+      MapCheckDecodeAll(Encoded, 193, &bDeterministic) != QCBOR_SUCCESS ||
+      bDeterministic) {
+      return 103;
+   }
+   QCBOREncode_Init(&EC, Buffer);
+   QCBOREncode_OpenMapIndefiniteLength(&EC);
+   for(i = 0; i < 60; i++) {
+      QCBOREncode_AddInt64ToMapN(&EC, i, i);
+   }
+   QCBOREncode_AddInt64ToMapN(&EC, 3, 0);
+   QCBOREncode_CloseMapIndefiniteLength(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded) ||
+      MapCheckDecodeAll(Encoded, 300, &bDeterministic) != QCBOR_ERR_DUPLICATE_LABEL) {
+      return 104;
+   }
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS */
+
+   // Not set up
+   const UsefulBufC Dup = {"\xa2\x01\x00\x01\x01", 5};
+   QCBORDecode_Init(&DC, Dup, QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_Finish(&DC) ||
+      QCBORDecode_IsDeterministic(&DC)) {
+      return 200;
+   }
+
+   // Labels aren't checked when maps are decoded as arrays
+   QCBORDecode_Init(&DC, Dup, QCBOR_DECODE_MODE_MAP_AS_ARRAY);
+   QCBORDecode_SetExtension(&DC, &Ext);
+   QCBORDecode_SetMapChecks(&DC, aScratch, 10);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP_AS_ARRAY ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_Finish(&DC)) {
+      return 201;
+   }
+
+   // Skipped maps are checked
+   QCBORDecode_Init(&DC, Dup, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &Ext);
+   QCBORDecode_SetMapChecks(&DC, aScratch, 10);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_ExitArrayOrMap(&DC) != QCBOR_ERR_DUPLICATE_LABEL) {
+      return 202;
+   }
+
+   // Labels decoded again after restoring a cursor aren't duplicates
+   QCBORDecodeCursor Start;
+   const UsefulBufC  TwoLabels = {"\xa2\x01\x00\x02\x00", 5};
+   QCBORDecode_Init(&DC, TwoLabels, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &Ext);
+   QCBORDecode_SetMapChecks(&DC, aScratch, 10);
+   QCBORDecode_SaveCursor(&DC, &Start);
+   for(i = 0; i < 2; i++) {
+      if(QCBORDecode_RestoreCursor(&DC, &Start) ||
+         QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_GetNext(&DC, &Item)) {
+         return 203;
+      }
+   }
+   if(QCBORDecode_Finish(&DC) || !QCBORDecode_IsDeterministic(&DC)) {
+      return 204;
+   }
+
+   // Reset starts over
+   QCBORDecode_Reset(&DC, Dup);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) != QCBOR_ERR_DUPLICATE_LABEL) {
+      return 205;
+   }
+   QCBORDecode_Reset(&DC, TwoLabels);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_Finish(&DC) ||
+      !QCBORDecode_IsDeterministic(&DC)) {
+      return 206;
+   }
+
+   // The elements of QCBORDecode_GetInt64Array() are checked
+   QCBORDecode_Init(&DC, (UsefulBufC){"\x82\x18\x01\x02", 4}, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &Ext);
+   QCBORDecode_SetMapChecks(&DC, aScratch, 10);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetInt64Array(&DC, &Item, nInts, 2, &uNum) ||
+      uNum != 2 || nInts[0] != 1 ||
+      QCBORDecode_Finish(&DC) ||
+      QCBORDecode_IsDeterministic(&DC)) {
+      return 207;
+   }
+
+   // Maps that are skipped over are still checked. [{1: 0, 1: 1}]
+   // skipped by QCBORDecode_SkipCurrent().
+   QCBORDecode_Init(&DC, (UsefulBufC){"\x81\xa2\x01\x00\x01\x01", 6}, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &Ext);
+   QCBORDecode_SetMapChecks(&DC, aScratch, 10);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_MAP ||
+      QCBORDecode_SkipCurrent(&DC, &Item) != QCBOR_ERR_DUPLICATE_LABEL) {
+      return 208;
+   }
+
+   // {1: [{2: 0, 2: 1}], 2: 0} with the duplicate two levels below the
+   // map that is exited
+   const UsefulBufC DeepDup = {"\xa2\x01\x81\xa2\x02\x00\x02\x01\x02\x00", 10};
+   QCBORDecode_Init(&DC, DeepDup, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &Ext);
+   QCBORDecode_SetMapChecks(&DC, aScratch, 10);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_ExitArrayOrMap(&DC) != QCBOR_ERR_DUPLICATE_LABEL) {
+      return 209;
+   }
+
+   // Skipped over by QCBORDecode_IndexMap()
+   QCBORMapIndex      Index;
+   QCBORMapIndexEntry aEntries[2];
+   QCBORDecode_Init(&DC, DeepDup, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_SetExtension(&DC, &Ext);
+   QCBORDecode_SetMapChecks(&DC, aScratch, 10);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      QCBORDecode_IndexMap(&DC, &Item, &Index, aEntries, 2) != QCBOR_ERR_DUPLICATE_LABEL) {
+      return 210;
+   }
+
+   // QCBORDecode_Validate() has no decode context so it doesn't check
+   // labels
+   if(QCBORDecode_Validate(DeepDup, NULL, NULL)) {
+      return 211;
+   }
+
+   return 0;
+}
@@ -210,6 +210,59 @@ int32_t IndefiniteLengthArrayMapTest(void);
 int32_t IndefiniteLengthStringTest(void);
 
 
+/*
+ Tests that an indefinite length string is allocated once for all its
+ chunks
+ */
+int32_t IndefiniteStringOneAllocTest(void);
+
+
+/*
+ Tests the arena string allocator, including reuse of its slabs
+ after a reset
+ */
+int32_t ArenaTest(void);
+
+
+/*
+ Tests QCBORDecode_SetDigest() by comparing what is given to the
+ digest to the input
+ */
+int32_t DigestDecodeTest(void);
+
+
+/*
+ Tests decoding of typed arrays and QCBORDecode_CopyTypedArray()
+ */
+int32_t TypedArrayDecodeTest(void);
+
+
+/*
+ Tests QCBORDecode_GetInt64Array() and QCBORDecode_GetDoubleArray().
+ */
+int32_t NumberArrayDecodeTest(void);
+
+
+/*
+ Tests QCBORDecode_SplitSequence() and QCBORDecode_PartitionSequence().
+ */
+int32_t SplitSequenceTest(void);
+
+
+/*
+ Tests QCBORDecode_CompileQuery() and QCBORDecode_RunQuery().
+ */
+int32_t QueryTest(void);
+
+
+#ifdef QCBOR_CONFIG_ENABLE_STATS
+/*
+ Tests QCBORDecode_GetStats() and QCBOREncode_GetStats().
+ */
+int32_t StatsTest(void);
+#endif /* QCBOR_CONFIG_ENABLE_STATS */
+
+
 /*
  Test deep nesting of indefinite length
  maps and arrays including too deep.
@@ -263,4 +316,70 @@ Tests for functions to safely convert integer types.
 */
 int32_t IntToTests(void);
 
+
+/*
+ Tests decoding input that is received a few bytes at a time
+ */
+int32_t IncrementalDecodeTest(void);
+
+
+/*
+ Tests QCBORDecode_GetNextBatch() against QCBORDecode_GetNext()
+ */
+int32_t BatchDecodeTest(void);
+
+
+/*
+ Tests QCBORDecode_IndexMap() and lookups by label
+ */
+int32_t IndexedMapTest(void);
+
+
+/*
+ Tests the maximum number of caller-configured tags, sorted and
+ unsorted, along with built-in tags on the same items
+ */
+int32_t CustomTagsTest(void);
+
+
+/*
+ Tests QCBORDecode_Validate() on well-formed and not-well-formed input
+ and with limits
+ */
+int32_t ValidateTest(void);
+
+
+/*
+ Tests QCBORDecode_SkipCurrent() and QCBORDecode_ExitArrayOrMap()
+ against plain decoding, including incremental decoding
+ */
+int32_t SkipTest(void);
+
+
+/*
+ Tests that input using a feature left out with QCBOR_DISABLE_TAGS and
+ such gives the disabled error and decodes normally otherwise
+ */
+int32_t DisabledFeaturesTest(void);
+
+
+/*
+ Tests string reference namespaces from encoding through decoding,
+ including the example in the stringref specification
+ */
+int32_t StringRefTest(void);
+
+
+/*
+ Tests QCBORDecode_SaveCursor(), QCBORDecode_RestoreCursor() and
+ QCBORDecode_Reset()
+ */
+int32_t CursorTest(void);
+
+
+/*
+ Tests QCBORDecode_SetMapChecks() and QCBORDecode_IsDeterministic()
+ */
+int32_t MapCheckTest(void);
+
 #endif /* defined(__QCBOR__qcbort_decode_tests__) */
@@ -1811,12 +1811,12 @@ int32_t BstrWrapErrorTest()
 
    // --------------- test nesting too deep ----------------------------------
    QCBOREncode_Init(&EC, UsefulBuf_FROM_BYTE_ARRAY(spBigBuf));
-   for(int i = 1; i < 18; i++) {
+   for(int i = 1; i < QCBOR_MAX_ARRAY_NESTING + 3; i++) {
       QCBOREncode_BstrWrap(&EC);
    }
    QCBOREncode_AddBool(&EC, true);
 
-   for(int i = 1; i < 18; i++) {
+   for(int i = 1; i < QCBOR_MAX_ARRAY_NESTING + 3; i++) {
       QCBOREncode_CloseBstrWrap(&EC, &Wrapped);
    }
 
@@ -1900,7 +1900,7 @@ static int32_t GetInt64(QCBORDecodeContext *pDC, int64_t *pInt)
 /*
  Get an array out of the decoder or fail.
  */
-static int32_t GetArray(QCBORDecodeContext *pDC, uint16_t *pInt)
+static int32_t GetArray(QCBORDecodeContext *pDC, QCBORCount *pInt)
 {
    QCBORItem Item;
    int32_t nReturn;
@@ -1920,7 +1920,7 @@ static int32_t GetArray(QCBORDecodeContext *pDC, uint16_t *pInt)
 /*
  Get a map out of the decoder or fail.
  */
-static int32_t GetMap(QCBORDecodeContext *pDC, uint16_t *pInt)
+static int32_t GetMap(QCBORDecodeContext *pDC, QCBORCount *pInt)
 {
    QCBORItem Item;
    int32_t nReturn;
@@ -1987,7 +1987,7 @@ static int32_t GetTextString(QCBORDecodeContext *pDC, UsefulBufC *pTstr)
 {
    int64_t            nInt;
    UsefulBufC         Bstr;
-   uint16_t           nArrayCount;
+   QCBORCount         nArrayCount;
    QCBORDecodeContext DC;
    int32_t            nResult;
 
@@ -2028,7 +2028,7 @@ static int32_t GetTextString(QCBORDecodeContext *pDC, UsefulBufC *pTstr)
 static int32_t DecodeNextNested2(UsefulBufC Wrapped)
 {
    int32_t            nResult;
-   uint16_t           nMapCount;
+   QCBORCount         nMapCount;
    int64_t            nInt;
    UsefulBufC         Bstr;
    QCBORDecodeContext DC;
@@ -2118,7 +2118,7 @@ int32_t BstrWrapNestTest()
    QCBORDecode_Init(&DC, Encoded, QCBOR_DECODE_MODE_NORMAL);
 
    UsefulBufC Bstr;
-   uint16_t nArrayCount;
+   QCBORCount nArrayCount;
 
    // Array surrounding the the whole thing
    if(GetArray(&DC, &nArrayCount) || nArrayCount != 2) {
@@ -2356,6 +2356,7 @@ int32_t EncodeErrorTests()
       return -1;
    }
 
+#ifndef QCBOR_USE_LARGE_ARRAYS
    // Second verify error from an array in encoded output too large
    // Also test fetching the error code before finish
    QCBOREncode_Init(&EC, Buffer);
@@ -2382,6 +2383,20 @@ int32_t EncodeErrorTests()
    if(QCBOREncode_FinishGetSize(&EC, &xx) != QCBOR_SUCCESS) {
       return -10;
    }
+#elif SIZE_MAX > UINT32_MAX
+   // With QCBOR_USE_LARGE_ARRAYS an array can start past 4GB
+   QCBOREncode_Init(&EC, (UsefulBuf){NULL, SIZE_MAX});
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddBytes(&EC, (UsefulBufC){NULL, UINT32_MAX});
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddInt64(&EC, 1);
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_FinishGetSize(&EC, &xx) != QCBOR_SUCCESS ||
+      xx != 1 + 5 + (size_t)UINT32_MAX + 1 + 1) {
+      return -12;
+   }
+#endif
 
 
    // ----- QCBOR_ERR_BUFFER_TOO_SMALL --------------
@@ -2749,3 +2764,1505 @@ int32_t QCBORHeadTest()
 
    return 0;
 }
+
+
+/*
+ Encodes a mix of everything that no-slide mode handles
+ differently: arrays, maps, bstr wrapping, indefinite lengths, raw
+ CBOR and strings containing the fill byte, with lengths that need
+ every size of head.
+ */
+static void EncodeForNoSlide(QCBOREncodeContext *pEC, UsefulBuf WrappedCopy, UsefulBufC *pWrapped)
+{
+   static const uint8_t spFillLike[] = {0x1c, 0x1c, 0x1c, 0x1c, 0x1c, 0x1c};
+   UsefulBufC           Wrapped;
+
+   QCBOREncode_OpenMap(pEC);
+   QCBOREncode_AddBytesToMap(pEC, "fill", UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spFillLike));
+
+   QCBOREncode_OpenArrayInMapN(pEC, 1);
+   for(int i = 0; i < 300; i++) {
+      QCBOREncode_AddInt64(pEC, i);
+   }
+   QCBOREncode_CloseArray(pEC);
+
+   QCBOREncode_OpenArrayInMapN(pEC, 2);
+   for(int i = 0; i < 24; i++) {
+      QCBOREncode_OpenArray(pEC);
+      QCBOREncode_CloseArray(pEC);
+   }
+   QCBOREncode_CloseArray(pEC);
+
+   QCBOREncode_OpenArrayIndefiniteLengthInMapN(pEC, 3);
+   QCBOREncode_OpenMap(pEC);
+   QCBOREncode_AddTextToMapN(pEC, 4, UsefulBuf_FROM_SZ_LITERAL("indefinite"));
+   QCBOREncode_CloseMap(pEC);
+   QCBOREncode_CloseArrayIndefiniteLength(pEC);
+
+   QCBOREncode_AddEncodedToMapN(pEC, 5, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spFiveArrarys));
+
+   QCBOREncode_BstrWrapInMapN(pEC, 6);
+   QCBOREncode_OpenArray(pEC);
+   QCBOREncode_BstrWrap(pEC);
+   QCBOREncode_OpenMap(pEC);
+   QCBOREncode_AddBytesToMapN(pEC, 7, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spFillLike));
+   QCBOREncode_CloseMap(pEC);
+   QCBOREncode_CloseBstrWrap2(pEC, false, NULL);
+   QCBOREncode_CloseArray(pEC);
+   QCBOREncode_CloseBstrWrap2(pEC, true, &Wrapped);
+   // Copied right away because in normal mode it is only valid until
+   // the next close. There's nothing to copy when calculating size.
+   *pWrapped = Wrapped.ptr ? UsefulBuf_Copy(WrappedCopy, Wrapped) : Wrapped;
+
+   QCBOREncode_BstrWrapInMapN(pEC, 8);
+   QCBOREncode_AddEncoded(pEC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spExpectedEncodedInts));
+   QCBOREncode_CloseBstrWrap2(pEC, false, &Wrapped);
+   if(Wrapped.ptr &&
+      UsefulBuf_Compare(Wrapped, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spExpectedEncodedInts))) {
+      *pWrapped = NULLUsefulBufC;
+   }
+   QCBOREncode_CloseMap(pEC);
+}
+
+
+int32_t NoSlideEncodeTest()
+{
+   QCBOREncodeContext EC;
+   UsefulBufC         Expected;
+   UsefulBufC         Encoded;
+   UsefulBufC         ExpectedWrapped;
+   UsefulBufC         Wrapped;
+   size_t             uSize;
+
+   UsefulBuf_MAKE_STACK_UB(ExpectedWrappedCopy, 100);
+   UsefulBuf_MAKE_STACK_UB(WrappedCopy, 100);
+
+   // ---- The reference is the normal sliding mode ----
+   UsefulBuf_MAKE_STACK_UB(ExpectedStorage, 1100);
+   QCBOREncode_Init(&EC, ExpectedStorage);
+   EncodeForNoSlide(&EC, ExpectedWrappedCopy, &ExpectedWrapped);
+   if(QCBOREncode_Finish(&EC, &Expected)) {
+      return -1;
+   }
+
+   // ---- Same output in no-slide mode ----
+   QCBOREncode_Init(&EC, UsefulBuf_FROM_BYTE_ARRAY(spBigBuf));
+   QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+   EncodeForNoSlide(&EC, WrappedCopy, &Wrapped);
+   // The wrapped bstrs have their fill removed at close
+   if(UsefulBuf_IsNULLC(Wrapped) || UsefulBuf_Compare(Wrapped, ExpectedWrapped)) {
+      return -2;
+   }
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -3;
+   }
+   if(UsefulBuf_Compare(Encoded, Expected)) {
+      return -4;
+   }
+   // Calling finish again gives the same result
+   if(QCBOREncode_Finish(&EC, &Encoded) || UsefulBuf_Compare(Encoded, Expected)) {
+      return -5;
+   }
+
+   // ---- Size calculation gives room for the fill ----
+   QCBOREncode_Init(&EC, (UsefulBuf){NULL, INT32_MAX});
+   QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+   EncodeForNoSlide(&EC, WrappedCopy, &Wrapped);
+   if(QCBOREncode_FinishGetSize(&EC, &uSize)) {
+      return -6;
+   }
+   if(uSize < Expected.len) {
+      return -7;
+   }
+
+   // ---- A buffer of exactly that size is big enough ----
+   QCBOREncode_Init(&EC, (UsefulBuf){spBigBuf, uSize});
+   QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+   EncodeForNoSlide(&EC, WrappedCopy, &Wrapped);
+   if(QCBOREncode_Finish(&EC, &Encoded) || UsefulBuf_Compare(Encoded, Expected)) {
+      return -8;
+   }
+
+   // ---- Just the size of the output isn't because of the fill ----
+   QCBOREncode_Init(&EC, (UsefulBuf){spBigBuf, Expected.len});
+   QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+   EncodeForNoSlide(&EC, WrappedCopy, &Wrapped);
+   if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_BUFFER_TOO_SMALL) {
+      return -9;
+   }
+
+#if QCBOR_MAX_ARRAY_NESTING >= 1 + 2 * BSTR_TEST_DEPTH
+   // ---- Deeply nested bstr wrapping ----
+   QCBOREncode_Init(&EC, UsefulBuf_FROM_BYTE_ARRAY(spBigBuf));
+   QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+   QCBOREncode_OpenArray(&EC);
+   for(int i = 0; i < BSTR_TEST_DEPTH; i++) {
+      QCBOREncode_BstrWrap(&EC);
+      QCBOREncode_OpenArray(&EC);
+      QCBOREncode_AddInt64(&EC, i);
+   }
+   for(int i = 0; i < BSTR_TEST_DEPTH; i++) {
+      QCBOREncode_CloseArray(&EC);
+      QCBOREncode_CloseBstrWrap(&EC, NULL);
+   }
+   QCBOREncode_OpenMap(&EC);
+   for(int i = 0; i < (BSTR_TEST_DEPTH-2); i++) {
+      QCBOREncode_BstrWrapInMapN(&EC, i+0x20);
+      QCBOREncode_OpenMap(&EC);
+      QCBOREncode_AddInt64ToMapN(&EC, i+0x10, i+0x10);
+      QCBOREncode_AddSZStringToMapN(&EC, i+0x40, "hello");
+   }
+   for(int i = 0; i < (BSTR_TEST_DEPTH-2); i++) {
+      QCBOREncode_CloseMap(&EC);
+      QCBOREncode_CloseBstrWrap(&EC, NULL);
+   }
+   QCBOREncode_CloseMap(&EC);
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -10;
+   }
+   if(UsefulBuf_Compare(UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spExpectedDeepBstr), Encoded)) {
+      return -11;
+   }
+#endif /* QCBOR_MAX_ARRAY_NESTING >= 1 + 2 * BSTR_TEST_DEPTH */
+
+   // ---- Length-only bstrs are not supported ----
+   QCBOREncode_Init(&EC, UsefulBuf_FROM_BYTE_ARRAY(spBigBuf));
+   QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+   QCBOREncode_AddBytesLenOnly(&EC, UsefulBuf_FROM_SZ_LITERAL("xxxx"));
+   if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_UNSUPPORTED) {
+      return -12;
+   }
+
+   // ---- Errors are still caught ----
+   QCBOREncode_Init(&EC, UsefulBuf_FROM_BYTE_ARRAY(spBigBuf));
+   QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_CloseBstrWrap2(&EC, true, &Wrapped);
+   if(!UsefulBuf_IsNULLC(Wrapped)) {
+      return -13;
+   }
+   if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_CLOSE_MISMATCH) {
+      return -14;
+   }
+
+   return 0;
+}
+
+
+/* A sink that appends to a UsefulOutBuf */
+static int SinkToOutBuf(void *pSinkCtx, UsefulBufC Bytes)
+{
+   UsefulOutBuf *pOutBuf = (UsefulOutBuf *)pSinkCtx;
+
+   UsefulOutBuf_AppendUsefulBuf(pOutBuf, Bytes);
+
+   return UsefulOutBuf_GetError(pOutBuf);
+}
+
+
+/* A sink that fails on the third call */
+static int FailingSink(void *pSinkCtx, UsefulBufC Bytes)
+{
+   int *pnCalls = (int *)pSinkCtx;
+
+   (void)Bytes;
+   return ++(*pnCalls) >= 3;
+}
+
+
+/*
+ Encodes a mix of data items with a bstr wrap, deep nesting and a
+ string larger than the small staging buffers used.
+ */
+static void EncodeForSink(QCBOREncodeContext *pEC)
+{
+   QCBOREncode_OpenMap(pEC);
+   QCBOREncode_AddSZStringToMap(pEC, "name", "a log record");
+   QCBOREncode_OpenArrayInMap(pEC, "samples");
+   for(int i = 0; i < 300; i++) {
+      QCBOREncode_AddInt64(pEC, (i - 150) * 10);
+   }
+   QCBOREncode_CloseArray(pEC);
+
+   QCBOREncode_OpenArrayInMapN(pEC, 2);
+   for(int i = 0; i < 6; i++) {
+      QCBOREncode_OpenArray(pEC);
+      QCBOREncode_AddDouble(pEC, 1.5 * i);
+   }
+   QCBOREncode_AddBool(pEC, true);
+   for(int i = 0; i < 6; i++) {
+      QCBOREncode_CloseArray(pEC);
+   }
+   QCBOREncode_CloseArray(pEC);
+
+   QCBOREncode_BstrWrapInMapN(pEC, 3);
+   QCBOREncode_OpenMap(pEC);
+   QCBOREncode_AddInt64ToMapN(pEC, 1, -7);
+   QCBOREncode_AddBytesToMapN(pEC, 4, UsefulBuf_FROM_SZ_LITERAL("kid"));
+   QCBOREncode_CloseMap(pEC);
+   QCBOREncode_CloseBstrWrap2(pEC, false, NULL);
+
+   QCBOREncode_AddBytesToMapN(pEC, 5, (UsefulBufC){spBigBuf, 600});
+   QCBOREncode_AddEncodedToMapN(pEC, 6, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spFiveArrarys));
+   QCBOREncode_OpenMapInMapN(pEC, 7);
+   QCBOREncode_CloseMap(pEC);
+   QCBOREncode_CloseMap(pEC);
+}
+
+
+/*
+ Decode two encoded inputs and check they have the same data items
+ even if the lengths of maps and arrays are encoded differently.
+ */
+static int32_t CompareDecoded(UsefulBufC Encoded1, UsefulBufC Encoded2)
+{
+   QCBORDecodeContext DC1, DC2;
+   QCBORItem          Item1, Item2;
+   QCBORError         uErr1, uErr2;
+
+   QCBORDecode_Init(&DC1, Encoded1, QCBOR_DECODE_MODE_NORMAL);
+   QCBORDecode_Init(&DC2, Encoded2, QCBOR_DECODE_MODE_NORMAL);
+
+   do {
+      uErr1 = QCBORDecode_GetNext(&DC1, &Item1);
+      uErr2 = QCBORDecode_GetNext(&DC2, &Item2);
+      if(uErr1 != uErr2) {
+         return 1;
+      }
+      if(uErr1 != QCBOR_SUCCESS) {
+         break;
+      }
+      if(Item1.uDataType     != Item2.uDataType ||
+         Item1.uNestingLevel != Item2.uNestingLevel ||
+         Item1.uLabelType    != Item2.uLabelType) {
+         return 2;
+      }
+      if(Item1.uLabelType == QCBOR_TYPE_TEXT_STRING) {
+         if(UsefulBuf_Compare(Item1.label.string, Item2.label.string)) {
+            return 3;
+         }
+      } else if(Item1.uLabelType != QCBOR_TYPE_NONE) {
+         if(Item1.label.int64 != Item2.label.int64) {
+            return 4;
+         }
+      }
+      switch(Item1.uDataType) {
+         case QCBOR_TYPE_ARRAY:
+         case QCBOR_TYPE_MAP:
+            // The count is UINT16_MAX if indefinite length
+            break;
+
+         case QCBOR_TYPE_BYTE_STRING:
+         case QCBOR_TYPE_TEXT_STRING:
+            if(UsefulBuf_Compare(Item1.val.string, Item2.val.string)) {
+               return 5;
+            }
+            break;
+
+         case QCBOR_TYPE_DOUBLE:
+            if(Item1.val.dfnum != Item2.val.dfnum) {
+               return 6;
+            }
+            break;
+
+         default:
+            if(Item1.val.uint64 != Item2.val.uint64) {
+               return 7;
+            }
+            break;
+      }
+   } while(1);
+
+   if(uErr1 != QCBOR_ERR_NO_MORE_ITEMS) {
+      return 8;
+   }
+   if(QCBORDecode_Finish(&DC1) || QCBORDecode_Finish(&DC2)) {
+      return 9;
+   }
+
+   return 0;
+}
+
+
+int32_t SinkEncodeTest()
+{
+   QCBOREncodeContext   EC;
+   QCBOREncodeExtension Ext;
+   UsefulOutBuf         SinkOutput;
+   UsefulBufC           Expected;
+   UsefulBufC           Encoded;
+   QCBORError           uErr;
+
+   UsefulBuf_MAKE_STACK_UB(ExpectedStorage, 2000);
+   UsefulBuf_MAKE_STACK_UB(SinkStorage, 2000);
+   UsefulBuf_MAKE_STACK_UB(Staging, 2000);
+
+   for(size_t i = 0; i < 600; i++) {
+      spBigBuf[i] = (uint8_t)i;
+   }
+
+   // ---- The reference output without a sink ----
+   QCBOREncode_Init(&EC, ExpectedStorage);
+   EncodeForSink(&EC);
+   if(QCBOREncode_Finish(&EC, &Expected)) {
+      return -1;
+   }
+
+   // ---- All fits in the staging buffer so output is the same ----
+   UsefulOutBuf_Init(&SinkOutput, SinkStorage);
+   QCBOREncode_InitWithSink(&EC, Staging, &Ext, SinkToOutBuf, &SinkOutput);
+   EncodeForSink(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -2;
+   }
+   if(Encoded.ptr != NULL || Encoded.len != Expected.len) {
+      return -3;
+   }
+   if(UsefulBuf_Compare(UsefulOutBuf_OutUBuf(&SinkOutput), Expected)) {
+      return -4;
+   }
+
+   // ---- Staging buffers of many sizes give the same data items ----
+   for(size_t uStagingSize = 24; uStagingSize < Expected.len; uStagingSize += 7) {
+      UsefulOutBuf_Init(&SinkOutput, SinkStorage);
+      QCBOREncode_InitWithSink(&EC,
+                               (UsefulBuf){Staging.ptr, uStagingSize},
+                               &Ext,
+                               SinkToOutBuf,
+                               &SinkOutput);
+      EncodeForSink(&EC);
+      if(QCBOREncode_Finish(&EC, &Encoded)) {
+         return -5;
+      }
+      if(Encoded.len != UsefulOutBuf_GetEndPosition(&SinkOutput)) {
+         return -6;
+      }
+      if(CompareDecoded(UsefulOutBuf_OutUBuf(&SinkOutput), Expected)) {
+         return -7;
+      }
+   }
+
+   // ---- Bstr-wrapped CBOR must fit in the staging buffer ----
+   UsefulOutBuf_Init(&SinkOutput, SinkStorage);
+   QCBOREncode_InitWithSink(&EC, (UsefulBuf){Staging.ptr, 20}, &Ext, SinkToOutBuf, &SinkOutput);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddSZString(&EC, "before the wrap");
+   QCBOREncode_BstrWrap(&EC);
+   QCBOREncode_AddSZString(&EC, "too long to fit in staging");
+   QCBOREncode_CloseBstrWrap2(&EC, false, NULL);
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_BUFFER_TOO_SMALL) {
+      return -8;
+   }
+
+   // ---- The wrapped CBOR returned is right ----
+   UsefulBufC Wrapped;
+   UsefulOutBuf_Init(&SinkOutput, SinkStorage);
+   QCBOREncode_InitWithSink(&EC, (UsefulBuf){Staging.ptr, 20}, &Ext, SinkToOutBuf, &SinkOutput);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddSZString(&EC, "before the wrap");
+   QCBOREncode_BstrWrap(&EC);
+   QCBOREncode_AddSZString(&EC, "wrapped");
+   QCBOREncode_CloseBstrWrap2(&EC, true, &Wrapped);
+   if(UsefulBuf_Compare(Wrapped, UsefulBuf_FROM_SZ_LITERAL("\x48\x67wrapped"))) {
+      return -9;
+   }
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -10;
+   }
+   static const uint8_t spExpectedSmallStaging[] = {
+      0x9f, 0x6f, 'b', 'e', 'f', 'o', 'r', 'e', ' ', 't', 'h', 'e', ' ',
+      'w', 'r', 'a', 'p', 0x48, 0x67, 'w', 'r', 'a', 'p', 'p', 'e', 'd',
+      0xff};
+   if(CheckResults(UsefulOutBuf_OutUBuf(&SinkOutput), spExpectedSmallStaging)) {
+      return -11;
+   }
+
+   // ---- Errors from the sink are returned ----
+   int nCalls = 0;
+   QCBOREncode_InitWithSink(&EC, (UsefulBuf){Staging.ptr, 24}, &Ext, FailingSink, &nCalls);
+   EncodeForSink(&EC);
+   uErr = QCBOREncode_Finish(&EC, &Encoded);
+   if(uErr != QCBOR_ERR_SINK_WRITE || nCalls != 3) {
+      return -12;
+   }
+
+   return 0;
+}
+
+
+/*
+ Put the segments from QCBOREncode_FinishSegments() back together.
+ */
+static UsefulBufC JoinSegments(UsefulBuf Storage, const UsefulBufC *pSegments, size_t uNumSegments)
+{
+   UsefulOutBuf UOB;
+
+   UsefulOutBuf_Init(&UOB, Storage);
+   for(size_t u = 0; u < uNumSegments; u++) {
+      UsefulOutBuf_AppendUsefulBuf(&UOB, pSegments[u]);
+   }
+   return UsefulOutBuf_OutUBuf(&UOB);
+}
+
+
+int32_t ReferenceEncodeTest()
+{
+   QCBOREncodeContext   EC;
+   QCBOREncodeExtension Ext;
+   QCBOREncodeRef       aRefs[8];
+   UsefulBufC           aSegments[17];
+   size_t               uNumSegments;
+   UsefulBufC           Expected;
+   UsefulBufC           Encoded;
+   size_t               uSize;
+
+   UsefulBuf_MAKE_STACK_UB(ExpectedStorage, 2000);
+   UsefulBuf_MAKE_STACK_UB(OutStorage, 2000);
+   UsefulBuf_MAKE_STACK_UB(JoinStorage, 2000);
+
+   for(size_t i = 0; i < 600; i++) {
+      spBigBuf[i] = (uint8_t)i;
+   }
+
+   // ---- The reference output ----
+   QCBOREncode_Init(&EC, ExpectedStorage);
+   EncodeForSink(&EC);
+   if(QCBOREncode_Finish(&EC, &Expected)) {
+      return -1;
+   }
+
+   // ---- Different amounts referenced give the same output ----
+   static const size_t auMinRefLens[] = {1, 4, 16, 600, 601};
+   for(size_t i = 0; i < sizeof(auMinRefLens)/sizeof(auMinRefLens[0]); i++) {
+      QCBOREncode_Init(&EC, OutStorage);
+      QCBOREncode_SetExtension(&EC, &Ext);
+      QCBOREncode_SetReferences(&EC, aRefs, 8, auMinRefLens[i]);
+      EncodeForSink(&EC);
+      if(QCBOREncode_FinishSegments(&EC, aSegments, 17, &uNumSegments)) {
+         return -2;
+      }
+      if(UsefulBuf_Compare(JoinSegments(JoinStorage, aSegments, uNumSegments), Expected)) {
+         return -3;
+      }
+      if(QCBOREncode_FinishGetSize(&EC, &uSize) || uSize != Expected.len) {
+         return -4;
+      }
+      const QCBORError uExpectedErr = auMinRefLens[i] > 600 ? QCBOR_SUCCESS :
+                                                              QCBOR_ERR_OUTPUT_HAS_REFERENCES;
+      if(QCBOREncode_Finish(&EC, &Encoded) != uExpectedErr) {
+         return -5;
+      }
+   }
+
+   // ---- The big string isn't copied or in the output buffer ----
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+   QCBOREncode_SetReferences(&EC, aRefs, 8, 100);
+   EncodeForSink(&EC);
+   if(QCBOREncode_FinishSegments(&EC, aSegments, 17, &uNumSegments) || uNumSegments != 3) {
+      return -6;
+   }
+   if(aSegments[1].ptr != spBigBuf || aSegments[1].len != 600 ||
+      aSegments[0].ptr != OutStorage.ptr ||
+      aSegments[0].len + aSegments[2].len != Expected.len - 600) {
+      return -7;
+   }
+
+   // ---- Only as many references as there is room for ----
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+   QCBOREncode_SetReferences(&EC, aRefs, 2, 1);
+   EncodeForSink(&EC);
+   if(QCBOREncode_FinishSegments(&EC, aSegments, 17, &uNumSegments) || uNumSegments != 5) {
+      return -8;
+   }
+   if(UsefulBuf_Compare(JoinSegments(JoinStorage, aSegments, uNumSegments), Expected)) {
+      return -9;
+   }
+
+   // ---- Not enough segments ----
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+   QCBOREncode_SetReferences(&EC, aRefs, 8, 100);
+   EncodeForSink(&EC);
+   if(QCBOREncode_FinishSegments(&EC, aSegments, 2, &uNumSegments) != QCBOR_ERR_BUFFER_TOO_SMALL) {
+      return -10;
+   }
+
+   // ---- Size calculation mode ----
+   QCBOREncode_Init(&EC, (UsefulBuf){NULL, UINT32_MAX});
+   QCBOREncode_SetExtension(&EC, &Ext);
+   QCBOREncode_SetReferences(&EC, aRefs, 8, 16);
+   EncodeForSink(&EC);
+   if(QCBOREncode_FinishGetSize(&EC, &uSize) || uSize != Expected.len) {
+      return -11;
+   }
+
+   // ---- Referenced strings at the start and end and in a row ----
+   static const uint8_t spExpectedRefsInARow[] = {
+      0x82, 0x83, 0x43, 'a', 'b', 'c', 0x63, 'd', 'e', 'f', 0x80, 0x43, 'g', 'h', 'i'};
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+   QCBOREncode_SetReferences(&EC, aRefs, 8, 3);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddBytes(&EC, UsefulBuf_FROM_SZ_LITERAL("abc"));
+   QCBOREncode_AddText(&EC, UsefulBuf_FROM_SZ_LITERAL("def"));
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_AddBytes(&EC, UsefulBuf_FROM_SZ_LITERAL("ghi"));
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_FinishSegments(&EC, aSegments, 17, &uNumSegments) || uNumSegments != 6) {
+      return -12;
+   }
+   if(CheckResults(JoinSegments(JoinStorage, aSegments, uNumSegments), spExpectedRefsInARow)) {
+      return -13;
+   }
+
+   // ---- Referenced encoded CBOR right before and at the start of arrays ----
+   static const uint8_t spExpectedRefsAtStart[] = {
+      0x82, 0x63, 'a', 'b', 'c', 0x81, 0x81, 0x63, 'd', 'e', 'f'};
+   static const uint8_t spEncodedAbc[] = {0x63, 'a', 'b', 'c'};
+   static const uint8_t spEncodedDef[] = {0x63, 'd', 'e', 'f'};
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+   QCBOREncode_SetReferences(&EC, aRefs, 8, 4);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddEncoded(&EC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spEncodedAbc));
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddEncoded(&EC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spEncodedDef));
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_CloseArray(&EC);
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_FinishSegments(&EC, aSegments, 17, &uNumSegments) || uNumSegments != 4) {
+      return -14;
+   }
+   if(CheckResults(JoinSegments(JoinStorage, aSegments, uNumSegments), spExpectedRefsAtStart)) {
+      return -15;
+   }
+
+   return 0;
+}
+
+
+/* Collects what is given to a digest callback */
+typedef struct {
+   UsefulOutBuf OutBuf;
+   int          nCalls;
+} DigestCollector;
+
+static void DigestToOutBuf(void *pDigestCtx, UsefulBufC Bytes)
+{
+   DigestCollector *pCollector = (DigestCollector *)pDigestCtx;
+
+   UsefulOutBuf_AppendUsefulBuf(&(pCollector->OutBuf), Bytes);
+   pCollector->nCalls++;
+}
+
+
+/*
+ Encodes a bstr wrap with an indefinite-length array that can be
+ given to the digest as it goes, definite-length maps and arrays and
+ a bstr wrap inside it that can't and a string bigger than the
+ staging buffer used with a sink. The wrap is with a digest if
+ pCollector is not NULL. The number of calls to the digest before
+ the close of the wrap is returned in pnCallsBeforeClose.
+ */
+static void EncodeForDigest(QCBOREncodeContext *pEC,
+                            DigestCollector    *pCollector,
+                            UsefulBuf           WrappedCopy,
+                            UsefulBufC         *pWrapped,
+                            int                *pnCallsBeforeClose)
+{
+   static const uint8_t spFillLike[] = {0x1c, 0x1c, 0x1c, 0x1c};
+   UsefulBufC           Wrapped;
+
+   QCBOREncode_OpenArray(pEC);
+   QCBOREncode_AddBytes(pEC, (UsefulBufC){spBigBuf, 300});
+
+   if(pCollector) {
+      QCBOREncode_BstrWrapWithDigest(pEC, DigestToOutBuf, pCollector);
+   } else {
+      QCBOREncode_BstrWrap(pEC);
+   }
+   QCBOREncode_OpenArrayIndefiniteLength(pEC);
+   for(int i = 0; i < 200; i++) {
+      QCBOREncode_AddInt64(pEC, i * 1000);
+   }
+   QCBOREncode_CloseArrayIndefiniteLength(pEC);
+
+   QCBOREncode_OpenMap(pEC);
+   QCBOREncode_AddBytesToMapN(pEC, 1, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spFillLike));
+   QCBOREncode_OpenArrayInMapN(pEC, 2);
+   for(int i = 0; i < 30; i++) {
+      QCBOREncode_AddInt64(pEC, -i);
+   }
+   QCBOREncode_CloseArray(pEC);
+   QCBOREncode_BstrWrapInMapN(pEC, 3);
+   QCBOREncode_OpenMap(pEC);
+   QCBOREncode_AddBytesToMapN(pEC, 4, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spFillLike));
+   QCBOREncode_CloseMap(pEC);
+   QCBOREncode_CloseBstrWrap2(pEC, true, NULL);
+   QCBOREncode_CloseMap(pEC);
+
+   QCBOREncode_AddEncoded(pEC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spFiveArrarys));
+   QCBOREncode_AddText(pEC, (UsefulBufC){spBigBuf, 600});
+
+   *pnCallsBeforeClose = pCollector ? pCollector->nCalls : 0;
+   QCBOREncode_CloseBstrWrap2(pEC, false, &Wrapped);
+   *pWrapped = Wrapped.ptr ? UsefulBuf_Copy(WrappedCopy, Wrapped) : Wrapped;
+
+   QCBOREncode_CloseArray(pEC);
+}
+
+
+int32_t DigestEncodeTest()
+{
+   QCBOREncodeContext   EC;
+   QCBOREncodeExtension Ext;
+   DigestCollector      Collector;
+   UsefulBufC           Expected;
+   UsefulBufC           ExpectedWrapped;
+   UsefulBufC           Encoded;
+   UsefulBufC           Wrapped;
+   int                  nCallsBeforeClose;
+   size_t               uSize;
+
+   UsefulBuf_MAKE_STACK_UB(ExpectedStorage, 3000);
+   UsefulBuf_MAKE_STACK_UB(ExpectedWrappedCopy, 2000);
+   UsefulBuf_MAKE_STACK_UB(OutStorage, 3000);
+   UsefulBuf_MAKE_STACK_UB(WrappedCopy, 2000);
+   UsefulBuf_MAKE_STACK_UB(CollectorStorage, 2000);
+
+   for(size_t i = 0; i < 600; i++) {
+      spBigBuf[i] = (uint8_t)i;
+   }
+
+   // ---- The reference output without a digest ----
+   QCBOREncode_Init(&EC, ExpectedStorage);
+   EncodeForDigest(&EC, NULL, ExpectedWrappedCopy, &ExpectedWrapped, &nCallsBeforeClose);
+   if(QCBOREncode_Finish(&EC, &Expected)) {
+      return -1;
+   }
+
+   // ---- Normal, no-slide and sink modes ----
+   static const uint8_t auConfigs[] = {0, QCBOR_ENCODE_CONFIG_NO_SLIDE};
+   for(size_t i = 0; i < sizeof(auConfigs)/sizeof(auConfigs[0]) + 1; i++) {
+      UsefulOutBuf SinkOutBuf;
+      UsefulOutBuf_Init(&SinkOutBuf, OutStorage);
+      UsefulBuf_MAKE_STACK_UB(Staging, 1700);
+
+      if(i < sizeof(auConfigs)/sizeof(auConfigs[0])) {
+         QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+         QCBOREncode_SetExtension(&EC, &Ext);
+         QCBOREncode_Config(&EC, auConfigs[i]);
+      } else {
+         // The wrap fits in the staging buffer, but all of it doesn't
+         QCBOREncode_InitWithSink(&EC, Staging, &Ext, SinkToOutBuf, &SinkOutBuf);
+      }
+      UsefulOutBuf_Init(&(Collector.OutBuf), CollectorStorage);
+      Collector.nCalls = 0;
+
+      EncodeForDigest(&EC, &Collector, WrappedCopy, &Wrapped, &nCallsBeforeClose);
+      if(QCBOREncode_Finish(&EC, &Encoded)) {
+         return -2;
+      }
+      if(i == sizeof(auConfigs)/sizeof(auConfigs[0])) {
+         // The open array is flushed with an indefinite-length head
+         if(CompareDecoded(UsefulOutBuf_OutUBuf(&SinkOutBuf), Expected)) {
+            return -3;
+         }
+      } else if(UsefulBuf_Compare(Encoded, Expected)) {
+         return -3;
+      }
+      if(UsefulBuf_Compare(Wrapped, ExpectedWrapped) ||
+         UsefulBuf_Compare(UsefulOutBuf_OutUBuf(&(Collector.OutBuf)), ExpectedWrapped)) {
+         return -4;
+      }
+      // The indefinite-length array is given before the close
+      if(nCallsBeforeClose < 5) {
+         return -5;
+      }
+   }
+
+   // ---- Nothing is given when calculating size ----
+   QCBOREncode_Init(&EC, (UsefulBuf){NULL, UINT32_MAX});
+   QCBOREncode_SetExtension(&EC, &Ext);
+   Collector.nCalls = 0;
+   EncodeForDigest(&EC, &Collector, WrappedCopy, &Wrapped, &nCallsBeforeClose);
+   if(QCBOREncode_FinishGetSize(&EC, &uSize) || uSize != Expected.len || Collector.nCalls) {
+      return -6;
+   }
+
+   // ---- One after another, but not one in another ----
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+   UsefulOutBuf_Init(&(Collector.OutBuf), CollectorStorage);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_BstrWrapWithDigest(&EC, DigestToOutBuf, &Collector);
+   QCBOREncode_AddInt64(&EC, 1);
+   QCBOREncode_CloseBstrWrap2(&EC, false, NULL);
+   QCBOREncode_BstrWrapWithDigest(&EC, DigestToOutBuf, &Collector);
+   QCBOREncode_AddInt64(&EC, 2);
+   QCBOREncode_CloseBstrWrap2(&EC, false, NULL);
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -7;
+   }
+   static const uint8_t spExpectedTwo[] = {0x01, 0x02};
+   if(CheckResults(UsefulOutBuf_OutUBuf(&(Collector.OutBuf)), spExpectedTwo)) {
+      return -8;
+   }
+
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+   QCBOREncode_BstrWrapWithDigest(&EC, DigestToOutBuf, &Collector);
+   QCBOREncode_BstrWrapWithDigest(&EC, DigestToOutBuf, &Collector);
+   if(QCBOREncode_GetErrorState(&EC) != QCBOR_ERR_UNSUPPORTED) {
+      return -9;
+   }
+
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+   QCBOREncode_BstrWrapWithDigest(&EC, DigestToOutBuf, &Collector);
+   QCBOREncode_AddBytesLenOnly(&EC, UsefulBuf_FROM_SZ_LITERAL("abc"));
+   if(QCBOREncode_GetErrorState(&EC) != QCBOR_ERR_UNSUPPORTED) {
+      return -10;
+   }
+
+   // ---- Not without an extension ----
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_BstrWrapWithDigest(&EC, DigestToOutBuf, &Collector);
+   if(QCBOREncode_GetErrorState(&EC) != QCBOR_ERR_NO_EXTENSION) {
+      return -11;
+   }
+
+   return 0;
+
+}
+
+
+static const uint8_t spExpectedTypedArrays[] = {
+   0x83,
+   0xd8, 0x41, 0x46, 0x01, 0x02, 0x03, 0x04, 0xff, 0xfe,
+   0xd8, 0x51, 0x48, 0x3f, 0x80, 0x00, 0x00, 0xc0, 0x20, 0x00, 0x00,
+   0xd8, 0x48, 0x42, 0xff, 0x02
+};
+
+int32_t TypedArrayEncodeTest()
+{
+   QCBOREncodeContext EC;
+   UsefulBufC         Encoded;
+
+   static const uint16_t au16[] = {0x0102, 0x0304, 0xfffe};
+   static const float    afloat[] = {1.0f, -2.5f};
+   static const int8_t   ai8[] = {-1, 2};
+   uint64_t              au64[10];
+
+   UsefulBuf_MAKE_STACK_UB(OutStorage, 200);
+
+   // ---- Big-endian output is the same on all CPUs ----
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddTypedArray(&EC, QCBOR_TYPED_ARRAY_UINT16, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(au16), true);
+   QCBOREncode_AddTypedArray(&EC, QCBOR_TYPED_ARRAY_FLOAT32, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(afloat), true);
+   // One-byte elements have no byte order
+   QCBOREncode_AddTypedArray(&EC, QCBOR_TYPED_ARRAY_SINT8, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(ai8), false);
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -1;
+   }
+   if(CheckResults(Encoded, spExpectedTypedArrays)) {
+      return -2;
+   }
+
+   // ---- More than one buffer full to swap ----
+   for(size_t i = 0; i < 10; i++) {
+      au64[i] = 0x0102030405060708ULL * i;
+   }
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_AddTypedArray(&EC, QCBOR_TYPED_ARRAY_UINT64, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(au64), true);
+   if(QCBOREncode_Finish(&EC, &Encoded) || Encoded.len != 4 + sizeof(au64)) {
+      return -3;
+   }
+   const uint8_t *pEncoded = Encoded.ptr;
+   if(pEncoded[0] != 0xd8 || pEncoded[1] != 0x43 || pEncoded[2] != 0x58 || pEncoded[3] != 0x50) {
+      return -4;
+   }
+   for(int i = 0; i < 10; i++) {
+      uint64_t uValue = 0;
+      for(int j = 0; j < 8; j++) {
+         uValue = (uValue << 8) + pEncoded[4 + i * 8 + j];
+      }
+      if(uValue != au64[i]) {
+         return -5;
+      }
+   }
+
+   // ---- Native byte order is output as is ----
+   const uint16_t uOne = 1;
+   const uint8_t  uLittleEndian = *(const uint8_t *)&uOne;
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_AddTypedArray(&EC, QCBOR_TYPED_ARRAY_UINT16, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(au16), false);
+   if(QCBOREncode_Finish(&EC, &Encoded) || Encoded.len != 3 + sizeof(au16)) {
+      return -6;
+   }
+   pEncoded = Encoded.ptr;
+   if(pEncoded[1] != (uLittleEndian ? 0x45 : 0x41) || memcmp(pEncoded + 3, au16, sizeof(au16))) {
+      return -7;
+   }
+
+   // ---- Errors ----
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_AddTypedArray(&EC, QCBOR_TYPED_ARRAY_UINT16, (UsefulBufC){au16, 3}, false);
+   if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_BAD_TYPED_ARRAY) {
+      return -8;
+   }
+   static const uint8_t auBadTypes[] = {0x04, 0x18, 0x1b, 0x20};
+   for(size_t i = 0; i < sizeof(auBadTypes); i++) {
+      QCBOREncode_Init(&EC, OutStorage);
+      QCBOREncode_AddTypedArray(&EC, auBadTypes[i], UsefulBuf_FROM_BYTE_ARRAY_LITERAL(au16), true);
+      if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_BAD_TYPED_ARRAY) {
+         return -9;
+      }
+   }
+
+   return 0;
+}
+
+
+/*
+ Encode records two at a time as they would be by separate workers
+ */
+#define FRAGMENT_NUM_RECORDS   6
+#define FRAGMENT_RECORDS_EACH  2
+
+static void EncodeFragmentRecord(QCBOREncodeContext *pEC, int64_t nRecord)
+{
+   QCBOREncode_OpenMap(pEC);
+   QCBOREncode_AddInt64ToMapN(pEC, 1, nRecord);
+   QCBOREncode_AddSZStringToMapN(pEC, 2, "a record long enough to be referenced");
+   QCBOREncode_OpenArrayInMapN(pEC, 3);
+   QCBOREncode_AddInt64(pEC, nRecord * 1000);
+   QCBOREncode_AddBool(pEC, nRecord & 1);
+   QCBOREncode_CloseArray(pEC);
+   QCBOREncode_CloseMap(pEC);
+}
+
+
+int32_t FragmentEncodeTest()
+{
+   QCBOREncodeContext   EC;
+   QCBOREncodeExtension Ext;
+   QCBOREncodeContext   WorkerEC;
+   UsefulBufC           Expected;
+   UsefulBufC           Encoded;
+   UsefulBufC           aFragments[FRAGMENT_NUM_RECORDS / FRAGMENT_RECORDS_EACH];
+   QCBOREncodeRef       aRefs[4];
+   UsefulBufC           aSegments[9];
+   size_t               uNumSegments;
+   const                size_t       uNumFragments = sizeof(aFragments)/sizeof(aFragments[0]);
+
+   UsefulBuf_MAKE_STACK_UB(ExpectedStorage, 600);
+   UsefulBuf_MAKE_STACK_UB(FragmentStorage, 600);
+   UsefulBuf_MAKE_STACK_UB(OutStorage, 600);
+   UsefulBuf_MAKE_STACK_UB(JoinStorage, 600);
+
+   // ---- The reference output, all in one context ----
+   QCBOREncode_Init(&EC, ExpectedStorage);
+   QCBOREncode_OpenArray(&EC);
+   for(int64_t i = 0; i < FRAGMENT_NUM_RECORDS; i++) {
+      EncodeFragmentRecord(&EC, i);
+   }
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Expected)) {
+      return -1;
+   }
+
+   // ---- Each fragment is a sequence of records in its own buffer ----
+   const size_t uFragmentSize = FragmentStorage.len / uNumFragments;
+   for(size_t i = 0; i < uNumFragments; i++) {
+      QCBOREncode_Init(&WorkerEC, (UsefulBuf){(uint8_t *)FragmentStorage.ptr + i * uFragmentSize,
+                                              uFragmentSize});
+      for(size_t j = 0; j < FRAGMENT_RECORDS_EACH; j++) {
+         EncodeFragmentRecord(&WorkerEC, (int64_t)(i * FRAGMENT_RECORDS_EACH + j));
+      }
+      if(QCBOREncode_Finish(&WorkerEC, &aFragments[i])) {
+         return -2;
+      }
+   }
+
+   // ---- Spliced in, copied, normally and with no slide ----
+   for(int nNoSlide = 0; nNoSlide < 2; nNoSlide++) {
+      QCBOREncode_Init(&EC, OutStorage);
+      if(nNoSlide) {
+         QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+      }
+      QCBOREncode_OpenArray(&EC);
+      for(size_t i = 0; i < uNumFragments; i++) {
+         QCBOREncode_AddEncodedFragment(&EC, aFragments[i], FRAGMENT_RECORDS_EACH);
+      }
+      QCBOREncode_CloseArray(&EC);
+      if(QCBOREncode_Finish(&EC, &Encoded)) {
+         return -3;
+      }
+      if(UsefulBuf_Compare(Encoded, Expected)) {
+         return -4;
+      }
+   }
+
+   // ---- Spliced in by reference without being copied ----
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_SetExtension(&EC, &Ext);
+   QCBOREncode_SetReferences(&EC, aRefs, 4, 16);
+   QCBOREncode_OpenArray(&EC);
+   for(size_t i = 0; i < uNumFragments; i++) {
+      QCBOREncode_AddEncodedFragment(&EC, aFragments[i], FRAGMENT_RECORDS_EACH);
+   }
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_FinishSegments(&EC, aSegments, 9, &uNumSegments) ||
+      uNumSegments != uNumFragments + 1) {
+      return -5;
+   }
+   for(size_t i = 0; i < uNumFragments; i++) {
+      if(aSegments[i + 1].ptr != aFragments[i].ptr || aSegments[i + 1].len != aFragments[i].len) {
+         return -6;
+      }
+   }
+   if(UsefulBuf_Compare(JoinSegments(JoinStorage, aSegments, uNumSegments), Expected)) {
+      return -7;
+   }
+
+   // ---- Map entries count as two items each ----
+   static const uint8_t spExpectedFragmentMap[] = {
+      0xa3, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+   static const uint8_t spMapEntries[] = {0x03, 0x04, 0x05, 0x06};
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_OpenMap(&EC);
+   QCBOREncode_AddInt64ToMapN(&EC, 1, 2);
+   QCBOREncode_AddEncodedFragment(&EC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spMapEntries), 4);
+   QCBOREncode_CloseMap(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -8;
+   }
+   if(CheckResults(Encoded, spExpectedFragmentMap)) {
+      return -9;
+   }
+
+   // ---- An empty fragment and too many items ----
+   static const uint8_t spExpectedEmptyFragment[] = {0x81, 0x01};
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddEncodedFragment(&EC, NULLUsefulBufC, 0);
+   QCBOREncode_AddInt64(&EC, 1);
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded)) {
+      return -10;
+   }
+   if(CheckResults(Encoded, spExpectedEmptyFragment)) {
+      return -11;
+   }
+
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_OpenArray(&EC);
+   QCBOREncode_AddInt64(&EC, 1);
+   QCBOREncode_AddEncodedFragment(&EC, aFragments[0], QCBOR_MAX_ITEMS_IN_ARRAY - 1);
+   QCBOREncode_CloseArray(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_ARRAY_TOO_LONG) {
+      return -12;
+   }
+
+   return 0;
+}
+
+
+/*
+ More items than fit in a uint16_t count, so this only succeeds with
+ QCBOR_USE_LARGE_ARRAYS
+ */
+#define LARGE_ARRAY_NUM_ITEMS 70000
+
+static uint8_t spLargeArrayBuf[LARGE_ARRAY_NUM_ITEMS + 10];
+
+int32_t LargeArrayTest()
+{
+   QCBOREncodeContext EC;
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+   UsefulBufC         Encoded;
+   QCBORError         uErr;
+
+   static const uint8_t spLargeArrayHead[] = {0x9a, 0x00, 0x01, 0x11, 0x70};
+
+   for(int nNoSlide = 0; nNoSlide < 2; nNoSlide++) {
+      QCBOREncode_Init(&EC, UsefulBuf_FROM_BYTE_ARRAY(spLargeArrayBuf));
+      if(nNoSlide) {
+         QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+      }
+      QCBOREncode_OpenArray(&EC);
+      for(uint32_t u = 0; u < LARGE_ARRAY_NUM_ITEMS; u++) {
+         QCBOREncode_AddUInt64(&EC, u % 24);
+      }
+      QCBOREncode_CloseArray(&EC);
+      uErr = QCBOREncode_Finish(&EC, &Encoded);
+#ifdef QCBOR_USE_LARGE_ARRAYS
+      if(uErr != QCBOR_SUCCESS ||
+         Encoded.len != sizeof(spLargeArrayHead) + LARGE_ARRAY_NUM_ITEMS ||
+         memcmp(Encoded.ptr, spLargeArrayHead, sizeof(spLargeArrayHead))) {
+         return -1;
+      }
+#else
+      if(uErr != QCBOR_ERR_ARRAY_TOO_LONG) {
+         return -1;
+      }
+#endif
+   }
+
+   // Decode, making the input by hand when it couldn't be encoded
+   memcpy(spLargeArrayBuf, spLargeArrayHead, sizeof(spLargeArrayHead));
+   for(uint32_t u = 0; u < LARGE_ARRAY_NUM_ITEMS; u++) {
+      spLargeArrayBuf[sizeof(spLargeArrayHead) + u] = (uint8_t)(u % 24);
+   }
+   QCBORDecode_Init(&DC,
+                    (UsefulBufC){spLargeArrayBuf, sizeof(spLargeArrayHead) + LARGE_ARRAY_NUM_ITEMS},
+                    QCBOR_DECODE_MODE_NORMAL);
+   uErr = QCBORDecode_GetNext(&DC, &Item);
+#ifdef QCBOR_USE_LARGE_ARRAYS
+   if(uErr != QCBOR_SUCCESS ||
+      Item.uDataType != QCBOR_TYPE_ARRAY ||
+      Item.val.uCount != LARGE_ARRAY_NUM_ITEMS) {
+      return -2;
+   }
+   for(uint32_t u = 0; u < LARGE_ARRAY_NUM_ITEMS; u++) {
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         Item.uDataType != QCBOR_TYPE_INT64 ||
+         Item.val.int64 != u % 24 ||
+         Item.uNextNestLevel != (u == LARGE_ARRAY_NUM_ITEMS - 1 ? 0 : 1)) {
+         return -3;
+      }
+   }
+   if(QCBORDecode_Finish(&DC)) {
+      return -4;
+   }
+#else
+   if(uErr != QCBOR_ERR_ARRAY_TOO_LONG) {
+      return -2;
+   }
+#endif
+
+   return 0;
+}
+
+
+/*
+ A structure with one of each type of record field
+ */
+typedef struct {
+   int64_t    nTime;
+   int32_t    nSmall;
+   uint64_t   uBig;
+   uint32_t   uMedium;
+   double     dX;
+   double     dY;
+   bool       bValid;
+   UsefulBufC Name;
+   UsefulBufC Id;
+} RecordTestStruct;
+
+static const QCBORRecordField spRecordFields[] = {
+   QCBORField_INT64(1, RecordTestStruct, nTime),
+   QCBORField_INT32(-2, RecordTestStruct, nSmall),
+   QCBORField_UINT64(3, RecordTestStruct, uBig),
+   QCBORField_UINT32(300, RecordTestStruct, uMedium),
+   QCBORField_DOUBLE(-1000, RecordTestStruct, dX),
+   QCBORField_DOUBLE(5, RecordTestStruct, dY),
+   QCBORField_BOOL(INT64_MIN, RecordTestStruct, bValid),
+   QCBORField_TEXT(70000, RecordTestStruct, Name),
+   QCBORField_BYTES(INT64_MAX, RecordTestStruct, Id),
+};
+
+static void EncodeRecordByHand(QCBOREncodeContext *pEC, const RecordTestStruct *pRecord)
+{
+   QCBOREncode_OpenMap(pEC);
+   QCBOREncode_AddInt64ToMapN(pEC, 1, pRecord->nTime);
+   QCBOREncode_AddInt64ToMapN(pEC, -2, pRecord->nSmall);
+   QCBOREncode_AddUInt64ToMapN(pEC, 3, pRecord->uBig);
+   QCBOREncode_AddUInt64ToMapN(pEC, 300, pRecord->uMedium);
+   QCBOREncode_AddDoubleToMapN(pEC, -1000, pRecord->dX);
+   QCBOREncode_AddDoubleToMapN(pEC, 5, pRecord->dY);
+   QCBOREncode_AddBoolToMapN(pEC, INT64_MIN, pRecord->bValid);
+   QCBOREncode_AddTextToMapN(pEC, 70000, pRecord->Name);
+   QCBOREncode_AddBytesToMapN(pEC, INT64_MAX, pRecord->Id);
+   QCBOREncode_CloseMap(pEC);
+}
+
+
+int32_t RecordTest()
+{
+   QCBOREncodeContext EC;
+   QCBORDecodeContext DC;
+   QCBORRecord        Record;
+   UsefulBufC         Expected;
+   UsefulBufC         Encoded;
+   size_t             uSize;
+   uint32_t           uFound;
+
+   UsefulBuf_MAKE_STACK_UB(ExpectedStorage, 400);
+   UsefulBuf_MAKE_STACK_UB(OutStorage, 400);
+
+   static const uint8_t spId[] = {0x01, 0x02, 0x03};
+   const RecordTestStruct aRecords[] = {
+      {0, 0, 0, 0, 0.0, 0.0, false, NULLUsefulBufC, NULLUsefulBufC},
+      {-1, INT32_MIN, UINT64_MAX, UINT32_MAX, 1.5, 3.4028234663852886e+38, true,
+       UsefulBuf_FROM_SZ_LITERAL("arm"), UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spId)},
+      {INT64_MIN, INT32_MAX, 24, 256, -0.1, 1e300, false,
+       UsefulBuf_FROM_SZ_LITERAL("a name that is more than twenty-three bytes"), NULLUsefulBufC},
+   };
+
+   // ---- Bad records ----
+   const QCBORRecordField aBadType[] = {{1, 0, 0}};
+   const QCBORRecordField aDuplicate[] = {
+      QCBORField_INT64(1, RecordTestStruct, nTime),
+      QCBORField_INT64(1, RecordTestStruct, nTime)
+   };
+   if(QCBOREncode_CompileRecord(&Record, aBadType, 1) != QCBOR_ERR_BAD_RECORD ||
+      QCBOREncode_CompileRecord(&Record, aDuplicate, 2) != QCBOR_ERR_BAD_RECORD ||
+      QCBOREncode_CompileRecord(&Record, spRecordFields, QCBOR_MAX_RECORD_FIELDS + 1) != QCBOR_ERR_BAD_RECORD) {
+      return -1;
+   }
+
+   if(QCBOREncode_CompileRecord(&Record,
+                                spRecordFields,
+                                sizeof(spRecordFields)/sizeof(spRecordFields[0]))) {
+      return -2;
+   }
+
+   for(size_t i = 0; i < sizeof(aRecords)/sizeof(aRecords[0]); i++) {
+      const int32_t nBase = (int32_t)i * -100;
+
+      QCBOREncode_Init(&EC, ExpectedStorage);
+      QCBOREncode_OpenArray(&EC);
+      EncodeRecordByHand(&EC, &aRecords[i]);
+      QCBOREncode_CloseArray(&EC);
+      if(QCBOREncode_Finish(&EC, &Expected)) {
+         return nBase - 10;
+      }
+
+      // ---- The same as by hand, normally and with no slide ----
+      for(int nNoSlide = 0; nNoSlide < 2; nNoSlide++) {
+         QCBOREncode_Init(&EC, OutStorage);
+         if(nNoSlide) {
+            QCBOREncode_Config(&EC, QCBOR_ENCODE_CONFIG_NO_SLIDE);
+         }
+         QCBOREncode_OpenArray(&EC);
+         QCBOREncode_AddRecord(&EC, &Record, &aRecords[i]);
+         QCBOREncode_CloseArray(&EC);
+         if(QCBOREncode_Finish(&EC, &Encoded)) {
+            return nBase - 11;
+         }
+         if(UsefulBuf_Compare(Encoded, Expected)) {
+            return nBase - 12;
+         }
+      }
+
+      // ---- Just the size, which is done field by field ----
+      QCBOREncode_Init(&EC, (UsefulBuf){NULL, SIZE_MAX});
+      QCBOREncode_OpenArray(&EC);
+      QCBOREncode_AddRecord(&EC, &Record, &aRecords[i]);
+      QCBOREncode_CloseArray(&EC);
+      if(QCBOREncode_FinishGetSize(&EC, &uSize) || uSize != Expected.len) {
+         return nBase - 13;
+      }
+
+      // ---- Not enough room gives the same error as by hand ----
+      QCBOREncode_Init(&EC, (UsefulBuf){OutStorage.ptr, Expected.len - 1});
+      QCBOREncode_OpenArray(&EC);
+      QCBOREncode_AddRecord(&EC, &Record, &aRecords[i]);
+      QCBOREncode_CloseArray(&EC);
+      if(QCBOREncode_Finish(&EC, &Encoded) != QCBOR_ERR_BUFFER_TOO_SMALL) {
+         return nBase - 14;
+      }
+
+      // ---- Decodes back to the same ----
+      RecordTestStruct Decoded;
+      memset(&Decoded, 0xff, sizeof(Decoded));
+      QCBORItem Item;
+      QCBORDecode_Init(&DC, Expected, QCBOR_DECODE_MODE_NORMAL);
+      if(QCBORDecode_GetNext(&DC, &Item) ||
+         QCBORDecode_GetRecord(&DC, &Record, &Decoded, &uFound) ||
+         QCBORDecode_Finish(&DC)) {
+         return nBase - 15;
+      }
+      if(uFound != 0x1ff ||
+         Decoded.nTime != aRecords[i].nTime ||
+         Decoded.nSmall != aRecords[i].nSmall ||
+         Decoded.uBig != aRecords[i].uBig ||
+         Decoded.uMedium != aRecords[i].uMedium ||
+         Decoded.dX != aRecords[i].dX ||
+         Decoded.dY != aRecords[i].dY ||
+         Decoded.bValid != aRecords[i].bValid ||
+         UsefulBuf_Compare(Decoded.Name, aRecords[i].Name) ||
+         UsefulBuf_Compare(Decoded.Id, aRecords[i].Id)) {
+         return nBase - 16;
+      }
+   }
+
+   // ---- An empty record and a record in a map ----
+   static const uint8_t spExpectedEmptyRecord[] = {0xa1, 0x01, 0xa0};
+   if(QCBOREncode_CompileRecord(&Record, NULL, 0)) {
+      return -20;
+   }
+   QCBOREncode_Init(&EC, OutStorage);
+   QCBOREncode_OpenMap(&EC);
+   QCBOREncode_AddRecordToMapN(&EC, 1, &Record, NULL);
+   QCBOREncode_CloseMap(&EC);
+   if(QCBOREncode_Finish(&EC, &Encoded) || CheckResults(Encoded, spExpectedEmptyRecord)) {
+      return -21;
+   }
+
+   // ---- Entries in any order, missing and not in the record ----
+   static const uint8_t spOutOfOrder[] = {
+      0xa5,
+         0x05, 0xfb, 0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 5: 1.0
+         0x0a, 0x82, 0x01, 0xa1, 0x01, 0x02, // 10: [1, {1: 2}]
+         0x01, 0x20,                    // 1: -1
+         0x0b, 0xa0,                    // 11: {}
+         0x01, 0x07,                    // 1: 7, the last one is used
+      0x08};
+   const QCBORRecordField aFewFields[] = {
+      QCBORField_INT64(1, RecordTestStruct, nTime),
+      QCBORField_DOUBLE(5, RecordTestStruct, dY),
+      QCBORField_BOOL(6, RecordTestStruct, bValid),
+   };
+   if(QCBOREncode_CompileRecord(&Record, aFewFields, 3)) {
+      return -30;
+   }
+   RecordTestStruct Few = aRecords[0];
+   QCBORItem        Item;
+   QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spOutOfOrder), QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetRecord(&DC, &Record, &Few, &uFound) ||
+      uFound != 0x03 ||
+      Few.nTime != 7 ||
+      Few.dY != 1.0 ||
+      Few.bValid != false) {
+      return -31;
+   }
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_INT64 ||
+      Item.val.int64 != 8 ||
+      QCBORDecode_Finish(&DC)) {
+      return -32;
+   }
+
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
+   static const uint8_t spIndefiniteMap[] = {0xbf, 0x06, 0xf5, 0x01, 0x02, 0xff};
+   QCBORDecode_Init(&DC, UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spIndefiniteMap), QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetRecord(&DC, &Record, &Few, &uFound) ||
+      uFound != 0x05 ||
+      Few.nTime != 2 ||
+      Few.bValid != true ||
+      QCBORDecode_Finish(&DC)) {
+      return -33;
+   }
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS */
+
+   // ---- Wrong types and integers too big ----
+   static const uint8_t spNotMap[]    = {0x80};
+   static const uint8_t spWrongType[] = {0xa1, 0x01, 0xf5};
+   static const uint8_t spTooBig[]    = {0xa1, 0x01, 0x1b, 0x80, 0, 0, 0, 0, 0, 0, 0};
+   static const uint8_t spNegative[]  = {0xa1, 0x03, 0x20};
+   static const uint8_t spInt32Big[]  = {0xa1, 0x21, 0x1a, 0x80, 0x00, 0x00, 0x00};
+   static const uint8_t spUInt32Big[] = {0xa1, 0x19, 0x01, 0x2c, 0x1b, 0, 0, 0, 1, 0, 0, 0, 0};
+   struct {
+      UsefulBufC Input;
+      QCBORError uExpected;
+   } aErrors[] = {
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spNotMap),    QCBOR_ERR_UNEXPECTED_TYPE},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spWrongType), QCBOR_ERR_UNEXPECTED_TYPE},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spTooBig),    QCBOR_ERR_INT_OVERFLOW},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spNegative),  QCBOR_ERR_INT_OVERFLOW},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spInt32Big),  QCBOR_ERR_INT_OVERFLOW},
+      {UsefulBuf_FROM_BYTE_ARRAY_LITERAL(spUInt32Big), QCBOR_ERR_INT_OVERFLOW},
+   };
+   if(QCBOREncode_CompileRecord(&Record,
+                                spRecordFields,
+                                sizeof(spRecordFields)/sizeof(spRecordFields[0]))) {
+      return -40;
+   }
+   for(size_t i = 0; i < sizeof(aErrors)/sizeof(aErrors[0]); i++) {
+      RecordTestStruct Decoded;
+      QCBORDecode_Init(&DC, aErrors[i].Input, QCBOR_DECODE_MODE_NORMAL);
+      if(QCBORDecode_GetRecord(&DC, &Record, &Decoded, &uFound) != aErrors[i].uExpected ||
+         uFound != 0) {
+         return -41 - (int32_t)i;
+      }
+   }
+
+   return 0;
+}
+
+
+#ifdef QCBOR_RING_LOAD_ACQUIRE
+static const char *szRingStrings[] = {"", "a", "abc", "abcdef"};
+
+/* Check a record in the ring is [uNumber, szRingStrings[uNumber % 4]] */
+static int32_t CheckRingRecord(UsefulBufC Record, uint64_t uNumber)
+{
+   QCBORDecodeContext DC;
+   QCBORItem          Item;
+
+   QCBORDecode_Init(&DC, Record, QCBOR_DECODE_MODE_NORMAL);
+   if(QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_ARRAY ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      Item.uDataType != QCBOR_TYPE_INT64 ||
+      (uint64_t)Item.val.int64 != uNumber ||
+      QCBORDecode_GetNext(&DC, &Item) ||
+      UsefulBuf_Compare(Item.val.string, UsefulBuf_FromSZ(szRingStrings[uNumber % 4])) ||
+      QCBORDecode_Finish(&DC)) {
+      return 1;
+   }
+   return 0;
+}
+
+
+int32_t RingTest()
+{
+   QCBOREncodeContext EC;
+   QCBORRing          Ring;
+   UsefulBufC         Records;
+   UsefulBufC         aItems[2];
+   size_t             uNumItems;
+   size_t             uConsumed;
+   QCBORError         uErr;
+   uint64_t           uNextProduced;
+   uint64_t           uNextConsumed;
+   uint32_t           uRound;
+   uint32_t           u;
+   uint32_t           uWraps;
+   uint32_t           uFulls;
+
+   UsefulBuf_MAKE_STACK_UB(Storage, 61);
+
+   QCBORRing_Init(&Ring, Storage);
+   if(QCBORRing_Peek(&Ring).len != 0) {
+      return 1;
+   }
+
+   // Produce and consume at different rates so the ring is sometimes
+   // full, sometimes empty and the records wrap at different places.
+   uNextProduced = 0;
+   uNextConsumed = 0;
+   uWraps        = 0;
+   uFulls        = 0;
+   for(uRound = 0; uRound < 500; uRound++) {
+      for(u = 0; u < uRound % 5 + 1; u++) {
+         uErr = QCBORRing_StartRecord(&Ring, &EC, 12);
+         if(uErr == QCBOR_ERR_RING_FULL) {
+            uFulls++;
+            break;
+         }
+         if(uErr) {
+            return 2;
+         }
+         QCBOREncode_OpenArray(&EC);
+         QCBOREncode_AddUInt64(&EC, uNextProduced);
+         QCBOREncode_AddSZString(&EC, szRingStrings[uNextProduced % 4]);
+         QCBOREncode_CloseArray(&EC);
+         if(QCBORRing_PublishRecord(&Ring, &EC)) {
+            return 3;
+         }
+         uNextProduced++;
+      }
+
+      for(u = 0; u < uRound % 4 + 1; u++) {
+         Records = QCBORRing_Peek(&Ring);
+         if(Records.len == 0) {
+            if(uNextConsumed != uNextProduced) {
+               return 4;
+            }
+            break;
+         }
+         if(Records.ptr == Storage.ptr && uNextConsumed > 0) {
+            uWraps++;
+         }
+         // Take one or two whole records
+         if(QCBORDecode_SplitSequence(Records, aItems, uRound % 2 + 1, &uNumItems, &uConsumed) ||
+            uNumItems == 0) {
+            return 5;
+         }
+         for(size_t i = 0; i < uNumItems; i++) {
+            if(CheckRingRecord(aItems[i], uNextConsumed++)) {
+               return 6;
+            }
+         }
+         QCBORRing_Consume(&Ring, uConsumed);
+      }
+   }
+   if(uWraps < 10 || uFulls < 10 || uNextConsumed < 1000) {
+      return 7;
+   }
+
+   // Drain it
+   while((Records = QCBORRing_Peek(&Ring)).len != 0) {
+      if(QCBORDecode_SplitSequence(Records, aItems, 1, &uNumItems, &uConsumed) ||
+         CheckRingRecord(aItems[0], uNextConsumed++)) {
+         return 8;
+      }
+      QCBORRing_Consume(&Ring, uConsumed);
+   }
+   if(uNextConsumed != uNextProduced) {
+      return 9;
+   }
+
+   // A record bigger than reserved isn't published
+   if(QCBORRing_StartRecord(&Ring, &EC, 4)) {
+      return 10;
+   }
+   QCBOREncode_AddSZString(&EC, "abcdef");
+   if(QCBORRing_PublishRecord(&Ring, &EC) != QCBOR_ERR_BUFFER_TOO_SMALL ||
+      QCBORRing_Peek(&Ring).len != 0) {
+      return 11;
+   }
+
+   // Too big for the ring at all
+   if(QCBORRing_StartRecord(&Ring, &EC, Storage.len + 1) != QCBOR_ERR_RING_FULL) {
+      return 12;
+   }
+
+   // Fill exactly to the end, then nothing fits until consumed
+   QCBORRing_Init(&Ring, Storage);
+   if(QCBORRing_StartRecord(&Ring, &EC, Storage.len)) {
+      return 13;
+   }
+   QCBOREncode_AddBytes(&EC, (UsefulBufC){Storage.ptr, Storage.len - 2});
+   if(QCBORRing_PublishRecord(&Ring, &EC) ||
+      QCBORRing_StartRecord(&Ring, &EC, 1) != QCBOR_ERR_RING_FULL) {
+      return 14;
+   }
+   Records = QCBORRing_Peek(&Ring);
+   if(Records.len != Storage.len) {
+      return 15;
+   }
+   QCBORRing_Consume(&Ring, Records.len);
+   if(QCBORRing_StartRecord(&Ring, &EC, 1)) {
+      return 16;
+   }
+   QCBOREncode_AddUInt64(&EC, 7);
+   if(QCBORRing_PublishRecord(&Ring, &EC)) {
+      return 17;
+   }
+   Records = QCBORRing_Peek(&Ring);
+   if(Records.ptr != Storage.ptr || Records.len != 1) {
+      return 18;
+   }
+
+   return 0;
+}
+#endif /* QCBOR_RING_LOAD_ACQUIRE */
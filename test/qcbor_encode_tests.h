@@ -190,4 +190,70 @@ int32_t QCBORHeadTest(void);
 
 
 
+/*
+ Test QCBOR_ENCODE_CONFIG_NO_SLIDE by comparing what it outputs to
+ the normal mode.
+ */
+int32_t NoSlideEncodeTest(void);
+
+
+
+/*
+ Test QCBOREncode_InitWithSink() with staging buffers of different
+ sizes.
+ */
+int32_t SinkEncodeTest(void);
+
+
+
+/*
+ Test QCBOREncode_SetReferences() and QCBOREncode_FinishSegments() by
+ comparing the joined segments to the normal output.
+ */
+int32_t ReferenceEncodeTest(void);
+
+
+
+/*
+ Test QCBOREncode_BstrWrapWithDigest() in all the output modes by
+ comparing what is given to the digest to the wrapped CBOR.
+ */
+int32_t DigestEncodeTest(void);
+
+
+/*
+ Test QCBOREncode_AddTypedArray() in both byte orders and its errors
+ */
+int32_t TypedArrayEncodeTest(void);
+
+
+/*
+ Test QCBOREncode_AddEncodedFragment() by splicing in records encoded
+ in separate contexts and comparing to encoding them all in one
+ */
+int32_t FragmentEncodeTest(void);
+
+
+/*
+ Test encoding and decoding an array with more items than fit in a
+ uint16_t, which works only with QCBOR_USE_LARGE_ARRAYS
+ */
+int32_t LargeArrayTest(void);
+
+
+/*
+ Test QCBOREncode_AddRecord() against encoding the same fields by
+ hand and decoding them back with QCBORDecode_GetRecord()
+ */
+int32_t RecordTest(void);
+
+
+/*
+ Test producing and consuming records with a QCBORRing, in one thread,
+ at rates that make it fill up and wrap around
+ */
+int32_t RingTest(void);
+
+
+
 #endif /* defined(__QCBOR__qcbor_encode_tests__) */
@@ -0,0 +1,275 @@
+/*==============================================================================
+ run_benchmarks.c -- benchmark aggregator and results reporting
+
+ Copyright (c) 2026, Laurence Lundblade. All rights reserved.
+
+ SPDX-License-Identifier: BSD-3-Clause
+
+ See BSD-3-Clause license in README.md
+
+ Created on 10/14/26
+ =============================================================================*/
+
+#include "run_benchmarks.h"
+#include "UsefulBuf.h"
+#include <stdbool.h>
+
+#include "qcbor_benchmarks.h"
+#include "qcbor/qcbor_encode.h" // For QCBOR_RING_LOAD_ACQUIRE
+
+
+/*
+ Benchmark configuration
+ */
+
+typedef int32_t (bench_fun_t)(uint32_t uIterations, BenchmarkWork *pWork);
+
+
+#define BENCH_ENTRY(bench_name)  {#bench_name, bench_name, true}
+#define BENCH_ENTRY_DISABLED(bench_name)  {#bench_name, bench_name, false}
+
+typedef struct {
+    const char  *szBenchName;
+    bench_fun_t *bench_fun;
+    bool         bEnabled;
+} bench_entry;
+
+
+static bench_entry s_benchmarks[] = {
+    BENCH_ENTRY(BenchEncodeCOSESign1),
+    BENCH_ENTRY(BenchEncodeCOSESign1NoSlide),
+    BENCH_ENTRY(BenchEncodeCOSESign1Sink),
+    BENCH_ENTRY(BenchEncodeCOSESign1Refs),
+    BENCH_ENTRY(BenchDecodeCOSESign1),
+    BENCH_ENTRY(BenchDecodeCOSESign1WithTags),
+    BENCH_ENTRY(BenchValidateCOSESign1),
+    BENCH_ENTRY(BenchEncodeCWTClaims),
+    BENCH_ENTRY(BenchDecodeCWTClaims),
+    BENCH_ENTRY(BenchDecodeCWTClaimsWithTags),
+    BENCH_ENTRY(BenchDecodeCWTClaimsBatch),
+    BENCH_ENTRY(BenchDecodeCWTClaimsChecked),
+    BENCH_ENTRY(BenchValidateCWTClaims),
+    BENCH_ENTRY(BenchDecodeCWTClaimsTwoPass),
+    BENCH_ENTRY(BenchDecodeCWTClaimsTwoPassCursor),
+    BENCH_ENTRY(BenchDecodeCWTClaimsTwoPassReset),
+    BENCH_ENTRY(BenchEncodeDeepNestedMaps),
+    BENCH_ENTRY(BenchEncodeDeepNestedMapsNoSlide),
+    BENCH_ENTRY(BenchDecodeDeepNestedMaps),
+    BENCH_ENTRY(BenchDecodeDeepNestedMapsChecked),
+    BENCH_ENTRY(BenchSkipDeepNestedMaps),
+    BENCH_ENTRY(BenchEncodeIntArray),
+    BENCH_ENTRY(BenchEncodeIntArraySink),
+    BENCH_ENTRY(BenchDecodeIntArray),
+    BENCH_ENTRY(BenchDecodeIntArrayBatch),
+    BENCH_ENTRY(BenchValidateIntArray),
+    BENCH_ENTRY(BenchSkipIntArray),
+    BENCH_ENTRY(BenchEncodeFloatArray),
+    BENCH_ENTRY(BenchDecodeFloatArray),
+    BENCH_ENTRY(BenchDecodeFloatArrayBatch),
+    BENCH_ENTRY(BenchDecodeIntArrayNative),
+    BENCH_ENTRY(BenchDecodeFloatArrayNative),
+    BENCH_ENTRY(BenchSplitIntSequence),
+    BENCH_ENTRY(BenchEncodeFloatTypedArray),
+    BENCH_ENTRY(BenchDecodeFloatTypedArray),
+    BENCH_ENTRY(BenchDecodeIndefiniteStrings),
+    BENCH_ENTRY(BenchValidateIndefiniteStrings),
+    BENCH_ENTRY(BenchDecodeIndefiniteStringsMoving),
+    BENCH_ENTRY(BenchQueryCOSESign1),
+    BENCH_ENTRY(BenchQueryCWTClaims),
+    BENCH_ENTRY(BenchQueryDeepNestedMaps),
+    BENCH_ENTRY(BenchEncodePoses),
+    BENCH_ENTRY(BenchEncodePosesRecord),
+    BENCH_ENTRY(BenchDecodePoses),
+    BENCH_ENTRY(BenchDecodePosesRecord),
+    BENCH_ENTRY(BenchEncodePosesCDDL),
+    BENCH_ENTRY(BenchDecodePosesCDDL),
+#ifdef QCBOR_RING_LOAD_ACQUIRE
+    BENCH_ENTRY(BenchEncodePosesCopied),
+    BENCH_ENTRY(BenchEncodePosesRing),
+#endif
+    BENCH_ENTRY(BenchUsefulBufIsValue),
+    BENCH_ENTRY(BenchUsefulBufFindBytes),
+};
+
+
+/* Run each benchmark at least this long */
+#define BENCH_MIN_NS 250000000ULL
+
+
+/*
+ Convert an unsigned number to a string. If uDecimals is not 0, the
+ number is treated as fixed point with that many decimal places. Like
+ NumToString() in run_tests.c this avoids linking in sprintf.
+
+ StringMem should be 24 bytes long, 20 for digits, 1 for the decimal
+ point, 1 for a leading 0 and 1 for \0 termination.
+ */
+static const char *UNumToString(uint64_t uNum, unsigned uDecimals, UsefulBuf StringMem)
+{
+   uint8_t  auDigits[20];
+   unsigned uNumDigits;
+
+   /* Produce the digits in reverse order */
+   uNumDigits = 0;
+   do {
+      auDigits[uNumDigits++] = (uint8_t)('0' + uNum % 10);
+      uNum /= 10;
+   } while(uNum || uNumDigits <= uDecimals);
+
+   UsefulOutBuf OutBuf;
+   UsefulOutBuf_Init(&OutBuf, StringMem);
+   while(uNumDigits) {
+      if(uNumDigits == uDecimals) {
+         UsefulOutBuf_AppendByte(&OutBuf, '.');
+      }
+      UsefulOutBuf_AppendByte(&OutBuf, auDigits[--uNumDigits]);
+   }
+   UsefulOutBuf_AppendByte(&OutBuf, '\0');
+
+   return UsefulOutBuf_GetError(&OutBuf) ? "" : StringMem.ptr;
+}
+
+
+/*
+ These measure the stack use with a fill pattern. PaintStack() fills
+ BENCH_STACK_PAINT_SIZE bytes below its caller's frame and saves where
+ they are. The benchmark run next from the same caller uses that part
+ of the stack and MeasureStack() scans it through the saved address
+ for how far down the fill was overwritten. They are called through
+ volatile function pointers so the compiler can't inline them.
+ */
+#define BENCH_STACK_PAINT_SIZE 32768
+#define BENCH_STACK_PAINT      0xa5
+
+/* An integer so it isn't a pointer to a local that has gone away */
+static uintptr_t suStackPaint;
+
+static void PaintStack(void)
+{
+   volatile uint8_t auStack[BENCH_STACK_PAINT_SIZE];
+
+   for(size_t i = 0; i < sizeof(auStack); i++) {
+      auStack[i] = BENCH_STACK_PAINT;
+   }
+   suStackPaint = (uintptr_t)auStack;
+}
+
+static size_t MeasureStack(void)
+{
+   const volatile uint8_t *pStack = (const volatile uint8_t *)suStackPaint;
+   size_t i;
+
+   /* The stack grows down so the untouched part is at the start */
+   for(i = 0; i < BENCH_STACK_PAINT_SIZE; i++) {
+      if(pStack[i] != BENCH_STACK_PAINT) {
+         break;
+      }
+   }
+   return BENCH_STACK_PAINT_SIZE - i;
+}
+
+static void (* volatile pfPaintStack)(void) = PaintStack;
+static size_t (* volatile pfMeasureStack)(void) = MeasureStack;
+
+
+static void OutputColumn(const char *szColumn,
+                         OutputStringCB pfOutput,
+                         void *pOutCtx,
+                         int bLast)
+{
+   (*pfOutput)(szColumn, pOutCtx, 0);
+   (*pfOutput)(bLast ? "" : ",", pOutCtx, bLast);
+}
+
+
+/*
+ Public function. See run_benchmarks.h.
+ */
+int RunBenchmarksQCBOR(const char *szBenchNames[],
+                       BenchmarkClockCB pfClock,
+                       void *pClockCtx,
+                       OutputStringCB pfOutput,
+                       void *pOutCtx)
+{
+   int nBenchFailed = 0;
+
+   UsefulBuf_MAKE_STACK_UB(StringStorage, 24);
+
+   (*pfOutput)("benchmark,iterations,items,bytes,ns_per_item,mb_per_s,stack_bytes", pOutCtx, 1);
+
+   bench_entry *b;
+   const bench_entry *s_benchmarks_end = s_benchmarks + sizeof(s_benchmarks)/sizeof(bench_entry);
+
+   for(b = s_benchmarks; b < s_benchmarks_end; b++) {
+      if(szBenchNames[0]) {
+         // Some benchmarks have been named
+         const char **szRequestedNames;
+         for(szRequestedNames = szBenchNames; *szRequestedNames;  szRequestedNames++) {
+            if(!strcmp(b->szBenchName, *szRequestedNames)) {
+               break; // Name matched
+            }
+         }
+         if(*szRequestedNames == NULL) {
+            // Didn't match this benchmark
+            continue;
+         }
+      } else {
+         // no benchmarks named, but don't run "disabled" benchmarks
+         if(!b->bEnabled) {
+            continue;
+         }
+      }
+
+      BenchmarkWork Work = {0, 0};
+      int32_t       nResult;
+
+      // One untimed iteration to warm up and set up the corpus, then
+      // one to measure the stack
+      nResult = (b->bench_fun)(1, &Work);
+      (*pfPaintStack)();
+      if(nResult == 0) {
+         nResult = (b->bench_fun)(1, &Work);
+      }
+      const size_t uStackBytes = (*pfMeasureStack)();
+
+      // Double the iterations until the run is long enough to time
+      uint32_t uIterations = 1;
+      uint64_t uElapsed = 0;
+      while(nResult == 0 && uIterations < UINT32_MAX/2) {
+         const uint64_t uStart = (*pfClock)(pClockCtx);
+         nResult = (b->bench_fun)(uIterations, &Work);
+         uElapsed = (*pfClock)(pClockCtx) - uStart;
+         if(uElapsed >= BENCH_MIN_NS) {
+            break;
+         }
+         uIterations *= 2;
+      }
+
+      OutputColumn(b->szBenchName, pfOutput, pOutCtx, 0);
+      if(nResult) {
+         (*pfOutput)("FAILED (returned ", pOutCtx, 0);
+         (*pfOutput)(UNumToString((uint64_t)nResult, 0, StringStorage), pOutCtx, 0);
+         (*pfOutput)(")", pOutCtx, 1);
+         nBenchFailed++;
+         continue;
+      }
+
+      const uint64_t uTotalItems = (uint64_t)uIterations * Work.uItems;
+      const uint64_t uTotalBytes = (uint64_t)uIterations * Work.uBytes;
+      if(uElapsed == 0) {
+         uElapsed = 1;
+      }
+
+      OutputColumn(UNumToString(uIterations, 0, StringStorage), pfOutput, pOutCtx, 0);
+      OutputColumn(UNumToString(Work.uItems, 0, StringStorage), pfOutput, pOutCtx, 0);
+      OutputColumn(UNumToString(Work.uBytes, 0, StringStorage), pfOutput, pOutCtx, 0);
+      OutputColumn(UNumToString(uTotalItems ? uElapsed * 100 / uTotalItems : 0, 2, StringStorage),
+                   pfOutput, pOutCtx, 0);
+      // bytes / ns * 1000 is MB/s; one more * 100 for two decimal places
+      OutputColumn(UNumToString(uTotalBytes * 100000 / uElapsed, 2, StringStorage),
+                   pfOutput, pOutCtx, 0);
+      OutputColumn(UNumToString(uStackBytes, 0, StringStorage), pfOutput, pOutCtx, 1);
+   }
+
+   return nBenchFailed;
+}
@@ -0,0 +1,85 @@
+/*==============================================================================
+ run_benchmarks.h -- benchmark aggregator and results reporting
+
+ Copyright (c) 2026, Laurence Lundblade. All rights reserved.
+
+ SPDX-License-Identifier: BSD-3-Clause
+
+ See BSD-3-Clause license in README.md
+
+ Created on 10/14/26
+ =============================================================================*/
+
+#include <stdint.h>
+#include "run_tests.h"
+
+/**
+ @file run_benchmarks.h
+*/
+
+/**
+ @brief Type for function to read a monotonic clock
+
+ @param[in] pClockCtx   A context pointer; NULL if not needed
+
+ @return The current time in nanoseconds.
+
+ This is a prototype of a function to be passed to
+ RunBenchmarksQCBOR() for timing. The starting point of the clock
+ doesn't matter, only that it doesn't go backwards. This is passed in
+ so the benchmarks themselves have no dependency on an OS.
+
+ With POSIX it can be implemented like this:
+
+ @code
+    static uint64_t clock_wrapper(void *pClockCtx)
+    {
+       struct timespec ts;
+       (void)pClockCtx;
+       clock_gettime(CLOCK_MONOTONIC, &ts);
+       return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    }
+ @endcode
+ */
+typedef uint64_t (*BenchmarkClockCB)(void *pClockCtx);
+
+
+/**
+ @brief Runs the QCBOR benchmarks.
+
+ @param[in]  szBenchNames  An argv-style list of benchmark names to
+                           run. If empty, all are run.
+ @param[in]  pfClock       Function that is called to read the clock.
+ @param[in]  pClockCtx     Context pointer passed to clock function.
+ @param[in]  pfOutput      Function that is called to output text strings.
+ @param[in]  pOutCtx       Context pointer passed to output function.
+
+ @return The number of benchmarks that failed. Zero means overall
+         success.
+
+ The output is comma-separated values, one line per benchmark after a
+ header line, so results from different releases can be compared with
+ diff or loaded into a spreadsheet. The columns are:
+
+ - benchmark: the name of the benchmark
+ - iterations: the number of times the operation was timed
+ - items: the number of data items in one iteration
+ - bytes: the number of encoded bytes in one iteration
+ - ns_per_item: nanoseconds per data item, to two decimal places
+ - mb_per_s: millions of encoded bytes per second, to two decimal places
+ - stack_bytes: approximate peak stack use of one iteration
+
+ The number of iterations is calibrated so each benchmark runs for
+ at least about a quarter of a second.
+
+ The stack use is measured by filling an area of the stack with a
+ pattern, running one iteration and seeing how much of the pattern
+ was overwritten. It is approximate because it includes the
+ benchmark function itself and it depends on the compiler's stack
+ layout, but it is good for seeing changes.
+ */
+int RunBenchmarksQCBOR(const char *szBenchNames[],
+                       BenchmarkClockCB pfClock,
+                       void *pClockCtx,
+                       OutputStringCB pfOutput,
+                       void *pOutCtx);
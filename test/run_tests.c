@@ -18,6 +18,8 @@
 #include "qcbor_decode_tests.h"
 #include "qcbor_encode_tests.h"
 #include "UsefulBuf_Tests.h"
+#include "qcbor/qcbor_common.h" // For the decoder feature profiles
+#include "qcbor/qcbor_encode.h" // For QCBOR_RING_LOAD_ACQUIRE
 
 
 /*
@@ -51,20 +53,51 @@ static test_entry2 s_tests2[] = {
     TEST_ENTRY(UOBTest_BoundaryConditionsTest),
     TEST_ENTRY(UBMacroConversionsTest),
     TEST_ENTRY(UBUtilTests),
+    TEST_ENTRY(UBUtilBigBufferTests),
     TEST_ENTRY(UIBTest_IntegerFormat)
 };
 
 
 static test_entry s_tests[] = {
     TEST_ENTRY(QCBORHeadTest),
+    // The tests that check QCBOR_MAX_ARRAY_NESTING are ones that encode
+    // or decode fixed input nested that deep
+#if QCBOR_MAX_ARRAY_NESTING >= 5
+    TEST_ENTRY(NoSlideEncodeTest),
+#endif
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && !defined(QCBOR_DISABLE_NON_INTEGER_LABELS) && \
+    QCBOR_MAX_ARRAY_NESTING >= 8
+    TEST_ENTRY(SinkEncodeTest),
+#endif
+#if QCBOR_MAX_ARRAY_NESTING >= 8
+    TEST_ENTRY(ReferenceEncodeTest),
+#endif
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && QCBOR_MAX_ARRAY_NESTING >= 5
+    TEST_ENTRY(DigestEncodeTest),
+#endif
+    TEST_ENTRY(TypedArrayEncodeTest),
+    TEST_ENTRY(FragmentEncodeTest),
+    TEST_ENTRY(LargeArrayTest),
+    TEST_ENTRY(RecordTest),
+#ifdef QCBOR_RING_LOAD_ACQUIRE
+    TEST_ENTRY(RingTest),
+#endif
     TEST_ENTRY(EmptyMapsAndArraysTest),
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS) && !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS)
     TEST_ENTRY(NotWellFormedTests),
+#endif
     TEST_ENTRY(ParseMapAsArrayTest),
+#ifndef QCBOR_DISABLE_NON_INTEGER_LABELS
     TEST_ENTRY(AllocAllStringsTest),
+#endif /* QCBOR_DISABLE_NON_INTEGER_LABELS */
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
     TEST_ENTRY(IndefiniteLengthNestTest),
     TEST_ENTRY(NestedMapTestIndefLen),
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS */
     TEST_ENTRY(ParseSimpleTest),
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS) && !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && !defined(QCBOR_DISABLE_TAGS)
     TEST_ENTRY(DecodeFailureTests),
+#endif
     TEST_ENTRY(EncodeRawTest),
     TEST_ENTRY(RTICResultsTest),
     TEST_ENTRY(MapEncodeTest),
@@ -74,46 +107,119 @@ static test_entry s_tests[] = {
     TEST_ENTRY(EncodeDateTest),
     TEST_ENTRY(SimpleValuesTest1),
     TEST_ENTRY(IntegerValuesTest1),
+#if QCBOR_MAX_ARRAY_NESTING >= 5
     TEST_ENTRY(AllAddMethodsTest),
+#endif
     TEST_ENTRY(ParseTooDeepArrayTest),
     TEST_ENTRY(ComprehensiveInputTest),
+#ifndef QCBOR_DISABLE_NON_INTEGER_LABELS
     TEST_ENTRY(ParseMapTest),
+#endif /* QCBOR_DISABLE_NON_INTEGER_LABELS */
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS
     TEST_ENTRY(IndefiniteLengthArrayMapTest),
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS */
     TEST_ENTRY(BasicEncodeTest),
     TEST_ENTRY(NestedMapTest),
+#if !defined(QCBOR_DISABLE_TAGS) && !defined(QCBOR_DISABLE_NON_INTEGER_LABELS)
     TEST_ENTRY(BignumParseTest),
+#endif
+#ifndef QCBOR_DISABLE_TAGS
     TEST_ENTRY(OptTagParseTest),
     TEST_ENTRY(DateParseTest),
+#endif /* QCBOR_DISABLE_TAGS */
     TEST_ENTRY(ShortBufferParseTest2),
     TEST_ENTRY(ShortBufferParseTest),
+#if QCBOR_MAX_ARRAY_NESTING >= 9
     TEST_ENTRY(ParseDeepArrayTest),
+#endif
     TEST_ENTRY(SimpleArrayTest),
     TEST_ENTRY(IntegerValuesParseTest),
     TEST_ENTRY(MemPoolTest),
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS) && !defined(QCBOR_DISABLE_NON_INTEGER_LABELS)
     TEST_ENTRY(IndefiniteLengthStringTest),
+#endif
+#ifndef QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS
+    TEST_ENTRY(IndefiniteStringOneAllocTest),
+    TEST_ENTRY(ArenaTest),
+#endif /* QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS */
+    TEST_ENTRY(DigestDecodeTest),
+#ifndef QCBOR_DISABLE_TAGS
+    TEST_ENTRY(TypedArrayDecodeTest),
+#endif /* QCBOR_DISABLE_TAGS */
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && !defined(QCBOR_DISABLE_TAGS)
+    TEST_ENTRY(NumberArrayDecodeTest),
+#endif
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS) && !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && !defined(QCBOR_DISABLE_TAGS)
+    TEST_ENTRY(SplitSequenceTest),
+#endif
+#ifndef QCBOR_DISABLE_TAGS
+    TEST_ENTRY(QueryTest),
+#endif /* QCBOR_DISABLE_TAGS */
+#if defined(QCBOR_CONFIG_ENABLE_STATS) && \
+    !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS) && !defined(QCBOR_DISABLE_TAGS)
+    TEST_ENTRY(StatsTest),
+#endif
+    TEST_ENTRY(DisabledFeaturesTest),
+#ifndef QCBOR_DISABLE_TAGS
+    TEST_ENTRY(StringRefTest),
+#endif /* QCBOR_DISABLE_TAGS */
+    TEST_ENTRY(CursorTest),
+    TEST_ENTRY(MapCheckTest),
 #ifndef QCBOR_DISABLE_PREFERRED_FLOAT
+#ifndef QCBOR_DISABLE_NON_INTEGER_LABELS
     TEST_ENTRY(HalfPrecisionDecodeBasicTests),
+#endif /* QCBOR_DISABLE_NON_INTEGER_LABELS */
     TEST_ENTRY(DoubleAsSmallestTest),
     TEST_ENTRY(HalfPrecisionAgainstRFCCodeTest),
+    TEST_ENTRY(HalfPrecisionAllValuesTest),
+    TEST_ENTRY(SinglePrecisionDecodeTest),
 #endif /* QCBOR_DISABLE_PREFERRED_FLOAT */
     TEST_ENTRY(GeneralFloatEncodeTests),
     TEST_ENTRY(GeneralFloatDecodeTests),
     TEST_ENTRY(BstrWrapTest),
     TEST_ENTRY(BstrWrapErrorTest),
+#if QCBOR_MAX_ARRAY_NESTING >= 13
     TEST_ENTRY(BstrWrapNestTest),
+#endif
     TEST_ENTRY(CoseSign1TBSTest),
+#ifndef QCBOR_DISABLE_NON_INTEGER_LABELS
     TEST_ENTRY(StringDecoderModeFailTest),
+#endif /* QCBOR_DISABLE_NON_INTEGER_LABELS */
     TEST_ENTRY_DISABLED(BigComprehensiveInputTest),
     TEST_ENTRY(EncodeErrorTests),
     TEST_ENTRY(SetUpAllocatorTest),
     TEST_ENTRY(SimpleValuesIndefiniteLengthTest1),
     TEST_ENTRY(EncodeLengthThirtyoneTest),
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && !defined(QCBOR_DISABLE_TAGS)
     TEST_ENTRY(CBORSequenceDecodeTests),
+#endif
     TEST_ENTRY(IntToTests),
+#ifndef QCBOR_DISABLE_NON_INTEGER_LABELS
+    TEST_ENTRY(IncrementalDecodeTest),
+#endif /* QCBOR_DISABLE_NON_INTEGER_LABELS */
+#ifndef QCBOR_DISABLE_TAGS
+    TEST_ENTRY(BatchDecodeTest),
+#endif /* QCBOR_DISABLE_TAGS */
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && !defined(QCBOR_DISABLE_NON_INTEGER_LABELS)
+    TEST_ENTRY(IndexedMapTest),
+#endif
+#ifndef QCBOR_DISABLE_TAGS
+    TEST_ENTRY(CustomTagsTest),
+#endif /* QCBOR_DISABLE_TAGS */
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_STRINGS) && !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && !defined(QCBOR_DISABLE_TAGS)
+    TEST_ENTRY(ValidateTest),
+#endif
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && !defined(QCBOR_DISABLE_TAGS) && !defined(QCBOR_DISABLE_NON_INTEGER_LABELS)
+    TEST_ENTRY(SkipTest),
+#endif
 #ifndef     QCBOR_CONFIG_DISABLE_EXP_AND_MANTISSA
     TEST_ENTRY(EncodeLengthThirtyoneTest),
+#ifndef QCBOR_DISABLE_TAGS
     TEST_ENTRY(ExponentAndMantissaDecodeTests),
+#endif /* QCBOR_DISABLE_TAGS */
+#if !defined(QCBOR_DISABLE_INDEFINITE_LENGTH_ARRAYS) && !defined(QCBOR_DISABLE_TAGS)
     TEST_ENTRY(ExponentAndMantissaDecodeFailTests),
+#endif
     TEST_ENTRY(ExponentAndMantissaEncodeTests),
 #endif /* QCBOR_CONFIG_DISABLE_EXP_AND_MANTISSA */
 };